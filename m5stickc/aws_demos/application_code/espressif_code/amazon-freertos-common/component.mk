@@ -94,6 +94,11 @@ COMPONENT_PRIV_INCLUDEDIRS := $(AMAZON_FREERTOS_ABSTRACTIONS_DIR)/pkcs11 \
                               $(AMAZON_FREERTOS_ARF_PORTS)/posix \
                               $(AMAZON_FREERTOS_ARF_PORTS)/ble
 
+# m5stickc_mem.c keeps its mbedTLS allocator in place of the one of CRYPTO_ConfigureHeap()
+ifdef CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+COMPONENT_ADD_LDFLAGS += -Wl,--wrap=CRYPTO_ConfigureHeap
+endif
+
 lib/greengrass/aws_greengrass_discovery.o: CFLAGS+=-Wno-format
 lib/common/aws_logging_task_dynamic_buffers.o: CFLAGS+=-Wno-format -Wno-uninitialized
 
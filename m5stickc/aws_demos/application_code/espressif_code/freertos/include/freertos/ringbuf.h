@@ -32,6 +32,12 @@ extern "C" {
  */
 typedef void * RingbufHandle_t;
 
+/**
+ * Type by which the readers of a broadcast ring buffer are referenced, see
+ * xRingbufferCreateBroadcast() and xRingbufferAddReader().
+ */
+typedef void * RingbufReaderHandle_t;
+
 typedef enum {
 	/**
 	 * No-split buffers will only store an item in contiguous memory and will
@@ -55,6 +61,82 @@ typedef enum {
 	RINGBUF_TYPE_BYTEBUF
 } ringbuf_type_t;
 
+/**
+ * What happens to a reader of a broadcast ring buffer that falls behind, when
+ * the oldest item it has not read yet is needed to make room for a new one.
+ */
+typedef enum {
+	/**
+	 * The item is dropped for the reader, which goes on with the next one. The
+	 * writer only waits while the reader copies that very item out.
+	 */
+	RINGBUF_READER_DROP = 0,
+	/**
+	 * The writer waits until the reader has read the item, or times out.
+	 */
+	RINGBUF_READER_BLOCK
+} ringbuf_reader_type_t;
+
+/**
+ * Item retrieved by uxRingbufferReceiveMultiple(). The tail part is only set for
+ * a split item of an allow-split buffer, it is NULL otherwise.
+ */
+typedef struct {
+	void *pvHeadItem;       /**< First (or only) part of the item */
+	size_t xHeadItemSize;   /**< Size of the first part */
+	void *pvTailItem;       /**< Second part of a split item, NULL if the item is not split */
+	size_t xTailItemSize;   /**< Size of the second part, 0 if the item is not split */
+} RingbufItem_t;
+
+/**
+ * Cumulative statistics of a ring buffer, see vRingbufferGetStats() and
+ * uxRingbufferGetAllStats(). The counters start at 0 when the ring buffer is
+ * created and wrap around, compare two readings to get a rate.
+ */
+typedef struct {
+	RingbufHandle_t xRingbuffer;    /**< Ring buffer the statistics belong to */
+	const char *pcName;             /**< Name given by vRingbufferSetName(), NULL if none */
+	size_t xSize;                   /**< Size of the buffer in bytes */
+	size_t xPeakUsed;               /**< Most bytes ever in use at once, headers and unused space at the end of the buffer included */
+	UBaseType_t uxItemsSent;        /**< Items sent (sends for byte buffers) */
+	UBaseType_t uxBytesSent;        /**< Bytes of data sent */
+	UBaseType_t uxSendTimeouts;     /**< Sends that failed for lack of space: timed out, or from an ISR */
+	UBaseType_t uxDroppedItems;     /**< Unread items (bytes for byte buffers) dropped to make room, see vRingbufferSetOverwrite(). Counted once per reader of a broadcast buffer */
+	UBaseType_t uxBlockedSends;     /**< Sends that had to wait for space */
+	TickType_t xBlockedTicks;       /**< Ticks spent by writers waiting for space */
+	UBaseType_t uxSplitItems;       /**< Items split in two parts at the end of an allow-split buffer */
+	UBaseType_t uxDummyWraps;       /**< Wrap arounds that left dummy data at the end of a no-split or allow-split buffer */
+	UBaseType_t uxWakeups;          /**< Blocked senders and receivers woken, locked buffers only */
+	UBaseType_t uxSpuriousWakeups;  /**< Woken senders and receivers that found no room or no item after all, and waited again */
+} RingbufStats_t;
+
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+/**
+ * Memory of the control block of a statically allocated ring buffer, see
+ * xRingbufferCreateStatic(). Its fields must not be accessed, it only has the
+ * size and the alignment of the control block.
+ */
+typedef struct xSTATIC_RINGBUFFER {
+	/** @cond */    //Doxygen command to hide the dummy fields from API Reference
+	size_t xDummy1;
+	UBaseType_t uxDummy2;
+	size_t xDummy3;
+	void *pvDummy4[5];
+	BaseType_t xDummy5;
+	void *pvDummy6[2];
+	BaseType_t xDummy7[2];
+	UBaseType_t uxDummy8[5];
+	void *pvDummy9[4];
+	RingbufStats_t xDummy10;
+	void *pvDummy11;
+#ifdef ESP_PLATFORM
+	portMUX_TYPE xDummy12;
+#endif
+	StaticSemaphore_t xDummy13[2];
+	/** @endcond */
+} StaticRingbuffer_t;
+#endif
+
 /**
  * @brief       Create a ring buffer
  *
@@ -81,12 +163,155 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
  */
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
 
+/**
+ * @brief Create a lock-free ring buffer for a single producer and a single consumer
+ *
+ * The buffer is used with the usual functions, but sending and receiving take
+ * no spinlock, and the semaphores are only used when the producer (or the
+ * consumer) actually has to block. Only one task or ISR may send to the
+ * buffer, and only one task or ISR may receive from it.
+ *
+ * @param[in]   xBufferSize Size of the buffer in bytes, see xRingbufferCreate()
+ * @param[in]   xBufferType RINGBUF_TYPE_NOSPLIT or RINGBUF_TYPE_BYTEBUF
+ *
+ * @note    Items must be returned in the order they were received.
+ * @note    One word (one byte for byte buffers) of the buffer always stays unused.
+ * @note    The read semaphore cannot be added to a queue set.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error or for RINGBUF_TYPE_ALLOWSPLIT.
+ */
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType);
+
+/**
+ * @brief Create a ring buffer that gives every item to several readers
+ *
+ * Every reader added with xRingbufferAddReader() gets every item sent after it
+ * was added, in order, with its own cursor over the single storage area. The
+ * items are stored as in a no-split buffer, and sent with xRingbufferSend() or
+ * xRingbufferSendFromISR(). They are only read with xRingbufferReceiveReader(),
+ * which copies them out: a reader never holds any space of the buffer.
+ *
+ * An item stays in the buffer until its space is needed, even after all the
+ * readers have read it. To make room, the writer drops the oldest item: for
+ * the RINGBUF_READER_DROP readers that have not read it yet, it is lost (see
+ * uxRingbufferGetReaderDropped()), but if a RINGBUF_READER_BLOCK reader has not
+ * read it yet, the writer waits for it.
+ *
+ * @param[in]   xBufferSize     Size of the buffer in bytes, see xRingbufferCreate()
+ * @param[in]   uxMaxReaders    Number of readers that can be added at once
+ *
+ * @note    xRingbufferSendAcquire(), the receive and return functions, the
+ *          queue sets and vRingbufferSetOverwrite() are not supported.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error.
+ */
+RingbufHandle_t xRingbufferCreateBroadcast(size_t xBufferSize, UBaseType_t uxMaxReaders);
+
+/**
+ * @brief Add a reader to a broadcast ring buffer
+ *
+ * The reader starts with the oldest item still in the buffer, readers added
+ * late still get the recent history.
+ *
+ * @param[in]   xRingbuffer     Broadcast ring buffer
+ * @param[in]   xReaderType     What happens when the reader falls behind
+ *
+ * @return  A handle to the reader, or NULL if uxMaxReaders readers were already added.
+ */
+RingbufReaderHandle_t xRingbufferAddReader(RingbufHandle_t xRingbuffer, ringbuf_reader_type_t xReaderType);
+
+/**
+ * @brief Remove a reader from its broadcast ring buffer
+ *
+ * @param[in]   xReader     Reader to remove, not receiving at the same time
+ */
+void vRingbufferRemoveReader(RingbufReaderHandle_t xReader);
+
+/**
+ * @brief Copy the next item of a reader of a broadcast ring buffer
+ *
+ * The item is copied outside of the critical section: the writers do not drop
+ * it meanwhile, a writer that needs its space waits for the copy (or fails,
+ * from an ISR), whatever the type of the reader.
+ *
+ * @param[in]   xReader         Reader
+ * @param[out]  pvBuffer        Buffer the item is copied to
+ * @param[in]   xBufferSize     Size of pvBuffer
+ * @param[out]  pxItemSize      Size of the item, 0 on time-out
+ * @param[in]   xTicksToWait    Ticks to wait for an item
+ *
+ * @note    Only one task may receive for a given reader at a time.
+ *
+ * @return
+ *      - pdTRUE if an item was copied
+ *      - pdFALSE on time-out, or if the item is larger than xBufferSize
+ *        (*pxItemSize): it is not copied, and stays the next item of the reader
+ */
+BaseType_t xRingbufferReceiveReader(RingbufReaderHandle_t xReader, void *pvBuffer, size_t xBufferSize, size_t *pxItemSize, TickType_t xTicksToWait);
+
+/**
+ * @brief Number of items a RINGBUF_READER_DROP reader missed
+ *
+ * @param[in]   xReader     Reader
+ *
+ * @return  The items dropped before the reader read them, since it was added
+ */
+UBaseType_t uxRingbufferGetReaderDropped(RingbufReaderHandle_t xReader);
+
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+/**
+ * @brief       Create a ring buffer in memory provided by the caller
+ *
+ * This API is similar to xRingbufferCreate(), but nothing is allocated: the
+ * storage area, the control block and the semaphores all live in the memory
+ * given by the caller, e.g. static variables, or variables placed in a
+ * specific region with DRAM_ATTR or RTC_NOINIT_ATTR.
+ *
+ * @param[in]   xBufferSize             Size of the buffer in bytes, and of pucRingbufferStorage
+ * @param[in]   xBufferType             Type of ring buffer, see documentation
+ * @param[in]   pucRingbufferStorage    Storage area of the buffer, 32-bit aligned for no-split/allow-split buffers
+ * @param[in]   pxStaticRingbuffer      Memory of the control block
+ *
+ * @note    xBufferSize of no-split/allow-split buffers must be 32-bit aligned, it is not rounded up.
+ * @note    The memory must stay valid until vRingbufferDelete() is called, which does not free it.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error.
+ */
+RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize, ringbuf_type_t xBufferType, uint8_t *pucRingbufferStorage, StaticRingbuffer_t *pxStaticRingbuffer);
+#endif
+
+/**
+ * @brief   Make a ring buffer drop its oldest data instead of making the senders wait
+ *
+ * When an item does not fit, the oldest items that have not been received yet
+ * are dropped until it does (for byte buffers, only as many bytes as needed).
+ * The drops are counted in RingbufStats_t.uxDroppedItems. Items that have been
+ * received and not returned yet are never dropped: while the receiver holds
+ * some, nothing can be made room for, and the send waits or fails as usual.
+ * No-split items that are acquired and not completed yet stop the dropping.
+ *
+ * @param[in]   xRingbuffer     Ring buffer
+ * @param[in]   xOverwrite      pdTRUE to drop the oldest data, pdFALSE to wait for room (the default)
+ *
+ * @note    Only no-split and byte buffers created by xRingbufferCreate() or
+ *          xRingbufferCreateStatic() are supported. Allow-split buffers may give
+ *          the two parts of an item to separate receives, and the receiver of
+ *          a SPSC buffer owns the read pointer.
+ */
+void vRingbufferSetOverwrite(RingbufHandle_t xRingbuffer, BaseType_t xOverwrite);
+
 /**
  * @brief       Insert an item into the ring buffer
  *
  * Attempt to insert an item into the ring buffer. This function will block until
  * enough free space is available or until it timesout.
  *
+ * Blocked senders are woken in priority order (in arrival order within a
+ * priority), and only once their item fits: a blocked sender of a large item
+ * does not keep a sender of a small item that fits from being woken. The same
+ * goes for the receive functions, a receiver is only woken for an item that no
+ * other woken receiver is about to take.
+ *
  * @param[in]   xRingbuffer     Ring buffer to insert the item into
  * @param[in]   pvItem          Pointer to data to insert. NULL is allowed if xItemSize is 0.
  * @param[in]   xItemSize       Size of data to insert.
@@ -125,6 +350,40 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size
  */
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief       Acquire space for an item in a no-split ring buffer
+ *
+ * Attempt to reserve space for an item, so that it can be written in place
+ * instead of being copied in. This function will block until enough free space
+ * is available or until it timesout. The item is not retrieved before
+ * xRingbufferSendComplete() is called on it.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to reserve the item in
+ * @param[out]  ppvItem         Double pointer to the reserved space (unmodified on failure)
+ * @param[in]   xItemSize       Size of the item to reserve.
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note    This function should only be called on no-split buffers
+ * @note    Items are retrieved in the order they were acquired: an item that
+ *          is acquired and not completed holds back the items acquired after it.
+ * @note    A SPSC buffer only allows one acquired item at a time.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the item is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+
+/**
+ * @brief       Complete an item acquired by xRingbufferSendAcquire()
+ *
+ * @param[in]   xRingbuffer     Ring buffer the item was acquired in
+ * @param[in]   pvItem          Pointer returned by xRingbufferSendAcquire()
+ *
+ * @return  pdTRUE
+ */
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem);
+
 /**
  * @brief   Retrieve an item from the ring buffer
  *
@@ -186,6 +445,27 @@ void *xRingbufferReceiveFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize)
  */
 BaseType_t xRingbufferReceiveSplit(RingbufHandle_t xRingbuffer, void **ppvHeadItem, void **ppvTailItem, size_t *pxHeadItemSize, size_t *pxTailItemSize, TickType_t xTicksToWait);
 
+/**
+ * @brief   Retrieve several items from a no-split/allow-split ring buffer
+ *
+ * Attempt to retrieve up to uxMaxItems items in one go. This function will
+ * block until at least one item is available or until it timesout, and then
+ * retrieves all the items available at that time (up to uxMaxItems) in a single
+ * critical section.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  pxItems         Array of at least uxMaxItems descriptors, filled with the retrieved items
+ * @param[in]   uxMaxItems      Maximum number of items to retrieve
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    A call to vRingbufferReturnMultiple() (or one to vRingbufferReturnItem()
+ *          for each part of each item) is required after this to free the items retrieved.
+ * @note    This function should not be called on byte buffers
+ *
+ * @return  Number of items retrieved, 0 on timeout
+ */
+UBaseType_t uxRingbufferReceiveMultiple(RingbufHandle_t xRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxMaxItems, TickType_t xTicksToWait);
+
 /**
  * @brief   Retrieve a split item from an allow-split ring buffer in an ISR
  *
@@ -265,6 +545,19 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
  */
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
 
+/**
+ * @brief   Return items retrieved by uxRingbufferReceiveMultiple() to the ring buffer
+ *
+ * All the items (both parts of split items) are returned in a single critical section.
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   pxItems     Descriptors filled by uxRingbufferReceiveMultiple()
+ * @param[in]   uxItems     Number of items to return
+ *
+ * @note    Items of a SPSC ring buffer must be returned in the order they were retrieved
+ */
+void vRingbufferReturnMultiple(RingbufHandle_t xRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxItems);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer from an ISR
  *
@@ -281,6 +574,8 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
  * @brief   Delete a ring buffer
  *
  * @param[in]   xRingbuffer     Ring buffer to delete
+ *
+ * @note    The memory of a ring buffer created with xRingbufferCreateStatic() is not freed.
  */
 void vRingbufferDelete(RingbufHandle_t xRingbuffer);
 
@@ -320,6 +615,8 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
  * to the ring buffer. This function adds the ring buffer's read semaphore to
  * a queue set.
  *
+ * @note    Not supported by SPSC and broadcast ring buffers.
+ *
  * @param[in]   xRingbuffer     Ring buffer to add to the queue set
  * @param[in]   xQueueSet       Queue set to add the ring buffer's read semaphore to
  *
@@ -382,6 +679,52 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer, UBaseType_t *uxFree, UBaseT
  */
 void xRingbufferPrintInfo(RingbufHandle_t xRingbuffer);
 
+/**
+ * @brief   Name a ring buffer
+ *
+ * The name identifies the ring buffer in its statistics (see RingbufStats_t).
+ *
+ * @param[in]   xRingbuffer     Ring buffer to name
+ * @param[in]   pcName          Name of the ring buffer. The string is not copied, it must outlive the ring buffer
+ */
+void vRingbufferSetName(RingbufHandle_t xRingbuffer, const char *pcName);
+
+/**
+ * @brief   Get the name of a ring buffer
+ *
+ * @param[in]   xRingbuffer     Ring buffer to get the name of
+ *
+ * @return  The name given by vRingbufferSetName(), or NULL if none was given
+ */
+const char *pcRingbufferGetName(RingbufHandle_t xRingbuffer);
+
+/**
+ * @brief   Get the cumulative statistics of a ring buffer
+ *
+ * @param[in]   xRingbuffer     Ring buffer to get the statistics of
+ * @param[out]  pxStats         Pointer used to store the statistics
+ *
+ * @note    The statistics of a SPSC ring buffer are only written by its
+ *          producer. Their fields are read one by one, without a lock.
+ */
+void vRingbufferGetStats(RingbufHandle_t xRingbuffer, RingbufStats_t *pxStats);
+
+/**
+ * @brief   Get the cumulative statistics of all the ring buffers
+ *
+ * Every ring buffer is registered when it is created, and removed from the
+ * registry when it is deleted. The statistics are copied while the registry is
+ * locked, so a ring buffer can be deleted at any time by another task. The
+ * xRingbuffer field of the statistics identifies a ring buffer, it should not
+ * be used to access it.
+ *
+ * @param[out]  pxStats     Array used to store the statistics, the most recently created ring buffer first
+ * @param[in]   uxMaxStats  Number of elements of pxStats
+ *
+ * @return  Number of ring buffers. Only the statistics of the first uxMaxStats are stored if it is larger
+ */
+UBaseType_t uxRingbufferGetAllStats(RingbufStats_t *pxStats, UBaseType_t uxMaxStats);
+
 /* -------------------------------- Deprecated Functions --------------------------- */
 
 /** @cond */    //Doxygen command to hide deprecated function from API Reference
@@ -396,7 +739,8 @@ bool xRingbufferIsNextItemWrapped(RingbufHandle_t xRingbuffer) __attribute__((de
  * Deprecated as queue sets are not meant to be used for writing to buffers. Adding
  * the ring buffer write semaphore to a queue set will break queue set usage rules,
  * as every read of a semaphore must be preceded by a call to xQueueSelectFromSet().
- * QueueSetWrite no longer supported.
+ * QueueSetWrite no longer supported, and the write semaphore is no longer given
+ * (blocked senders are woken one by one).
  */
 BaseType_t xRingbufferAddToQueueSetWrite(RingbufHandle_t xRingbuffer, QueueSetHandle_t xQueueSet) __attribute__((deprecated));
 
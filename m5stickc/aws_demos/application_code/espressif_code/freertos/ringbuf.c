@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
@@ -23,15 +25,87 @@
 #define rbALIGN_SIZE( xSize )       ( ( xSize + portBYTE_ALIGNMENT_MASK ) & ~portBYTE_ALIGNMENT_MASK )
 #define rbCHECK_ALIGNED( pvPtr )    ( ( ( UBaseType_t ) pvPtr & portBYTE_ALIGNMENT_MASK ) == 0 )
 
+/*
+ * Locking. On the ESP32 the ring buffer is protected by its own spinlock. Other
+ * ports (e.g. the FreeRTOS POSIX port, to build and exercise this file on a host)
+ * are single core without spinlocks, a critical section is enough there. The
+ * POSIX port has no real interrupts, the ISR variants do the same.
+ */
+#ifdef ESP_PLATFORM
+#define rbINIT_LOCK( pxRb )             vPortCPUInitializeMutex( &( pxRb )->mux )
+#define rbENTER_CRITICAL( pxRb )        portENTER_CRITICAL( &( pxRb )->mux )
+#define rbEXIT_CRITICAL( pxRb )         portEXIT_CRITICAL( &( pxRb )->mux )
+#define rbENTER_CRITICAL_ISR( pxRb )    portENTER_CRITICAL_ISR( &( pxRb )->mux )
+#define rbEXIT_CRITICAL_ISR( pxRb )     portEXIT_CRITICAL_ISR( &( pxRb )->mux )
+#else
+#define rbINIT_LOCK( pxRb )             ( ( void ) ( pxRb ) )
+#define rbENTER_CRITICAL( pxRb )        taskENTER_CRITICAL()
+#define rbEXIT_CRITICAL( pxRb )         taskEXIT_CRITICAL()
+#define rbENTER_CRITICAL_ISR( pxRb )    taskENTER_CRITICAL()
+#define rbEXIT_CRITICAL_ISR( pxRb )     taskEXIT_CRITICAL()
+#endif
+
+/*
+ * Registry of all the ring buffers (see uxRingbufferGetAllStats()), protected by
+ * its own lock. A ring buffer lock may be taken while holding the registry lock,
+ * never the other way round.
+ */
+#ifdef ESP_PLATFORM
+static portMUX_TYPE xRegistryMux = portMUX_INITIALIZER_UNLOCKED;
+#define rbENTER_REGISTRY()              portENTER_CRITICAL( &xRegistryMux )
+#define rbEXIT_REGISTRY()               portEXIT_CRITICAL( &xRegistryMux )
+#else
+#define rbENTER_REGISTRY()              taskENTER_CRITICAL()
+#define rbEXIT_REGISTRY()               taskEXIT_CRITICAL()
+#endif
+
+/*
+ * Single-producer/single-consumer buffers (see xRingbufferCreateSPSC()) take no
+ * lock. The producer owns pucWrite, the consumer owns pucRead and pucFree. Each
+ * side publishes its pointer with a release store, and reads the pointer of the
+ * other side with an acquire load.
+ */
+#define rbLOAD_ACQUIRE( x )             __atomic_load_n( &( x ), __ATOMIC_ACQUIRE )
+#define rbSTORE_RELEASE( x, xValue )    __atomic_store_n( &( x ), ( xValue ), __ATOMIC_RELEASE )
+#define rbFULL_BARRIER()                __atomic_thread_fence( __ATOMIC_SEQ_CST )
+
 //Ring buffer flags
 #define rbALLOW_SPLIT_FLAG          ( ( UBaseType_t ) 1 )   //The ring buffer allows items to be split
 #define rbBYTE_BUFFER_FLAG          ( ( UBaseType_t ) 2 )   //The ring buffer is a byte buffer
 #define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
+#define rbSPSC_FLAG                 ( ( UBaseType_t ) 8 )   //Single producer and single consumer, lock-free. Never uses rbBUFFER_FULL_FLAG
+#define rbBUFFER_STATIC_FLAG        ( ( UBaseType_t ) 16 )  //The ring buffer was created with xRingbufferCreateStatic(), its memory is not freed
+#define rbOVERWRITE_FLAG            ( ( UBaseType_t ) 32 )  //Sends drop the oldest unread items/data to make room (see vRingbufferSetOverwrite())
+#define rbBROADCAST_FLAG            ( ( UBaseType_t ) 64 )  //No-split buffer read by several readers with their own cursors (see xRingbufferCreateBroadcast())
+#define rbQUEUE_SET_READ_FLAG       ( ( UBaseType_t ) 128 ) //xItemsBufferedSemaphore is in a queue set (see xRingbufferAddToQueueSetRead())
+
+/*
+ * Type specialization. The operations that depend on the type of the buffer are
+ * not called through function pointers: rbSPECIALIZE() expands a statement once
+ * for each type, with xType declared as a constant of that type, and the
+ * dispatch functions (prvCheckItemFits(), prvCopyItem(), ...) are always inlined
+ * so that each expansion only keeps the code of its own type.
+ */
+#define rbFORCE_INLINE                  inline __attribute__((always_inline))
+#define rbSPECIALIZE( pxRb, xType, xStatement )                                 \
+    do {                                                                        \
+        if ( ( pxRb )->uxRingbufferFlags & rbBYTE_BUFFER_FLAG ) {               \
+            const ringbuf_type_t xType = RINGBUF_TYPE_BYTEBUF;                  \
+            xStatement;                                                         \
+        } else if ( ( pxRb )->uxRingbufferFlags & rbALLOW_SPLIT_FLAG ) {        \
+            const ringbuf_type_t xType = RINGBUF_TYPE_ALLOWSPLIT;               \
+            xStatement;                                                         \
+        } else {                                                                \
+            const ringbuf_type_t xType = RINGBUF_TYPE_NOSPLIT;                  \
+            xStatement;                                                         \
+        }                                                                       \
+    } while ( 0 )
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
 #define rbITEM_DUMMY_DATA_FLAG      ( ( UBaseType_t ) 2 )   //Data from here to end of the ring buffer is dummy data. Restart reading at start of head of the buffer
 #define rbITEM_SPLIT_FLAG           ( ( UBaseType_t ) 4 )   //Valid for RINGBUF_TYPE_ALLOWSPLIT, indicating that rest of the data is wrapped around
+#define rbITEM_WRITTEN_FLAG         ( ( UBaseType_t ) 8 )   //Valid for RINGBUF_TYPE_NOSPLIT, the data has been written (see xRingbufferSendAcquire()) and can be retrieved
 
 typedef struct {
     //This size of this structure must be 32-bit aligned
@@ -41,36 +115,78 @@ typedef struct {
 
 #define rbHEADER_SIZE     sizeof(ItemHeader_t)
 typedef struct Ringbuffer_t Ringbuffer_t;
-typedef BaseType_t (*CheckItemFitsFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
-typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const uint8_t *pcItem, size_t xItemSize);
-typedef BaseType_t (*CheckItemAvailFunction_t) (Ringbuffer_t *pxRingbuffer);
-typedef void *(*GetItemFunction_t)(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xMaxSize, size_t *pxItemSize);
-typedef void (*ReturnItemFunction_t)(Ringbuffer_t *pxRingbuffer, uint8_t *pvItem);
-typedef size_t (*GetCurMaxSizeFunction_t)(Ringbuffer_t *pxRingbuffer);
+
+//Reader of a broadcast ring buffer. The semaphore of a slot lives as long as the ring buffer
+typedef struct {
+    Ringbuffer_t *pxRingbuffer;                 //Ring buffer read, NULL if the slot is unused
+    uint8_t *pucRead;                           //Next item to read
+    BaseType_t xItemsWaiting;                   //Items in the ring buffer that the reader has not read yet
+    ringbuf_reader_type_t xReaderType;          //What happens when the reader falls behind
+    UBaseType_t uxDropped;                      //Items dropped before the reader read them
+    BaseType_t xCopying;                        //The reader copies its next item out of the critical section, the writers may not drop it meanwhile
+    SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore, given when an item is sent while the reader waits
+    volatile BaseType_t xWaiting;               //The reader is about to block on xItemsBufferedSemaphore
+} RingbufReader_t;
+
+/*
+ * Task blocked on a locked ring buffer, on the stack of the task. The waiters
+ * of a ring buffer are listed by priority, in arrival order within a priority.
+ * The task that wakes a waiter unlinks it within the critical section and
+ * gives its semaphore right after.
+ */
+typedef struct RingbufWaiter {
+    struct RingbufWaiter *pxNext;
+    UBaseType_t uxPriority;                     //Priority of the task when it started to wait
+    size_t xItemSize;                           //Senders only: size of the item to send
+    SemaphoreHandle_t xSemaphore;               //Binary semaphore, given once by the task that unlinks the waiter
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+    StaticSemaphore_t xSemaphoreStatic;
+#endif
+} RingbufWaiter_t;
 
 struct Ringbuffer_t {
     size_t xSize;                               //Size of the data storage
     UBaseType_t uxRingbufferFlags;              //Flags to indicate the type and status of ring buffer
     size_t xMaxItemSize;                        //Maximum item size
 
-    CheckItemFitsFunction_t xCheckItemFits;     //Function to check if item can currently fit in ring buffer
-    CopyItemFunction_t vCopyItem;               //Function to copy item to ring buffer
-    GetItemFunction_t pvGetItem;                //Function to get item from ring buffer
-    ReturnItemFunction_t vReturnItem;           //Function to return item to ring buffer
-    GetCurMaxSizeFunction_t xGetCurMaxSize;     //Function to get current free size
-
     uint8_t *pucWrite;                          //Write Pointer. Points to where the next item should be written
     uint8_t *pucRead;                           //Read Pointer. Points to where the next item should be read from
     uint8_t *pucFree;                           //Free Pointer. Points to the last item that has yet to be returned to the ring buffer
     uint8_t *pucHead;                           //Pointer to the start of the ring buffer storage area
     uint8_t *pucTail;                           //Pointer to the end of the ring buffer storage area
 
-    BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read
-    SemaphoreHandle_t xFreeSpaceSemaphore;      //Binary semaphore, wakes up writing threads when more free space becomes available or when another thread times out attempting to write
-    SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore, indicates there are new packets in the circular buffer. See remark.
+    BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read. Broadcast: items in the ring buffer
+    SemaphoreHandle_t xFreeSpaceSemaphore;      //Binary semaphore of the SPSC producer and of the broadcast writers. Locked buffers wake their senders through pxSendWaiters
+    SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore of the SPSC consumer, and of queue sets (indicates there are new packets in the circular buffer). See remark.
+    volatile BaseType_t xWriterWaiting;         //SPSC: the producer is about to block on xFreeSpaceSemaphore. Broadcast: writers blocked on it
+    volatile BaseType_t xReaderWaiting;         //SPSC only: the consumer is about to block on xItemsBufferedSemaphore
+    UBaseType_t uxSent;                         //SPSC only: items/bytes sent, only written by the producer
+    UBaseType_t uxReceived;                     //SPSC only: items/bytes received, only written by the consumer
+    UBaseType_t uxMaxReaders;                   //Broadcast only: number of reader slots
+    UBaseType_t uxSendersWoken;                 //Locked only: senders unlinked from pxSendWaiters that have not tried again yet
+    UBaseType_t uxReceiversWoken;               //Locked only: receivers unlinked from pxReceiveWaiters that have not tried again yet
+    uint8_t *pucAcquired;                       //SPSC only: item acquired by the producer and not yet completed
+    RingbufReader_t *pxReaders;                 //Broadcast only: reader slots
+    RingbufWaiter_t *pxSendWaiters;             //Locked only: blocked senders, by priority
+    RingbufWaiter_t *pxReceiveWaiters;          //Locked only: blocked receivers, by priority
+    RingbufStats_t xStats;                      //Cumulative statistics. Written under the lock, or only by the producer of SPSC buffers
+    Ringbuffer_t *pxNext;                       //Next ring buffer in the registry
+#ifdef ESP_PLATFORM
     portMUX_TYPE mux;                           //Spinlock required for SMP
+#endif
 };
 
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+//Control block of a statically allocated ring buffer. StaticRingbuffer_t must match it
+typedef struct {
+    Ringbuffer_t xRingbuffer;
+    StaticSemaphore_t xFreeSpaceSemaphoreStatic;
+    StaticSemaphore_t xItemsBufferedSemaphoreStatic;
+} RingbufferStatic_t;
+
+_Static_assert(sizeof(StaticRingbuffer_t) == sizeof(RingbufferStatic_t), "StaticRingbuffer_t does not match the control block");
+#endif
+
 /*
 Remark: A counting semaphore for items_buffered_sem would be more logical, but counting semaphores in
 FreeRTOS need a maximum count, and allocate more memory the larger the maximum count is. Here, we
@@ -78,6 +194,9 @@ would need to set the maximum to the maximum amount of times a null-byte unit fi
 which is quite high and so would waste a fair amount of memory.
 */
 
+//Most recently created ring buffer, head of the registry
+static Ringbuffer_t *pxRegistryHead = NULL;
+
 /* ------------------------------------------------ Static Declarations ------------------------------------------ */
 /*
  * WARNING: All of the following static functions (except generic functions)
@@ -88,8 +207,14 @@ which is quite high and so would waste a fair amount of memory.
 //Calculate current amount of free space (in bytes) in the ring buffer
 static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer);
 
+//Initialize a ring buffer whose memory and semaphores are already allocated, and register it
+static void prvInitializeNewRingbuffer(size_t xBufferSize, ringbuf_type_t xBufferType, Ringbuffer_t *pxNewRingbuffer, uint8_t *pucRingbufferStorage);
+
+//Update the statistics of a sent item. xUsed is the number of bytes in use once it is sent
+static void prvRecordSend(Ringbuffer_t *pxRingbuffer, size_t xItemSize, size_t xUsed);
+
 //Checks if an item/data is currently available for retrieval
-static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer);
+static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType);
 
 //Checks if an item will currently fit in a no-split/allow-split ring buffer
 static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
@@ -97,6 +222,9 @@ static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xI
 //Checks if an item will currently fit in a byte buffer
 static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 
+//Reserves space for an item in a no-split ring buffer and returns a pointer to it. Only call this function after calling prvCheckItemFitsDefault()
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
 //Copies an item to a no-split ring buffer. Only call this function after calling prvCheckItemFitsDefault()
 static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
 
@@ -127,6 +255,24 @@ static size_t prvGetCurMaxSizeAllowSplit(Ringbuffer_t *pxRingbuffer);
 //Get the maximum size an item that can currently have if sent to a byte buffer
 static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer);
 
+//Dispatch to the function of buffer type xType. Only call these with a constant xType (see rbSPECIALIZE())
+static rbFORCE_INLINE BaseType_t prvCheckItemFits(Ringbuffer_t *pxRingbuffer, size_t xItemSize, const ringbuf_type_t xType);
+static rbFORCE_INLINE void prvCopyItem(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, const ringbuf_type_t xType);
+static rbFORCE_INLINE void *prvGetItem(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xMaxSize, size_t *pxItemSize, const ringbuf_type_t xType);
+static rbFORCE_INLINE void prvReturnItem(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem, const ringbuf_type_t xType);
+static rbFORCE_INLINE size_t prvGetCurMaxSize(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType);
+
+//Drop the oldest unread items/data of a no-split ring buffer or byte buffer until an item fits. Returns pdFALSE if it still does not fit
+static rbFORCE_INLINE BaseType_t prvMakeRoom(Ringbuffer_t *pxRingbuffer, size_t xItemSize, const ringbuf_type_t xType);
+
+/**
+ * Generic function used to send an item/data to ring buffers. If ppvItem is not
+ * NULL, space is only reserved for the item in a no-split buffer and a pointer
+ * to it is returned in *ppvItem, the item is sent by xRingbufferSendComplete().
+ */
+static BaseType_t prvSendGeneric(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+static rbFORCE_INLINE BaseType_t prvSendGenericType(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait, const ringbuf_type_t xType);
+
 /**
  * Generic function used to retrieve an item/data from ring buffers. If called on
  * an allow-split buffer, and pvItem2 and xItemSize2 are not NULL, both parts of
@@ -134,9 +280,90 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer);
  * byte buffers.
  */
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait);
+static rbFORCE_INLINE BaseType_t prvReceiveGenericType(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait, const ringbuf_type_t xType);
 
 //Generic function used to retrieve an item/data from ring buffers in an ISR
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize);
+static rbFORCE_INLINE BaseType_t prvReceiveGenericFromISRType(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, const ringbuf_type_t xType);
+
+//Retrieve up to uxMaxItems available items (both parts of split items) from a no-split/allow-split ring buffer
+static rbFORCE_INLINE UBaseType_t prvGetItems(Ringbuffer_t *pxRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxMaxItems, const ringbuf_type_t xType);
+
+/*
+ * Blocking on locked ring buffers. A sender is only woken once its item fits,
+ * the first sender in priority order whose item fits, and only one at a time:
+ * the woken sender passes the wakeup on when it has tried again. A receiver is
+ * only woken for an item that no other woken receiver is about to take. The
+ * prvWake functions must be called within the critical section, and return
+ * the semaphore to give after it, or NULL.
+ */
+static rbFORCE_INLINE SemaphoreHandle_t prvWakeSender(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType);
+static rbFORCE_INLINE SemaphoreHandle_t prvWakeReceiver(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType);
+
+//Set up a waiter for the calling task, with its semaphore. Called outside of the critical section
+static BaseType_t prvInitWaiter(RingbufWaiter_t *pxWaiter, size_t xItemSize);
+
+//Insert a waiter in a list, after the waiters of the same or a higher priority. Called within the critical section
+static void prvInsertWaiter(RingbufWaiter_t **ppxList, RingbufWaiter_t *pxWaiter);
+
+/*
+ * Block on a waiter inserted in a list, until woken or timeout. Called outside
+ * of the critical section, returns within it with the waiter unlinked. Returns
+ * pdTRUE if the waiter was woken, and then counts it out of *puxWoken.
+ */
+static BaseType_t prvBlockWaiter(Ringbuffer_t *pxRingbuffer, RingbufWaiter_t **ppxList, UBaseType_t *puxWoken, RingbufWaiter_t *pxWaiter, TickType_t xTicksToWait);
+
+//Keep the read semaphore of a ring buffer in a queue set given while items are waiting. Called outside of the critical section
+static void prvQueueSetSent(Ringbuffer_t *pxRingbuffer, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken);
+static void prvQueueSetReceived(Ringbuffer_t *pxRingbuffer, BaseType_t xItemsLeft, BaseType_t xFromISR);
+
+/*
+ * The following SPSC functions are lock-free. The send functions may only be
+ * called by the producer, the receive and return functions by the consumer.
+ */
+
+//Copy an item/data to a SPSC no-split ring buffer or byte buffer if it fits. Returns pdFALSE otherwise.
+//If ppvItem is not NULL, space is only reserved for the item in a no-split buffer, see prvCompleteSPSC()
+static BaseType_t prvTrySendSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, void **ppvItem, size_t xItemSize);
+
+//Publish an item reserved by prvTrySendSPSC() to the consumer
+static void prvCompleteSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Retrieve an item/data from a SPSC ring buffer. Returns NULL if none is available
+static void *prvTryReceiveSPSC(Ringbuffer_t *pxRingbuffer, size_t xMaxSize, size_t *pxItemSize);
+
+//Return an item/data to a SPSC ring buffer. Items must be returned in the order they were retrieved
+static void prvReturnItemSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Give the semaphore of the other side if it is waiting on it
+static void prvWakeSPSC(volatile BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken);
+
+//Blocking send and receive of SPSC ring buffers
+static BaseType_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+static void *prvReceiveSPSC(Ringbuffer_t *pxRingbuffer, size_t xMaxSize, size_t *pxItemSize, TickType_t xTicksToWait);
+
+/*
+ * Broadcast ring buffers store the items as no-split buffers do. pucFree points
+ * to the oldest item, which stays until its space is needed, and pucWrite to
+ * where the next one goes. Each reader has its own read pointer and count of
+ * items waiting: a reader that has not read the oldest item has all the items
+ * of the buffer waiting.
+ */
+
+//Advance a read pointer (or the free pointer) of a broadcast ring buffer past the item it points to
+static void prvSkipItemBroadcast(Ringbuffer_t *pxRingbuffer, uint8_t **ppucItem);
+
+//Drop the oldest item of a broadcast ring buffer for all the readers. Returns pdFALSE if a RINGBUF_READER_BLOCK reader has not read it yet, or a reader is copying it
+static BaseType_t prvDropOldestBroadcast(Ringbuffer_t *pxRingbuffer);
+
+//Copy an item to a broadcast ring buffer, dropping the oldest items if necessary. Returns pdFALSE if it does not fit
+static BaseType_t prvTrySendBroadcast(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Give the semaphores of the readers waiting for an item. Called outside of the critical section
+static void prvWakeReaders(Ringbuffer_t *pxRingbuffer, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken);
+
+//Blocking send of broadcast ring buffers
+static BaseType_t prvSendBroadcast(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, TickType_t xTicksToWait);
 
 /* ------------------------------------------------ Static Definitions ------------------------------------------- */
 
@@ -157,6 +384,15 @@ static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
     return xReturn;
 }
 
+static void prvRecordSend(Ringbuffer_t *pxRingbuffer, size_t xItemSize, size_t xUsed)
+{
+    pxRingbuffer->xStats.uxItemsSent++;
+    pxRingbuffer->xStats.uxBytesSent += xItemSize;
+    if (xUsed > pxRingbuffer->xStats.xPeakUsed) {
+        pxRingbuffer->xStats.xPeakUsed = xUsed;
+    }
+}
+
 static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xItemSize)
 {
     //Check arguments and buffer state
@@ -202,7 +438,7 @@ static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t
     return (xItemSize <= pxRingbuffer->xSize - (pxRingbuffer->pucWrite - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
 }
 
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
 {
     //Check arguments and buffer state
     size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
@@ -217,16 +453,15 @@ static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
         pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;      //Set remaining length as dummy data
         pxDummy->xItemLen = 0;                              //Dummy data should have no length
         pxRingbuffer->pucWrite = pxRingbuffer->pucHead;     //Reset write pointer to wrap around
+        pxRingbuffer->xStats.uxDummyWraps++;
     }
 
-    //Item should be guaranteed to fit at this point. Set item header and copy data
+    //Item should be guaranteed to fit at this point. Set item header, the data is not written yet
     ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;
+    uint8_t *pucData = pxRingbuffer->pucWrite + rbHEADER_SIZE;
     pxHeader->xItemLen = xItemSize;
     pxHeader->uxItemFlags = 0;
-    pxRingbuffer->pucWrite += rbHEADER_SIZE;    //Advance pucWrite past header
-    memcpy(pxRingbuffer->pucWrite, pucItem, xItemSize);
-    pxRingbuffer->xItemsWaiting++;
-    pxRingbuffer->pucWrite += xAlignedItemSize; //Advance pucWrite past item to next aligned address
+    pxRingbuffer->pucWrite = pucData + xAlignedItemSize;    //Advance pucWrite past header and item to next aligned address
 
     //If current remaining length can't fit a header, wrap around write pointer
     if (pxRingbuffer->pucTail - pxRingbuffer->pucWrite < rbHEADER_SIZE) {
@@ -237,6 +472,15 @@ static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
         //Mark the buffer as full to distinguish with an empty buffer
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
     }
+    return pucData;
+}
+
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucData = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+    memcpy(pucData, pucItem, xItemSize);
+    ((ItemHeader_t *)(pucData - rbHEADER_SIZE))->uxItemFlags |= rbITEM_WRITTEN_FLAG;
+    pxRingbuffer->xItemsWaiting++;
 }
 
 static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
@@ -264,9 +508,11 @@ static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *puc
             xItemSize -= xRemLen;
             xAlignedItemSize -= xRemLen;
             pxFirstHeader->uxItemFlags |= rbITEM_SPLIT_FLAG;        //There must be more data
+            pxRingbuffer->xStats.uxSplitItems++;
         } else {
             //Remaining length was only large enough to fit header
             pxFirstHeader->uxItemFlags |= rbITEM_DUMMY_DATA_FLAG;   //Item will completely be stored in 2nd part
+            pxRingbuffer->xStats.uxDummyWraps++;
         }
         pxRingbuffer->pucWrite = pxRingbuffer->pucHead;             //Reset write pointer to start of buffer
     }
@@ -321,12 +567,20 @@ static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
     }
 }
 
-static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer)
+static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType)
 {
-    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && pxRingbuffer->pucRead != pxRingbuffer->pucFree) {
+    if ((xType == RINGBUF_TYPE_BYTEBUF) && pxRingbuffer->pucRead != pxRingbuffer->pucFree) {
         return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
     }
     if ((pxRingbuffer->xItemsWaiting > 0) && ((pxRingbuffer->pucRead != pxRingbuffer->pucWrite) || (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG))) {
+        if (xType == RINGBUF_TYPE_NOSPLIT) {
+            //No-split items are retrieved in order. The next one may have been acquired and not written yet
+            ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+            if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+                pxHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
+            }
+            return (pxHeader->uxItemFlags & rbITEM_WRITTEN_FLAG) ? pdTRUE : pdFALSE;
+        }
         return pdTRUE;      //Items/data available for retrieval
     } else {
         return pdFALSE;     //No items/data available for retrieval
@@ -431,8 +685,13 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
      * freed or items with dummy data should be skipped over
      */
     pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucFree;
+    //A full buffer whose items have all been retrieved also has pucFree == pucRead, with none of them freed yet
+    BaseType_t xAllRetrieved = ((pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) && pxRingbuffer->pucFree == pxRingbuffer->pucRead) ? pdTRUE : pdFALSE;
+    BaseType_t xFreed = pdFALSE;
     //Skip over Items that have already been freed or are dummy items
-    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && pxRingbuffer->pucFree != pxRingbuffer->pucRead) {
+    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && (pxRingbuffer->pucFree != pxRingbuffer->pucRead || xAllRetrieved == pdTRUE)) {
+        xAllRetrieved = pdFALSE;
+        xFreed = pdTRUE;
         if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
             pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;   //Mark as freed (not strictly necessary but adds redundancy)
             pxRingbuffer->pucFree = pxRingbuffer->pucHead;    //Wrap around due to dummy data
@@ -454,8 +713,8 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
     if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
         if (pxRingbuffer->pucFree != pxRingbuffer->pucWrite) {
             pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
-        } else if (pxRingbuffer->pucFree == pxRingbuffer->pucWrite && pxRingbuffer->pucFree == pxRingbuffer->pucRead) {
-            //Special case where a full buffer is completely freed in one go
+        } else if (xFreed == pdTRUE) {
+            //Special case where a full buffer is completely freed in one go (the free pointer went all the way around)
             pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
         }
     }
@@ -552,35 +811,324 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer)
     return xFreeSize;
 }
 
-static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait)
+static rbFORCE_INLINE BaseType_t prvCheckItemFits(Ringbuffer_t *pxRingbuffer, size_t xItemSize, const ringbuf_type_t xType)
+{
+    if (xType == RINGBUF_TYPE_BYTEBUF) {
+        return prvCheckItemFitsByteBuffer(pxRingbuffer, xItemSize);
+    }
+    return prvCheckItemFitsDefault(pxRingbuffer, xItemSize);
+}
+
+static rbFORCE_INLINE void prvCopyItem(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, const ringbuf_type_t xType)
+{
+    if (xType == RINGBUF_TYPE_NOSPLIT) {
+        prvCopyItemNoSplit(pxRingbuffer, pucItem, xItemSize);
+    } else if (xType == RINGBUF_TYPE_ALLOWSPLIT) {
+        prvCopyItemAllowSplit(pxRingbuffer, pucItem, xItemSize);
+    } else {
+        prvCopyItemByteBuf(pxRingbuffer, pucItem, xItemSize);
+    }
+}
+
+static rbFORCE_INLINE void *prvGetItem(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xMaxSize, size_t *pxItemSize, const ringbuf_type_t xType)
+{
+    if (xType == RINGBUF_TYPE_BYTEBUF) {
+        return prvGetItemByteBuf(pxRingbuffer, pxIsSplit, xMaxSize, pxItemSize);
+    }
+    return prvGetItemDefault(pxRingbuffer, pxIsSplit, xMaxSize, pxItemSize);
+}
+
+static rbFORCE_INLINE void prvReturnItem(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem, const ringbuf_type_t xType)
+{
+    if (xType == RINGBUF_TYPE_BYTEBUF) {
+        prvReturnItemByteBuf(pxRingbuffer, pucItem);
+    } else {
+        prvReturnItemDefault(pxRingbuffer, pucItem);
+    }
+}
+
+static rbFORCE_INLINE size_t prvGetCurMaxSize(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType)
+{
+    if (xType == RINGBUF_TYPE_NOSPLIT) {
+        return prvGetCurMaxSizeNoSplit(pxRingbuffer);
+    } else if (xType == RINGBUF_TYPE_ALLOWSPLIT) {
+        return prvGetCurMaxSizeAllowSplit(pxRingbuffer);
+    }
+    return prvGetCurMaxSizeByteBuf(pxRingbuffer);
+}
+
+static rbFORCE_INLINE BaseType_t prvMakeRoom(Ringbuffer_t *pxRingbuffer, size_t xItemSize, const ringbuf_type_t xType)
+{
+    size_t xDroppedSize;
+    BaseType_t xIsSplit;
+    while (prvCheckItemFits(pxRingbuffer, xItemSize, xType) != pdTRUE) {
+        /*
+         * Only the oldest unread item can be dropped, and it only makes room if no
+         * received item before it is still held (the free pointer has caught up with
+         * the read pointer). Dropping is a retrieval immediately followed by a return.
+         */
+        if (pxRingbuffer->pucFree != pxRingbuffer->pucRead || prvCheckItemAvail(pxRingbuffer, xType) != pdTRUE) {
+            return pdFALSE;
+        }
+        if (xType == RINGBUF_TYPE_BYTEBUF) {
+            //Only drop the missing bytes (in two parts if they wrap around)
+            uint8_t *pucData = prvGetItemByteBuf(pxRingbuffer, NULL, xItemSize - prvGetCurMaxSizeByteBuf(pxRingbuffer), &xDroppedSize);
+            prvReturnItemByteBuf(pxRingbuffer, pucData);
+            pxRingbuffer->xStats.uxDroppedItems += xDroppedSize;
+        } else {
+            uint8_t *pucItem = prvGetItemDefault(pxRingbuffer, &xIsSplit, 0, &xDroppedSize);
+            prvReturnItemDefault(pxRingbuffer, pucItem);
+            pxRingbuffer->xStats.uxDroppedItems++;
+        }
+    }
+    return pdTRUE;
+}
+
+static rbFORCE_INLINE SemaphoreHandle_t prvWakeSender(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType)
+{
+    RingbufWaiter_t **ppxWaiter;
+    if (pxRingbuffer->pxSendWaiters == NULL || pxRingbuffer->uxSendersWoken > 0) {
+        return NULL;
+    }
+    for (ppxWaiter = &pxRingbuffer->pxSendWaiters; *ppxWaiter != NULL; ppxWaiter = &(*ppxWaiter)->pxNext) {
+        RingbufWaiter_t *pxWaiter = *ppxWaiter;
+        //An overwriting sender can make room once no received item is held and an unread one can be dropped (see prvMakeRoom())
+        if (prvCheckItemFits(pxRingbuffer, pxWaiter->xItemSize, xType) == pdTRUE ||
+            ((pxRingbuffer->uxRingbufferFlags & rbOVERWRITE_FLAG) && pxRingbuffer->pucFree == pxRingbuffer->pucRead &&
+             prvCheckItemAvail(pxRingbuffer, xType) == pdTRUE)) {
+            *ppxWaiter = pxWaiter->pxNext;
+            pxRingbuffer->uxSendersWoken++;
+            pxRingbuffer->xStats.uxWakeups++;
+            return pxWaiter->xSemaphore;
+        }
+    }
+    return NULL;
+}
+
+static rbFORCE_INLINE SemaphoreHandle_t prvWakeReceiver(Ringbuffer_t *pxRingbuffer, const ringbuf_type_t xType)
+{
+    RingbufWaiter_t *pxWaiter = pxRingbuffer->pxReceiveWaiters;
+    if (pxWaiter == NULL || prvCheckItemAvail(pxRingbuffer, xType) != pdTRUE) {
+        return NULL;
+    }
+    //A byte buffer hands out all its contiguous data at once, one woken receiver is enough
+    if (pxRingbuffer->uxReceiversWoken >= ((xType == RINGBUF_TYPE_BYTEBUF) ? 1 : (UBaseType_t)pxRingbuffer->xItemsWaiting)) {
+        return NULL;
+    }
+    pxRingbuffer->pxReceiveWaiters = pxWaiter->pxNext;
+    pxRingbuffer->uxReceiversWoken++;
+    pxRingbuffer->xStats.uxWakeups++;
+    return pxWaiter->xSemaphore;
+}
+
+static BaseType_t prvInitWaiter(RingbufWaiter_t *pxWaiter, size_t xItemSize)
+{
+    pxWaiter->pxNext = NULL;
+    pxWaiter->uxPriority = uxTaskPriorityGet(NULL);
+    pxWaiter->xItemSize = xItemSize;
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+    pxWaiter->xSemaphore = xSemaphoreCreateBinaryStatic(&pxWaiter->xSemaphoreStatic);
+#else
+    pxWaiter->xSemaphore = xSemaphoreCreateBinary();
+#endif
+    return (pxWaiter->xSemaphore != NULL) ? pdTRUE : pdFALSE;
+}
+
+static void prvInsertWaiter(RingbufWaiter_t **ppxList, RingbufWaiter_t *pxWaiter)
+{
+    while (*ppxList != NULL && (*ppxList)->uxPriority >= pxWaiter->uxPriority) {
+        ppxList = &(*ppxList)->pxNext;
+    }
+    pxWaiter->pxNext = *ppxList;
+    *ppxList = pxWaiter;
+}
+
+static BaseType_t prvBlockWaiter(Ringbuffer_t *pxRingbuffer, RingbufWaiter_t **ppxList, UBaseType_t *puxWoken, RingbufWaiter_t *pxWaiter, TickType_t xTicksToWait)
+{
+    if (xSemaphoreTake(pxWaiter->xSemaphore, xTicksToWait) != pdTRUE) {
+        rbENTER_CRITICAL(pxRingbuffer);
+        while (*ppxList != NULL) {
+            if (*ppxList == pxWaiter) {
+                *ppxList = pxWaiter->pxNext;
+                return pdFALSE;     //Timed out
+            }
+            ppxList = &(*ppxList)->pxNext;
+        }
+        //Woken while timing out. The semaphore is given right after, and must be taken before it goes away with the stack
+        rbEXIT_CRITICAL(pxRingbuffer);
+        xSemaphoreTake(pxWaiter->xSemaphore, portMAX_DELAY);
+    }
+    rbENTER_CRITICAL(pxRingbuffer);
+    (*puxWoken)--;
+    return pdTRUE;
+}
+
+static void prvQueueSetSent(Ringbuffer_t *pxRingbuffer, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    //One queue set event per item sent, as long as the semaphore was taken since the last one
+    if (xFromISR == pdTRUE) {
+        xSemaphoreGiveFromISR(pxRingbuffer->xItemsBufferedSemaphore, pxHigherPriorityTaskWoken);
+    } else {
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+    }
+}
+
+static void prvQueueSetReceived(Ringbuffer_t *pxRingbuffer, BaseType_t xItemsLeft, BaseType_t xFromISR)
+{
+    //Take the event of the item received, and give a new one for the items left
+    if (xFromISR == pdTRUE) {
+        xSemaphoreTakeFromISR(pxRingbuffer->xItemsBufferedSemaphore, NULL);
+        if (xItemsLeft == pdTRUE) {
+            xSemaphoreGiveFromISR(pxRingbuffer->xItemsBufferedSemaphore, NULL);
+        }
+    } else {
+        xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, 0);
+        if (xItemsLeft == pdTRUE) {
+            xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+        }
+    }
+}
+
+static BaseType_t prvSendGeneric(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSendSPSC(pxRingbuffer, pvItem, ppvItem, xItemSize, xTicksToWait);
+    }
+    if (pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG) {
+        return prvSendBroadcast(pxRingbuffer, pvItem, xItemSize, xTicksToWait);
+    }
+    rbSPECIALIZE(pxRingbuffer, xType, return prvSendGenericType(pxRingbuffer, pvItem, ppvItem, xItemSize, xTicksToWait, xType));
+}
+
+static rbFORCE_INLINE BaseType_t prvSendGenericType(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait, const ringbuf_type_t xType)
 {
+    //Attempt to send an item
     BaseType_t xReturn = pdFALSE;
-    BaseType_t xReturnSemaphore = pdFALSE;
+    BaseType_t xBlocked = pdFALSE;
+    BaseType_t xWoken = pdFALSE;
+    BaseType_t xQueueSet;
+    SemaphoreHandle_t xWakeSender;
+    SemaphoreHandle_t xWakeReceiver = NULL;
+    RingbufWaiter_t xWaiter;
     TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
     TickType_t xTicksRemaining = xTicksToWait;
-    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
-        //Block until more free space becomes available or timeout
-        if (xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining) != pdTRUE) {
-            xReturn = pdFALSE;     //Timed out attempting to get semaphore
+
+    xWaiter.xSemaphore = NULL;      //Only set up before the first wait
+    rbENTER_CRITICAL(pxRingbuffer);
+    for (;;) {
+        //Check if item can fit (or can be made room for)
+        if (prvCheckItemFits(pxRingbuffer, xItemSize, xType) == pdTRUE ||
+            ((pxRingbuffer->uxRingbufferFlags & rbOVERWRITE_FLAG) && prvMakeRoom(pxRingbuffer, xItemSize, xType) == pdTRUE)) {
+            //Item will fit, copy item or only reserve space for it. Acquired items are announced by xRingbufferSendComplete()
+            if (xType == RINGBUF_TYPE_NOSPLIT && ppvItem != NULL) {
+                *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+            } else {
+                prvCopyItem(pxRingbuffer, pvItem, xItemSize, xType);
+                xWakeReceiver = prvWakeReceiver(pxRingbuffer, xType);
+            }
+            xReturn = pdTRUE;
+            prvRecordSend(pxRingbuffer, xItemSize, pxRingbuffer->xSize - prvGetFreeSize(pxRingbuffer));
+            break;
+        }
+        if (xWoken == pdTRUE) {
+            pxRingbuffer->xStats.uxSpuriousWakeups++;   //Another task took the space first
+        }
+        if (xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {   //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
             break;
         }
+        if (xWaiter.xSemaphore == NULL) {
+            //Set up the waiter outside of the critical section, then check again
+            rbEXIT_CRITICAL(pxRingbuffer);
+            xReturn = prvInitWaiter(&xWaiter, xItemSize);
+            rbENTER_CRITICAL(pxRingbuffer);
+            if (xReturn != pdTRUE) {
+                break;
+            }
+            xReturn = pdFALSE;
+            xWoken = pdFALSE;
+            continue;
+        }
+        //Pass on a wakeup that could not be used before waiting again
+        xWakeSender = (xWoken == pdTRUE) ? prvWakeSender(pxRingbuffer, xType) : NULL;
+        prvInsertWaiter(&pxRingbuffer->pxSendWaiters, &xWaiter);
+        rbEXIT_CRITICAL(pxRingbuffer);
+        if (xWakeSender != NULL) {
+            xSemaphoreGive(xWakeSender);
+        }
+        xBlocked = pdTRUE;      //Counted in the statistics, see below
+        xWoken = prvBlockWaiter(pxRingbuffer, &pxRingbuffer->pxSendWaiters, &pxRingbuffer->uxSendersWoken, &xWaiter, xTicksRemaining);
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+
+    //A woken sender passes the wakeup on, there may be room for the item of another sender too
+    xWakeSender = (xWoken == pdTRUE) ? prvWakeSender(pxRingbuffer, xType) : NULL;
+    if (xBlocked == pdTRUE) {
+        pxRingbuffer->xStats.uxBlockedSends++;
+        pxRingbuffer->xStats.xBlockedTicks += xTaskGetTickCount() - (xTicksEnd - xTicksToWait);
+    }
+    if (xReturn != pdTRUE) {
+        pxRingbuffer->xStats.uxSendTimeouts++;
+    }
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGive(xWakeReceiver);
+    }
+    if (xWakeSender != NULL) {
+        xSemaphoreGive(xWakeSender);
+    }
+    if (xReturn == pdTRUE && ppvItem == NULL && xQueueSet == pdTRUE) {
+        prvQueueSetSent(pxRingbuffer, pdFALSE, NULL);
+    }
+    if (xWaiter.xSemaphore != NULL) {
+        vSemaphoreDelete(xWaiter.xSemaphore);
+    }
+    return xReturn;
+}
 
-        //Semaphore obtained, check if item can be retrieved
-        portENTER_CRITICAL(&pxRingbuffer->mux);
-        if (prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait)
+{
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG) == 0);    //Broadcast buffers are read with xRingbufferReceiveReader()
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //SPSC buffers are never split, pvItem2 is not used
+        *pvItem1 = prvReceiveSPSC(pxRingbuffer, xMaxSize, xItemSize1, xTicksToWait);
+        return (*pvItem1 != NULL) ? pdTRUE : pdFALSE;
+    }
+    rbSPECIALIZE(pxRingbuffer, xType, return prvReceiveGenericType(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize, xTicksToWait, xType));
+}
+
+static rbFORCE_INLINE BaseType_t prvReceiveGenericType(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait, const ringbuf_type_t xType)
+{
+    BaseType_t xReturn = pdFALSE;
+    BaseType_t xWoken = pdFALSE;
+    BaseType_t xItemsLeft;
+    BaseType_t xQueueSet;
+    SemaphoreHandle_t xWakeReceiver;
+    RingbufWaiter_t xWaiter;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+
+    xWaiter.xSemaphore = NULL;      //Only set up before the first wait
+    rbENTER_CRITICAL(pxRingbuffer);
+    for (;;) {
+        //Check if item can be retrieved
+        if (prvCheckItemAvail(pxRingbuffer, xType) == pdTRUE) {
             //Item is available for retrieval
             BaseType_t xIsSplit;
-            if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+            if (xType == RINGBUF_TYPE_BYTEBUF) {
                 //Second argument (pxIsSplit) is unused for byte buffers
-                *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, NULL, xMaxSize, xItemSize1);
+                *pvItem1 = prvGetItem(pxRingbuffer, NULL, xMaxSize, xItemSize1, xType);
             } else {
                 //Third argument (xMaxSize) is unused for no-split/allow-split buffers
-                *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1);
+                *pvItem1 = prvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1, xType);
             }
             //Check for item split if configured to do so
-            if ((pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) && (pvItem2 != NULL) && (xItemSize2 != NULL)) {
+            if ((xType == RINGBUF_TYPE_ALLOWSPLIT) && (pvItem2 != NULL) && (xItemSize2 != NULL)) {
                 if (xIsSplit == pdTRUE) {
-                    *pvItem2 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize2);
+                    *pvItem2 = prvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize2, xType);
                     configASSERT(*pvItem2 < *pvItem1);  //Check wrap around has occurred
                     configASSERT(xIsSplit == pdFALSE);  //Second part should not have wrapped flag
                 } else {
@@ -588,48 +1136,83 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1,
                 }
             }
             xReturn = pdTRUE;
-            if (pxRingbuffer->xItemsWaiting > 0) {
-                xReturnSemaphore = pdTRUE;
-            }
-            portEXIT_CRITICAL(&pxRingbuffer->mux);
             break;
         }
-        //No item available for retrieval, adjust ticks and take the semaphore again
+        if (xWoken == pdTRUE) {
+            pxRingbuffer->xStats.uxSpuriousWakeups++;   //Another task took the item first
+        }
+        if (xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {   //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            break;
+        }
+        if (xWaiter.xSemaphore == NULL) {
+            //Set up the waiter outside of the critical section, then check again
+            rbEXIT_CRITICAL(pxRingbuffer);
+            xReturn = prvInitWaiter(&xWaiter, 0);
+            rbENTER_CRITICAL(pxRingbuffer);
+            if (xReturn != pdTRUE) {
+                break;
+            }
+            xReturn = pdFALSE;
+            xWoken = pdFALSE;
+            continue;
+        }
+        prvInsertWaiter(&pxRingbuffer->pxReceiveWaiters, &xWaiter);
+        rbEXIT_CRITICAL(pxRingbuffer);
+        xWoken = prvBlockWaiter(pxRingbuffer, &pxRingbuffer->pxReceiveWaiters, &pxRingbuffer->uxReceiversWoken, &xWaiter, xTicksRemaining);
         if (xTicksToWait != portMAX_DELAY) {
             xTicksRemaining = xTicksEnd - xTaskGetTickCount();
         }
-        portEXIT_CRITICAL(&pxRingbuffer->mux);
-        /*
-         * Gap between critical section and re-acquiring of the semaphore. If
-         * semaphore is given now, priority inversion might occur (see docs)
-         */
     }
 
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);  //Give semaphore back so other tasks can retrieve
+    //Wake another receiver for the items left
+    xWakeReceiver = prvWakeReceiver(pxRingbuffer, xType);
+    xItemsLeft = (pxRingbuffer->xItemsWaiting > 0) ? pdTRUE : pdFALSE;
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGive(xWakeReceiver);
+    }
+    if (xReturn == pdTRUE && xQueueSet == pdTRUE) {
+        prvQueueSetReceived(pxRingbuffer, xItemsLeft, pdFALSE);
+    }
+    if (xWaiter.xSemaphore != NULL) {
+        vSemaphoreDelete(xWaiter.xSemaphore);
     }
     return xReturn;
 }
 
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize)
+{
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG) == 0);    //Broadcast buffers are read with xRingbufferReceiveReader()
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        *pvItem1 = prvTryReceiveSPSC(pxRingbuffer, xMaxSize, xItemSize1);
+        return (*pvItem1 != NULL) ? pdTRUE : pdFALSE;
+    }
+    rbSPECIALIZE(pxRingbuffer, xType, return prvReceiveGenericFromISRType(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize, xType));
+}
+
+static rbFORCE_INLINE BaseType_t prvReceiveGenericFromISRType(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, const ringbuf_type_t xType)
 {
     BaseType_t xReturn = pdFALSE;
-    BaseType_t xReturnSemaphore = pdFALSE;
+    BaseType_t xItemsLeft;
+    BaseType_t xQueueSet;
+    SemaphoreHandle_t xWakeReceiver = NULL;
 
-    portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
-    if(prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+    rbENTER_CRITICAL_ISR(pxRingbuffer);
+    if(prvCheckItemAvail(pxRingbuffer, xType) == pdTRUE) {
         BaseType_t xIsSplit;
-        if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        if (xType == RINGBUF_TYPE_BYTEBUF) {
             //Second argument (pxIsSplit) is unused for byte buffers
-            *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, NULL, xMaxSize, xItemSize1);
+            *pvItem1 = prvGetItem(pxRingbuffer, NULL, xMaxSize, xItemSize1, xType);
         } else {
             //Third argument (xMaxSize) is unused for no-split/allow-split buffers
-            *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1);
+            *pvItem1 = prvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1, xType);
         }
         //Check for item split if configured to do so
-        if ((pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) && pvItem2 != NULL && xItemSize2 != NULL) {
+        if ((xType == RINGBUF_TYPE_ALLOWSPLIT) && pvItem2 != NULL && xItemSize2 != NULL) {
             if (xIsSplit == pdTRUE) {
-                *pvItem2 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize2);
+                *pvItem2 = prvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize2, xType);
                 configASSERT(*pvItem2 < *pvItem1);  //Check wrap around has occurred
                 configASSERT(xIsSplit == pdFALSE);  //Second part should not have wrapped flag
             } else {
@@ -637,102 +1220,488 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pv
             }
         }
         xReturn = pdTRUE;
-        if (pxRingbuffer->xItemsWaiting > 0) {
-            xReturnSemaphore = pdTRUE;
-        }
+        //Wake a receiver for the items left
+        xWakeReceiver = prvWakeReceiver(pxRingbuffer, xType);
     }
-    portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
+    xItemsLeft = (pxRingbuffer->xItemsWaiting > 0) ? pdTRUE : pdFALSE;
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL_ISR(pxRingbuffer);
 
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGiveFromISR(pxRingbuffer->xItemsBufferedSemaphore, NULL);  //Give semaphore back so other tasks can retrieve
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGiveFromISR(xWakeReceiver, NULL);
+    }
+    if (xReturn == pdTRUE && xQueueSet == pdTRUE) {
+        prvQueueSetReceived(pxRingbuffer, xItemsLeft, pdTRUE);
     }
     return xReturn;
 }
 
-/* ------------------------------------------------- Public Definitions -------------------------------------------- */
-
-RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+static rbFORCE_INLINE UBaseType_t prvGetItems(Ringbuffer_t *pxRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxMaxItems, const ringbuf_type_t xType)
 {
-    //Allocate memory
-    Ringbuffer_t *pxRingbuffer = calloc(1, sizeof(Ringbuffer_t));
-    if (pxRingbuffer == NULL) {
-        goto err;
-    }
-    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
-        xBufferSize = rbALIGN_SIZE(xBufferSize);    //xBufferSize is rounded up for no-split/allow-split buffers
-    }
-    pxRingbuffer->pucHead = malloc(xBufferSize);
-    if (pxRingbuffer->pucHead == NULL) {
-        goto err;
+    UBaseType_t uxCount = 0;
+    BaseType_t xIsSplit;
+    while (uxCount < uxMaxItems && prvCheckItemAvail(pxRingbuffer, xType) == pdTRUE) {
+        RingbufItem_t *pxItem = &pxItems[uxCount++];
+        pxItem->pvHeadItem = prvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItem->xHeadItemSize, xType);
+        pxItem->pvTailItem = NULL;
+        pxItem->xTailItemSize = 0;
+        if (xType == RINGBUF_TYPE_ALLOWSPLIT && xIsSplit == pdTRUE) {
+            //Both parts of a split item are always written together
+            pxItem->pvTailItem = prvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItem->xTailItemSize, xType);
+            configASSERT(pxItem->pvTailItem < pxItem->pvHeadItem);  //Check wrap around has occurred
+            configASSERT(xIsSplit == pdFALSE);  //Second part should not have wrapped flag
+        }
     }
+    return uxCount;
+}
 
-    //Initialize values
-    pxRingbuffer->xSize = xBufferSize;
-    pxRingbuffer->pucTail = pxRingbuffer->pucHead + xBufferSize;
-    pxRingbuffer->pucFree = pxRingbuffer->pucHead;
-    pxRingbuffer->pucRead = pxRingbuffer->pucHead;
-    pxRingbuffer->pucWrite = pxRingbuffer->pucHead;
-    pxRingbuffer->xItemsWaiting = 0;
-    pxRingbuffer->xFreeSpaceSemaphore = xSemaphoreCreateBinary();
-    pxRingbuffer->xItemsBufferedSemaphore = xSemaphoreCreateBinary();
-    pxRingbuffer->uxRingbufferFlags = 0;
-
-    //Initialize type dependent values and function pointers
-    if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
-        pxRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
-        pxRingbuffer->vCopyItem = prvCopyItemNoSplit;
-        pxRingbuffer->pvGetItem = prvGetItemDefault;
-        pxRingbuffer->vReturnItem = prvReturnItemDefault;
-        /*
-         * Buffer lengths are always aligned. No-split buffer (read/write/free)
-         * pointers are also always aligned. Therefore worse case scenario is
-         * the write pointer is at the most aligned halfway point.
-         */
-        pxRingbuffer->xMaxItemSize = rbALIGN_SIZE(pxRingbuffer->xSize / 2) - rbHEADER_SIZE;
-        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeNoSplit;
-    } else if (xBufferType == RINGBUF_TYPE_ALLOWSPLIT) {
-        pxRingbuffer->uxRingbufferFlags |= rbALLOW_SPLIT_FLAG;
-        pxRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
-        pxRingbuffer->vCopyItem = prvCopyItemAllowSplit;
-        pxRingbuffer->pvGetItem = prvGetItemDefault;
-        pxRingbuffer->vReturnItem = prvReturnItemDefault;
-        //Worst case an item is split into two, incurring two headers of overhead
-        pxRingbuffer->xMaxItemSize = pxRingbuffer->xSize - (sizeof(ItemHeader_t) * 2);
-        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeAllowSplit;
-    } else if (xBufferType == RINGBUF_TYPE_BYTEBUF) {
-        pxRingbuffer->uxRingbufferFlags |= rbBYTE_BUFFER_FLAG;
-        pxRingbuffer->xCheckItemFits = prvCheckItemFitsByteBuffer;
-        pxRingbuffer->vCopyItem = prvCopyItemByteBuf;
-        pxRingbuffer->pvGetItem = prvGetItemByteBuf;
-        pxRingbuffer->vReturnItem = prvReturnItemByteBuf;
-        //Byte buffers do not incur any overhead
-        pxRingbuffer->xMaxItemSize = pxRingbuffer->xSize;
-        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeByteBuf;
-    } else {
-        //Unsupported type
-        configASSERT(0);
-    }
+/* ------------------------------------------------ SPSC Definitions --------------------------------------------- */
 
-    if (pxRingbuffer->xFreeSpaceSemaphore == NULL || pxRingbuffer->xItemsBufferedSemaphore == NULL) {
-        goto err;
-    }
-    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
-    vPortCPUInitializeMutex(&pxRingbuffer->mux);
+/*
+ * SPSC buffers never let the write pointer catch up with the free pointer: one
+ * aligned word (one byte in byte buffers) always stays unused, so pucWrite ==
+ * pucFree always means empty and the full flag, which both sides would have to
+ * write, is not needed.
+ *
+ * A side that finds the buffer full (or empty) raises its waiting flag, tries
+ * again, and only then blocks on its semaphore. The other side checks that flag
+ * after publishing its pointer and only gives the semaphore when it is raised.
+ * The full barriers on both sides guarantee that at least one of them sees the
+ * other. A semaphore given to a side that no longer waits only costs it one
+ * extra try the next time it blocks.
+ */
 
-    return (RingbufHandle_t)pxRingbuffer;
+static size_t prvGetFreeSizeSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucWrite, uint8_t *pucFree)
+{
+    return (pucFree > pucWrite) ? (size_t)(pucFree - pucWrite) : pxRingbuffer->xSize - (size_t)(pucWrite - pucFree);
+}
 
-err:
-    //Some error has happened. Free/destroy all allocated things and return NULL.
-    if (pxRingbuffer) {
-        free(pxRingbuffer->pucHead);
-        if (pxRingbuffer->xFreeSpaceSemaphore) {
-            vSemaphoreDelete(pxRingbuffer->xFreeSpaceSemaphore);
+static BaseType_t prvTrySendSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, void **ppvItem, size_t xItemSize)
+{
+    configASSERT(pxRingbuffer->pucAcquired == NULL);    //The acquired item must be completed first
+    uint8_t *pucWrite = pxRingbuffer->pucWrite;     //Only written by this side
+    uint8_t *pucFree = rbLOAD_ACQUIRE(pxRingbuffer->pucFree);
+    size_t xFreeSize = prvGetFreeSizeSPSC(pxRingbuffer, pucWrite, pucFree);
+    size_t xRemLen = pxRingbuffer->pucTail - pucWrite;    //Length from pucWrite until end of buffer
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        if (xItemSize >= xFreeSize) {
+            return pdFALSE;
         }
-        if (pxRingbuffer->xItemsBufferedSemaphore) {
-            vSemaphoreDelete(pxRingbuffer->xItemsBufferedSemaphore);
+        if (xRemLen <= xItemSize) {
+            //Copy until the end of the buffer, and the rest from the start
+            memcpy(pucWrite, pucItem, xRemLen);
+            memcpy(pxRingbuffer->pucHead, pucItem + xRemLen, xItemSize - xRemLen);
+            pucWrite = pxRingbuffer->pucHead + (xItemSize - xRemLen);
+        } else {
+            memcpy(pucWrite, pucItem, xItemSize);
+            pucWrite += xItemSize;
         }
+        rbSTORE_RELEASE(pxRingbuffer->pucWrite, pucWrite);
+        pxRingbuffer->uxSent += xItemSize;
+        prvRecordSend(pxRingbuffer, xItemSize, pxRingbuffer->xSize - xFreeSize + xItemSize);
+        return pdTRUE;
     }
-    free(pxRingbuffer);
+
+    //No-split items are contiguous. Space used: the item, plus whatever is skipped before pucTail
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);
+    uint8_t *pucItemHeader = pucWrite;
+    size_t xUsed;
+    configASSERT(rbCHECK_ALIGNED(pucWrite));
+    configASSERT(xRemLen >= rbHEADER_SIZE);
+    if (xRemLen >= xAlignedItemSize + rbHEADER_SIZE) {
+        xUsed = xAlignedItemSize + rbHEADER_SIZE;
+        if (xRemLen - xUsed < rbHEADER_SIZE) {
+            xUsed = xRemLen;    //The rest can't fit a header, pucWrite wraps around after the item
+        }
+    } else {
+        xUsed = xRemLen + xAlignedItemSize + rbHEADER_SIZE;
+        pucItemHeader = pxRingbuffer->pucHead;  //Wrap around after dummy data
+    }
+    if (xUsed >= xFreeSize) {
+        return pdFALSE;
+    }
+
+    if (pucItemHeader != pucWrite) {
+        ItemHeader_t *pxDummy = (ItemHeader_t *)pucWrite;
+        pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;
+        pxDummy->xItemLen = 0;
+        pxRingbuffer->xStats.uxDummyWraps++;
+    }
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucItemHeader;
+    pxHeader->xItemLen = xItemSize;
+    pxHeader->uxItemFlags = 0;
+    //The free size may be stale, the peak is an upper bound
+    prvRecordSend(pxRingbuffer, xItemSize, pxRingbuffer->xSize - xFreeSize + xUsed);
+    if (ppvItem != NULL) {
+        //Nothing is published until prvCompleteSPSC()
+        pxRingbuffer->pucAcquired = pucItemHeader + rbHEADER_SIZE;
+        *ppvItem = pxRingbuffer->pucAcquired;
+        return pdTRUE;
+    }
+    memcpy(pucItemHeader + rbHEADER_SIZE, pucItem, xItemSize);
+    prvCompleteSPSC(pxRingbuffer, pucItemHeader + rbHEADER_SIZE);
+    return pdTRUE;
+}
+
+static void prvCompleteSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    ItemHeader_t *pxHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+    uint8_t *pucWrite = pucItem + rbALIGN_SIZE(pxHeader->xItemLen);
+    if (pxRingbuffer->pucTail - pucWrite < rbHEADER_SIZE) {
+        pucWrite = pxRingbuffer->pucHead;
+    }
+    pxRingbuffer->pucAcquired = NULL;
+    //Publish the item (and the dummy data) to the consumer
+    rbSTORE_RELEASE(pxRingbuffer->pucWrite, pucWrite);
+    pxRingbuffer->uxSent++;
+}
+
+static void *prvTryReceiveSPSC(Ringbuffer_t *pxRingbuffer, size_t xMaxSize, size_t *pxItemSize)
+{
+    uint8_t *pucRead = pxRingbuffer->pucRead;       //Only written by this side
+    uint8_t *pucWrite = rbLOAD_ACQUIRE(pxRingbuffer->pucWrite);
+    uint8_t *pucReturn;
+
+    if (pucRead == pucWrite) {
+        return NULL;    //Empty
+    }
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        if (pucRead != pxRingbuffer->pucFree) {
+            return NULL;    //Byte buffers do not allow multiple retrievals before return
+        }
+        //Return the contiguous data from the read pointer, up to xMaxSize
+        size_t xAvailable = (pucWrite > pucRead) ? (size_t)(pucWrite - pucRead) : (size_t)(pxRingbuffer->pucTail - pucRead);
+        if (xMaxSize != 0 && xMaxSize < xAvailable) {
+            xAvailable = xMaxSize;
+        }
+        pucReturn = pucRead;
+        pucRead += xAvailable;
+        if (pucRead == pxRingbuffer->pucTail) {
+            pucRead = pxRingbuffer->pucHead;
+        }
+        *pxItemSize = xAvailable;
+        pxRingbuffer->pucRead = pucRead;
+        pxRingbuffer->uxReceived += xAvailable;
+        return pucReturn;
+    }
+
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucRead;
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pucRead = pxRingbuffer->pucHead;
+        pxHeader = (ItemHeader_t *)pucRead;
+    }
+    configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    pucReturn = pucRead + rbHEADER_SIZE;
+    *pxItemSize = pxHeader->xItemLen;
+    pucRead += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+    if (pxRingbuffer->pucTail - pucRead < rbHEADER_SIZE) {
+        pucRead = pxRingbuffer->pucHead;
+    }
+    pxRingbuffer->pucRead = pucRead;
+    pxRingbuffer->uxReceived++;
+    return pucReturn;
+}
+
+static void prvReturnItemSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    uint8_t *pucFree;
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        configASSERT(pucItem == pxRingbuffer->pucFree);
+        pucFree = pxRingbuffer->pucRead;
+    } else {
+        //Returned in order: the item is at the free pointer, or at the head after dummy data
+        ItemHeader_t *pxHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+        configASSERT((uint8_t *)pxHeader == pxRingbuffer->pucFree || (uint8_t *)pxHeader == pxRingbuffer->pucHead);
+        pucFree = pucItem + rbALIGN_SIZE(pxHeader->xItemLen);
+        if (pxRingbuffer->pucTail - pucFree < rbHEADER_SIZE) {
+            pucFree = pxRingbuffer->pucHead;
+        }
+    }
+    //Hand the space back to the producer, once the consumer is done with it
+    rbSTORE_RELEASE(pxRingbuffer->pucFree, pucFree);
+}
+
+static void prvWakeSPSC(volatile BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    rbFULL_BARRIER();   //The pointer must be published before the flag is read
+    if (*pxWaiting == pdTRUE) {
+        if (xFromISR == pdTRUE) {
+            xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken);
+        } else {
+            xSemaphoreGive(xSemaphore);
+        }
+    }
+}
+
+static BaseType_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    BaseType_t xReturn = prvTrySendSPSC(pxRingbuffer, pucItem, ppvItem, xItemSize);
+    BaseType_t xBlocked = (xReturn != pdTRUE && xTicksToWait != 0) ? pdTRUE : pdFALSE;
+
+    while (xReturn != pdTRUE && xTicksRemaining != 0 && xTicksRemaining <= xTicksToWait) {  //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+        //Announce the wait, then try again in case the consumer returned an item in between
+        pxRingbuffer->xWriterWaiting = pdTRUE;
+        rbFULL_BARRIER();
+        xReturn = prvTrySendSPSC(pxRingbuffer, pucItem, ppvItem, xItemSize);
+        if (xReturn != pdTRUE) {
+            xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining);
+            if (xTicksToWait != portMAX_DELAY) {
+                xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+            }
+            xReturn = prvTrySendSPSC(pxRingbuffer, pucItem, ppvItem, xItemSize);
+        }
+        pxRingbuffer->xWriterWaiting = pdFALSE;
+    }
+
+    //Only the producer writes the statistics, no lock needed
+    if (xBlocked == pdTRUE) {
+        pxRingbuffer->xStats.uxBlockedSends++;
+        pxRingbuffer->xStats.xBlockedTicks += xTaskGetTickCount() - (xTicksEnd - xTicksToWait);
+    }
+    if (xReturn != pdTRUE) {
+        pxRingbuffer->xStats.uxSendTimeouts++;
+    }
+    if (xReturn == pdTRUE && ppvItem == NULL) {
+        prvWakeSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, pdFALSE, NULL);
+    }
+    return xReturn;
+}
+
+static void *prvReceiveSPSC(Ringbuffer_t *pxRingbuffer, size_t xMaxSize, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    void *pvItem = prvTryReceiveSPSC(pxRingbuffer, xMaxSize, pxItemSize);
+
+    while (pvItem == NULL && xTicksRemaining != 0 && xTicksRemaining <= xTicksToWait) {  //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+        //Announce the wait, then try again in case the producer sent an item in between
+        pxRingbuffer->xReaderWaiting = pdTRUE;
+        rbFULL_BARRIER();
+        pvItem = prvTryReceiveSPSC(pxRingbuffer, xMaxSize, pxItemSize);
+        if (pvItem == NULL) {
+            xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining);
+            if (xTicksToWait != portMAX_DELAY) {
+                xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+            }
+            pvItem = prvTryReceiveSPSC(pxRingbuffer, xMaxSize, pxItemSize);
+        }
+        pxRingbuffer->xReaderWaiting = pdFALSE;
+    }
+    return pvItem;
+}
+
+static void prvSkipItemBroadcast(Ringbuffer_t *pxRingbuffer, uint8_t **ppucItem)
+{
+    ItemHeader_t *pxHeader = (ItemHeader_t *)*ppucItem;
+    //Wrap around if dummy data, as prvGetItemDefault() does
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pxHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
+    }
+    configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    *ppucItem = (uint8_t *)pxHeader + rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+    //Check if the pointer requires wrap around
+    if ((pxRingbuffer->pucTail - *ppucItem) < rbHEADER_SIZE) {
+        *ppucItem = pxRingbuffer->pucHead;
+    }
+}
+
+static BaseType_t prvDropOldestBroadcast(Ringbuffer_t *pxRingbuffer)
+{
+    RingbufReader_t *pxReader;
+    UBaseType_t i;
+    if (pxRingbuffer->xItemsWaiting == 0) {
+        return pdFALSE;
+    }
+    for (i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+        pxReader = &pxRingbuffer->pxReaders[i];
+        if (pxReader->pxRingbuffer != NULL && pxReader->xItemsWaiting == pxRingbuffer->xItemsWaiting &&
+            (pxReader->xReaderType == RINGBUF_READER_BLOCK || pxReader->xCopying == pdTRUE)) {
+            return pdFALSE;     //Wait for the reader
+        }
+    }
+    //The readers that have not read the oldest item miss it
+    for (i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+        pxReader = &pxRingbuffer->pxReaders[i];
+        if (pxReader->pxRingbuffer != NULL && pxReader->xItemsWaiting == pxRingbuffer->xItemsWaiting) {
+            configASSERT(pxReader->pucRead == pxRingbuffer->pucFree);
+            prvSkipItemBroadcast(pxRingbuffer, &pxReader->pucRead);
+            pxReader->xItemsWaiting--;
+            pxReader->uxDropped++;
+            pxRingbuffer->xStats.uxDroppedItems++;
+        }
+    }
+    prvSkipItemBroadcast(pxRingbuffer, &pxRingbuffer->pucFree);
+    pxRingbuffer->pucRead = pxRingbuffer->pucFree;  //Only kept for vRingbufferGetInfo()
+    pxRingbuffer->xItemsWaiting--;
+    pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;     //The free pointer has moved, or the buffer is empty
+    return pdTRUE;
+}
+
+static BaseType_t prvTrySendBroadcast(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    UBaseType_t i;
+    while (prvCheckItemFitsDefault(pxRingbuffer, xItemSize) != pdTRUE) {
+        if (prvDropOldestBroadcast(pxRingbuffer) != pdTRUE) {
+            return pdFALSE;
+        }
+    }
+    prvCopyItemNoSplit(pxRingbuffer, pucItem, xItemSize);
+    for (i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+        if (pxRingbuffer->pxReaders[i].pxRingbuffer != NULL) {
+            pxRingbuffer->pxReaders[i].xItemsWaiting++;
+        }
+    }
+    prvRecordSend(pxRingbuffer, xItemSize, pxRingbuffer->xSize - prvGetFreeSize(pxRingbuffer));
+    return pdTRUE;
+}
+
+static void prvWakeReaders(Ringbuffer_t *pxRingbuffer, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    UBaseType_t i;
+    //A reader announces its wait in the critical section in which it finds no item. A reader removed meanwhile only gets a spurious give
+    for (i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+        prvWakeSPSC(&pxRingbuffer->pxReaders[i].xWaiting, pxRingbuffer->pxReaders[i].xItemsBufferedSemaphore, xFromISR, pxHigherPriorityTaskWoken);
+    }
+}
+
+static BaseType_t prvSendBroadcast(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    BaseType_t xReturn;
+    BaseType_t xBlocked = pdFALSE;
+    BaseType_t xWaited = pdFALSE;
+    BaseType_t xWakeWriter;
+
+    for (;;) {
+        rbENTER_CRITICAL(pxRingbuffer);
+        if (xWaited == pdTRUE) {
+            pxRingbuffer->xWriterWaiting--;
+            xWaited = pdFALSE;
+        }
+        xReturn = prvTrySendBroadcast(pxRingbuffer, pucItem, xItemSize);
+        if (xReturn == pdTRUE || xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {  //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            break;      //Still in the critical section
+        }
+        //Announce the wait in the same critical section, a blocking reader that reads the oldest item gives the semaphore
+        pxRingbuffer->xWriterWaiting++;
+        rbEXIT_CRITICAL(pxRingbuffer);
+        xWaited = pdTRUE;
+        xBlocked = pdTRUE;
+        xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining);
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+
+    if (xBlocked == pdTRUE) {
+        pxRingbuffer->xStats.uxBlockedSends++;
+        pxRingbuffer->xStats.xBlockedTicks += xTaskGetTickCount() - (xTicksEnd - xTicksToWait);
+    }
+    if (xReturn != pdTRUE) {
+        pxRingbuffer->xStats.uxSendTimeouts++;
+    }
+    //Pass the semaphore on to the next waiting writer, there may be room for its item too
+    xWakeWriter = (xReturn == pdTRUE && pxRingbuffer->xWriterWaiting > 0) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeWriter == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    }
+    if (xReturn == pdTRUE) {
+        prvWakeReaders(pxRingbuffer, pdFALSE, NULL);
+    }
+    return xReturn;
+}
+
+static void prvInitializeNewRingbuffer(size_t xBufferSize, ringbuf_type_t xBufferType, Ringbuffer_t *pxNewRingbuffer, uint8_t *pucRingbufferStorage)
+{
+    //Initialize values
+    pxNewRingbuffer->xSize = xBufferSize;
+    pxNewRingbuffer->pucHead = pucRingbufferStorage;
+    pxNewRingbuffer->pucTail = pucRingbufferStorage + xBufferSize;
+    pxNewRingbuffer->pucFree = pucRingbufferStorage;
+    pxNewRingbuffer->pucRead = pucRingbufferStorage;
+    pxNewRingbuffer->pucWrite = pucRingbufferStorage;
+    pxNewRingbuffer->xItemsWaiting = 0;
+    pxNewRingbuffer->uxRingbufferFlags = 0;
+
+    //Initialize type dependent values
+    if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
+        /*
+         * Buffer lengths are always aligned. No-split buffer (read/write/free)
+         * pointers are also always aligned. Therefore worse case scenario is
+         * the write pointer is at the most aligned halfway point.
+         */
+        pxNewRingbuffer->xMaxItemSize = rbALIGN_SIZE(pxNewRingbuffer->xSize / 2) - rbHEADER_SIZE;
+    } else if (xBufferType == RINGBUF_TYPE_ALLOWSPLIT) {
+        pxNewRingbuffer->uxRingbufferFlags |= rbALLOW_SPLIT_FLAG;
+        //Worst case an item is split into two, incurring two headers of overhead
+        pxNewRingbuffer->xMaxItemSize = pxNewRingbuffer->xSize - (sizeof(ItemHeader_t) * 2);
+    } else if (xBufferType == RINGBUF_TYPE_BYTEBUF) {
+        pxNewRingbuffer->uxRingbufferFlags |= rbBYTE_BUFFER_FLAG;
+        //Byte buffers do not incur any overhead
+        pxNewRingbuffer->xMaxItemSize = pxNewRingbuffer->xSize;
+    } else {
+        //Unsupported type
+        configASSERT(0);
+    }
+
+    rbINIT_LOCK(pxNewRingbuffer);
+    pxNewRingbuffer->xStats.xRingbuffer = (RingbufHandle_t)pxNewRingbuffer;
+    pxNewRingbuffer->xStats.xSize = pxNewRingbuffer->xSize;
+
+    //Register the ring buffer
+    rbENTER_REGISTRY();
+    pxNewRingbuffer->pxNext = pxRegistryHead;
+    pxRegistryHead = pxNewRingbuffer;
+    rbEXIT_REGISTRY();
+}
+
+/* ------------------------------------------------- Public Definitions -------------------------------------------- */
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    //Allocate memory
+    Ringbuffer_t *pxRingbuffer = calloc(1, sizeof(Ringbuffer_t));
+    uint8_t *pucRingbufferStorage;
+    if (pxRingbuffer == NULL) {
+        goto err;
+    }
+    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
+        xBufferSize = rbALIGN_SIZE(xBufferSize);    //xBufferSize is rounded up for no-split/allow-split buffers
+    }
+    pucRingbufferStorage = malloc(xBufferSize);
+    if (pucRingbufferStorage == NULL) {
+        goto err;
+    }
+    pxRingbuffer->pucHead = pucRingbufferStorage;
+    pxRingbuffer->xFreeSpaceSemaphore = xSemaphoreCreateBinary();
+    pxRingbuffer->xItemsBufferedSemaphore = xSemaphoreCreateBinary();
+    if (pxRingbuffer->xFreeSpaceSemaphore == NULL || pxRingbuffer->xItemsBufferedSemaphore == NULL) {
+        goto err;
+    }
+
+    prvInitializeNewRingbuffer(xBufferSize, xBufferType, pxRingbuffer, pucRingbufferStorage);
+    return (RingbufHandle_t)pxRingbuffer;
+
+err:
+    //Some error has happened. Free/destroy all allocated things and return NULL.
+    if (pxRingbuffer) {
+        free(pxRingbuffer->pucHead);
+        if (pxRingbuffer->xFreeSpaceSemaphore) {
+            vSemaphoreDelete(pxRingbuffer->xFreeSpaceSemaphore);
+        }
+        if (pxRingbuffer->xItemsBufferedSemaphore) {
+            vSemaphoreDelete(pxRingbuffer->xItemsBufferedSemaphore);
+        }
+    }
+    free(pxRingbuffer);
     return NULL;
 }
 
@@ -741,62 +1710,276 @@ RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum)
     return xRingbufferCreate((rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE) * xItemNum, RINGBUF_TYPE_NOSPLIT);
 }
 
-BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    if (xBufferType == RINGBUF_TYPE_ALLOWSPLIT) {
+        return NULL;    //Not supported
+    }
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbufferCreate(xBufferSize, xBufferType);
+    if (pxRingbuffer == NULL) {
+        return NULL;
+    }
+
+    pxRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG;
+    //One word (one byte for byte buffers) always stays unused. A no-split item must fit in an empty buffer wherever the pointers are
+    if (xBufferType == RINGBUF_TYPE_BYTEBUF) {
+        pxRingbuffer->xMaxItemSize = pxRingbuffer->xSize - 1;
+    } else {
+        pxRingbuffer->xMaxItemSize = ((pxRingbuffer->xSize / 2) & ~portBYTE_ALIGNMENT_MASK) - rbHEADER_SIZE;
+    }
+    return (RingbufHandle_t)pxRingbuffer;
+}
+
+RingbufHandle_t xRingbufferCreateBroadcast(size_t xBufferSize, UBaseType_t uxMaxReaders)
+{
+    configASSERT(uxMaxReaders > 0);
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbufferCreate(xBufferSize, RINGBUF_TYPE_NOSPLIT);
+    UBaseType_t i;
+    if (pxRingbuffer == NULL) {
+        return NULL;
+    }
+
+    pxRingbuffer->pxReaders = calloc(uxMaxReaders, sizeof(RingbufReader_t));
+    if (pxRingbuffer->pxReaders == NULL) {
+        goto err;
+    }
+    pxRingbuffer->uxMaxReaders = uxMaxReaders;
+    for (i = 0; i < uxMaxReaders; i++) {
+        pxRingbuffer->pxReaders[i].xItemsBufferedSemaphore = xSemaphoreCreateBinary();
+        if (pxRingbuffer->pxReaders[i].xItemsBufferedSemaphore == NULL) {
+            goto err;
+        }
+    }
+    pxRingbuffer->uxRingbufferFlags |= rbBROADCAST_FLAG;
+    return (RingbufHandle_t)pxRingbuffer;
+
+err:
+    vRingbufferDelete(pxRingbuffer);    //Also deletes the reader slots created so far
+    return NULL;
+}
+
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize, ringbuf_type_t xBufferType, uint8_t *pucRingbufferStorage, StaticRingbuffer_t *pxStaticRingbuffer)
 {
     //Check arguments
+    RingbufferStatic_t *pxStatic = (RingbufferStatic_t *)pxStaticRingbuffer;
+    configASSERT(pxStatic != NULL && pucRingbufferStorage != NULL);
+    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
+        //No-split/allow-split buffers cannot be rounded up, the storage is given
+        configASSERT(rbCHECK_ALIGNED(xBufferSize) && rbCHECK_ALIGNED(pucRingbufferStorage));
+    }
+
+    Ringbuffer_t *pxRingbuffer = &pxStatic->xRingbuffer;
+    memset(pxStatic, 0, sizeof(*pxStatic));
+    pxRingbuffer->xFreeSpaceSemaphore = xSemaphoreCreateBinaryStatic(&pxStatic->xFreeSpaceSemaphoreStatic);
+    pxRingbuffer->xItemsBufferedSemaphore = xSemaphoreCreateBinaryStatic(&pxStatic->xItemsBufferedSemaphoreStatic);
+    if (pxRingbuffer->xFreeSpaceSemaphore == NULL || pxRingbuffer->xItemsBufferedSemaphore == NULL) {
+        return NULL;    //Not possible with valid static memory
+    }
+
+    prvInitializeNewRingbuffer(xBufferSize, xBufferType, pxRingbuffer, pucRingbufferStorage);
+    pxRingbuffer->uxRingbufferFlags |= rbBUFFER_STATIC_FLAG;
+    return (RingbufHandle_t)pxRingbuffer;
+}
+#endif
+
+void vRingbufferSetOverwrite(RingbufHandle_t xRingbuffer, BaseType_t xOverwrite)
+{
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
-    configASSERT(pvItem != NULL || xItemSize == 0);
-    if (xItemSize > pxRingbuffer->xMaxItemSize) {
-        return pdFALSE;     //Data will never ever fit in the queue.
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbSPSC_FLAG | rbBROADCAST_FLAG)) == 0);  //Only locked no-split buffers and byte buffers are supported
+
+    SemaphoreHandle_t xWakeSender = NULL;
+    rbENTER_CRITICAL(pxRingbuffer);
+    if (xOverwrite == pdTRUE) {
+        pxRingbuffer->uxRingbufferFlags |= rbOVERWRITE_FLAG;
+        //A waiting sender may be able to make room now
+        rbSPECIALIZE(pxRingbuffer, xType, xWakeSender = prvWakeSender(pxRingbuffer, xType));
+    } else {
+        pxRingbuffer->uxRingbufferFlags &= ~rbOVERWRITE_FLAG;
     }
-    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
-        return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
+    rbEXIT_CRITICAL(pxRingbuffer);
+    if (xWakeSender != NULL) {
+        xSemaphoreGive(xWakeSender);
     }
+}
 
-    //Attempt to send an item
-    BaseType_t xReturn = pdFALSE;
-    BaseType_t xReturnSemaphore = pdFALSE;
-    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
-    TickType_t xTicksRemaining = xTicksToWait;
-    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
-        //Block until more free space becomes available or timeout
-        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
-            xReturn = pdFALSE;
+RingbufReaderHandle_t xRingbufferAddReader(RingbufHandle_t xRingbuffer, ringbuf_reader_type_t xReaderType)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    RingbufReader_t *pxReader = NULL;
+    UBaseType_t i;
+    configASSERT(pxRingbuffer);
+    configASSERT(pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG);
+
+    rbENTER_CRITICAL(pxRingbuffer);
+    for (i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+        if (pxRingbuffer->pxReaders[i].pxRingbuffer == NULL) {
+            pxReader = &pxRingbuffer->pxReaders[i];
+            pxReader->pxRingbuffer = pxRingbuffer;
+            //Start at the oldest item still in the buffer
+            pxReader->pucRead = pxRingbuffer->pucFree;
+            pxReader->xItemsWaiting = pxRingbuffer->xItemsWaiting;
+            pxReader->xReaderType = xReaderType;
+            pxReader->uxDropped = 0;
+            pxReader->xCopying = pdFALSE;
+            pxReader->xWaiting = pdFALSE;
             break;
         }
-        //Semaphore obtained, check if item can fit
-        portENTER_CRITICAL(&pxRingbuffer->mux);
-        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
-            //Item will fit, copy item
-            pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
-            xReturn = pdTRUE;
-            //Check if the free semaphore should be returned to allow other tasks to send
-            if (prvGetFreeSize(pxRingbuffer) > 0) {
-                xReturnSemaphore = pdTRUE;
+    }
+    rbEXIT_CRITICAL(pxRingbuffer);
+    return (RingbufReaderHandle_t)pxReader;
+}
+
+void vRingbufferRemoveReader(RingbufReaderHandle_t xReader)
+{
+    RingbufReader_t *pxReader = (RingbufReader_t *)xReader;
+    configASSERT(pxReader && pxReader->pxRingbuffer);
+    Ringbuffer_t *pxRingbuffer = pxReader->pxRingbuffer;
+    BaseType_t xWakeWriter;
+
+    rbENTER_CRITICAL(pxRingbuffer);
+    pxReader->pxRingbuffer = NULL;
+    xWakeWriter = (pxRingbuffer->xWriterWaiting > 0) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+    if (xWakeWriter == pdTRUE) {
+        //The writers may have been waiting for this reader
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    }
+}
+
+BaseType_t xRingbufferReceiveReader(RingbufReaderHandle_t xReader, void *pvBuffer, size_t xBufferSize, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+    //Check arguments
+    RingbufReader_t *pxReader = (RingbufReader_t *)xReader;
+    configASSERT(pxReader && pxReader->pxRingbuffer);
+    configASSERT(pvBuffer != NULL || xBufferSize == 0);
+    configASSERT(pxItemSize != NULL);
+    Ringbuffer_t *pxRingbuffer = pxReader->pxRingbuffer;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    ItemHeader_t *pxHeader = NULL;
+    BaseType_t xFound = pdFALSE;
+    BaseType_t xWakeWriter;
+
+    *pxItemSize = 0;
+    for (;;) {
+        rbENTER_CRITICAL(pxRingbuffer);
+        pxReader->xWaiting = pdFALSE;
+        if (pxReader->xItemsWaiting > 0) {
+            pxHeader = (ItemHeader_t *)pxReader->pucRead;
+            if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+                pxHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
             }
-            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            *pxItemSize = pxHeader->xItemLen;
+            xFound = pdTRUE;
+            if (pxHeader->xItemLen > xBufferSize) {
+                pxHeader = NULL;    //Left unread, for a call with a large enough buffer
+            } else {
+                pxReader->xCopying = pdTRUE;
+            }
+        } else if (xTicksRemaining != 0 && xTicksRemaining <= xTicksToWait) {    //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            //Announce the wait in the same critical section, the writer gives the semaphore after its next item
+            pxReader->xWaiting = pdTRUE;
+        }
+        rbEXIT_CRITICAL(pxRingbuffer);
+        if (xFound == pdTRUE || pxReader->xWaiting != pdTRUE) {
             break;
         }
-        //Item doesn't fit, adjust ticks and take the semaphore again
+        xSemaphoreTake(pxReader->xItemsBufferedSemaphore, xTicksRemaining);
         if (xTicksToWait != portMAX_DELAY) {
             xTicksRemaining = xTicksEnd - xTaskGetTickCount();
         }
-        portEXIT_CRITICAL(&pxRingbuffer->mux);
-        /*
-         * Gap between critical section and re-acquiring of the semaphore. If
-         * semaphore is given now, priority inversion might occur (see docs)
-         */
+    }
+    if (pxHeader == NULL) {
+        return pdFALSE;
     }
 
-    if (xReturn == pdTRUE) {
-        //Indicate item was successfully sent
-        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+    //Copy out of the critical section, the writers do not drop the item while xCopying is set
+    memcpy(pvBuffer, (uint8_t *)pxHeader + rbHEADER_SIZE, pxHeader->xItemLen);
+
+    rbENTER_CRITICAL(pxRingbuffer);
+    //Reading the oldest item may let the writers drop it
+    xWakeWriter = (pxReader->xItemsWaiting == pxRingbuffer->xItemsWaiting && pxRingbuffer->xWriterWaiting > 0) ? pdTRUE : pdFALSE;
+    prvSkipItemBroadcast(pxRingbuffer, &pxReader->pucRead);
+    pxReader->xItemsWaiting--;
+    pxReader->xCopying = pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeWriter == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
     }
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
+    return pdTRUE;
+}
+
+UBaseType_t uxRingbufferGetReaderDropped(RingbufReaderHandle_t xReader)
+{
+    RingbufReader_t *pxReader = (RingbufReader_t *)xReader;
+    configASSERT(pxReader && pxReader->pxRingbuffer);
+    return pxReader->uxDropped;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pvItem != NULL || xItemSize == 0);
+    if (xItemSize > pxRingbuffer->xMaxItemSize) {
+        return pdFALSE;     //Data will never ever fit in the queue.
     }
-    return xReturn;
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
+        return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
+    }
+    return prvSendGeneric(pxRingbuffer, pvItem, NULL, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItem != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG | rbBROADCAST_FLAG)) == 0);   //Only no-split buffers are supported, not broadcast ones
+    if (xItemSize > pxRingbuffer->xMaxItemSize) {
+        return pdFALSE;     //Data will never ever fit in the queue.
+    }
+    return prvSendGeneric(pxRingbuffer, NULL, ppvItem, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pvItem != NULL);
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        configASSERT(pvItem == pxRingbuffer->pucAcquired);
+        prvCompleteSPSC(pxRingbuffer, (uint8_t *)pvItem);
+        prvWakeSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, pdFALSE, NULL);
+        return pdTRUE;
+    }
+
+    ItemHeader_t *pxHeader = (ItemHeader_t *)((uint8_t *)pvItem - rbHEADER_SIZE);
+    SemaphoreHandle_t xWakeReceiver;
+    BaseType_t xQueueSet;
+    rbENTER_CRITICAL(pxRingbuffer);
+    configASSERT((uint8_t *)pvItem > pxRingbuffer->pucHead && (uint8_t *)pvItem <= pxRingbuffer->pucTail);
+    configASSERT(pxHeader->uxItemFlags == 0);   //Acquired, and not completed before
+    pxHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;
+    pxRingbuffer->xItemsWaiting++;
+    //Indicate item was successfully sent
+    xWakeReceiver = prvWakeReceiver(pxRingbuffer, RINGBUF_TYPE_NOSPLIT);
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGive(xWakeReceiver);
+    }
+    if (xQueueSet == pdTRUE) {
+        prvQueueSetSent(pxRingbuffer, pdFALSE, NULL);
+    }
+    return pdTRUE;
 }
 
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken)
@@ -811,29 +1994,54 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvIte
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvTrySendSPSC(pxRingbuffer, pvItem, NULL, xItemSize) != pdTRUE) {
+            pxRingbuffer->xStats.uxSendTimeouts++;
+            return pdFALSE;
+        }
+        prvWakeSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, pdTRUE, pxHigherPriorityTaskWoken);
+        return pdTRUE;
+    }
 
     //Attempt to send an item
     BaseType_t xReturn;
-    BaseType_t xReturnSemaphore = pdFALSE;
-    portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
-    if (pxRingbuffer->xCheckItemFits(xRingbuffer, xItemSize) == pdTRUE) {
-        pxRingbuffer->vCopyItem(xRingbuffer, pvItem, xItemSize);
-        xReturn = pdTRUE;
-        //Check if the free semaphore should be returned to allow other tasks to send
-        if (prvGetFreeSize(pxRingbuffer) > 0) {
-            xReturnSemaphore = pdTRUE;
+    BaseType_t xQueueSet;
+    SemaphoreHandle_t xWakeReceiver = NULL;
+    if (pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG) {
+        rbENTER_CRITICAL_ISR(pxRingbuffer);
+        xReturn = prvTrySendBroadcast(pxRingbuffer, pvItem, xItemSize);
+        if (xReturn != pdTRUE) {
+            pxRingbuffer->xStats.uxSendTimeouts++;
+        }
+        rbEXIT_CRITICAL_ISR(pxRingbuffer);
+        if (xReturn == pdTRUE) {
+            prvWakeReaders(pxRingbuffer, pdTRUE, pxHigherPriorityTaskWoken);
         }
+        return xReturn;
+    }
+    rbENTER_CRITICAL_ISR(pxRingbuffer);
+    if (pxRingbuffer->uxRingbufferFlags & rbOVERWRITE_FLAG) {
+        rbSPECIALIZE(pxRingbuffer, xType, xReturn = prvMakeRoom(pxRingbuffer, xItemSize, xType));
+    } else {
+        rbSPECIALIZE(pxRingbuffer, xType, xReturn = prvCheckItemFits(pxRingbuffer, xItemSize, xType));
+    }
+    if (xReturn == pdTRUE) {
+        rbSPECIALIZE(pxRingbuffer, xType, prvCopyItem(pxRingbuffer, pvItem, xItemSize, xType);
+                     xWakeReceiver = prvWakeReceiver(pxRingbuffer, xType));
+        prvRecordSend(pxRingbuffer, xItemSize, pxRingbuffer->xSize - prvGetFreeSize(pxRingbuffer));
     } else {
         xReturn = pdFALSE;
+        pxRingbuffer->xStats.uxSendTimeouts++;
     }
-    portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL_ISR(pxRingbuffer);
 
-    if (xReturn == pdTRUE) {
-        //Indicate item was successfully sent
-        xSemaphoreGiveFromISR(pxRingbuffer->xItemsBufferedSemaphore, pxHigherPriorityTaskWoken);
+    //Indicate item was successfully sent
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGiveFromISR(xWakeReceiver, pxHigherPriorityTaskWoken);
     }
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGiveFromISR(pxRingbuffer->xFreeSpaceSemaphore, pxHigherPriorityTaskWoken);  //Give back semaphore so other tasks can send
+    if (xReturn == pdTRUE && xQueueSet == pdTRUE) {
+        prvQueueSetSent(pxRingbuffer, pdTRUE, pxHigherPriorityTaskWoken);
     }
     return xReturn;
 }
@@ -997,10 +2205,147 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
-    portENTER_CRITICAL(&pxRingbuffer->mux);
-    pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
-    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvReturnItemSPSC(pxRingbuffer, (uint8_t *)pvItem);
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdFALSE, NULL);
+        return;
+    }
+
+    SemaphoreHandle_t xWakeSender;
+    SemaphoreHandle_t xWakeReceiver;
+    rbENTER_CRITICAL(pxRingbuffer);
+    //A byte buffer only hands out data again once the data retrieved is returned
+    rbSPECIALIZE(pxRingbuffer, xType, prvReturnItem(pxRingbuffer, (uint8_t *)pvItem, xType);
+                 xWakeSender = prvWakeSender(pxRingbuffer, xType);
+                 xWakeReceiver = (xType == RINGBUF_TYPE_BYTEBUF) ? prvWakeReceiver(pxRingbuffer, xType) : NULL);
+    rbEXIT_CRITICAL(pxRingbuffer);
+    if (xWakeSender != NULL) {
+        xSemaphoreGive(xWakeSender);
+    }
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGive(xWakeReceiver);
+    }
+}
+
+UBaseType_t uxRingbufferReceiveMultiple(RingbufHandle_t xRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxMaxItems, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pxItems != NULL || uxMaxItems == 0);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0);  //Byte buffers already return all contiguous data at once
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbBROADCAST_FLAG) == 0);    //Broadcast buffers are read with xRingbufferReceiveReader()
+    if (uxMaxItems == 0) {
+        return 0;
+    }
+
+    UBaseType_t uxCount = 0;
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //Wait for the first item only, then take whatever else is there
+        void *pvItem = prvReceiveSPSC(pxRingbuffer, 0, &pxItems[0].xHeadItemSize, xTicksToWait);
+        while (pvItem != NULL) {
+            pxItems[uxCount].pvHeadItem = pvItem;
+            pxItems[uxCount].pvTailItem = NULL;
+            pxItems[uxCount].xTailItemSize = 0;
+            if (++uxCount == uxMaxItems) {
+                break;
+            }
+            pvItem = prvTryReceiveSPSC(pxRingbuffer, 0, &pxItems[uxCount].xHeadItemSize);
+        }
+        return uxCount;
+    }
+
+    BaseType_t xWoken = pdFALSE;
+    BaseType_t xItemsLeft;
+    BaseType_t xQueueSet;
+    BaseType_t xReturn;
+    SemaphoreHandle_t xWakeReceiver;
+    RingbufWaiter_t xWaiter;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+
+    xWaiter.xSemaphore = NULL;      //Only set up before the first wait
+    rbENTER_CRITICAL(pxRingbuffer);
+    for (;;) {
+        //Retrieve all available items in one critical section
+        rbSPECIALIZE(pxRingbuffer, xType, uxCount = prvGetItems(pxRingbuffer, pxItems, uxMaxItems, xType));
+        if (uxCount > 0) {
+            break;
+        }
+        if (xWoken == pdTRUE) {
+            pxRingbuffer->xStats.uxSpuriousWakeups++;   //Another task took the items first
+        }
+        if (xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {   //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            break;
+        }
+        if (xWaiter.xSemaphore == NULL) {
+            //Set up the waiter outside of the critical section, then check again
+            rbEXIT_CRITICAL(pxRingbuffer);
+            xReturn = prvInitWaiter(&xWaiter, 0);
+            rbENTER_CRITICAL(pxRingbuffer);
+            if (xReturn != pdTRUE) {
+                break;
+            }
+            xWoken = pdFALSE;
+            continue;
+        }
+        prvInsertWaiter(&pxRingbuffer->pxReceiveWaiters, &xWaiter);
+        rbEXIT_CRITICAL(pxRingbuffer);
+        xWoken = prvBlockWaiter(pxRingbuffer, &pxRingbuffer->pxReceiveWaiters, &pxRingbuffer->uxReceiversWoken, &xWaiter, xTicksRemaining);
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+
+    //Wake another receiver for the items left
+    rbSPECIALIZE(pxRingbuffer, xType, xWakeReceiver = prvWakeReceiver(pxRingbuffer, xType));
+    xItemsLeft = (pxRingbuffer->xItemsWaiting > 0) ? pdTRUE : pdFALSE;
+    xQueueSet = (pxRingbuffer->uxRingbufferFlags & rbQUEUE_SET_READ_FLAG) ? pdTRUE : pdFALSE;
+    rbEXIT_CRITICAL(pxRingbuffer);
+
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGive(xWakeReceiver);
+    }
+    if (uxCount > 0 && xQueueSet == pdTRUE) {
+        prvQueueSetReceived(pxRingbuffer, xItemsLeft, pdFALSE);
+    }
+    if (xWaiter.xSemaphore != NULL) {
+        vSemaphoreDelete(xWaiter.xSemaphore);
+    }
+    return uxCount;
+}
+
+void vRingbufferReturnMultiple(RingbufHandle_t xRingbuffer, RingbufItem_t *pxItems, UBaseType_t uxItems)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pxItems != NULL || uxItems == 0);
+    UBaseType_t i;
+    if (uxItems == 0) {
+        return;
+    }
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        for (i = 0; i < uxItems; i++) {
+            prvReturnItemSPSC(pxRingbuffer, (uint8_t *)pxItems[i].pvHeadItem);
+        }
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdFALSE, NULL);
+        return;
+    }
+
+    SemaphoreHandle_t xWakeSender;
+    rbENTER_CRITICAL(pxRingbuffer);
+    for (i = 0; i < uxItems; i++) {
+        if (pxItems[i].pvTailItem != NULL) {
+            prvReturnItemDefault(pxRingbuffer, (uint8_t *)pxItems[i].pvTailItem);
+        }
+        prvReturnItemDefault(pxRingbuffer, (uint8_t *)pxItems[i].pvHeadItem);
+    }
+    rbSPECIALIZE(pxRingbuffer, xType, xWakeSender = prvWakeSender(pxRingbuffer, xType));
+    rbEXIT_CRITICAL(pxRingbuffer);
+    if (xWakeSender != NULL) {
+        xSemaphoreGive(xWakeSender);
+    }
 }
 
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken)
@@ -1009,10 +2354,26 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
-    portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
-    pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
-    portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
-    xSemaphoreGiveFromISR(pxRingbuffer->xFreeSpaceSemaphore, pxHigherPriorityTaskWoken);
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvReturnItemSPSC(pxRingbuffer, (uint8_t *)pvItem);
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdTRUE, pxHigherPriorityTaskWoken);
+        return;
+    }
+
+    SemaphoreHandle_t xWakeSender;
+    SemaphoreHandle_t xWakeReceiver;
+    rbENTER_CRITICAL_ISR(pxRingbuffer);
+    //A byte buffer only hands out data again once the data retrieved is returned
+    rbSPECIALIZE(pxRingbuffer, xType, prvReturnItem(pxRingbuffer, (uint8_t *)pvItem, xType);
+                 xWakeSender = prvWakeSender(pxRingbuffer, xType);
+                 xWakeReceiver = (xType == RINGBUF_TYPE_BYTEBUF) ? prvWakeReceiver(pxRingbuffer, xType) : NULL);
+    rbEXIT_CRITICAL_ISR(pxRingbuffer);
+    if (xWakeSender != NULL) {
+        xSemaphoreGiveFromISR(xWakeSender, pxHigherPriorityTaskWoken);
+    }
+    if (xWakeReceiver != NULL) {
+        xSemaphoreGiveFromISR(xWakeReceiver, pxHigherPriorityTaskWoken);
+    }
 }
 
 void vRingbufferDelete(RingbufHandle_t xRingbuffer)
@@ -1021,13 +2382,36 @@ void vRingbufferDelete(RingbufHandle_t xRingbuffer)
     configASSERT(pxRingbuffer);
 
     if (pxRingbuffer) {
-        free(pxRingbuffer->pucHead);
+        //Unregister the ring buffer first, uxRingbufferGetAllStats() may be reading it
+        rbENTER_REGISTRY();
+        Ringbuffer_t **ppxCur = &pxRegistryHead;
+        while (*ppxCur != NULL && *ppxCur != pxRingbuffer) {
+            ppxCur = &(*ppxCur)->pxNext;
+        }
+        if (*ppxCur != NULL) {
+            *ppxCur = pxRingbuffer->pxNext;
+        }
+        rbEXIT_REGISTRY();
+
+        //Static semaphores are deleted too, their memory is not freed
         if (pxRingbuffer->xFreeSpaceSemaphore) {
             vSemaphoreDelete(pxRingbuffer->xFreeSpaceSemaphore);
         }
         if (pxRingbuffer->xItemsBufferedSemaphore) {
             vSemaphoreDelete(pxRingbuffer->xItemsBufferedSemaphore);
         }
+        if (pxRingbuffer->pxReaders != NULL) {
+            for (UBaseType_t i = 0; i < pxRingbuffer->uxMaxReaders; i++) {
+                if (pxRingbuffer->pxReaders[i].xItemsBufferedSemaphore) {
+                    vSemaphoreDelete(pxRingbuffer->pxReaders[i].xItemsBufferedSemaphore);
+                }
+            }
+            free(pxRingbuffer->pxReaders);
+        }
+        if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_STATIC_FLAG) {
+            return;     //The memory belongs to the caller
+        }
+        free(pxRingbuffer->pucHead);
     }
     free(pxRingbuffer);
 }
@@ -1045,9 +2429,21 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
     configASSERT(pxRingbuffer);
 
     size_t xFreeSize;
-    portENTER_CRITICAL(&pxRingbuffer->mux);
-    xFreeSize = pxRingbuffer->xGetCurMaxSize(pxRingbuffer);
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
+    rbSPECIALIZE(pxRingbuffer, xType, xFreeSize = prvGetCurMaxSize(pxRingbuffer, xType));
+    rbEXIT_CRITICAL(pxRingbuffer);
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (rbLOAD_ACQUIRE(pxRingbuffer->pucWrite) == rbLOAD_ACQUIRE(pxRingbuffer->pucFree)) {
+            xFreeSize = pxRingbuffer->xMaxItemSize;     //Empty
+        } else {
+            //Minus the word (or byte) that always stays unused
+            size_t xUnused = (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) ? 1 : portBYTE_ALIGNMENT_MASK + 1;
+            xFreeSize = (xFreeSize > xUnused) ? xFreeSize - xUnused : 0;
+            if (xFreeSize > pxRingbuffer->xMaxItemSize) {
+                xFreeSize = pxRingbuffer->xMaxItemSize;
+            }
+        }
+    }
     return xFreeSize;
 }
 
@@ -1055,17 +2451,23 @@ BaseType_t xRingbufferAddToQueueSetRead(RingbufHandle_t xRingbuffer, QueueSetHan
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbSPSC_FLAG | rbBROADCAST_FLAG)) == 0);    //Their semaphores are only given to a waiting reader
 
     BaseType_t xReturn;
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     //Cannot add semaphore to queue set if semaphore is not empty. Temporarily hold semaphore
     BaseType_t xHoldSemaphore = xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, 0);
     xReturn = xQueueAddToSet(pxRingbuffer->xItemsBufferedSemaphore, xQueueSet);
+    if (xReturn == pdPASS) {
+        //From now on the semaphore is given while items are waiting, starting with the items already there
+        pxRingbuffer->uxRingbufferFlags |= rbQUEUE_SET_READ_FLAG;
+        xHoldSemaphore = (xHoldSemaphore == pdTRUE || pxRingbuffer->xItemsWaiting > 0) ? pdTRUE : pdFALSE;
+    }
     if (xHoldSemaphore == pdTRUE) {
         //Return semaphore if temporarily held
         configASSERT(xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore) == pdTRUE);
     }
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
     return xReturn;
 }
 
@@ -1083,15 +2485,18 @@ BaseType_t xRingbufferRemoveFromQueueSetRead(RingbufHandle_t xRingbuffer, QueueS
     configASSERT(pxRingbuffer);
 
     BaseType_t xReturn;
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     //Cannot remove semaphore from queue set if semaphore is not empty. Temporarily hold semaphore
     BaseType_t xHoldSemaphore = xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, 0);
     xReturn = xQueueRemoveFromSet(pxRingbuffer->xItemsBufferedSemaphore, xQueueSet);
+    if (xReturn == pdPASS) {
+        pxRingbuffer->uxRingbufferFlags &= ~rbQUEUE_SET_READ_FLAG;
+    }
     if (xHoldSemaphore == pdTRUE) {
         //Return semaphore if temporarily held
         configASSERT(xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore) == pdTRUE);
     }
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
     return xReturn;
 }
 
@@ -1100,7 +2505,7 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer, UBaseType_t *uxFree, UBaseT
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     if (uxFree != NULL) {
         *uxFree = (UBaseType_t)(pxRingbuffer->pucFree - pxRingbuffer->pucHead);
     }
@@ -1111,9 +2516,13 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer, UBaseType_t *uxFree, UBaseT
         *uxWrite = (UBaseType_t)(pxRingbuffer->pucWrite - pxRingbuffer->pucHead);
     }
     if (uxItemsWaiting != NULL) {
-        *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+            *uxItemsWaiting = pxRingbuffer->uxSent - pxRingbuffer->uxReceived;
+        } else {
+            *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        }
     }
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
 }
 
 void xRingbufferPrintInfo(RingbufHandle_t xRingbuffer)
@@ -1121,10 +2530,56 @@ void xRingbufferPrintInfo(RingbufHandle_t xRingbuffer)
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     printf("Rb size:%d\tfree: %d\trptr: %d\tfreeptr: %d\twptr: %d\n",
-           pxRingbuffer->xSize, prvGetFreeSize(pxRingbuffer),
-           pxRingbuffer->pucRead - pxRingbuffer->pucHead,
-           pxRingbuffer->pucFree - pxRingbuffer->pucHead,
-           pxRingbuffer->pucWrite - pxRingbuffer->pucHead);
+           (int)pxRingbuffer->xSize, (int)prvGetFreeSize(pxRingbuffer),
+           (int)(pxRingbuffer->pucRead - pxRingbuffer->pucHead),
+           (int)(pxRingbuffer->pucFree - pxRingbuffer->pucHead),
+           (int)(pxRingbuffer->pucWrite - pxRingbuffer->pucHead));
+}
+
+void vRingbufferSetName(RingbufHandle_t xRingbuffer, const char *pcName)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    rbENTER_CRITICAL(pxRingbuffer);
+    pxRingbuffer->xStats.pcName = pcName;
+    rbEXIT_CRITICAL(pxRingbuffer);
+}
+
+const char *pcRingbufferGetName(RingbufHandle_t xRingbuffer)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    return pxRingbuffer->xStats.pcName;
+}
+
+void vRingbufferGetStats(RingbufHandle_t xRingbuffer, RingbufStats_t *pxStats)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pxStats != NULL);
+
+    rbENTER_CRITICAL(pxRingbuffer);
+    *pxStats = pxRingbuffer->xStats;
+    rbEXIT_CRITICAL(pxRingbuffer);
+}
+
+UBaseType_t uxRingbufferGetAllStats(RingbufStats_t *pxStats, UBaseType_t uxMaxStats)
+{
+    configASSERT(pxStats != NULL || uxMaxStats == 0);
+    UBaseType_t uxCount = 0;
+    Ringbuffer_t *pxRingbuffer;
+
+    rbENTER_REGISTRY();
+    for (pxRingbuffer = pxRegistryHead; pxRingbuffer != NULL; pxRingbuffer = pxRingbuffer->pxNext) {
+        if (uxCount < uxMaxStats) {
+            rbENTER_CRITICAL(pxRingbuffer);
+            pxStats[uxCount] = pxRingbuffer->xStats;
+            rbEXIT_CRITICAL(pxRingbuffer);
+        }
+        uxCount++;
+    }
+    rbEXIT_REGISTRY();
+    return uxCount;
 }
 
 /* --------------------------------- Deprecated Functions ------------------------------ */
@@ -1137,10 +2592,10 @@ bool xRingbufferIsNextItemWrapped(RingbufHandle_t xRingbuffer)
     configASSERT(pxRingbuffer);
     bool is_wrapped;
 
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     ItemHeader_t *xHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
     is_wrapped = xHeader->uxItemFlags & rbITEM_SPLIT_FLAG;
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
     return is_wrapped;
 }
 
@@ -1151,7 +2606,7 @@ BaseType_t xRingbufferAddToQueueSetWrite(RingbufHandle_t xRingbuffer, QueueSetHa
     configASSERT(pxRingbuffer);
 
     BaseType_t xReturn;
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     //Cannot add semaphore to queue set if semaphore is not empty. Temporary hold semaphore
     BaseType_t xHoldSemaphore = xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, 0);
     xReturn = xQueueAddToSet(pxRingbuffer->xFreeSpaceSemaphore, xQueueSet);
@@ -1159,7 +2614,7 @@ BaseType_t xRingbufferAddToQueueSetWrite(RingbufHandle_t xRingbuffer, QueueSetHa
         //Return semaphore is temporarily held
         configASSERT(xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore) == pdTRUE);
     }
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
     return xReturn;
 }
 
@@ -1170,7 +2625,7 @@ BaseType_t xRingbufferRemoveFromQueueSetWrite(RingbufHandle_t xRingbuffer, Queue
     configASSERT(pxRingbuffer);
 
     BaseType_t xReturn;
-    portENTER_CRITICAL(&pxRingbuffer->mux);
+    rbENTER_CRITICAL(pxRingbuffer);
     //Cannot remove semaphore from queue set if semaphore is not empty. Temporary hold semaphore
     BaseType_t xHoldSemaphore = xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, 0);
     xReturn = xQueueRemoveFromSet(pxRingbuffer->xFreeSpaceSemaphore, xQueueSet);
@@ -1178,7 +2633,7 @@ BaseType_t xRingbufferRemoveFromQueueSetWrite(RingbufHandle_t xRingbuffer, Queue
         //Return semaphore is temporarily held
         configASSERT(xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore) == pdTRUE);
     }
-    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    rbEXIT_CRITICAL(pxRingbuffer);
     return xReturn;
 }
 
@@ -0,0 +1,329 @@
+/**
+ * @file m5stickc_battery.c
+ * @brief Battery monitor: filtered sampling, state of charge and runtime estimation.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_BATTERY
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+#include "esp_log.h"
+
+#include "m5stickc.h"
+
+#include "m5stickc_battery.h"
+#include "m5stickc_scheduler.h"
+
+static const char *TAG = "m5stickc_battery";
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Number of fractional bits kept in the filtered voltage.
+ */
+#define BATTERY_FILTER_FRAC_BITS    ( 4 )
+
+/**
+ * @brief AXP192 ADC conversions: VBAT LSB is 1.1 mV, APS LSB is 1.4 mV.
+ */
+#define BATTERY_VBAT_TO_MV( raw )   ( ( ( uint32_t ) ( raw ) * 11 ) / 10 )
+#define BATTERY_VAPS_TO_MV( raw )   ( ( ( uint32_t ) ( raw ) * 14 ) / 10 )
+
+/**
+ * @brief APS voltage above which VBUS is considered present.
+ */
+#define BATTERY_CHARGING_VAPS_MV    ( 4500 )
+
+/**
+ * @brief Internal state of charge resolution: hundredths of a percent.
+ */
+#define BATTERY_LEVEL_SCALE         ( 100 )
+
+/**
+ * @brief Weight of a new discharge rate measurement: 1 / 2^shift.
+ */
+#define BATTERY_RATE_FILTER_SHIFT   ( 2 )
+
+typedef struct {
+    uint16_t mv;
+    uint8_t level;
+} battery_curve_point_t;
+
+/**
+ * @brief Open circuit voltage to state of charge of a single Li-ion cell.
+ *
+ * Points are sorted by descending voltage. The curve is flat between 3.7 V and
+ * 3.9 V and drops fast below 3.7 V, which a linear formula can not follow.
+ */
+static const battery_curve_point_t xBatteryCurve[] = {
+    { 4200, 100 },
+    { 4150, 95 },
+    { 4110, 90 },
+    { 4080, 85 },
+    { 4020, 80 },
+    { 3980, 75 },
+    { 3950, 70 },
+    { 3910, 65 },
+    { 3870, 60 },
+    { 3850, 55 },
+    { 3840, 50 },
+    { 3820, 45 },
+    { 3800, 40 },
+    { 3790, 35 },
+    { 3770, 30 },
+    { 3750, 25 },
+    { 3730, 20 },
+    { 3710, 15 },
+    { 3690, 10 },
+    { 3610, 5 },
+    { 3270, 0 },
+};
+
+#define BATTERY_CURVE_POINTS ( sizeof( xBatteryCurve ) / sizeof( xBatteryCurve[ 0 ] ) )
+
+/*-----------------------------------------------------------*/
+
+static m5stickc_battery_callback_t xBatteryCallback = NULL;
+static m5stickc_scheduler_job_t xBatterySampleJob = NULL;
+static portMUX_TYPE xBatteryMux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Exponential filter of the battery voltage, in mV << BATTERY_FILTER_FRAC_BITS */
+static bool bFilterPrimed = false;
+static int32_t lFilteredVoltage = 0;
+
+/* Discharge rate estimation, levels in hundredths of a percent */
+static bool bRateReferenceSet = false;
+static uint32_t ulRateReferenceLevel = 0;
+static uint64_t ullRateReferenceTimeMs = 0;
+static uint32_t ulDischargeRate = 0;    /* Hundredths of a percent per hour */
+
+static m5stickc_battery_state_t xBatteryState = {
+    .voltage_mv = 0,
+    .level = 0,
+    .charging = false,
+    .runtime_min = M5STICKC_BATTERY_RUNTIME_UNKNOWN
+};
+static m5stickc_battery_state_t xBatteryPublished;
+static bool bBatteryPublished = false;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Map a voltage onto the discharge curve.
+ *
+ * @return The state of charge in hundredths of a percent.
+ */
+static uint32_t prvVoltageToLevel(uint32_t ulVoltage)
+{
+    size_t i;
+
+    if (ulVoltage >= xBatteryCurve[0].mv)
+    {
+        return 100 * BATTERY_LEVEL_SCALE;
+    }
+
+    for (i = 1; i < BATTERY_CURVE_POINTS; i++)
+    {
+        if (ulVoltage >= xBatteryCurve[i].mv)
+        {
+            const battery_curve_point_t *pxHigh = &xBatteryCurve[i - 1];
+            const battery_curve_point_t *pxLow = &xBatteryCurve[i];
+
+            return pxLow->level * BATTERY_LEVEL_SCALE +
+                   ((ulVoltage - pxLow->mv) * (pxHigh->level - pxLow->level) * BATTERY_LEVEL_SCALE) / (pxHigh->mv - pxLow->mv);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Update the discharge rate from the level drop observed since the
+ * reference point, and return the estimated runtime.
+ */
+static uint32_t prvEstimateRuntime(uint32_t ulLevel, bool bCharging)
+{
+    uint64_t ullNowMs = IotClock_GetTimeMs();
+
+    if (bCharging || !bRateReferenceSet || ulLevel > ulRateReferenceLevel)
+    {
+        /* Restart the measurement from here */
+        bRateReferenceSet = !bCharging;
+        ulRateReferenceLevel = ulLevel;
+        ullRateReferenceTimeMs = ullNowMs;
+    }
+    else if (ulRateReferenceLevel - ulLevel >= BATTERY_LEVEL_SCALE && ullNowMs > ullRateReferenceTimeMs)
+    {
+        /* At least 1% was consumed since the reference point */
+        uint32_t ulRate = (uint32_t)(((uint64_t)(ulRateReferenceLevel - ulLevel) * 3600000ULL) / (ullNowMs - ullRateReferenceTimeMs));
+
+        if (ulDischargeRate == 0)
+        {
+            ulDischargeRate = ulRate;
+        }
+        else
+        {
+            ulDischargeRate += ((int32_t)ulRate - (int32_t)ulDischargeRate) >> BATTERY_RATE_FILTER_SHIFT;
+        }
+
+        ESP_LOGD(TAG, "prvEstimateRuntime: rate %u, filtered rate %u", ulRate, ulDischargeRate);
+
+        ulRateReferenceLevel = ulLevel;
+        ullRateReferenceTimeMs = ullNowMs;
+    }
+
+    if (bCharging || ulDischargeRate == 0)
+    {
+        return M5STICKC_BATTERY_RUNTIME_UNKNOWN;
+    }
+
+    return (ulLevel * 60) / ulDischargeRate;
+}
+
+static bool prvShouldPublish(const m5stickc_battery_state_t *pxState)
+{
+    if (!bBatteryPublished)
+    {
+        return true;
+    }
+
+    if (pxState->charging != xBatteryPublished.charging || pxState->level != xBatteryPublished.level)
+    {
+        return true;
+    }
+
+    if (abs((int)pxState->voltage_mv - (int)xBatteryPublished.voltage_mv) >= M5CONFIG_BATTERY_PUBLISH_DELTA_MV)
+    {
+        return true;
+    }
+
+    if ((pxState->runtime_min == M5STICKC_BATTERY_RUNTIME_UNKNOWN) != (xBatteryPublished.runtime_min == M5STICKC_BATTERY_RUNTIME_UNKNOWN))
+    {
+        return true;
+    }
+
+    if (pxState->runtime_min != M5STICKC_BATTERY_RUNTIME_UNKNOWN &&
+        abs((int)pxState->runtime_min - (int)xBatteryPublished.runtime_min) >= M5CONFIG_BATTERY_PUBLISH_DELTA_RUNTIME)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+static void prvBatterySampleJob(void *context)
+{
+    m5stickc_battery_sample();
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_battery_sample(void)
+{
+    esp_err_t res = ESP_FAIL;
+    uint16_t vbat = 0, vaps = 0;
+    m5stickc_battery_state_t xState;
+    bool bPublish = false;
+
+    res = m5power_get_vbat(&vbat);
+    res |= m5power_get_vaps(&vaps);
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "m5stickc_battery_sample: failed to read the battery voltage");
+        return res;
+    }
+
+    int32_t lSample = (int32_t)BATTERY_VBAT_TO_MV(vbat) << BATTERY_FILTER_FRAC_BITS;
+
+    if (!bFilterPrimed)
+    {
+        lFilteredVoltage = lSample;
+        bFilterPrimed = true;
+    }
+    else
+    {
+        lFilteredVoltage += (lSample - lFilteredVoltage) >> M5CONFIG_BATTERY_FILTER_SHIFT;
+    }
+
+    xState.voltage_mv = (uint16_t)(lFilteredVoltage >> BATTERY_FILTER_FRAC_BITS);
+    xState.charging = BATTERY_VAPS_TO_MV(vaps) >= BATTERY_CHARGING_VAPS_MV;
+
+    uint32_t ulLevel = prvVoltageToLevel(xState.voltage_mv);
+    xState.level = (uint8_t)(ulLevel / BATTERY_LEVEL_SCALE);
+    xState.runtime_min = prvEstimateRuntime(ulLevel, xState.charging);
+
+    ESP_LOGD(TAG, "m5stickc_battery_sample: VBat: %u, VAps: %u, filtered: %u mV, level: %u, runtime: %u",
+             vbat, vaps, xState.voltage_mv, xState.level, xState.runtime_min);
+
+    portENTER_CRITICAL(&xBatteryMux);
+    xBatteryState = xState;
+    portEXIT_CRITICAL(&xBatteryMux);
+
+    if (prvShouldPublish(&xState))
+    {
+        xBatteryPublished = xState;
+        bBatteryPublished = true;
+        bPublish = true;
+    }
+
+    if (bPublish && xBatteryCallback != NULL)
+    {
+        xBatteryCallback(&xState);
+    }
+
+    return res;
+}
+
+esp_err_t m5stickc_battery_get_state(m5stickc_battery_state_t *state)
+{
+    if (state == NULL || !bFilterPrimed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&xBatteryMux);
+    *state = xBatteryState;
+    portEXIT_CRITICAL(&xBatteryMux);
+
+    return ESP_OK;
+}
+
+esp_err_t m5stickc_battery_init(m5stickc_battery_callback_t callback)
+{
+    esp_err_t res = ESP_FAIL;
+
+    xBatteryCallback = callback;
+
+    /* First sample primes the filter and publishes the initial state */
+    res = m5stickc_battery_sample();
+
+    if (xBatterySampleJob == NULL)
+    {
+        xBatterySampleJob = m5stickc_scheduler_add("battery", M5CONFIG_BATTERY_SAMPLE_PERIOD_MS, M5CONFIG_BATTERY_SAMPLE_SLACK_MS, true, prvBatterySampleJob, NULL);
+    }
+
+    if (xBatterySampleJob == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_battery_init: failed to schedule the sampling");
+        return ESP_FAIL;
+    }
+
+    return res;
+}
+
+/*-----------------------------------------------------------*/
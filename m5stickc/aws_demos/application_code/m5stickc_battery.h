@@ -0,0 +1,39 @@
+/**
+ * @file m5stickc_battery.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_BATTERY_H_
+#define _M5STICKC_BATTERY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief Value of runtime_min while no discharge rate has been observed yet
+ * (or while the device is charging).
+ */
+#define M5STICKC_BATTERY_RUNTIME_UNKNOWN ( UINT32_MAX )
+
+typedef struct {
+    uint16_t voltage_mv;    /* Filtered battery voltage */
+    uint8_t level;          /* State of charge, 0 to 100 % */
+    bool charging;          /* VBUS is present */
+    uint32_t runtime_min;   /* Estimated remaining runtime, or M5STICKC_BATTERY_RUNTIME_UNKNOWN */
+} m5stickc_battery_state_t;
+
+/**
+ * @brief Called from the sampling context whenever the published battery
+ * state changes meaningfully.
+ */
+typedef void (*m5stickc_battery_callback_t)(const m5stickc_battery_state_t *state);
+
+esp_err_t m5stickc_battery_init(m5stickc_battery_callback_t callback);
+esp_err_t m5stickc_battery_sample(void);
+esp_err_t m5stickc_battery_get_state(m5stickc_battery_state_t *state);
+
+#endif /* ifndef _M5STICKC_BATTERY_H_ */
@@ -0,0 +1,221 @@
+/**
+ * @file m5stickc_boot.c
+ * @brief Boot orchestrator: runs the independent init steps concurrently, following a dependency graph.
+ *
+ * Each step gets its own task, which waits on an event group for the steps it
+ * depends on. Most init steps spend their time waiting on flash, the radio or
+ * the SPI and I2C buses, so they overlap even on a single core. Once all the
+ * steps are done, the critical path of the graph is logged: it is the lower
+ * bound of the boot time, whatever the number of cores.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_BOOT
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "m5stickc_boot.h"
+#include "m5stickc_boot_trace.h"
+
+static const char *TAG = "m5stickc_boot";
+
+/*-----------------------------------------------------------*/
+
+typedef struct {
+    int64_t start;
+    int64_t end;
+    esp_err_t result;
+    uint32_t stack_free;    /* High water mark of the task that ran the step */
+} boot_step_state_t;
+
+static const m5stickc_boot_step_t *pxBootSteps = NULL;
+static boot_step_state_t xBootState[M5STICKC_BOOT_MAX_STEPS];
+static EventGroupHandle_t xBootEvents = NULL;
+static volatile uint32_t ulBootFailed = 0;
+static portMUX_TYPE xBootMux = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+static void prvRunStep(size_t index)
+{
+    const m5stickc_boot_step_t *pxStep = &pxBootSteps[index];
+    boot_step_state_t *pxState = &xBootState[index];
+
+    if (pxStep->deps)
+    {
+        xEventGroupWaitBits(xBootEvents, pxStep->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+
+    pxState->start = esp_timer_get_time();
+
+    if (ulBootFailed & pxStep->deps)
+    {
+        ESP_LOGE(TAG, "%s: skipped, a dependency failed", pxStep->name);
+        pxState->result = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        pxState->result = pxStep->run();
+    }
+
+    pxState->end = esp_timer_get_time();
+    pxState->stack_free = uxTaskGetStackHighWaterMark(NULL);
+
+    if (pxState->result == ESP_OK)
+    {
+        m5stickc_boot_trace_mark(pxStep->name);
+    }
+    else
+    {
+        portENTER_CRITICAL(&xBootMux);
+        ulBootFailed |= M5STICKC_BOOT_DEP(index);
+        portEXIT_CRITICAL(&xBootMux);
+    }
+
+    xEventGroupSetBits(xBootEvents, M5STICKC_BOOT_DEP(index));
+}
+
+static void prvBootStepTask(void *pvParameters)
+{
+    prvRunStep((size_t)pvParameters);
+
+    vTaskDelete(NULL);
+}
+
+static void prvReport(size_t count, int64_t start, int64_t end)
+{
+    int64_t pathLength[M5STICKC_BOOT_MAX_STEPS];
+    int pathPrevious[M5STICKC_BOOT_MAX_STEPS];
+    int64_t sequential = 0;
+    size_t i, j, last = 0;
+    char pPath[128] = { 0 };
+    size_t length = 0;
+    int step;
+
+    ESP_LOGI(TAG, "%-16s %12s %12s %10s %s", "Step", "Start (us)", "Time (us)", "Stack free", "Result");
+
+    for (i = 0; i < count; i++)
+    {
+        int64_t duration = xBootState[i].end - xBootState[i].start;
+
+        ESP_LOGI(TAG, "%-16s %12lld %12lld %10u %s", pxBootSteps[i].name, xBootState[i].start - start, duration,
+                 xBootState[i].stack_free, xBootState[i].result == ESP_OK ? "OK" : "NOK");
+
+        sequential += duration;
+
+        /* The table is in dependency order: the longest chain ending at each step is known */
+        pathLength[i] = duration;
+        pathPrevious[i] = -1;
+
+        for (j = 0; j < i; j++)
+        {
+            if ((pxBootSteps[i].deps & M5STICKC_BOOT_DEP(j)) && pathLength[j] + duration > pathLength[i])
+            {
+                pathLength[i] = pathLength[j] + duration;
+                pathPrevious[i] = (int)j;
+            }
+        }
+
+        if (pathLength[i] > pathLength[last])
+        {
+            last = i;
+        }
+    }
+
+    /* Walk the chain back from its end */
+    for (step = (int)last; step >= 0 && length < sizeof(pPath); step = pathPrevious[step])
+    {
+        length += snprintf(pPath + length, sizeof(pPath) - length, "%s%s",
+                           step == (int)last ? "" : " <- ", pxBootSteps[step].name);
+    }
+
+    ESP_LOGI(TAG, "Critical path: %lld us (%s)", pathLength[last], pPath);
+    ESP_LOGI(TAG, "Boot graph: %lld us, %lld us if run sequentially", end - start, sequential);
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_boot_run(const m5stickc_boot_step_t *steps, size_t count)
+{
+    UBaseType_t uxPriority = uxTaskPriorityGet(NULL);
+    EventBits_t uxAllSteps = 0;
+    int64_t start, end;
+    size_t i;
+
+    if (steps == NULL || count == 0 || count > M5STICKC_BOOT_MAX_STEPS || xBootEvents != NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        /* Only earlier steps as dependencies, so that the graph has no cycle */
+        if (steps[i].run == NULL || (steps[i].deps >> i) != 0)
+        {
+            ESP_LOGE(TAG, "m5stickc_boot_run: invalid step %s", steps[i].name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    xBootEvents = xEventGroupCreate();
+
+    if (xBootEvents == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_boot_run: failed to create the event group");
+        return ESP_ERR_NO_MEM;
+    }
+
+    pxBootSteps = steps;
+    memset(xBootState, 0, sizeof(xBootState));
+
+    start = esp_timer_get_time();
+
+    for (i = 0; i < count; i++)
+    {
+        if (xTaskCreatePinnedToCore(prvBootStepTask, steps[i].name, steps[i].stack, (void *)i,
+                                    uxPriority, NULL, steps[i].core) != pdPASS)
+        {
+            /* Run it here instead, after the steps it depends on */
+            ESP_LOGW(TAG, "m5stickc_boot_run: no task for %s, running it inline", steps[i].name);
+            prvRunStep(i);
+        }
+
+        uxAllSteps |= M5STICKC_BOOT_DEP(i);
+    }
+
+    xEventGroupWaitBits(xBootEvents, uxAllSteps, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    end = esp_timer_get_time();
+
+    prvReport(count, start, end);
+
+    for (i = 0; i < count; i++)
+    {
+        if (xBootState[i].result != ESP_OK)
+        {
+            return xBootState[i].result;
+        }
+    }
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,43 @@
+/**
+ * @file m5stickc_boot.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_BOOT_H_
+#define _M5STICKC_BOOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/* A step can only depend on the steps listed before it in the table */
+#define M5STICKC_BOOT_DEP(index)    ( 1UL << ( index ) )
+
+/* The event group of the orchestrator has 24 usable bits */
+#define M5STICKC_BOOT_MAX_STEPS     ( 24 )
+
+/**
+ * @brief One node of the boot graph, run in its own task once all its dependencies are done.
+ */
+typedef struct {
+    const char *name;           /* Task name, and boot trace stage */
+    esp_err_t (*run)(void);
+    uint32_t deps;              /* M5STICKC_BOOT_DEP() of each step that must be done first */
+    uint32_t stack;             /* Task stack size in bytes */
+    int core;                   /* 0, 1 or tskNO_AFFINITY, ignored with CONFIG_FREERTOS_UNICORE */
+} m5stickc_boot_step_t;
+
+/**
+ * @brief Run the boot graph and wait until every step is done.
+ *
+ * The steps that depend on a failed step are skipped. Logs the time of each step and the
+ * critical path of the graph.
+ *
+ * @return ESP_OK if every step succeeded, the first error otherwise.
+ */
+esp_err_t m5stickc_boot_run(const m5stickc_boot_step_t *steps, size_t count);
+
+#endif /* ifndef _M5STICKC_BOOT_H_ */
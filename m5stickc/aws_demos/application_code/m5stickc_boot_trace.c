@@ -0,0 +1,191 @@
+/**
+ * @file m5stickc_boot_trace.c
+ * @brief Boot profiler: timestamps of each boot stage, from app_main to the first publish.
+ *
+ * Each mark stores the CPU cycle counter and the esp_timer time in a static
+ * buffer, so marking is cheap enough to be left in the boot path. The cycle
+ * counter wraps every 2^32 cycles (about 26 s at 160 MHz) and does not tick
+ * at a constant rate under DFS, so the microsecond time is the reference and
+ * cycles are only reported for short stages.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_BOOT
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+/* Shadow include. */
+#include "aws_iot_shadow.h"
+
+#include "aws_demo.h"
+#include "types/iot_network_types.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
+#include "esp_log.h"
+
+#include "m5stickc_lab_connection.h"
+#include "m5stickc_boot_trace.h"
+
+static const char *TAG = "m5stickc_boot_trace";
+
+/*-----------------------------------------------------------*/
+
+#define BOOT_TRACE_TOPIC_FORMAT     "m5stickc/%s/boot"
+#define BOOT_TRACE_TOPIC_LENGTH     ( sizeof( BOOT_TRACE_TOPIC_FORMAT ) + 12 )
+
+/* {"s":"<stage>","us":<time>}, with stage names up to 24 characters */
+#define BOOT_TRACE_ENTRY_LENGTH     ( 48 )
+#define BOOT_TRACE_PAYLOAD_LENGTH   ( 16 + M5CONFIG_BOOT_TRACE_MAX_STAGES * BOOT_TRACE_ENTRY_LENGTH )
+
+#define BOOT_TRACE_PUBLISH_RETRY_MS     ( 1000 )
+#define BOOT_TRACE_PUBLISH_RETRY_LIMIT  ( 3 )
+
+/* Stages longer than this are not reported in cycles, the counter may have wrapped */
+#define BOOT_TRACE_CYCLES_MAX_US    ( 10000000LL )
+
+typedef struct {
+    const char *stage;
+    uint32_t ccount;
+    int64_t us;
+} boot_trace_entry_t;
+
+static boot_trace_entry_t xBootTrace[M5CONFIG_BOOT_TRACE_MAX_STAGES];
+static size_t xBootTraceCount = 0;
+static bool bBootTraceOverflow = false;
+static portMUX_TYPE xBootTraceMux = portMUX_INITIALIZER_UNLOCKED;
+
+#if M5CONFIG_BOOT_TRACE_PUBLISH
+static bool bBootTracePublished = false;
+static char pBootTracePayload[BOOT_TRACE_PAYLOAD_LENGTH];
+static char pBootTraceTopic[BOOT_TRACE_TOPIC_LENGTH];
+#endif
+
+/*-----------------------------------------------------------*/
+
+void m5stickc_boot_trace_mark(const char *stage)
+{
+    uint32_t ccount = xthal_get_ccount();
+    int64_t us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&xBootTraceMux);
+
+    if (xBootTraceCount < M5CONFIG_BOOT_TRACE_MAX_STAGES)
+    {
+        xBootTrace[xBootTraceCount].stage = stage;
+        xBootTrace[xBootTraceCount].ccount = ccount;
+        xBootTrace[xBootTraceCount].us = us;
+        xBootTraceCount++;
+    }
+    else
+    {
+        bBootTraceOverflow = true;
+    }
+
+    portEXIT_CRITICAL(&xBootTraceMux);
+}
+
+void m5stickc_boot_trace_dump(void)
+{
+    size_t i, count;
+
+    portENTER_CRITICAL(&xBootTraceMux);
+    count = xBootTraceCount;
+    portEXIT_CRITICAL(&xBootTraceMux);
+
+    ESP_LOGI(TAG, "%-24s %12s %12s %12s", "Stage", "Time (us)", "Delta (us)", "Delta (cyc)");
+
+    for (i = 0; i < count; i++)
+    {
+        const boot_trace_entry_t *pxEntry = &xBootTrace[i];
+        int64_t delta = i == 0 ? 0 : pxEntry->us - xBootTrace[i - 1].us;
+
+        if (i > 0 && delta < BOOT_TRACE_CYCLES_MAX_US)
+        {
+            ESP_LOGI(TAG, "%-24s %12lld %12lld %12u", pxEntry->stage, pxEntry->us, delta,
+                     pxEntry->ccount - xBootTrace[i - 1].ccount);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%-24s %12lld %12lld %12s", pxEntry->stage, pxEntry->us, delta, "-");
+        }
+    }
+
+    if (bBootTraceOverflow)
+    {
+        ESP_LOGW(TAG, "Some stages were dropped, increase M5CONFIG_BOOT_TRACE_MAX_STAGES");
+    }
+}
+
+esp_err_t m5stickc_boot_trace_publish(const char *strID)
+{
+#if M5CONFIG_BOOT_TRACE_PUBLISH
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    size_t i, count, length = 0;
+    int status;
+
+    if (bBootTracePublished)
+    {
+        return ESP_OK;
+    }
+    bBootTracePublished = true;
+
+    portENTER_CRITICAL(&xBootTraceMux);
+    count = xBootTraceCount;
+    portEXIT_CRITICAL(&xBootTraceMux);
+
+    status = snprintf(pBootTraceTopic, sizeof(pBootTraceTopic), BOOT_TRACE_TOPIC_FORMAT, strID);
+    if (status < 0 || status >= (int)sizeof(pBootTraceTopic))
+    {
+        return ESP_FAIL;
+    }
+
+    length = snprintf(pBootTracePayload, sizeof(pBootTracePayload), "{\"stages\":[");
+
+    for (i = 0; i < count && length < sizeof(pBootTracePayload); i++)
+    {
+        length += snprintf(pBootTracePayload + length, sizeof(pBootTracePayload) - length,
+                           "%s{\"s\":\"%s\",\"us\":%lld}", i == 0 ? "" : ",", xBootTrace[i].stage, xBootTrace[i].us);
+    }
+
+    if (length < sizeof(pBootTracePayload))
+    {
+        length += snprintf(pBootTracePayload + length, sizeof(pBootTracePayload) - length, "]}");
+    }
+
+    if (length >= sizeof(pBootTracePayload))
+    {
+        ESP_LOGE(TAG, "m5stickc_boot_trace_publish: payload does not fit in %u bytes", sizeof(pBootTracePayload));
+        return ESP_ERR_NO_MEM;
+    }
+
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.retryMs = BOOT_TRACE_PUBLISH_RETRY_MS;
+    publishInfo.retryLimit = BOOT_TRACE_PUBLISH_RETRY_LIMIT;
+    publishInfo.pTopicName = pBootTraceTopic;
+    publishInfo.topicNameLength = (uint16_t)strlen(pBootTraceTopic);
+    publishInfo.pPayload = pBootTracePayload;
+    publishInfo.payloadLength = length;
+
+    return m5stickc_lab_connection_publish(&publishInfo, NULL);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/*-----------------------------------------------------------*/
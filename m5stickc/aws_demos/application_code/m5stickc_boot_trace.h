@@ -0,0 +1,29 @@
+/**
+ * @file m5stickc_boot_trace.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_BOOT_TRACE_H_
+#define _M5STICKC_BOOT_TRACE_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Record the end of a boot stage. The name is stored as a pointer, so
+ * it has to be a string literal.
+ */
+void m5stickc_boot_trace_mark(const char *stage);
+
+/**
+ * @brief Print the recorded stages as a table on the serial console.
+ */
+void m5stickc_boot_trace_dump(void);
+
+/**
+ * @brief Publish the recorded stages on m5stickc/<strID>/boot. Only the first call publishes.
+ */
+esp_err_t m5stickc_boot_trace_publish(const char *strID);
+
+#endif /* ifndef _M5STICKC_BOOT_TRACE_H_ */
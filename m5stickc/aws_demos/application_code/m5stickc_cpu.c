@@ -0,0 +1,474 @@
+/**
+ * @file m5stickc_cpu.c
+ * @brief CPU share of each task and idle time of each core, over sliding windows.
+ *
+ * FreeRTOS adds the run time of each task up in ulRunTimeCounter, counted
+ * with the 1 MHz ESP timer, which does not change with the CPU frequency
+ * (CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER). The counters are 32 bits
+ * and wrap every 71 minutes, so they are only ever used as differences
+ * between two walks of the tasks, one window apart. Each window is kept as a
+ * share in permille, and the average of the last M5CONFIG_CPU_WINDOWS windows
+ * smooths the bursts out.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_CPU
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+#include "aws_demo.h"
+#include "types/iot_network_types.h"
+#include "esp_log.h"
+
+#include "m5stickc_lab_connection.h"
+#include "m5stickc_scheduler.h"
+#include "m5stickc_cpu.h"
+
+static const char *TAG = "m5stickc_cpu";
+
+/*-----------------------------------------------------------*/
+
+#define CPU_TOPIC_FORMAT            "m5stickc/%s/cpu"
+#define CPU_TOPIC_LENGTH            ( sizeof( CPU_TOPIC_FORMAT ) + 12 )
+
+/* {"w":,"idle":[],"t":{"<name>":<permille>,...}} */
+#define CPU_PAYLOAD_LENGTH          ( 48 + portNUM_PROCESSORS * 6 + M5CONFIG_CPU_MAX_TASKS * ( configMAX_TASK_NAME_LEN + 8 ) )
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t run;                           /* Run time in the current window, all the tasks of that name */
+    uint16_t share[M5CONFIG_CPU_WINDOWS];   /* Permille of the CPU time of each window */
+    uint16_t published;                     /* Average at the last publication */
+} cpu_record_t;
+
+typedef struct {
+    TaskHandle_t handle;                    /* NULL when the slot is free */
+    uint32_t counter;                       /* ulRunTimeCounter at the previous walk */
+    cpu_record_t *record;
+    bool seen;
+} cpu_slot_t;
+
+static cpu_record_t xRecords[M5CONFIG_CPU_MAX_TASKS];
+static size_t xRecordCount = 0;
+static cpu_slot_t xSlots[M5CONFIG_CPU_MAX_TASKS];
+static bool bTablesFull = false;
+
+static uint32_t ulIdleRun[portNUM_PROCESSORS];
+static uint16_t usIdleShare[portNUM_PROCESSORS][M5CONFIG_CPU_WINDOWS];
+static uint16_t usIdlePublished[portNUM_PROCESSORS];
+
+static size_t xWindowNext = 0;
+static size_t xWindowCount = 0;
+static uint32_t ulWindowTime = 0;           /* Length of the last window, us */
+static uint32_t ulLastTotal = 0;
+static uint32_t ulWindows = 0;
+static bool bStarted = false;
+
+/* Filled by uxTaskGetSystemState, kept out of the stack of the timer task */
+static TaskStatus_t xTaskStatus[M5CONFIG_CPU_MAX_TASKS];
+
+static SemaphoreHandle_t xCpuMutex = NULL;
+static m5stickc_scheduler_job_t xCpuJob = NULL;
+static const char *pCpuStrID = NULL;
+
+#if M5CONFIG_CPU_PUBLISH
+static char pCpuPayload[CPU_PAYLOAD_LENGTH];
+static char pCpuTopic[CPU_TOPIC_LENGTH];
+#endif
+
+/*-----------------------------------------------------------*/
+
+static cpu_record_t *prvFindRecord(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        if (strncmp(xRecords[i].name, name, sizeof(xRecords[i].name)) == 0)
+        {
+            return &xRecords[i];
+        }
+    }
+
+    if (xRecordCount == M5CONFIG_CPU_MAX_TASKS)
+    {
+        bTablesFull = true;
+        return NULL;
+    }
+
+    strncpy(xRecords[xRecordCount].name, name, sizeof(xRecords[xRecordCount].name) - 1);
+
+    return &xRecords[xRecordCount++];
+}
+
+static cpu_slot_t *prvFindSlot(TaskHandle_t handle)
+{
+    cpu_slot_t *pxFree = NULL;
+    size_t i;
+
+    for (i = 0; i < M5CONFIG_CPU_MAX_TASKS; i++)
+    {
+        if (xSlots[i].handle == handle)
+        {
+            return &xSlots[i];
+        }
+        if (xSlots[i].handle == NULL && pxFree == NULL)
+        {
+            pxFree = &xSlots[i];
+        }
+    }
+
+    return pxFree;
+}
+
+static uint16_t prvAverage(const uint16_t *share)
+{
+    uint32_t sum = 0;
+    size_t i;
+
+    for (i = 0; i < xWindowCount; i++)
+    {
+        sum += share[i];
+    }
+
+    return xWindowCount == 0 ? 0 : (uint16_t)(sum / xWindowCount);
+}
+
+static uint16_t prvShare(uint32_t run, uint32_t total)
+{
+    uint32_t share = total == 0 ? 0 : (uint32_t)(((uint64_t)run * 1000) / total);
+
+    return share > 1000 ? 1000 : (uint16_t)share;
+}
+
+/**
+ * @brief Walk the tasks and close the window. The first walk only sets the counters.
+ *
+ * @return true when a window was closed.
+ */
+static bool prvWalk(void)
+{
+    UBaseType_t uxCount, i;
+    uint32_t ulTotal = 0, ulElapsed;
+    int core;
+
+    uxCount = uxTaskGetSystemState(xTaskStatus, M5CONFIG_CPU_MAX_TASKS, &ulTotal);
+
+    if (uxCount == 0)
+    {
+        ESP_LOGW(TAG, "prvWalk: more than %u tasks, increase M5CONFIG_CPU_MAX_TASKS", M5CONFIG_CPU_MAX_TASKS);
+        return false;
+    }
+
+    ulElapsed = ulTotal - ulLastTotal;
+
+    for (i = 0; i < M5CONFIG_CPU_MAX_TASKS; i++)
+    {
+        xSlots[i].seen = false;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        const TaskStatus_t *pxStatus = &xTaskStatus[i];
+        cpu_slot_t *pxSlot = prvFindSlot(pxStatus->xHandle);
+        uint32_t delta;
+
+        if (pxSlot == NULL)
+        {
+            bTablesFull = true;
+            continue;
+        }
+
+        if (pxSlot->handle == NULL)
+        {
+            pxSlot->handle = pxStatus->xHandle;
+            pxSlot->record = prvFindRecord(pxStatus->pcTaskName);
+            /* Created since the previous walk, its counter started at zero */
+            pxSlot->counter = bStarted ? 0 : pxStatus->ulRunTimeCounter;
+        }
+
+        delta = pxStatus->ulRunTimeCounter - pxSlot->counter;
+
+        /* More than the window: the handle of a deleted task was reused by a new one */
+        if (delta > ulElapsed)
+        {
+            pxSlot->record = prvFindRecord(pxStatus->pcTaskName);
+            delta = pxStatus->ulRunTimeCounter;
+        }
+
+        pxSlot->counter = pxStatus->ulRunTimeCounter;
+        pxSlot->seen = true;
+
+        if (!bStarted)
+        {
+            continue;
+        }
+
+        if (pxSlot->record != NULL)
+        {
+            pxSlot->record->run += delta;
+        }
+
+        for (core = 0; core < portNUM_PROCESSORS; core++)
+        {
+            if (pxStatus->xHandle == xTaskGetIdleTaskHandleForCPU(core))
+            {
+                ulIdleRun[core] += delta;
+            }
+        }
+    }
+
+    /* Deleted tasks */
+    for (i = 0; i < M5CONFIG_CPU_MAX_TASKS; i++)
+    {
+        if (!xSlots[i].seen)
+        {
+            xSlots[i].handle = NULL;
+        }
+    }
+
+    ulLastTotal = ulTotal;
+
+    if (!bStarted)
+    {
+        bStarted = true;
+        return false;
+    }
+
+    /* Every core counts the elapsed time once */
+    for (i = 0; i < xRecordCount; i++)
+    {
+        xRecords[i].share[xWindowNext] = prvShare(xRecords[i].run, ulElapsed * portNUM_PROCESSORS);
+        xRecords[i].run = 0;
+    }
+
+    for (core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        usIdleShare[core][xWindowNext] = prvShare(ulIdleRun[core], ulElapsed);
+        ulIdleRun[core] = 0;
+    }
+
+    ulWindowTime = ulElapsed;
+    xWindowNext = (xWindowNext + 1) % M5CONFIG_CPU_WINDOWS;
+    if (xWindowCount < M5CONFIG_CPU_WINDOWS)
+    {
+        xWindowCount++;
+    }
+    ulWindows++;
+
+    return true;
+}
+
+#if M5CONFIG_CPU_PUBLISH
+static inline bool prvChanged(uint16_t average, uint16_t published)
+{
+    return (average > published ? average - published : published - average) >= M5CONFIG_CPU_PUBLISH_DELTA;
+}
+
+/**
+ * @brief Publish the averages that moved by M5CONFIG_CPU_PUBLISH_DELTA since
+ * the last publication. Must be called with the mutex held.
+ */
+static esp_err_t prvPublish(void)
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    size_t i, length = 0, changed = 0;
+    int core, status;
+
+    /* Nothing to publish on before a lab connects */
+    if (pCpuStrID == NULL || m5stickc_lab_connection_thing_name() == NULL || xWindowCount == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    status = snprintf(pCpuTopic, sizeof(pCpuTopic), CPU_TOPIC_FORMAT, pCpuStrID);
+    if (status < 0 || status >= (int)sizeof(pCpuTopic))
+    {
+        return ESP_FAIL;
+    }
+
+    /* The idle time is always sent, it is what the tasks are compared with */
+    length = snprintf(pCpuPayload, sizeof(pCpuPayload), "{\"w\":%u,\"idle\":[", ulWindowTime / 1000);
+
+    for (core = 0; core < portNUM_PROCESSORS && length < sizeof(pCpuPayload); core++)
+    {
+        usIdlePublished[core] = prvAverage(usIdleShare[core]);
+        length += snprintf(pCpuPayload + length, sizeof(pCpuPayload) - length, "%s%u", core == 0 ? "" : ",", usIdlePublished[core]);
+    }
+
+    if (length < sizeof(pCpuPayload))
+    {
+        length += snprintf(pCpuPayload + length, sizeof(pCpuPayload) - length, "],\"t\":{");
+    }
+
+    for (i = 0; i < xRecordCount && length < sizeof(pCpuPayload); i++)
+    {
+        uint16_t average = prvAverage(xRecords[i].share);
+
+        if (!prvChanged(average, xRecords[i].published))
+        {
+            continue;
+        }
+
+        length += snprintf(pCpuPayload + length, sizeof(pCpuPayload) - length, "%s\"%s\":%u",
+                           changed == 0 ? "" : ",", xRecords[i].name, average);
+        xRecords[i].published = average;
+        changed++;
+    }
+
+    if (length < sizeof(pCpuPayload))
+    {
+        length += snprintf(pCpuPayload + length, sizeof(pCpuPayload) - length, "}}");
+    }
+
+    if (length >= sizeof(pCpuPayload))
+    {
+        ESP_LOGE(TAG, "prvPublish: payload does not fit in %u bytes", sizeof(pCpuPayload));
+        return ESP_ERR_NO_MEM;
+    }
+
+    publishInfo.qos = IOT_MQTT_QOS_0;
+    publishInfo.pTopicName = pCpuTopic;
+    publishInfo.topicNameLength = (uint16_t)strlen(pCpuTopic);
+    publishInfo.pPayload = pCpuPayload;
+    publishInfo.payloadLength = length;
+
+    return m5stickc_lab_connection_publish(&publishInfo, NULL);
+}
+#endif
+
+static void prvCpuJobCallback(void *context)
+{
+    bool bReport;
+
+    xSemaphoreTake(xCpuMutex, portMAX_DELAY);
+    bReport = prvWalk() && M5CONFIG_CPU_REPORT_WINDOWS > 0 && ulWindows % M5CONFIG_CPU_REPORT_WINDOWS == 0;
+#if M5CONFIG_CPU_PUBLISH
+    if (bReport)
+    {
+        prvPublish();
+    }
+#endif
+    xSemaphoreGive(xCpuMutex);
+
+    if (bReport)
+    {
+        m5stickc_cpu_report();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_cpu_monitor_start(const char *strID)
+{
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    if (xCpuJob != NULL)
+    {
+        return ESP_OK;
+    }
+
+    xCpuMutex = xSemaphoreCreateMutex();
+    if (xCpuMutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pCpuStrID = strID;
+
+    /* The first window starts now */
+    prvWalk();
+
+    xCpuJob = m5stickc_scheduler_add("cpu", M5CONFIG_CPU_WINDOW_MS, M5CONFIG_CPU_WINDOW_SLACK_MS, true, prvCpuJobCallback, NULL);
+
+    return xCpuJob != NULL ? ESP_OK : ESP_FAIL;
+#else
+    ESP_LOGW(TAG, "m5stickc_cpu_monitor_start: needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void m5stickc_cpu_report(void)
+{
+    uint8_t pOrder[M5CONFIG_CPU_MAX_TASKS];
+    uint16_t pAverage[M5CONFIG_CPU_MAX_TASKS];
+    size_t i, j, last;
+    int core;
+
+    if (xCpuMutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xCpuMutex, portMAX_DELAY);
+
+    if (xWindowCount == 0)
+    {
+        xSemaphoreGive(xCpuMutex);
+        return;
+    }
+
+    last = (xWindowNext + M5CONFIG_CPU_WINDOWS - 1) % M5CONFIG_CPU_WINDOWS;
+
+    /* Busiest first, insertion sort of a few entries */
+    for (i = 0; i < xRecordCount; i++)
+    {
+        pAverage[i] = prvAverage(xRecords[i].share);
+
+        for (j = i; j > 0 && pAverage[pOrder[j - 1]] < pAverage[i]; j--)
+        {
+            pOrder[j] = pOrder[j - 1];
+        }
+        pOrder[j] = (uint8_t)i;
+    }
+
+    ESP_LOGI(TAG, "CPU over %u ms windows: last, and average of the last %u", ulWindowTime / 1000, xWindowCount);
+
+    for (core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        uint16_t average = prvAverage(usIdleShare[core]);
+
+        ESP_LOGI(TAG, "Idle core %d       %3u.%u%% %3u.%u%%", core, usIdleShare[core][last] / 10, usIdleShare[core][last] % 10,
+                 average / 10, average % 10);
+    }
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        const cpu_record_t *pxRecord = &xRecords[pOrder[i]];
+
+        /* The rest rounds to nothing */
+        if (pAverage[pOrder[i]] == 0 && pxRecord->share[last] == 0)
+        {
+            break;
+        }
+
+        ESP_LOGI(TAG, "%-16s %3u.%u%% %3u.%u%%", pxRecord->name, pxRecord->share[last] / 10, pxRecord->share[last] % 10,
+                 pAverage[pOrder[i]] / 10, pAverage[pOrder[i]] % 10);
+    }
+
+    if (bTablesFull)
+    {
+        ESP_LOGW(TAG, "Some tasks were not measured, increase M5CONFIG_CPU_MAX_TASKS");
+    }
+
+    xSemaphoreGive(xCpuMutex);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,26 @@
+/**
+ * @file m5stickc_cpu.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_CPU_H_
+#define _M5STICKC_CPU_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Measure the CPU share of each task and the idle time of each core
+ * over windows of M5CONFIG_CPU_WINDOW_MS, on the scheduler. The snapshots are
+ * printed on the serial console and published on m5stickc/<strID>/cpu.
+ */
+esp_err_t m5stickc_cpu_monitor_start(const char *strID);
+
+/**
+ * @brief Print the share of the last window and the average of the last
+ * M5CONFIG_CPU_WINDOWS windows, busiest task first.
+ */
+void m5stickc_cpu_report(void);
+
+#endif /* ifndef _M5STICKC_CPU_H_ */
@@ -9,6 +9,10 @@
 /* The config header is always included first. */
 #include "iot_config.h"
 
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_DEMO
+
 /* Standard includes. */
 #include <stdbool.h>
 #include <stdlib.h>
@@ -29,21 +33,18 @@
 
 #include "m5stickc.h"
 
-#include "m5stickc_lab_config.h"
 #include "m5stickc_demo.h"
 
-/* Declaration of demo functions. */
-#if defined(M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP) || defined(M5CONFIG_LAB1_AWS_IOT_BUTTON)
-#include "m5stickc_lab0_sleep.h"
-#endif // M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP || M5CONFIG_LAB1_AWS_IOT_BUTTON
-#if defined(M5CONFIG_LAB1_AWS_IOT_BUTTON) || defined(M5CONFIG_LAB2_SHADOW)
-#include "m5stickc_lab1_aws_iot_button.h"
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON || M5CONFIG_LAB2_SHADOW
-#ifdef M5CONFIG_LAB2_SHADOW
-#include "m5stickc_lab2_shadow.h"
-#endif // M5CONFIG_LAB2_SHADOW
-
-#include "m5stickc_lab_connection.h"
+#include "m5stickc_lab.h"
+#include "m5stickc_battery.h"
+#include "m5stickc_scheduler.h"
+#include "m5stickc_pm.h"
+#include "m5stickc_boot_trace.h"
+#include "m5stickc_mem.h"
+#include "m5stickc_stack.h"
+#include "m5stickc_cpu.h"
+#include "m5stickc_ringbuf.h"
+#include "m5stickc_rbbench.h"
 
 /*-----------------------------------------------------------*/
 
@@ -55,27 +56,27 @@ uint8_t uM5StickCID[6] = { 0 };
 #define M5STICKC_ID_STR_LENGTH ( sizeof(uM5StickCID) * 2 + 1 )
 char strM5StickCID[M5STICKC_ID_STR_LENGTH] = "";
 
-/*-----------------------------------------------------------*/
+#define SCREEN_OFFSET 2
+#define SCREEN_LINE_HEIGHT 14
+#define SCREEN_LINE_1  SCREEN_OFFSET + 0 * SCREEN_LINE_HEIGHT
+#define SCREEN_LINE_2  SCREEN_OFFSET + 1 * SCREEN_LINE_HEIGHT
+#define SCREEN_LINE_3  SCREEN_OFFSET + 2 * SCREEN_LINE_HEIGHT
+#define SCREEN_LINE_4  SCREEN_OFFSET + 3 * SCREEN_LINE_HEIGHT
 
-esp_err_t draw_battery_level(void);
-void battery_refresh_timer_init(void);
+/*-----------------------------------------------------------*/
 
 esp_err_t m5stickc_demo_init(void);
 
-static esp_err_t prvDeepSleep( gpio_num_t wakeup_pin );
-static void prvSleepTimerCallback( TimerHandle_t pxTimer );
-
-#if defined(M5CONFIG_LAB1_AWS_IOT_BUTTON) || defined(M5CONFIG_LAB2_SHADOW)
-
-IotSemaphore_t m5stickc_lab1_semaphore;
-
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON || M5CONFIG_LAB2_SHADOW
+static void prvBatteryCallback(const m5stickc_battery_state_t *state);
+static void prvLabChangedCallback(const m5stickc_lab_t *lab);
 
 
 /*-----------------------------------------------------------*/
 
 esp_err_t m5stickc_demo_run(void)
 {
+    m5stickc_boot_trace_mark("demo_run");
+
     esp_err_t res = esp_efuse_mac_get_default(uM5StickCID);
 
     if (res == ESP_OK)
@@ -114,21 +115,13 @@ void m5button_event_handler(void * handler_arg, esp_event_base_t base, int32_t i
         {
             ESP_LOGI(TAG, "Button A Held");            
         }
-        
-#ifdef M5CONFIG_LAB1_AWS_IOT_BUTTON
-        m5stickc_lab0_event();
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON
 
-#if defined(M5CONFIG_LAB1_AWS_IOT_BUTTON) || defined(M5CONFIG_LAB2_SHADOW)
-        IotSemaphore_Wait(&m5stickc_lab1_semaphore);
-        m5stickc_lab1_action(strM5StickCID, id);
-        IotSemaphore_Post(&m5stickc_lab1_semaphore);
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON || M5CONFIG_LAB2_SHADOW
-
-#if defined(M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP) || defined(M5CONFIG_LAB1_AWS_IOT_BUTTON)
-        m5stickc_lab0_event();
-#endif // M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP || M5CONFIG_LAB1_AWS_IOT_BUTTON
+        m5stickc_lab_button(id);
+    }
 
+    if (base == M5BUTTON_B_EVENT_BASE && id == M5BUTTON_BUTTON_CLICK_EVENT) {
+        ESP_LOGI(TAG, "Button B Pressed");
+        m5stickc_lab_select_next();
     }
 
     if (base == M5BUTTON_B_EVENT_BASE && id == M5BUTTON_BUTTON_HOLD_EVENT) {
@@ -138,20 +131,18 @@ void m5button_event_handler(void * handler_arg, esp_event_base_t base, int32_t i
     }
 }
 
-esp_err_t m5stickc_demo_init(void)
+esp_err_t m5stickc_demo_display_init(void)
 {
     esp_err_t res = ESP_FAIL;
 
-    ESP_LOGI(TAG, "======================================================");
-    ESP_LOGI(TAG, "m5stickc_demo_init: ...");
-
     m5stickc_config_t m5config;
     m5config.power.enable_lcd_backlight = false;
     m5config.power.lcd_backlight_level = 1;
 
     res = m5_init(&m5config);
-    ESP_LOGI(TAG, "m5stickc_demo_init: m5_init ...             %s", res == ESP_OK ? "OK" : "NOK");
+    ESP_LOGI(TAG, "m5stickc_demo_display_init: m5_init ...     %s", res == ESP_OK ? "OK" : "NOK");
     if (res != ESP_OK) return res;
+    m5stickc_boot_trace_mark("m5_init");
 
     TFT_FONT_ROTATE = 0;
     TFT_TEXT_WRAP = 0;
@@ -166,37 +157,42 @@ esp_err_t m5stickc_demo_init(void)
     TFT_FONT_BACKGROUND = TFT_BLACK;
     TFT_FONT_FOREGROUND = TFT_ORANGE;
     res = m5display_on();
-    ESP_LOGI(TAG, "                    LCD Backlight ON ...    %s", res == ESP_OK ? "OK" : "NOK");
+    ESP_LOGI(TAG, "                            LCD Backlight ON ... %s", res == ESP_OK ? "OK" : "NOK");
     if (res != ESP_OK) return res;
 
-    #define SCREEN_OFFSET 2
-    #define SCREEN_LINE_HEIGHT 14
-    #define SCREEN_LINE_1  SCREEN_OFFSET + 0 * SCREEN_LINE_HEIGHT
-    #define SCREEN_LINE_2  SCREEN_OFFSET + 1 * SCREEN_LINE_HEIGHT
-    #define SCREEN_LINE_3  SCREEN_OFFSET + 2 * SCREEN_LINE_HEIGHT
-    #define SCREEN_LINE_4  SCREEN_OFFSET + 3 * SCREEN_LINE_HEIGHT
-
     TFT_print((char *)"Amazon FreeRTOS", CENTER, SCREEN_LINE_1);
     TFT_print((char *)"workshop", CENTER, SCREEN_LINE_2);
 
-#ifdef M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP
-    TFT_print((char *)"LAB0 - SETUP & SLEEP", CENTER, SCREEN_LINE_4);
-    m5stickc_lab0_init( prvSleepTimerCallback );
-#endif // M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP
+    TFT_drawLine(0, M5DISPLAY_HEIGHT - 13 - 3, M5DISPLAY_WIDTH, M5DISPLAY_HEIGHT - 13 - 3, TFT_ORANGE);
+
+    return ESP_OK;
+}
 
-#ifdef M5CONFIG_LAB1_AWS_IOT_BUTTON
-    TFT_print((char *)"LAB1 - AWS IOT BUTTON", CENTER, SCREEN_LINE_4);
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON
+esp_err_t m5stickc_demo_power_init(void)
+{
+    esp_err_t res = ESP_FAIL;
 
-#ifdef M5CONFIG_LAB2_SHADOW
-    TFT_print((char *)"LAB2 - THING SHADOW", CENTER, SCREEN_LINE_4);
-    m5stickc_lab2_init(strM5StickCID);
-#endif // M5CONFIG_LAB2_SHADOW
+    res = m5stickc_scheduler_init();
+    ESP_LOGI(TAG, "m5stickc_demo_power_init: Scheduler init ... %s", res == ESP_OK ? "OK" : "NOK");
+    if (res != ESP_OK) return res;
 
-    TFT_drawLine(0, M5DISPLAY_HEIGHT - 13 - 3, M5DISPLAY_WIDTH, M5DISPLAY_HEIGHT - 13 - 3, TFT_ORANGE);
-    
-    res = draw_battery_level();
-    battery_refresh_timer_init();
+    /* Not fatal: the demo simply runs at full clock without it */
+    res = m5stickc_pm_init();
+    ESP_LOGI(TAG, "                          Power management ... %s", res == ESP_OK ? "OK" : "NOK");
+
+    return ESP_OK;
+}
+
+esp_err_t m5stickc_demo_init(void)
+{
+    esp_err_t res = ESP_FAIL;
+
+    ESP_LOGI(TAG, "======================================================");
+    ESP_LOGI(TAG, "m5stickc_demo_init: ...");
+
+    res = m5stickc_battery_init(prvBatteryCallback);
+    ESP_LOGI(TAG, "                    Battery monitor ...     %s", res == ESP_OK ? "OK" : "NOK");
+    m5stickc_boot_trace_mark("battery");
 
     res = esp_event_handler_register_with(m5_event_loop, M5BUTTON_A_EVENT_BASE, ESP_EVENT_ANY_ID, m5button_event_handler, NULL);
     ESP_LOGI(TAG, "                    Button A registered ... %s", res == ESP_OK ? "OK" : "NOK");
@@ -206,167 +202,72 @@ esp_err_t m5stickc_demo_init(void)
     ESP_LOGI(TAG, "                    Button B registered ... %s", res == ESP_OK ? "OK" : "NOK");
     if (res != ESP_OK) return res;
 
-    ESP_LOGI(TAG, "m5stickc_demo_init: ... done");
-    ESP_LOGI(TAG, "======================================================");
-
-#if defined(M5CONFIG_LAB1_AWS_IOT_BUTTON) || defined(M5CONFIG_LAB2_SHADOW)
+    /* Not fatal: only the heap snapshots are lost */
+    res = m5stickc_mem_monitor_start(strM5StickCID);
+    ESP_LOGI(TAG, "                    Heap monitor ...        %s", res == ESP_OK ? "OK" : "NOK");
 
-    if (!IotSemaphore_Create(&m5stickc_lab1_semaphore, 0, 1))
-    {
-        ESP_LOGE(TAG, "Failed to create Lab 1 semaphore!");
-        res = ESP_FAIL;
-    }
+    res = m5stickc_stack_monitor_start();
+    ESP_LOGI(TAG, "                    Stack monitor ...       %s", res == ESP_OK ? "OK" : "NOK");
 
-    if (res == ESP_OK)
-    {
-        /* Init the Semaphore to release it */
-        IotSemaphore_Post(&m5stickc_lab1_semaphore);
-    }
+    res = m5stickc_cpu_monitor_start(strM5StickCID);
+    ESP_LOGI(TAG, "                    CPU profiler ...        %s", res == ESP_OK ? "OK" : "NOK");
 
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON || M5CONFIG_LAB2_SHADOW
+    res = m5stickc_ringbuf_monitor_start();
+    ESP_LOGI(TAG, "                    Ring buffer monitor ... %s", res == ESP_OK ? "OK" : "NOK");
 
-#ifdef M5CONFIG_LAB1_AWS_IOT_BUTTON
+#if M5CONFIG_RBBENCH
+    res = m5stickc_rbbench_start();
+    ESP_LOGI(TAG, "                    Ring buffer bench ...   %s", res == ESP_OK ? "OK" : "NOK");
+#endif
 
-    m5stickc_lab1_init(strM5StickCID);
+    ESP_LOGI(TAG, "m5stickc_demo_init: ... done");
+    ESP_LOGI(TAG, "======================================================");
 
-    // Create semaphore for lab1
-    if ( res == ESP_OK )
+    res = m5stickc_lab_init(strM5StickCID, prvLabChangedCallback);
+    if (res == ESP_OK)
     {
-        /* Take the Semaphore */
-        IotSemaphore_Wait( &m5stickc_lab1_semaphore );
-        
-        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0)
-        {
-            // Woken up by our button
-            ESP_LOGI( TAG, "                    Woken up by the button" );
-            m5stickc_lab1_action(strM5StickCID, M5BUTTON_BUTTON_CLICK_EVENT);
-        }
-        else
-        {
-            // Woken up by other
-            ESP_LOGI( TAG, "                    Woken up by other!" );
-        }
-
-        IotSemaphore_Post( &m5stickc_lab1_semaphore );
+        res = m5stickc_lab_start();
     }
-
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON
-
-#if defined(M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP) || defined(M5CONFIG_LAB1_AWS_IOT_BUTTON)
-    m5stickc_lab0_init( prvSleepTimerCallback );
-#endif // M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP || M5CONFIG_LAB1_AWS_IOT_BUTTON
+    m5stickc_boot_trace_mark("lab_start");
+    m5stickc_boot_trace_dump();
 
     return res;
 }
 
 /*-----------------------------------------------------------*/
 
-static const TickType_t xBatteryRefreshTimerFrequency_ms = 10000UL;
-static TimerHandle_t xBatteryRefresh;
-
-esp_err_t draw_battery_level(void)
+static void prvBatteryCallback(const m5stickc_battery_state_t *state)
 {
-    esp_err_t res = ESP_FAIL;
     int status = EXIT_SUCCESS;
-    uint16_t vbat = 0, vaps = 0, b, c, battery;
     char pVbatStr[11] = {0};
+    uint8_t level = state->level;
 
-    res = m5power_get_vbat(&vbat);
-    res |= m5power_get_vaps(&vaps);
-
-    if (res == ESP_OK)
+    if (level >= 100)
     {
-        ESP_LOGD(TAG, "draw_battery_level: VBat:         %u", vbat);
-        ESP_LOGD(TAG, "draw_battery_level: VAps:         %u", vaps);
-        b = (vbat * 1.1);
-        ESP_LOGD(TAG, "draw_battery_level: b:            %u", b);
-        c = (vaps * 1.4);
-        ESP_LOGD(TAG, "draw_battery_level: c:            %u", c);
-        battery = ((b - 3000)) / 12;
-        ESP_LOGD(TAG, "draw_battery_level: battery:      %u", battery);
-
-        if (battery >= 100)
-        {
-            battery = 99; // No need to support 100% :)
-        }
-
-        if (c >= 4500) //4.5)
-        {
-            status = snprintf(pVbatStr, 11, "CHG: %02u%%", battery);
-        }
-        else
-        {
-            status = snprintf(pVbatStr, 11, "BAT: %02u%%", battery);
-        }
-
-        if (status < 0) {
-            ESP_LOGE(TAG, "draw_battery_level: error with creating battery string");
-        }
-        else
-        {
-            ESP_LOGD(TAG, "draw_battery_level: Charging str(%i): %s", status, pVbatStr);
-            TFT_print(pVbatStr, 1, M5DISPLAY_HEIGHT - 13);
-        }
+        level = 99; // No need to support 100% :)
     }
 
-    return res;
-}
-
-static void prvBatteryRefreshTimerCallback(TimerHandle_t pxTimer)
-{
-    draw_battery_level();    
-}
-
-void battery_refresh_timer_init(void)
-{
-    xBatteryRefresh = xTimerCreate("BatteryRefresh", pdMS_TO_TICKS(xBatteryRefreshTimerFrequency_ms), pdTRUE, NULL, prvBatteryRefreshTimerCallback);
-    xTimerStart(xBatteryRefresh, 0);
-}
-
-/*-----------------------------------------------------------*/
-
-static esp_err_t prvDeepSleep( gpio_num_t wakeup_pin )
-{
-    esp_err_t res = ESP_FAIL;
-
-#ifdef M5CONFIG_LAB1_AWS_IOT_BUTTON
-    m5stickc_lab_connection_cleanup();
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON
-
-    ESP_LOGI(TAG, "Going to DEEP SLEEP!");
+    status = snprintf(pVbatStr, 11, "%s: %02u%%", state->charging ? "CHG" : "BAT", level);
 
-    res = esp_sleep_enable_ext0_wakeup( wakeup_pin, 0 );
-
-    if (res != ESP_OK)
-    {
-        return res;
+    if (status < 0) {
+        ESP_LOGE(TAG, "prvBatteryCallback: error with creating battery string");
     }
-
-    res = m5power_set_sleep();
-    if (res == ESP_OK)
+    else
     {
-        esp_deep_sleep_start();
+        ESP_LOGD(TAG, "prvBatteryCallback: %u mV, runtime %u min, str(%i): %s", state->voltage_mv, state->runtime_min, status, pVbatStr);
+        TFT_print(pVbatStr, 1, M5DISPLAY_HEIGHT - 13);
     }
-
-    return res;
 }
 
-static void prvSleepTimerCallback(TimerHandle_t pxTimer)
-{
-    esp_err_t res = ESP_FAIL;
-
-    ESP_LOGI(TAG, "Sleep timer callback!");
+/*-----------------------------------------------------------*/
 
-#ifdef M5CONFIG_LAB1_AWS_IOT_BUTTON
-    
-    IotSemaphore_Wait( &m5stickc_lab1_semaphore );
-    
-#endif // M5CONFIG_LAB1_AWS_IOT_BUTTON
+static void prvLabChangedCallback(const m5stickc_lab_t *lab)
+{
+    char pTitle[22] = {0};
 
-    res = prvDeepSleep( M5BUTTON_BUTTON_A_GPIO );
+    /* Pad with spaces so that a shorter title clears the previous one */
+    snprintf(pTitle, sizeof(pTitle), "%-21s", lab->title);
+    TFT_print(pTitle, CENTER, SCREEN_LINE_4);
+}
 
-    if (res != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error setting deep sleep!");
-    }
-}
\ No newline at end of file
+/*-----------------------------------------------------------*/
@@ -15,4 +15,13 @@
 
 esp_err_t m5stickc_demo_run(void);
 
+/**
+ * @brief Boot steps, run by app_main before m5stickc_demo_run.
+ *
+ * The display step powers the AXP192 and draws the static part of the screen,
+ * the power step starts the scheduler and the power manager.
+ */
+esp_err_t m5stickc_demo_display_init(void);
+esp_err_t m5stickc_demo_power_init(void);
+
 #endif /* ifndef _M5STICKC_DEMO__H_ */
@@ -0,0 +1,457 @@
+/**
+ * @file m5stickc_lab.c
+ * @brief Lab registry: all the labs are linked in, the active one is selected at runtime.
+ *
+ * The selection comes from NVS, button B or the "lab" field of the shadow, and
+ * is applied without rebooting: the active lab is suspended, the new one is run.
+ * The switches run in the lab task, as they connect to MQTT and update the
+ * shadow. The MQTT connection and the display are shared by all the labs.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_LAB
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+/* Shadow include. */
+#include "aws_iot_shadow.h"
+
+/* JSON utilities include. */
+#include "iot_json_utils.h"
+
+#include "aws_demo.h"
+#include "types/iot_network_types.h"
+#include "nvs.h"
+#include "esp_log.h"
+
+#include "m5stickc_lab_connection.h"
+#include "m5stickc_lab.h"
+#include "m5stickc_stack.h"
+
+static const char *TAG = "m5stickc_lab";
+
+/*-----------------------------------------------------------*/
+
+#define LAB_NVS_NAMESPACE       "m5stickc"
+#define LAB_NVS_KEY             "lab"
+#define LAB_NAME_MAX_LENGTH     ( 16 )
+
+/* Set in a switch request when it came from the shadow */
+#define LAB_SELECT_FROM_SHADOW  ( 0x80000000UL )
+
+/* Switch request for the lab after the active one, resolved by the lab task */
+#define LAB_SELECT_NEXT         ( 0x7FFFFFFFUL )
+
+#define LAB_NONE                ( -1 )
+
+#define LAB_TASK_NAME           "m5lab"
+#define LAB_TASK_STACK_SIZE     ( 4096 )
+#define LAB_TASK_PRIORITY       ( tskIDLE_PRIORITY + 2 )
+#define LAB_QUEUE_LENGTH        ( 4 )
+
+/**
+ * @brief Shadow document acknowledging the lab selection, so that the delta is cleared.
+ */
+#define SHADOW_REPORTED_LAB_JSON    \
+    "{"                             \
+    "\"state\":{"                   \
+    "\"reported\":{"                \
+    "\"lab\":\"%s\""                \
+    "}"                             \
+    "},"                            \
+    "\"clientToken\":\"%06lu\""     \
+    "}"
+
+static const m5stickc_lab_t *const xLabs[] = {
+    &m5stickc_lab0,
+    &m5stickc_lab1,
+    &m5stickc_lab2,
+};
+
+#define LAB_COUNT ( sizeof( xLabs ) / sizeof( xLabs[ 0 ] ) )
+
+static const char *pLabStrID = NULL;
+static m5stickc_lab_changed_callback_t xLabChangedCallback = NULL;
+static SemaphoreHandle_t xLabMutex = NULL;
+static QueueHandle_t xLabQueue = NULL;
+static int lCurrentLab = LAB_NONE;
+static bool bLabInitialized[LAB_COUNT] = { false };
+
+/*-----------------------------------------------------------*/
+
+static int prvFindLab(const char *pName, size_t nameLength)
+{
+    size_t i;
+
+    for (i = 0; i < LAB_COUNT; i++)
+    {
+        if (strlen(xLabs[i]->name) == nameLength && strncmp(xLabs[i]->name, pName, nameLength) == 0)
+        {
+            return (int)i;
+        }
+    }
+
+    return LAB_NONE;
+}
+
+static int prvLoadSelection(void)
+{
+    nvs_handle handle;
+    char pName[LAB_NAME_MAX_LENGTH] = { 0 };
+    size_t length = sizeof(pName);
+    int lab = LAB_NONE;
+
+    if (nvs_open(LAB_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        if (nvs_get_str(handle, LAB_NVS_KEY, pName, &length) == ESP_OK)
+        {
+            lab = prvFindLab(pName, strlen(pName));
+        }
+        nvs_close(handle);
+    }
+
+    if (lab == LAB_NONE)
+    {
+        lab = prvFindLab(M5CONFIG_LAB_DEFAULT, strlen(M5CONFIG_LAB_DEFAULT));
+    }
+
+    return lab == LAB_NONE ? 0 : lab;
+}
+
+static void prvSaveSelection(const char *pName)
+{
+    nvs_handle handle;
+    esp_err_t res = nvs_open(LAB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+
+    if (res == ESP_OK)
+    {
+        res = nvs_set_str(handle, LAB_NVS_KEY, pName);
+        if (res == ESP_OK)
+        {
+            res = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGW(TAG, "prvSaveSelection: failed to save %s: %d", pName, res);
+    }
+}
+
+static void prvReportSelection(const char *pName)
+{
+    AwsIotShadowDocumentInfo_t updateDocument = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+    char pUpdateDocument[sizeof(SHADOW_REPORTED_LAB_JSON) + LAB_NAME_MAX_LENGTH + 6] = { 0 };
+    const char *pThingName = m5stickc_lab_connection_thing_name();
+    int status;
+
+    if (pThingName == NULL)
+    {
+        return;
+    }
+
+    status = snprintf(pUpdateDocument, sizeof(pUpdateDocument), SHADOW_REPORTED_LAB_JSON,
+                      pName, (long unsigned)(IotClock_GetTimeMs() % 1000000));
+
+    if (status <= 0 || status >= (int)sizeof(pUpdateDocument))
+    {
+        ESP_LOGE(TAG, "prvReportSelection: failed to generate the shadow document");
+        return;
+    }
+
+    updateDocument.pThingName = pThingName;
+    updateDocument.thingNameLength = strlen(pThingName);
+    updateDocument.u.update.pUpdateDocument = pUpdateDocument;
+    updateDocument.u.update.updateDocumentLength = (size_t)status;
+
+    m5stickc_lab_connection_update_shadow(&updateDocument);
+}
+
+static esp_err_t prvActivate(int lab)
+{
+    esp_err_t res = ESP_OK;
+    const m5stickc_lab_t *pxLab = xLabs[lab];
+
+    xSemaphoreTake(xLabMutex, portMAX_DELAY);
+
+    if (lab == lCurrentLab)
+    {
+        xSemaphoreGive(xLabMutex);
+        return ESP_OK;
+    }
+
+    if (lCurrentLab != LAB_NONE)
+    {
+        ESP_LOGI(TAG, "Suspending %s", xLabs[lCurrentLab]->name);
+
+        if (xLabs[lCurrentLab]->suspend != NULL)
+        {
+            xLabs[lCurrentLab]->suspend();
+        }
+
+        /* Its callbacks must not run under the next lab, which may not use the connection */
+        m5stickc_lab_connection_detach();
+    }
+
+    /* Active only once started, so that selecting a lab that failed tries it again */
+    lCurrentLab = LAB_NONE;
+
+    ESP_LOGI(TAG, "Running %s", pxLab->name);
+
+    if (!bLabInitialized[lab] && pxLab->init != NULL)
+    {
+        res = pxLab->init(pLabStrID);
+    }
+
+    if (res == ESP_OK)
+    {
+        bLabInitialized[lab] = true;
+
+        if (pxLab->run != NULL)
+        {
+            res = pxLab->run(pLabStrID);
+        }
+    }
+
+    if (res == ESP_OK)
+    {
+        lCurrentLab = lab;
+    }
+
+    xSemaphoreGive(xLabMutex);
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "prvActivate: %s failed to start: %d", pxLab->name, res);
+        return res;
+    }
+
+    if (xLabChangedCallback != NULL)
+    {
+        xLabChangedCallback(pxLab);
+    }
+
+    return res;
+}
+
+/**
+ * @brief Apply the switch requests. The labs block on MQTT while they start,
+ * so this is the only task that runs them after boot.
+ */
+static void prvLabTask(void *pvParameters)
+{
+    uint32_t ulRequest;
+    int lab, previous;
+
+    for (;;)
+    {
+        xQueueReceive(xLabQueue, &ulRequest, portMAX_DELAY);
+
+        if ((ulRequest & ~LAB_SELECT_FROM_SHADOW) == LAB_SELECT_NEXT)
+        {
+            lab = lCurrentLab == LAB_NONE ? 0 : (lCurrentLab + 1) % (int)LAB_COUNT;
+        }
+        else
+        {
+            lab = (int)(ulRequest & ~LAB_SELECT_FROM_SHADOW);
+        }
+
+        /* Only this task changes the active lab after boot */
+        previous = lCurrentLab;
+
+        if (prvActivate(lab) != ESP_OK)
+        {
+            continue;
+        }
+
+        /* Spares the flash a write when the lab was already the active one */
+        if (lab != previous)
+        {
+            prvSaveSelection(xLabs[lab]->name);
+        }
+
+        if (ulRequest & LAB_SELECT_FROM_SHADOW)
+        {
+            prvReportSelection(xLabs[lab]->name);
+        }
+    }
+}
+
+static esp_err_t prvSelect(uint32_t ulRequest)
+{
+    if (xLabQueue == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xQueueSend(xLabQueue, &ulRequest, 0) != pdPASS)
+    {
+        ESP_LOGE(TAG, "prvSelect: lab queue full, switch dropped");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_lab_init(const char *strID, m5stickc_lab_changed_callback_t callback)
+{
+    if (xLabMutex == NULL)
+    {
+        xLabMutex = xSemaphoreCreateMutex();
+    }
+
+    if (xLabMutex == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_lab_init: failed to create the mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xLabQueue == NULL)
+    {
+        xLabQueue = xQueueCreate(LAB_QUEUE_LENGTH, sizeof(uint32_t));
+    }
+
+    if (xLabQueue == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_lab_init: failed to create the queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    pLabStrID = strID;
+    xLabChangedCallback = callback;
+
+    return ESP_OK;
+}
+
+esp_err_t m5stickc_lab_start(void)
+{
+    esp_err_t res;
+
+    if (xLabMutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    res = prvActivate(prvLoadSelection());
+
+    /* Started even if the lab failed, another one can still be selected */
+    if (xTaskCreate(prvLabTask, LAB_TASK_NAME, LAB_TASK_STACK_SIZE, NULL, LAB_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "m5stickc_lab_start: failed to create the lab task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    m5stickc_stack_expect(LAB_TASK_NAME, LAB_TASK_STACK_SIZE, "LAB_TASK_STACK_SIZE");
+
+    return res;
+}
+
+esp_err_t m5stickc_lab_select(const char *name)
+{
+    int lab = name ? prvFindLab(name, strlen(name)) : LAB_NONE;
+
+    if (lab == LAB_NONE)
+    {
+        ESP_LOGE(TAG, "m5stickc_lab_select: unknown lab %s", name ? name : "(NULL)");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return prvSelect((uint32_t)lab);
+}
+
+esp_err_t m5stickc_lab_select_next(void)
+{
+    return prvSelect(LAB_SELECT_NEXT);
+}
+
+void m5stickc_lab_button(int32_t buttonID)
+{
+    if (xLabMutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xLabMutex, portMAX_DELAY);
+
+    if (lCurrentLab != LAB_NONE && xLabs[lCurrentLab]->button != NULL)
+    {
+        xLabs[lCurrentLab]->button(pLabStrID, buttonID);
+    }
+
+    xSemaphoreGive(xLabMutex);
+}
+
+void m5stickc_lab_teardown(void)
+{
+    if (xLabMutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xLabMutex, portMAX_DELAY);
+
+    if (lCurrentLab != LAB_NONE && xLabs[lCurrentLab]->teardown != NULL)
+    {
+        xLabs[lCurrentLab]->teardown();
+    }
+
+    /* Whichever lab opened it, the active one may not use it */
+    m5stickc_lab_connection_cleanup();
+
+    xSemaphoreGive(xLabMutex);
+}
+
+void m5stickc_lab_shadow_delta(const char *pDocument, size_t documentLength)
+{
+    const char *pState = NULL, *pLab = NULL;
+    size_t stateLength = 0, labLength = 0;
+    int lab;
+
+    if (!IotJsonUtils_FindJsonValue(pDocument, documentLength, "state", 5, &pState, &stateLength) ||
+        !IotJsonUtils_FindJsonValue(pState, stateLength, "lab", 3, &pLab, &labLength))
+    {
+        return;
+    }
+
+    /* The value is a JSON string, drop the quotes */
+    if (labLength >= 2 && pLab[0] == '"')
+    {
+        pLab++;
+        labLength -= 2;
+    }
+
+    lab = prvFindLab(pLab, labLength);
+
+    if (lab == LAB_NONE)
+    {
+        ESP_LOGW(TAG, "Shadow delta: unknown lab %.*s", (int)labLength, pLab);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Shadow delta: lab %s", xLabs[lab]->name);
+    prvSelect((uint32_t)lab | LAB_SELECT_FROM_SHADOW);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,64 @@
+/**
+ * @file m5stickc_lab.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_LAB_H_
+#define _M5STICKC_LAB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief A lab linked into the image. Every callback is optional.
+ */
+typedef struct {
+    const char *name;                                       /* Key used in NVS and in the shadow "lab" field */
+    const char *title;                                      /* Shown on the screen */
+    esp_err_t (*init)(const char *strID);                   /* Once, the first time the lab is selected */
+    esp_err_t (*run)(const char *strID);                    /* Every time the lab becomes the active one */
+    void (*button)(const char *strID, int32_t buttonID);    /* Button A events */
+    void (*suspend)(void);                                  /* Another lab becomes the active one */
+    void (*teardown)(void);                                 /* The device is about to go to deep sleep, the connection is closed after it */
+} m5stickc_lab_t;
+
+extern const m5stickc_lab_t m5stickc_lab0;
+extern const m5stickc_lab_t m5stickc_lab1;
+extern const m5stickc_lab_t m5stickc_lab2;
+
+typedef void (*m5stickc_lab_changed_callback_t)(const m5stickc_lab_t *lab);
+
+esp_err_t m5stickc_lab_init(const char *strID, m5stickc_lab_changed_callback_t callback);
+
+/**
+ * @brief Activate the lab saved in NVS, or M5CONFIG_LAB_DEFAULT.
+ */
+esp_err_t m5stickc_lab_start(void);
+
+/**
+ * @brief Switch to another lab without rebooting, and save the selection in NVS.
+ *
+ * The switch is queued to the lab task, so this can be called from event
+ * handlers and MQTT callbacks without blocking them.
+ */
+esp_err_t m5stickc_lab_select(const char *name);
+esp_err_t m5stickc_lab_select_next(void);
+
+void m5stickc_lab_button(int32_t buttonID);
+
+/**
+ * @brief Tear the active lab down before deep sleep, and close the MQTT
+ * connection if one was started. Waits for any button action in progress.
+ */
+void m5stickc_lab_teardown(void);
+
+/**
+ * @brief Look for a "lab" field in a shadow delta document and switch to it.
+ */
+void m5stickc_lab_shadow_delta(const char *pDocument, size_t documentLength);
+
+#endif /* ifndef _M5STICKC_LAB_H_ */
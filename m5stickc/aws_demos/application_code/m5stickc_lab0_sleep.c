@@ -6,12 +6,18 @@
  * This code is licensed under the MIT License.
  */
 
+/* Compile-time log level of this module, defined before esp_log.h is included. */
 #include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_LAB0
+
 #include "m5stickc_lab0_sleep.h"
+#include "m5stickc_lab.h"
+#include "m5stickc_scheduler.h"
 
 /* Platform layer includes. */
 #include "platform/iot_clock.h"
 
+#include "esp_sleep.h"
 #include "esp_log.h"
 
 #include "m5stickc.h"
@@ -20,21 +26,101 @@ static const char *TAG = "m5stickc_lab0_sleep";
 
 /*-----------------------------------------------------------*/
 
-static const TickType_t xSleepTimerFrequency_ms = 15000UL;
-static TimerHandle_t xSleepTimer;
+static const uint32_t xSleepTimerFrequency_ms = 15000UL;
+static const uint32_t xSleepTimerSlack_ms = 1000UL;
+static m5stickc_scheduler_job_t xSleepJob = NULL;
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvDeepSleep( gpio_num_t wakeup_pin )
+{
+    esp_err_t res = ESP_FAIL;
+
+    ESP_LOGI(TAG, "Going to DEEP SLEEP!");
+
+    res = esp_sleep_enable_ext0_wakeup( wakeup_pin, 0 );
+
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    res = m5power_set_sleep();
+    if (res == ESP_OK)
+    {
+        esp_deep_sleep_start();
+    }
+
+    return res;
+}
+
+static void prvSleepTimerCallback( void *context )
+{
+    esp_err_t res = ESP_FAIL;
+
+    ESP_LOGI(TAG, "Sleep timer callback!");
+
+    /* Waits for a button action in progress, and closes the connection if any */
+    m5stickc_lab_teardown();
+
+    res = prvDeepSleep( M5BUTTON_BUTTON_A_GPIO );
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error setting deep sleep!");
+    }
+}
 
 /*-----------------------------------------------------------*/
 
-void m5stickc_lab0_init( TimerCallbackFunction_t callback )
+void m5stickc_lab0_start( void )
+{
+    if ( xSleepJob != NULL )
+    {
+        /* Already scheduled, just restart the countdown */
+        m5stickc_scheduler_reset( xSleepJob );
+        return;
+    }
+
+    xSleepJob = m5stickc_scheduler_add("sleep", xSleepTimerFrequency_ms, xSleepTimerSlack_ms, false, prvSleepTimerCallback, NULL);
+}
+
+void m5stickc_lab0_stop( void )
 {
-    xSleepTimer = xTimerCreate("SleepTimer", pdMS_TO_TICKS(xSleepTimerFrequency_ms), pdFALSE, NULL, callback);
-    xTimerStart( xSleepTimer, 0 );
+    if ( xSleepJob != NULL )
+    {
+        m5stickc_scheduler_remove( xSleepJob );
+        xSleepJob = NULL;
+    }
 }
 
 void m5stickc_lab0_event( void )
 {
     ESP_LOGI(TAG, "Reseting sleep timer");
-    xTimerReset(xSleepTimer, pdMS_TO_TICKS(xSleepTimerFrequency_ms));
+    m5stickc_scheduler_reset( xSleepJob );
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvLab0Run( const char *strID )
+{
+    m5stickc_lab0_start();
+    return xSleepJob != NULL ? ESP_OK : ESP_FAIL;
+}
+
+static void prvLab0Button( const char *strID, int32_t buttonID )
+{
+    m5stickc_lab0_event();
 }
 
-/*-----------------------------------------------------------*/
\ No newline at end of file
+const m5stickc_lab_t m5stickc_lab0 = {
+    .name = "lab0",
+    .title = "LAB0 - SETUP & SLEEP",
+    .init = NULL,
+    .run = prvLab0Run,
+    .button = prvLab0Button,
+    .suspend = m5stickc_lab0_stop,
+    .teardown = NULL
+};
+
+/*-----------------------------------------------------------*/
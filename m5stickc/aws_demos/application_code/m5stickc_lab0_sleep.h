@@ -8,10 +8,9 @@
 #ifndef _M5STICKC_LAB0_SLEEP_H_
 #define _M5STICKC_LAB0_SLEEP_H_
 
-/* Platform layer includes. */
-#include "platform/iot_clock.h"
-
-void m5stickc_lab0_init( TimerCallbackFunction_t callback );
+/* Start, or restart, the countdown to deep sleep. */
+void m5stickc_lab0_start( void );
+void m5stickc_lab0_stop( void );
 void m5stickc_lab0_event( void );
 
 #endif /* ifndef _M5STICKC_LAB0_SLEEP_H_ */
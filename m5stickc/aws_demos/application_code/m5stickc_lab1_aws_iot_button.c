@@ -9,7 +9,12 @@
 /* The config header is always included first. */
 #include "iot_config.h"
 
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_LAB1
+
 /* Standard includes. */
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -27,11 +32,13 @@
 
 #include "aws_demo.h"
 #include "types/iot_network_types.h"
+#include "esp_sleep.h"
 #include "esp_log.h"
 
-#include "m5stickc_lab_config.h"
 #include "m5stickc_lab_connection.h"
+#include "m5stickc_lab.h"
 #include "m5stickc_lab1_aws_iot_button.h"
+#include "m5stickc_lab0_sleep.h"
 
 #include "m5stickc.h"
 
@@ -189,10 +196,10 @@ static void _operationCompleteCallback( void * param1,
     }
     else
     {
-        IotLogError( "MQTT %s %d could not be sent. Error %s.",
-                     IotMqtt_OperationType( pOperation->u.operation.type ),
-                     ( int ) publishCount,
-                     IotMqtt_strerror( pOperation->u.operation.result ) );
+        ESP_LOGE(TAG, "MQTT %s %d could not be sent. Error %s.",
+                 IotMqtt_OperationType( pOperation->u.operation.type ),
+                 ( int ) publishCount,
+                 IotMqtt_strerror( pOperation->u.operation.result ) );
     }
 }
 
@@ -318,3 +325,40 @@ void m5stickc_lab1_action( const char * strID, int32_t buttonID )
 }
 
 /*-----------------------------------------------------------*/
+
+static esp_err_t prvLab1Run( const char * strID )
+{
+    static bool firstRun = true;
+
+    m5stickc_lab1_init( strID );
+    m5stickc_lab0_start();
+
+    if ( firstRun && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0 )
+    {
+        // Woken up by our button
+        ESP_LOGI( TAG, "Woken up by the button" );
+        m5stickc_lab1_action( strID, M5BUTTON_BUTTON_CLICK_EVENT );
+    }
+    firstRun = false;
+
+    return ESP_OK;
+}
+
+static void prvLab1Button( const char * strID, int32_t buttonID )
+{
+    m5stickc_lab0_event();
+    m5stickc_lab1_action( strID, buttonID );
+    m5stickc_lab0_event();
+}
+
+const m5stickc_lab_t m5stickc_lab1 = {
+    .name = "lab1",
+    .title = "LAB1 - AWS IOT BUTTON",
+    .init = NULL,
+    .run = prvLab1Run,
+    .button = prvLab1Button,
+    .suspend = m5stickc_lab0_stop,
+    .teardown = NULL
+};
+
+/*-----------------------------------------------------------*/
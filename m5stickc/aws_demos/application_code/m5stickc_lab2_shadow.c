@@ -9,6 +9,10 @@
 /* The config header is always included first. */
 #include "iot_config.h"
 
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_LAB2
+
 /* Standard includes. */
 #include <stdbool.h>
 #include <stdio.h>
@@ -35,9 +39,12 @@
 #include "types/iot_network_types.h"
 #include "esp_log.h"
 
-#include "m5stickc_lab_config.h"
 #include "m5stickc_lab_connection.h"
 #include "m5stickc_lab2_shadow.h"
+#include "m5stickc_lab1_aws_iot_button.h"
+#include "m5stickc_lab.h"
+#include "m5stickc_scheduler.h"
+#include "m5stickc_log.h"
 
 #include "m5stickc.h"
 
@@ -122,10 +129,30 @@ shadowState_t shadowStateDesired = {
 
 /*-----------------------------------------------------------*/
 
-static const TickType_t xAirConRefreshTimerFrequency_ms = 10000UL;
-static TimerHandle_t xAirCon;
+static const uint32_t xAirConRefreshTimerFrequency_ms = 10000UL;
+static const uint32_t xAirConRefreshTimerSlack_ms = 2000UL;
+static m5stickc_scheduler_job_t xAirCon = NULL;
+
+static void prvAirConTimerCallback(void *context);
 
-static void prvAirConTimerCallback(TimerHandle_t pxTimer);
+/*-----------------------------------------------------------*/
+
+static void prvAirConStart(const char *pThingName)
+{
+    if (xAirCon == NULL && pThingName != NULL)
+    {
+        xAirCon = m5stickc_scheduler_add("aircon", xAirConRefreshTimerFrequency_ms, xAirConRefreshTimerSlack_ms, true, prvAirConTimerCallback, (void *)pThingName);
+    }
+}
+
+static void prvAirConStop(void)
+{
+    if (xAirCon != NULL)
+    {
+        m5stickc_scheduler_remove(xAirCon);
+        xAirCon = NULL;
+    }
+}
 
 /*-----------------------------------------------------------*/
 
@@ -137,9 +164,7 @@ void vLab2NetworkConnectedCallback(bool awsIotMqttMode,
 {
     ESP_LOGD(TAG, "vNetworkConnectedCallback for %s", pIdentifier);
 
-    /* Start the AirCon */
-    xAirCon = xTimerCreate("AirConRefresh", pdMS_TO_TICKS(xAirConRefreshTimerFrequency_ms), pdTRUE, (void *)pIdentifier, prvAirConTimerCallback);
-    xTimerStart(xAirCon, 0);
+    prvAirConStart(pIdentifier);
 }
 
 void vLab2NetworkDisconnectedCallback(const IotNetworkInterface_t *pNetworkInterface)
@@ -448,12 +473,12 @@ static void _shadowUpdatedCallback(void *pCallbackContext,
 
 /*-----------------------------------------------------------*/
 
-static void prvAirConTimerCallback(TimerHandle_t pxTimer)
+static void prvAirConTimerCallback(void *context)
 {
     int status = EXIT_SUCCESS;
-    configASSERT(pxTimer);
+    configASSERT(context);
 
-    char *pThingName = (char *)pvTimerGetTimerID(pxTimer);
+    char *pThingName = (char *)context;
 
     // Used for the screen.
     char pAirConStr[11] = {0};
@@ -466,7 +491,7 @@ static void prvAirConTimerCallback(TimerHandle_t pxTimer)
             shadowStateReported.temperature = shadowStateDesired.temperature;
         }
 
-        ESP_LOGI(TAG, "Timer: AirCon is ON => Temp (%u) needs to decrease to target (%u)",
+        M5_LOGI(TAG, "Timer: AirCon is ON => Temp (%u) needs to decrease to target (%u)",
                 shadowStateReported.temperature,
                 shadowStateDesired.temperature);
 
@@ -480,7 +505,7 @@ static void prvAirConTimerCallback(TimerHandle_t pxTimer)
             shadowStateReported.temperature = 40;
         }
 
-        ESP_LOGI(TAG, "Timer: AirCon is OFF => Temp (%u) increases", shadowStateReported.temperature);
+        M5_LOGI(TAG, "Timer: AirCon is OFF => Temp (%u) increases", shadowStateReported.temperature);
 
         status = snprintf(pAirConStr, 11, "OFF %02u", shadowStateReported.temperature);
     }
@@ -495,7 +520,7 @@ static void prvAirConTimerCallback(TimerHandle_t pxTimer)
 
     if (status != EXIT_SUCCESS)
     {
-        IotLogError("Timer: Failed to report shadow.");
+        ESP_LOGE(TAG, "Timer: Failed to report shadow.");
     }
 
 }
@@ -518,3 +543,30 @@ void m5stickc_lab2_init(const char *const strID)
 }
 
 /*-----------------------------------------------------------*/
+
+static esp_err_t prvLab2Run(const char *strID)
+{
+    m5stickc_lab2_init(strID);
+
+    /* When switching from another lab the network is already up */
+    prvAirConStart(m5stickc_lab_connection_thing_name());
+
+    return ESP_OK;
+}
+
+static void prvLab2Button(const char *strID, int32_t buttonID)
+{
+    m5stickc_lab1_action(strID, buttonID);
+}
+
+const m5stickc_lab_t m5stickc_lab2 = {
+    .name = "lab2",
+    .title = "LAB2 - THING SHADOW",
+    .init = NULL,
+    .run = prvLab2Run,
+    .button = prvLab2Button,
+    .suspend = prvAirConStop,
+    .teardown = NULL
+};
+
+/*-----------------------------------------------------------*/
@@ -10,16 +10,227 @@
 
 #include "stdint.h"
 
-/* To run a particular lab you need to define one of these.
- * Only one lab can be configured at a time
+/* All the labs are linked into the image, the one to run is selected at runtime.
+ * The selection is saved in NVS, and can be changed with button B or with the
+ * "lab" field of the desired shadow state. This is the lab used until then:
  *
- *          M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP
- *          M5CONFIG_LAB1_AWS_IOT_BUTTON
- *          M5CONFIG_LAB2_SHADOW
+ *          "lab0"  Deep sleep and button wakeup
+ *          "lab1"  AWS IoT button
+ *          "lab2"  Thing shadow */
+
+#define M5CONFIG_LAB_DEFAULT                    "lab0"
+
+/* Battery monitor configuration.
+ *
+ *          M5CONFIG_BATTERY_SAMPLE_PERIOD_MS       How often the AXP192 battery voltage is sampled
+ *          M5CONFIG_BATTERY_FILTER_SHIFT           Exponential filter weight, new sample counts for 1 / 2^shift
+ *          M5CONFIG_BATTERY_PUBLISH_DELTA_MV       Filtered voltage change that triggers a new publication
+ *          M5CONFIG_BATTERY_PUBLISH_DELTA_RUNTIME  Runtime estimate change (minutes) that triggers a new publication */
+
+#define M5CONFIG_BATTERY_SAMPLE_PERIOD_MS       ( 2000 )
+#define M5CONFIG_BATTERY_FILTER_SHIFT           ( 3 )
+#define M5CONFIG_BATTERY_PUBLISH_DELTA_MV       ( 20 )
+#define M5CONFIG_BATTERY_PUBLISH_DELTA_RUNTIME  ( 5 )
+
+/* Scheduler configuration.
+ *
+ *          M5CONFIG_SCHEDULER_MAX_JOBS             Number of job slots shared by all modules. 8 jobs at most are alive
+ *                                                  at once: stats, battery, mem, stack, cpu, ringbuf, pm_stats, and the
+ *                                                  job of the running lab (sleep or aircon). Keep some headroom
+ *          M5CONFIG_SCHEDULER_STATS_PERIOD_MS      How often the wakeup statistics are logged, 0 to disable
+ *          M5CONFIG_BATTERY_SAMPLE_SLACK_MS        How early a battery sample may run to share a wakeup */
+
+#define M5CONFIG_SCHEDULER_MAX_JOBS             ( 12 )
+#define M5CONFIG_SCHEDULER_STATS_PERIOD_MS      ( 60000 )
+#define M5CONFIG_BATTERY_SAMPLE_SLACK_MS        ( 1000 )
+
+/* Power management configuration (needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE).
+ *
+ *          M5CONFIG_PM_MIN_FREQ_MHZ                CPU frequency when no task needs full speed (XTAL is 40)
+ *          M5CONFIG_PM_LIGHT_SLEEP                 Enter light sleep automatically when idle
+ *          M5CONFIG_PM_STATS_PERIOD_MS             How often the power mode residency is logged, 0 to disable */
+
+#define M5CONFIG_PM_MIN_FREQ_MHZ                ( 40 )
+#define M5CONFIG_PM_LIGHT_SLEEP                 ( true )
+#define M5CONFIG_PM_STATS_PERIOD_MS             ( 60000 )
+
+/* Boot profiler configuration.
+ *
+ *          M5CONFIG_BOOT_TRACE_MAX_STAGES          Size of the static buffer of boot stage timestamps
+ *          M5CONFIG_BOOT_TRACE_PUBLISH             Publish the boot stages once, after the first publish */
+
+#define M5CONFIG_BOOT_TRACE_MAX_STAGES          ( 24 )
+#define M5CONFIG_BOOT_TRACE_PUBLISH             ( 1 )
+
+/* Key provisioning configuration.
+ *
+ *          M5CONFIG_PROVISIONING_SKIP              Skip the PKCS#11 provisioning when the credentials fingerprint
+ *                                                  saved in NVS matches aws_clientcredential_keys.h */
+
+#define M5CONFIG_PROVISIONING_SKIP              ( 1 )
+
+/* UART0 driver configuration, installed for the BLE numeric comparison input (BLE_ENABLED).
+ *
+ * The input is one character and a line ending per pairing, and the
+ * driver needs more than the 128-byte hardware FIFO on the RX side. The
+ * compact mode gives back 12 KB of internal RAM to the MQTT and TLS
+ * buffers: RX 256 instead of 4096 bytes, no TX buffer instead of 8192
+ * (the console does not write through the driver), 4 events instead of 10.
+ * The "UART0 high water" log line reports the peak usage: keep at least
+ * twice the RX peak, and one event more than the queue peak.
+ *
+ * Measured headroom: none yet. The compact sizes are derived from the input
+ * above, not from a device log. Record the RX and event peaks of a pairing
+ * here once measured:
+ *
+ *          UART0 high water                        RX unmeasured of 256 bytes, events unmeasured of 4
+ *
+ *          M5CONFIG_UART_COMPACT                   1 for the compact buffers, 0 for the original ones */
+
+#define M5CONFIG_UART_COMPACT                   ( 1 )
+
+#if M5CONFIG_UART_COMPACT
+#define M5CONFIG_UART_RX_BUFFER_SIZE            ( 256 )
+#define M5CONFIG_UART_TX_BUFFER_SIZE            ( 0 )
+#define M5CONFIG_UART_EVENT_QUEUE_LENGTH        ( 4 )
+#else
+#define M5CONFIG_UART_RX_BUFFER_SIZE            ( 4096 )
+#define M5CONFIG_UART_TX_BUFFER_SIZE            ( 8192 )
+#define M5CONFIG_UART_EVENT_QUEUE_LENGTH        ( 10 )
+#endif
+
+/* Heap allocation tracker configuration.
+ *
+ *          M5CONFIG_MEM_TRACK                      Attribute the live bytes of the mbedTLS, MQTT, Shadow and task pool
+ *                                                  allocations to their subsystem (8 bytes of header per block)
+ *          M5CONFIG_MEM_SAMPLE_PERIOD_MS           How often the free heap and the largest free block are sampled
+ *          M5CONFIG_MEM_SAMPLE_SLACK_MS            How early a sample may run to share a wakeup
+ *          M5CONFIG_MEM_HISTORY                    Samples kept, published as the fragmentation trend
+ *          M5CONFIG_MEM_REPORT_SAMPLES             Samples between two snapshots on the serial console, 0 to disable
+ *          M5CONFIG_MEM_PUBLISH                    Also publish the snapshots on m5stickc/<id>/health when connected */
+
+#define M5CONFIG_MEM_TRACK                      ( 1 )
+#define M5CONFIG_MEM_SAMPLE_PERIOD_MS           ( 60000 )
+#define M5CONFIG_MEM_SAMPLE_SLACK_MS            ( 5000 )
+#define M5CONFIG_MEM_HISTORY                    ( 8 )
+#define M5CONFIG_MEM_REPORT_SAMPLES             ( 5 )
+#define M5CONFIG_MEM_PUBLISH                    ( 1 )
+
+/* Stack monitor configuration (needs CONFIG_FREERTOS_USE_TRACE_FACILITY).
+ *
+ *          M5CONFIG_STACK_SAMPLE_PERIOD_MS         How often the tasks are walked, short enough to see the short-lived ones
+ *          M5CONFIG_STACK_SAMPLE_SLACK_MS          How early a walk may run to share a wakeup
+ *          M5CONFIG_STACK_MAX_TASKS                Tasks walked at once, and task names recorded
+ *          M5CONFIG_STACK_REPORT_SAMPLES           Walks between two reports on the serial console, 0 to disable
+ *          M5CONFIG_STACK_MARGIN_PERCENT           Margin of the recommended sizes over the peak usage
+ *          M5CONFIG_STACK_MARGIN_MIN               Smallest margin in bytes, for the interrupts and the library calls
+ *                                                  that did not happen on the longest path yet */
+
+#define M5CONFIG_STACK_SAMPLE_PERIOD_MS         ( 10000 )
+#define M5CONFIG_STACK_SAMPLE_SLACK_MS          ( 5000 )
+#define M5CONFIG_STACK_MAX_TASKS                ( 32 )
+#define M5CONFIG_STACK_REPORT_SAMPLES           ( 30 )
+#define M5CONFIG_STACK_MARGIN_PERCENT           ( 25 )
+#define M5CONFIG_STACK_MARGIN_MIN               ( 512 )
+
+/* CPU profiler configuration (needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS).
+ *
+ *          M5CONFIG_CPU_WINDOW_MS                  Length of a measurement window
+ *          M5CONFIG_CPU_WINDOW_SLACK_MS            How early a window may end to share a wakeup, the share uses the real length
+ *          M5CONFIG_CPU_WINDOWS                    Windows averaged, the sliding window is WINDOW_MS * WINDOWS long
+ *          M5CONFIG_CPU_MAX_TASKS                  Tasks walked at once, and task names measured
+ *          M5CONFIG_CPU_REPORT_WINDOWS             Windows between two reports on the serial console, 0 to disable
+ *          M5CONFIG_CPU_PUBLISH                    Also publish the reports on m5stickc/<id>/cpu when connected
+ *          M5CONFIG_CPU_PUBLISH_DELTA              Change of the average, in permille, for a task to be published again */
+
+#define M5CONFIG_CPU_WINDOW_MS                  ( 10000 )
+#define M5CONFIG_CPU_WINDOW_SLACK_MS            ( 2000 )
+#define M5CONFIG_CPU_WINDOWS                    ( 6 )
+#define M5CONFIG_CPU_MAX_TASKS                  ( 32 )
+#define M5CONFIG_CPU_REPORT_WINDOWS             ( 30 )
+#define M5CONFIG_CPU_PUBLISH                    ( 1 )
+#define M5CONFIG_CPU_PUBLISH_DELTA              ( 10 )
+
+/* Ring buffer monitor configuration.
  *
- *  These defines are used in iot_demo_runner.h for demo selection */
+ *          M5CONFIG_RINGBUF_SAMPLE_PERIOD_MS       How often the statistics of the ring buffers are read
+ *          M5CONFIG_RINGBUF_SAMPLE_SLACK_MS        How early a sample may run to share a wakeup
+ *          M5CONFIG_RINGBUF_MAX                    Ring buffers read at once, and recorded
+ *          M5CONFIG_RINGBUF_REPORT_SAMPLES         Samples between two reports on the serial console, 0 to disable
+ *          M5CONFIG_RINGBUF_BACKPRESSURE_SAMPLES   Samples in a row with sends that failed, blocked or dropped items before a ring buffer is reported
+ *          M5CONFIG_RINGBUF_MARGIN_PERCENT         Margin of the recommended sizes over the peak usage */
+
+#define M5CONFIG_RINGBUF_SAMPLE_PERIOD_MS       ( 10000 )
+#define M5CONFIG_RINGBUF_SAMPLE_SLACK_MS        ( 5000 )
+#define M5CONFIG_RINGBUF_MAX                    ( 8 )
+#define M5CONFIG_RINGBUF_REPORT_SAMPLES         ( 30 )
+#define M5CONFIG_RINGBUF_BACKPRESSURE_SAMPLES   ( 3 )
+#define M5CONFIG_RINGBUF_MARGIN_PERCENT         ( 25 )
+
+/* Ring buffer benchmark configuration (m5stickc_rbbench.c), run once at startup.
+ *
+ *          M5CONFIG_RBBENCH                        Measure the ring buffers and check their content, 0 to leave it out
+ *          M5CONFIG_RBBENCH_BUFFER_SIZE            Size of the ring buffer under test
+ *          M5CONFIG_RBBENCH_ITEMS                  Items sent in each run, shared by the producers
+ *          M5CONFIG_RBBENCH_PRODUCERS_MAX          Most producer tasks, the runs double them from 1 up to this */
+
+#define M5CONFIG_RBBENCH                        ( 0 )
+#define M5CONFIG_RBBENCH_BUFFER_SIZE            ( 4096 )
+#define M5CONFIG_RBBENCH_ITEMS                  ( 2000 )
+#define M5CONFIG_RBBENCH_PRODUCERS_MAX          ( 4 )
+
+/* Binary logging configuration.
+ *
+ *          M5CONFIG_LOG_BINARY                     Queue the M5_LOGx records unformatted, decode them on the host with
+ *                                                  m5stickc/tools/m5stickc_log_decode.py (0 for plain ESP_LOGx)
+ *          M5CONFIG_LOG_BINARY_BUFFER_SIZE         Ring buffer shared by all the records waiting to be printed
+ *          M5CONFIG_LOG_BINARY_RECORD_MAX          Largest record, the arguments that do not fit are dropped
+ *          M5CONFIG_LOG_BINARY_STRING_MAX          Characters kept of each %s argument */
+
+#define M5CONFIG_LOG_BINARY                     ( 0 )
+#define M5CONFIG_LOG_BINARY_BUFFER_SIZE         ( 2048 )
+#define M5CONFIG_LOG_BINARY_RECORD_MAX          ( 128 )
+#define M5CONFIG_LOG_BINARY_STRING_MAX          ( 48 )
+
+/* Log rate limiting configuration, applies to the text output of ESP_LOGx.
+ *
+ *          M5CONFIG_LOG_RATE_LIMIT                 Limit the rate of each warning and error call site, and fold
+ *                                                  repeated lines. Info and debug lines are never dropped
+ *          M5CONFIG_LOG_RATE_BURST                 Lines a call site can print in a row
+ *          M5CONFIG_LOG_RATE_PER_SECOND            Lines per second a call site can print after a burst
+ *          M5CONFIG_LOG_RATE_BUCKETS               Call sites tracked at the same time, the others are not limited
+ *          M5CONFIG_LOG_LINE_MAX                   Longest line that can be folded, longer ones are always printed */
+
+#define M5CONFIG_LOG_RATE_LIMIT                 ( 1 )
+#define M5CONFIG_LOG_RATE_BURST                 ( 5 )
+#define M5CONFIG_LOG_RATE_PER_SECOND            ( 1 )
+#define M5CONFIG_LOG_RATE_BUCKETS               ( 32 )
+#define M5CONFIG_LOG_LINE_MAX                   ( 192 )
+
+/* Compile-time log levels, from ESP_LOG_NONE to ESP_LOG_VERBOSE, one per module.
+ * The ESP_LOGx and M5_LOGx calls above the level of their module are removed
+ * from the image, format strings included. esp_log_level_set can only lower
+ * the level further at runtime. m5stickc/tools/m5stickc_log_report.py lists
+ * what each level removes. The Amazon FreeRTOS libraries use IOT_LOG_LEVEL_*
+ * in iot_config.h instead. */
 
-#define M5CONFIG_LAB0_DEEP_SLEEP_BUTTON_WAKEUP
+#define M5CONFIG_LOG_LEVEL_DEMO                 ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_LAB                  ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_LAB0                 ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_LAB1                 ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_LAB2                 ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_CONNECTION           ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_BATTERY              ESP_LOG_WARN
+#define M5CONFIG_LOG_LEVEL_SCHEDULER            ESP_LOG_WARN
+#define M5CONFIG_LOG_LEVEL_PM                   ESP_LOG_WARN
+#define M5CONFIG_LOG_LEVEL_BOOT                 ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_PROVISIONING         ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_LOG                  ESP_LOG_WARN
+#define M5CONFIG_LOG_LEVEL_MEM                  ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_STACK                ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_CPU                  ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_RBBENCH              ESP_LOG_INFO
+#define M5CONFIG_LOG_LEVEL_RINGBUF              ESP_LOG_INFO
 
 uint8_t myStickCID[6];
 
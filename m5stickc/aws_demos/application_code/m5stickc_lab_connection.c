@@ -9,6 +9,10 @@
 /* The config header is always included first. */
 #include "iot_config.h"
 
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_CONNECTION
+
 /* Standard includes. */
 #include <stdbool.h>
 #include <stdio.h>
@@ -22,6 +26,9 @@
 #include "platform/iot_clock.h"
 #include "platform/iot_threads.h"
 
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+
 /* MQTT include. */
 #include "iot_mqtt.h"
 
@@ -35,8 +42,11 @@
 #include "types/iot_network_types.h"
 #include "esp_log.h"
 
-#include "m5stickc_lab_config.h"
 #include "m5stickc_lab_connection.h"
+#include "m5stickc_lab.h"
+#include "m5stickc_boot_trace.h"
+#include "m5stickc_pm.h"
+#include "m5stickc_log.h"
 
 #include "m5stickc.h"
 
@@ -117,6 +127,22 @@ static m5stickc_iot_connection_params_t *_pConnectionParams = NULL;
 /* boolean flag for connection established */
 static bool connectionEstablished = false;
 
+/* The demo task was created, later calls to m5stickc_lab_connection_init only swap the parameters */
+static bool connectionStarted = false;
+
+/* An updated callback is registered and must be removed when the next lab has none */
+static bool updatedCallbackSet = false;
+
+/* The clean up signal was sent, the demo task destroys its semaphore once it got it */
+static bool cleanUpRequested = false;
+static portMUX_TYPE xCleanUpMux = portMUX_INITIALIZER_UNLOCKED;
+
+/* The boot trace is reported after the first publish */
+static bool firstPublishDone = false;
+
+/* Thing Name of the established connection */
+static const char *_pThingName = NULL;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -183,6 +209,50 @@ static void _cleanup(void)
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Shadow delta callback shared by all the labs.
+ *
+ * Handles the "lab" field, then forwards the document to the active lab.
+ */
+static void _shadowDeltaDispatch(void *pCallbackContext,
+                                 AwsIotShadowCallbackParam_t *pCallbackParam)
+{
+    m5stickc_lab_shadow_delta(pCallbackParam->u.callback.pDocument,
+                              pCallbackParam->u.callback.documentLength);
+
+    if (_pConnectionParams->shadowDeltaCallback != NULL)
+    {
+        _pConnectionParams->shadowDeltaCallback(pCallbackContext, pCallbackParam);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Network callbacks given to the demo runner, forwarded to the active lab.
+ */
+static void _networkConnectedDispatch(bool awsIotMqttMode,
+                                      const char *pIdentifier,
+                                      void *pNetworkServerInfo,
+                                      void *pNetworkCredentialInfo,
+                                      const IotNetworkInterface_t *pNetworkInterface)
+{
+    if (_pConnectionParams->networkConnectedCallback != NULL)
+    {
+        _pConnectionParams->networkConnectedCallback(awsIotMqttMode, pIdentifier, pNetworkServerInfo, pNetworkCredentialInfo, pNetworkInterface);
+    }
+}
+
+static void _networkDisconnectedDispatch(const IotNetworkInterface_t *pNetworkInterface)
+{
+    if (_pConnectionParams->networkDisconnectedCallback != NULL)
+    {
+        _pConnectionParams->networkDisconnectedCallback(pNetworkInterface);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Set the Shadow callback functions used in this demo.
  *
@@ -198,44 +268,46 @@ static int _setShadowCallbacks(const char *pThingName)
     AwsIotShadowCallbackInfo_t deltaCallback = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
     AwsIotShadowCallbackInfo_t updatedCallback = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
 
-    /* Set the functions for callbacks. */
+    /* Set the functions for callbacks. The delta callback is always set, so
+     * that the "lab" field can switch labs whichever lab is running. */
     deltaCallback.pCallbackContext = &shadowDeltaSem;
-    deltaCallback.function = _pConnectionParams->shadowDeltaCallback;
+    deltaCallback.function = _shadowDeltaDispatch;
     updatedCallback.function = _pConnectionParams->shadowUpdatedCallback;
 
-    if (_pConnectionParams->shadowDeltaCallback != NULL)
-    {
-        /* Set the delta callback, which notifies of different desired and reported
-         * Shadow states. */
-        callbackStatus = AwsIotShadow_SetDeltaCallback(_mqttConnection,
-                                                    pThingName,
-                                                    strlen(pThingName),
-                                                    0,
-                                                    &deltaCallback);
+    /* Set the delta callback, which notifies of different desired and reported
+     * Shadow states. */
+    callbackStatus = AwsIotShadow_SetDeltaCallback(_mqttConnection,
+                                                   pThingName,
+                                                   strlen(pThingName),
+                                                   0,
+                                                   &deltaCallback);
 
-        if (callbackStatus != AWS_IOT_SHADOW_SUCCESS)
-        {
-            IotLogError("Failed to set shadow callback, error %s.",
-                        AwsIotShadow_strerror(callbackStatus));
-            status = EXIT_FAILURE;
-        }
+    if (callbackStatus != AWS_IOT_SHADOW_SUCCESS)
+    {
+        IotLogError("Failed to set shadow callback, error %s.",
+                    AwsIotShadow_strerror(callbackStatus));
+        status = EXIT_FAILURE;
     }
 
-    if (_pConnectionParams->shadowUpdatedCallback != NULL && callbackStatus == AWS_IOT_SHADOW_SUCCESS)
+    if ((_pConnectionParams->shadowUpdatedCallback != NULL || updatedCallbackSet) && callbackStatus == AWS_IOT_SHADOW_SUCCESS)
     {
         /* Set the updated callback, which notifies when a Shadow document is
-         * changed. */
+         * changed. A NULL callback info removes the one set by a previous lab. */
         callbackStatus = AwsIotShadow_SetUpdatedCallback(_mqttConnection,
                                                          pThingName,
                                                          strlen(pThingName),
                                                          0,
-                                                         &updatedCallback);
+                                                         _pConnectionParams->shadowUpdatedCallback != NULL ? &updatedCallback : NULL);
         if (callbackStatus != AWS_IOT_SHADOW_SUCCESS)
         {
             IotLogError("Failed to set shadow callback, error %s.",
                         AwsIotShadow_strerror(callbackStatus));
             status = EXIT_FAILURE;
         }
+        else
+        {
+            updatedCallbackSet = (_pConnectionParams->shadowUpdatedCallback != NULL);
+        }
     }
 
     return status;
@@ -358,10 +430,10 @@ static int _establishMqttConnection(const char *pIdentifier,
     /* Establish the MQTT connection. */
     if ( status == EXIT_SUCCESS )
     {
-        IotLogInfo("MQTT client identifier is %.*s (length %hu).",
-                   connectInfo.clientIdentifierLength,
-                   connectInfo.pClientIdentifier,
-                   connectInfo.clientIdentifierLength);
+        ESP_LOGI(TAG, "MQTT client identifier is %.*s (length %hu).",
+                 connectInfo.clientIdentifierLength,
+                 connectInfo.pClientIdentifier,
+                 connectInfo.clientIdentifierLength);
 
         connectStatus = IotMqtt_Connect(&networkInfo,
                                         &connectInfo,
@@ -370,8 +442,8 @@ static int _establishMqttConnection(const char *pIdentifier,
 
         if (connectStatus != IOT_MQTT_SUCCESS)
         {
-            IotLogError("MQTT CONNECT returned error %s.",
-                        IotMqtt_strerror(connectStatus));
+            ESP_LOGE(TAG, "MQTT CONNECT returned error %s.",
+                     IotMqtt_strerror(connectStatus));
 
             status = EXIT_FAILURE;
         }
@@ -443,6 +515,7 @@ int m5stickc_lab_run(bool awsIotMqttMode,
     {
         /* Mark the libraries as initialized. */
         librariesInitialized = true;
+        m5stickc_boot_trace_mark("mqtt_init");
 
         /* Establish a new MQTT connection. */
         status = _establishMqttConnection(pIdentifier,
@@ -458,7 +531,12 @@ int m5stickc_lab_run(bool awsIotMqttMode,
     if (status == EXIT_SUCCESS)
     {
         /* Mark the MQTT connection as established. */
+        _pThingName = pIdentifier;
         connectionEstablished = true;
+        m5stickc_boot_trace_mark("mqtt_connected");
+
+        /* Let the CPU sleep between DTIM beacons now that the connection is up. */
+        m5stickc_pm_network_up();
 
         /* Set the Shadow callbacks for this demo. */
         status = _setShadowCallbacks(pIdentifier);
@@ -486,8 +564,8 @@ int m5stickc_lab_run(bool awsIotMqttMode,
     /* Disconnect the MQTT connection if it was established. */
     if (connectionEstablished == true)
     {
-        IotMqtt_Disconnect(_mqttConnection, 0);
         connectionEstablished = false;
+        IotMqtt_Disconnect(_mqttConnection, 0);
     }
 
     /* Clean up libraries if they were initialized. */
@@ -507,17 +585,28 @@ esp_err_t m5stickc_lab_connection_init(m5stickc_iot_connection_params_t * pConne
 
     _pConnectionParams = pConnectionParams;
 
+    if (connectionStarted)
+    {
+        /* Another lab is taking over the connection: move the shadow callbacks to it.
+         * The shadow delta semaphore is only released once the connection is set up. */
+        if (connectionEstablished)
+        {
+            IotSemaphore_Wait(&shadowDeltaSem);
+            res = _setShadowCallbacks(_pThingName) == EXIT_SUCCESS ? ESP_OK : ESP_FAIL;
+            IotSemaphore_Post(&shadowDeltaSem);
+        }
+
+        return res;
+    }
+
     static demoContext_t mqttDemoContext =
     {
         .networkTypes = democonfigNETWORK_TYPES,
         .demoFunction = m5stickc_lab_run,
-        .networkConnectedCallback = NULL,
-        .networkDisconnectedCallback = NULL
+        .networkConnectedCallback = _networkConnectedDispatch,
+        .networkDisconnectedCallback = _networkDisconnectedDispatch
     };
 
-    mqttDemoContext.networkConnectedCallback = _pConnectionParams->networkConnectedCallback;
-    mqttDemoContext.networkDisconnectedCallback = _pConnectionParams->networkDisconnectedCallback;
-
     // Create semaphore for connection readiness
     if (res == EXIT_SUCCESS && !IotSemaphore_Create(&connectionReadySem, 0, 1))
     {
@@ -542,7 +631,8 @@ esp_err_t m5stickc_lab_connection_init(m5stickc_iot_connection_params_t * pConne
     if ( res == EXIT_SUCCESS )
     {
         ESP_LOGI(TAG, "Creating IoT Thread");
-        res = Iot_CreateDetachedThread(runDemoTask, &mqttDemoContext, democonfigDEMO_PRIORITY, democonfigDEMO_STACKSIZE);        
+        res = Iot_CreateDetachedThread(runDemoTask, &mqttDemoContext, democonfigDEMO_PRIORITY, democonfigDEMO_STACKSIZE) ? ESP_OK : ESP_FAIL;
+        connectionStarted = (res == ESP_OK);
     }
 
     return res;
@@ -589,15 +679,24 @@ esp_err_t m5stickc_lab_connection_publish(IotMqttPublishInfo_t * publishInfo, Io
     {
         /* PUBLISH a message. This is an asynchronous function that notifies of
          * completion through a callback. */
-        ESP_LOGI(TAG, "MQTT Publish: %s: %s", (char *)publishInfo->pTopicName, (char *)publishInfo->pPayload);
+        M5_LOGI(TAG, "MQTT Publish: %.*s: %.*s", (int)publishInfo->topicNameLength, publishInfo->pTopicName,
+                (int)publishInfo->payloadLength, (const char *)publishInfo->pPayload);
 
         publishStatus = IotMqtt_Publish(_mqttConnection, publishInfo, 0, publishComplete, NULL);
 
         if (publishStatus != IOT_MQTT_STATUS_PENDING)
         {
-            ESP_LOGE(TAG, "MQTT Publish returned error %s.", IotMqtt_strerror(publishStatus));
+            M5_LOGE(TAG, "MQTT Publish returned error %s.", IotMqtt_strerror(publishStatus));
             status = EXIT_FAILURE;
         }
+        else if (!firstPublishDone)
+        {
+            /* End of the boot, report where the time went */
+            firstPublishDone = true;
+            m5stickc_boot_trace_mark("first_publish");
+            m5stickc_boot_trace_dump();
+            m5stickc_boot_trace_publish(_pConnectionParams->strID);
+        }
     }
     else
     {
@@ -615,9 +714,40 @@ void m5stickc_lab_connection_ready_wait(void)
     IotSemaphore_Post( &connectionReadySem );
 }
 
+const char *m5stickc_lab_connection_thing_name(void)
+{
+    return connectionEstablished ? _pThingName : NULL;
+}
+
 void m5stickc_lab_connection_cleanup(void)
 {
-    IotSemaphore_Post(&cleanUpReadySem);
+    bool post;
+
+    portENTER_CRITICAL(&xCleanUpMux);
+    post = connectionStarted && !cleanUpRequested;
+    cleanUpRequested = cleanUpRequested || post;
+    portEXIT_CRITICAL(&xCleanUpMux);
+
+    if (post)
+    {
+        IotSemaphore_Post(&cleanUpReadySem);
+    }
+}
+
+void m5stickc_lab_connection_detach(void)
+{
+    static m5stickc_iot_connection_params_t detachedParams;
+
+    if (!connectionStarted || _pConnectionParams == &detachedParams)
+    {
+        return;
+    }
+
+    /* Same identity, no callbacks: the shadow updated callback is removed */
+    detachedParams.strID = _pConnectionParams->strID;
+    detachedParams.useShadow = _pConnectionParams->useShadow;
+
+    m5stickc_lab_connection_init(&detachedParams);
 }
 
 /**
@@ -21,10 +21,25 @@ typedef struct {
     void (*shadowUpdatedCallback)(void *, AwsIotShadowCallbackParam_t *);
 } m5stickc_iot_connection_params_t;
 
+/**
+ * @brief Start the shared connection, or hand it over to another lab when already started.
+ */
 esp_err_t m5stickc_lab_connection_init(m5stickc_iot_connection_params_t * params);
 void m5stickc_lab_connection_ready_wait(void);
+const char *m5stickc_lab_connection_thing_name(void);
+
+/**
+ * @brief Close the connection and clean the libraries up, if the connection
+ * was started. Only the first call has an effect.
+ */
 void m5stickc_lab_connection_cleanup(void);
 
+/**
+ * @brief Take the callbacks of the lab using the connection off it, the
+ * connection stays up for the next lab to take over.
+ */
+void m5stickc_lab_connection_detach(void);
+
 esp_err_t m5stickc_lab_connection_update_shadow(AwsIotShadowDocumentInfo_t *updateDocument);
 esp_err_t m5stickc_lab_connection_publish(IotMqttPublishInfo_t *publishInfo, IotMqttCallbackInfo_t *publishComplete);
 
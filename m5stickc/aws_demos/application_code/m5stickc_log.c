@@ -0,0 +1,653 @@
+/**
+ * @file m5stickc_log.c
+ * @brief Binary logging: the messages are formatted on the host, not on the device.
+ *
+ * A record holds the time, the level, the addresses of the tag and of the
+ * format string, and the raw arguments. Only the %s arguments are copied, up
+ * to M5CONFIG_LOG_BINARY_STRING_MAX characters, since they may not outlive
+ * the call. The records are written in place in a ring buffer (acquired, then
+ * completed), read in batches by a low priority task that prints each of them
+ * base64-encoded on a line starting with '~':
+ *
+ *      u32 time (ms) | u8 level | u32 tag | u32 format | arguments
+ *
+ * in little endian. An argument is 4 bytes, 8 bytes for %ll and floating
+ * point conversions, and a length byte followed by the characters for %s.
+ * Bit 7 of the level is set when the record was truncated.
+ *
+ * When the ring buffer is full, the oldest records that the task has not
+ * taken yet are dropped to make room for the new one. Only when the task holds
+ * all of them, while it prints a batch, is the new record dropped instead.
+ *
+ * The text output of ESP_LOGx goes through a rate limiter: every call site of
+ * a warning or an error, identified by the address of its format string, has
+ * a token bucket, and a line identical to the previous one is counted instead
+ * of printed. The info and debug lines are never dropped, as the reports print
+ * their rows from one call site in a loop.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_LOG
+
+/* Standard includes. */
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+#include "esp_log.h"
+
+#include "m5stickc_log.h"
+#include "m5stickc_stack.h"
+
+/*-----------------------------------------------------------*/
+
+#if M5CONFIG_LOG_BINARY
+
+static const char *TAG = "m5stickc_log";
+
+#define LOG_RECORD_HEADER_LENGTH    ( 13 )
+#define LOG_RECORD_TRUNCATED        ( 0x80 )
+
+#define LOG_TASK_NAME               "m5log"
+#define LOG_TASK_STACK_SIZE         ( 2048 )
+#define LOG_TASK_PRIORITY           ( tskIDLE_PRIORITY + 1 )
+
+/* Records taken out of the ring buffer at once */
+#define LOG_TASK_BATCH              ( 8 )
+
+/* 4 characters for every 3 bytes, plus the '~', the newline and the terminator */
+#define LOG_LINE_LENGTH             ( ( M5CONFIG_LOG_BINARY_RECORD_MAX + 2 ) / 3 * 4 + 3 )
+
+/* A statically allocated no-split ring buffer is not rounded up, its size must be aligned */
+#define LOG_RINGBUF_SIZE            ( ( M5CONFIG_LOG_BINARY_BUFFER_SIZE + portBYTE_ALIGNMENT_MASK ) & ~portBYTE_ALIGNMENT_MASK )
+
+static RingbufHandle_t xLogRingbuf = NULL;
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+/* In .bss: the ring buffer lives as long as the application, and is there at boot */
+static uint8_t pLogRingbufStorage[LOG_RINGBUF_SIZE] __attribute__((aligned(portBYTE_ALIGNMENT)));
+static StaticRingbuffer_t xLogRingbufStatic;
+#endif
+static uint32_t ulLogDropped = 0;
+static portMUX_TYPE xLogMux = portMUX_INITIALIZER_UNLOCKED;
+static char pLogLine[LOG_LINE_LENGTH];
+
+static const char pBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append to the record. With a NULL record only the length is counted.
+ */
+static bool prvPut(uint8_t *pRecord, size_t *pLength, const void *pData, size_t dataLength)
+{
+    if (*pLength + dataLength > M5CONFIG_LOG_BINARY_RECORD_MAX)
+    {
+        return false;
+    }
+
+    if (pRecord != NULL)
+    {
+        memcpy(pRecord + *pLength, pData, dataLength);
+    }
+    *pLength += dataLength;
+
+    return true;
+}
+
+static bool prvPutString(uint8_t *pRecord, size_t *pLength, const char *pString, int precision)
+{
+    size_t maxLength = M5CONFIG_LOG_BINARY_STRING_MAX;
+    uint8_t length = 0;
+
+    if (pString == NULL)
+    {
+        pString = "(null)";
+    }
+
+    if (precision >= 0 && (size_t)precision < maxLength)
+    {
+        maxLength = (size_t)precision;
+    }
+
+    /* Not strlen: with a precision the string does not have to be terminated */
+    while (length < maxLength && pString[length] != '\0')
+    {
+        length++;
+    }
+
+    return prvPut(pRecord, pLength, &length, 1) && prvPut(pRecord, pLength, pString, length);
+}
+
+/**
+ * @brief Copy the arguments, the format is only scanned for the type of each conversion.
+ */
+static bool prvPutArguments(uint8_t *pRecord, size_t *pLength, const char *format, va_list args)
+{
+    const char *p = format;
+    int precision;
+    bool bLong;
+    uint32_t ulValue;
+    uint64_t ullValue;
+    double dValue;
+
+    while (*p != '\0')
+    {
+        if (*p++ != '%')
+        {
+            continue;
+        }
+
+        if (*p == '%')
+        {
+            p++;
+            continue;
+        }
+
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+        {
+            p++;
+        }
+
+        if (*p == '*')
+        {
+            ulValue = (uint32_t)va_arg(args, int);
+            if (!prvPut(pRecord, pLength, &ulValue, sizeof(ulValue))) return false;
+            p++;
+        }
+
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+
+        precision = -1;
+
+        if (*p == '.')
+        {
+            p++;
+            if (*p == '*')
+            {
+                precision = va_arg(args, int);
+                ulValue = (uint32_t)precision;
+                if (!prvPut(pRecord, pLength, &ulValue, sizeof(ulValue))) return false;
+                p++;
+            }
+            else
+            {
+                precision = 0;
+                while (*p >= '0' && *p <= '9')
+                {
+                    precision = precision * 10 + (*p++ - '0');
+                }
+            }
+        }
+
+        bLong = false;
+
+        while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 't' || *p == 'j' || *p == 'L')
+        {
+            bLong = bLong || (p[0] == 'l' && p[1] == 'l') || *p == 'j';
+            p++;
+        }
+
+        switch (*p)
+        {
+        case '\0':
+            return true;
+
+        case 's':
+            if (!prvPutString(pRecord, pLength, va_arg(args, const char *), precision)) return false;
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            dValue = va_arg(args, double);
+            if (!prvPut(pRecord, pLength, &dValue, sizeof(dValue))) return false;
+            break;
+
+        default:
+            if (bLong)
+            {
+                ullValue = va_arg(args, uint64_t);
+                if (!prvPut(pRecord, pLength, &ullValue, sizeof(ullValue))) return false;
+            }
+            else
+            {
+                ulValue = va_arg(args, uint32_t);
+                if (!prvPut(pRecord, pLength, &ulValue, sizeof(ulValue))) return false;
+            }
+            break;
+        }
+
+        p++;
+    }
+
+    return true;
+}
+
+static void prvPrintRecord(const uint8_t *pRecord, size_t length)
+{
+    size_t i, n = 0;
+    uint32_t ulBits;
+
+    pLogLine[n++] = '~';
+
+    for (i = 0; i < length; i += 3)
+    {
+        ulBits = (uint32_t)pRecord[i] << 16;
+        ulBits |= i + 1 < length ? (uint32_t)pRecord[i + 1] << 8 : 0;
+        ulBits |= i + 2 < length ? (uint32_t)pRecord[i + 2] : 0;
+
+        pLogLine[n++] = pBase64[(ulBits >> 18) & 0x3F];
+        pLogLine[n++] = pBase64[(ulBits >> 12) & 0x3F];
+        pLogLine[n++] = i + 1 < length ? pBase64[(ulBits >> 6) & 0x3F] : '=';
+        pLogLine[n++] = i + 2 < length ? pBase64[ulBits & 0x3F] : '=';
+    }
+
+    pLogLine[n++] = '\n';
+    pLogLine[n] = '\0';
+
+    fputs(pLogLine, stdout);
+}
+
+static void prvLogTask(void *pvParameters)
+{
+    RingbufItem_t xRecords[LOG_TASK_BATCH];
+    RingbufStats_t xStats;
+    UBaseType_t uxCount, i;
+    UBaseType_t uxOverwritten = 0;
+    uint32_t ulDropped;
+
+    for (;;)
+    {
+        uxCount = uxRingbufferReceiveMultiple(xLogRingbuf, xRecords, LOG_TASK_BATCH, portMAX_DELAY);
+
+        if (uxCount == 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < uxCount; i++)
+        {
+            prvPrintRecord(xRecords[i].pvHeadItem, xRecords[i].xHeadItemSize);
+        }
+        vRingbufferReturnMultiple(xLogRingbuf, xRecords, uxCount);
+
+        portENTER_CRITICAL(&xLogMux);
+        ulDropped = ulLogDropped;
+        ulLogDropped = 0;
+        portEXIT_CRITICAL(&xLogMux);
+
+        if (ulDropped > 0)
+        {
+            ESP_LOGW(TAG, "%u records dropped, the buffer is full", ulDropped);
+        }
+
+        vRingbufferGetStats(xLogRingbuf, &xStats);
+        if (xStats.uxDroppedItems != uxOverwritten)
+        {
+            ESP_LOGW(TAG, "%u oldest records dropped, the buffer is full", xStats.uxDroppedItems - uxOverwritten);
+            uxOverwritten = xStats.uxDroppedItems;
+        }
+    }
+}
+
+#endif /* if M5CONFIG_LOG_BINARY */
+
+/*-----------------------------------------------------------*/
+
+#if M5CONFIG_LOG_RATE_LIMIT
+
+/* Tokens are counted in thousandths, so that the refill is exact at any rate */
+#define LOG_TOKEN                   ( 1000UL )
+#define LOG_TOKENS_MAX              ( M5CONFIG_LOG_RATE_BURST * LOG_TOKEN )
+
+typedef struct {
+    const char *format;
+    uint32_t tokens;
+    TickType_t refilled;
+    uint32_t suppressed;
+} log_bucket_t;
+
+static vprintf_like_t xLogOutput = NULL;
+static SemaphoreHandle_t xLogLimiterMutex = NULL;
+static log_bucket_t xLogBuckets[M5CONFIG_LOG_RATE_BUCKETS];
+static const char *pLastFormat = NULL;
+static uint32_t ulLastRepeated = 0;
+static char pLogText[M5CONFIG_LOG_LINE_MAX];
+static char pLastText[M5CONFIG_LOG_LINE_MAX];
+
+/*-----------------------------------------------------------*/
+
+static int prvOutput(const char *format, ...)
+{
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = xLogOutput(format, args);
+    va_end(args);
+
+    return length;
+}
+
+/**
+ * @brief Whether the line is a warning or an error. ESP_LOG_FORMAT starts with
+ * the level letter, after the color escape sequence when there is one.
+ */
+static bool prvIsLimited(const char *format)
+{
+    if (format[0] == '\033')
+    {
+        format = strchr(format, 'm');
+        if (format == NULL)
+        {
+            return false;
+        }
+        format++;
+    }
+
+    return format[0] == 'E' || format[0] == 'W';
+}
+
+/**
+ * @brief A bucket that would be full again and has nothing to report carries
+ * no state, another call site can take it over.
+ */
+static bool prvIsIdle(const log_bucket_t *pxBucket, TickType_t now)
+{
+    uint32_t ulElapsed = (uint32_t)(now - pxBucket->refilled) * portTICK_PERIOD_MS;
+
+    return pxBucket->suppressed == 0 && ulElapsed >= LOG_TOKENS_MAX / M5CONFIG_LOG_RATE_PER_SECOND;
+}
+
+static void prvRefill(log_bucket_t *pxBucket, TickType_t now)
+{
+    uint32_t ulElapsed = (uint32_t)(now - pxBucket->refilled) * portTICK_PERIOD_MS;
+
+    if (ulElapsed > 0)
+    {
+        if (ulElapsed >= LOG_TOKENS_MAX / M5CONFIG_LOG_RATE_PER_SECOND)
+        {
+            pxBucket->tokens = LOG_TOKENS_MAX;
+        }
+        else
+        {
+            pxBucket->tokens += ulElapsed * M5CONFIG_LOG_RATE_PER_SECOND;
+            if (pxBucket->tokens > LOG_TOKENS_MAX)
+            {
+                pxBucket->tokens = LOG_TOKENS_MAX;
+            }
+        }
+        pxBucket->refilled = now;
+    }
+}
+
+/**
+ * @brief Find the bucket of a call site by linear probing from its hash. The
+ * buckets are never emptied, only taken over when idle, so the first empty one
+ * ends the search.
+ *
+ * @return NULL when every bucket is busy: the line is not limited.
+ */
+static log_bucket_t *prvBucket(const char *format, TickType_t now)
+{
+    size_t first = ((uintptr_t)format >> 2) % M5CONFIG_LOG_RATE_BUCKETS;
+    log_bucket_t *pxBucket, *pxFree = NULL;
+    size_t i;
+
+    for (i = 0; i < M5CONFIG_LOG_RATE_BUCKETS; i++)
+    {
+        pxBucket = &xLogBuckets[(first + i) % M5CONFIG_LOG_RATE_BUCKETS];
+
+        if (pxBucket->format == format)
+        {
+            prvRefill(pxBucket, now);
+            return pxBucket;
+        }
+
+        if (pxBucket->format == NULL)
+        {
+            if (pxFree == NULL)
+            {
+                pxFree = pxBucket;
+            }
+            break;
+        }
+
+        if (pxFree == NULL && prvIsIdle(pxBucket, now))
+        {
+            pxFree = pxBucket;
+        }
+    }
+
+    if (pxFree != NULL)
+    {
+        /* A new call site starts from a full bucket */
+        pxFree->format = format;
+        pxFree->tokens = LOG_TOKENS_MAX;
+        pxFree->refilled = now;
+        pxFree->suppressed = 0;
+    }
+
+    return pxFree;
+}
+
+/**
+ * @brief Skip the color and the timestamp, so that repeated lines compare equal.
+ */
+static const char *prvMessage(const char *pText)
+{
+    const char *pMessage = strstr(pText, ") ");
+
+    return pMessage ? pMessage + 2 : pText;
+}
+
+static int prvLimitedVprintf(const char *format, va_list args)
+{
+    log_bucket_t *pxBucket = NULL;
+    uint32_t ulSuppressed = 0;
+    va_list copy;
+    int length;
+
+    /* Called before the scheduler or from a context that cannot block */
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING || xPortInIsrContext())
+    {
+        return xLogOutput(format, args);
+    }
+
+    xSemaphoreTake(xLogLimiterMutex, portMAX_DELAY);
+
+    if (prvIsLimited(format))
+    {
+        pxBucket = prvBucket(format, xTaskGetTickCount());
+    }
+
+    if (pxBucket != NULL)
+    {
+        if (pxBucket->tokens < LOG_TOKEN)
+        {
+            pxBucket->suppressed++;
+            xSemaphoreGive(xLogLimiterMutex);
+            return 0;
+        }
+
+        pxBucket->tokens -= LOG_TOKEN;
+    }
+
+    va_copy(copy, args);
+    length = vsnprintf(pLogText, sizeof(pLogText), format, copy);
+    va_end(copy);
+
+    if (length < 0 || length >= (int)sizeof(pLogText))
+    {
+        /* Too long to be folded, print it as it is */
+        pLastFormat = NULL;
+        xSemaphoreGive(xLogLimiterMutex);
+        return xLogOutput(format, args);
+    }
+
+    if (format == pLastFormat && strcmp(prvMessage(pLogText), prvMessage(pLastText)) == 0)
+    {
+        ulLastRepeated++;
+        xSemaphoreGive(xLogLimiterMutex);
+        return 0;
+    }
+
+    if (ulLastRepeated > 0)
+    {
+        prvOutput("last message repeated %u times\n", ulLastRepeated);
+        ulLastRepeated = 0;
+    }
+
+    if (pxBucket != NULL)
+    {
+        ulSuppressed = pxBucket->suppressed;
+        pxBucket->suppressed = 0;
+    }
+
+    if (ulSuppressed > 0)
+    {
+        prvOutput("%u similar messages suppressed\n", ulSuppressed);
+    }
+
+    prvOutput("%s", pLogText);
+
+    pLastFormat = format;
+    memcpy(pLastText, pLogText, (size_t)length + 1);
+
+    xSemaphoreGive(xLogLimiterMutex);
+
+    return length;
+}
+
+#endif /* if M5CONFIG_LOG_RATE_LIMIT */
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_log_init(void)
+{
+#if M5CONFIG_LOG_RATE_LIMIT
+    if (xLogLimiterMutex == NULL)
+    {
+        xLogLimiterMutex = xSemaphoreCreateMutex();
+
+        if (xLogLimiterMutex == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        xLogOutput = esp_log_set_vprintf(prvLimitedVprintf);
+    }
+#endif
+
+#if M5CONFIG_LOG_BINARY
+    if (xLogRingbuf != NULL)
+    {
+        return ESP_OK;
+    }
+
+#if ( configSUPPORT_STATIC_ALLOCATION == 1 )
+    xLogRingbuf = xRingbufferCreateStatic(LOG_RINGBUF_SIZE, RINGBUF_TYPE_NOSPLIT, pLogRingbufStorage, &xLogRingbufStatic);
+#else
+    xLogRingbuf = xRingbufferCreate(M5CONFIG_LOG_BINARY_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+#endif
+
+    if (xLogRingbuf == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_log_init: failed to create the ring buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    vRingbufferSetName(xLogRingbuf, LOG_TASK_NAME);
+    vRingbufferSetOverwrite(xLogRingbuf, pdTRUE);
+
+    if (xTaskCreate(prvLogTask, LOG_TASK_NAME, LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "m5stickc_log_init: failed to create the task");
+        vRingbufferDelete(xLogRingbuf);
+        xLogRingbuf = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    m5stickc_stack_expect(LOG_TASK_NAME, LOG_TASK_STACK_SIZE, "LOG_TASK_STACK_SIZE");
+#endif
+
+    return ESP_OK;
+}
+
+#if M5CONFIG_LOG_BINARY
+void m5stickc_log_binary(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    uint8_t *pRecord = NULL;
+    size_t length = LOG_RECORD_HEADER_LENGTH;
+    uint8_t ucLevel = (uint8_t)level;
+    uint32_t ulTime = esp_log_timestamp();
+    uint32_t ulTag = (uint32_t)(uintptr_t)tag;
+    uint32_t ulFormat = (uint32_t)(uintptr_t)format;
+    va_list args;
+    va_list argsLength;
+
+    va_start(args, format);
+
+    if (xLogRingbuf == NULL)
+    {
+        printf("%s: ", tag);
+        vprintf(format, args);
+        putchar('\n');
+        va_end(args);
+        return;
+    }
+
+    /* The record is written in place in the ring buffer, a first pass only counts its length */
+    va_copy(argsLength, args);
+    if (!prvPutArguments(NULL, &length, format, argsLength))
+    {
+        ucLevel |= LOG_RECORD_TRUNCATED;
+    }
+    va_end(argsLength);
+
+    if (xRingbufferSendAcquire(xLogRingbuf, (void **)&pRecord, length, 0) != pdTRUE)
+    {
+        va_end(args);
+        portENTER_CRITICAL(&xLogMux);
+        ulLogDropped++;
+        portEXIT_CRITICAL(&xLogMux);
+        return;
+    }
+
+    memcpy(pRecord, &ulTime, sizeof(ulTime));
+    pRecord[4] = ucLevel;
+    memcpy(pRecord + 5, &ulTag, sizeof(ulTag));
+    memcpy(pRecord + 9, &ulFormat, sizeof(ulFormat));
+
+    /* Same arguments, same length: stops at the same place when truncated */
+    length = LOG_RECORD_HEADER_LENGTH;
+    prvPutArguments(pRecord, &length, format, args);
+    va_end(args);
+
+    xRingbufferSendComplete(xLogRingbuf, pRecord);
+}
+#endif
+
+/*-----------------------------------------------------------*/
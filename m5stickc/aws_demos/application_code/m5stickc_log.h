@@ -0,0 +1,47 @@
+/**
+ * @file m5stickc_log.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_LOG_H_
+#define _M5STICKC_LOG_H_
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "m5stickc_lab_config.h"
+
+/**
+ * @brief Drop-in replacements for ESP_LOGx on the hot paths.
+ *
+ * With M5CONFIG_LOG_BINARY, the message is not formatted on the device: the
+ * addresses of the tag and of the format, and the raw arguments, are queued
+ * and printed as one encoded line, which m5stickc/tools/m5stickc_log_decode.py
+ * formats on the host with the ELF file. The tag and the format have to be
+ * string literals. The runtime level set with esp_log_level_set is ignored.
+ */
+#if M5CONFIG_LOG_BINARY
+#define M5_LOG_LEVEL(level, tag, format, ...)   do { if ( LOG_LOCAL_LEVEL >= level ) m5stickc_log_binary(level, tag, format, ##__VA_ARGS__); } while(0)
+#else
+#define M5_LOG_LEVEL(level, tag, format, ...)   ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__)
+#endif
+
+#define M5_LOGE(tag, format, ...)   M5_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define M5_LOGW(tag, format, ...)   M5_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define M5_LOGI(tag, format, ...)   M5_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define M5_LOGD(tag, format, ...)   M5_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define M5_LOGV(tag, format, ...)   M5_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+/**
+ * @brief Install the rate limiter of the ESP_LOGx output (M5CONFIG_LOG_RATE_LIMIT),
+ * and create the binary record buffer and the task that prints it (M5CONFIG_LOG_BINARY).
+ *
+ * Binary records logged before are formatted and printed as text.
+ */
+esp_err_t m5stickc_log_init(void);
+
+void m5stickc_log_binary(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#endif /* ifndef _M5STICKC_LOG_H_ */
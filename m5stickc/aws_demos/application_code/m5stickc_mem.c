@@ -0,0 +1,482 @@
+/**
+ * @file m5stickc_mem.c
+ * @brief Heap allocations attributed to the subsystems of the demo, and heap fragmentation over time.
+ *
+ * The blocks of the tracked allocators carry a small header with their size
+ * and subsystem, so that freeing them updates the live bytes of the right
+ * subsystem without a lookup table. The heap itself is sampled on the
+ * scheduler: free bytes, largest free block and their ratio, which is how
+ * fragmented the heap is. A long running device that is leaking shows up in
+ * the live bytes of a subsystem, one that is fragmenting in the largest free
+ * block shrinking while the free bytes stay put.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_MEM
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+#include "aws_demo.h"
+#include "types/iot_network_types.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+#include "mbedtls/platform.h"
+#endif
+
+#include "m5stickc_lab_connection.h"
+#include "m5stickc_scheduler.h"
+#include "m5stickc_mem.h"
+
+static const char *TAG = "m5stickc_mem";
+
+/*-----------------------------------------------------------*/
+
+#define MEM_HEALTH_TOPIC_FORMAT     "m5stickc/%s/health"
+#define MEM_HEALTH_TOPIC_LENGTH     ( sizeof( MEM_HEALTH_TOPIC_FORMAT ) + 12 )
+
+/* {"free":,"min":,"largest":,"frag_max":,"bad_free":}, the subsystems and the history */
+#define MEM_HEALTH_PAYLOAD_LENGTH   ( 96 + M5STICKC_MEM_TAG_COUNT * 64 + M5CONFIG_MEM_HISTORY * 24 )
+
+/* Same heap as pvPortMalloc */
+#define MEM_CAPS_DEFAULT            ( MALLOC_CAP_8BIT )
+
+/* Part of the header check, with the address of the block */
+#define MEM_HEADER_MAGIC            ( 0xA55AC33CUL )
+
+/* Largest tracked block, its size shares a word with the tag */
+#define MEM_SIZE_MAX                ( 0x00FFFFFFUL )
+
+typedef struct {
+    uint32_t size : 24;
+    uint32_t tag : 8;
+    uint32_t check;
+} mem_header_t;
+
+typedef struct {
+    uint32_t live;          /* Bytes allocated and not freed yet */
+    uint32_t peak;          /* Highest live bytes */
+    uint32_t allocs;        /* Allocations since boot */
+    uint32_t failures;      /* Allocations that returned NULL */
+    uint32_t sampled;       /* allocs at the previous sample */
+    uint32_t rate;          /* Allocations per minute over the last sample period */
+} mem_tag_stats_t;
+
+typedef struct {
+    uint32_t free;
+    uint32_t largest;
+} mem_sample_t;
+
+static const char *const pTagNames[M5STICKC_MEM_TAG_COUNT] = {
+    "user_message",
+    "mbedtls",
+    "mqtt",
+    "shadow",
+    "taskpool",
+};
+
+static mem_tag_stats_t xTagStats[M5STICKC_MEM_TAG_COUNT];
+static uint32_t ulBadFrees = 0;
+static portMUX_TYPE xMemMux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Heap samples, the oldest is overwritten */
+static mem_sample_t xHistory[M5CONFIG_MEM_HISTORY];
+static size_t xHistoryCount = 0;
+static size_t xHistoryNext = 0;
+static uint32_t ulLargestMin = UINT32_MAX;
+static uint32_t ulFragmentationMax = 0;
+static TickType_t xLastSample = 0;
+static uint32_t ulSamples = 0;
+
+static m5stickc_scheduler_job_t xMemJob = NULL;
+static const char *pMemStrID = NULL;
+
+#if M5CONFIG_MEM_PUBLISH
+static char pMemHealthPayload[MEM_HEALTH_PAYLOAD_LENGTH];
+static char pMemHealthTopic[MEM_HEALTH_TOPIC_LENGTH];
+#endif
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvHeaderCheck(const mem_header_t *pxHeader)
+{
+    return MEM_HEADER_MAGIC ^ (uint32_t)(uintptr_t)pxHeader ^ pxHeader->size ^ ((uint32_t)pxHeader->tag << 24);
+}
+
+static inline uint32_t prvFragmentation(uint32_t free, uint32_t largest)
+{
+    return free == 0 ? 0 : 100 - (uint32_t)(((uint64_t)largest * 100) / free);
+}
+
+static void prvAccount(m5stickc_mem_tag_t tag, size_t size, bool bSuccess)
+{
+    mem_tag_stats_t *pxStats = &xTagStats[tag];
+
+    portENTER_CRITICAL(&xMemMux);
+
+    if (bSuccess)
+    {
+        pxStats->allocs++;
+        pxStats->live += size;
+        if (pxStats->live > pxStats->peak)
+        {
+            pxStats->peak = pxStats->live;
+        }
+    }
+    else
+    {
+        pxStats->failures++;
+    }
+
+    portEXIT_CRITICAL(&xMemMux);
+}
+
+/*-----------------------------------------------------------*/
+
+void *m5stickc_mem_malloc(m5stickc_mem_tag_t tag, size_t size, uint32_t caps)
+{
+#if M5CONFIG_MEM_TRACK
+    mem_header_t *pxHeader = NULL;
+
+    if (size <= MEM_SIZE_MAX)
+    {
+        pxHeader = heap_caps_malloc(sizeof(mem_header_t) + size, caps);
+    }
+
+    prvAccount(tag, size, pxHeader != NULL);
+
+    if (pxHeader == NULL)
+    {
+        return NULL;
+    }
+
+    pxHeader->size = (uint32_t)size;
+    pxHeader->tag = (uint32_t)tag;
+    pxHeader->check = prvHeaderCheck(pxHeader);
+
+    return pxHeader + 1;
+#else
+    return heap_caps_malloc(size, caps);
+#endif
+}
+
+void *m5stickc_mem_calloc(m5stickc_mem_tag_t tag, size_t n, size_t size, uint32_t caps)
+{
+    void *ptr = NULL;
+
+    if (n != 0 && size > SIZE_MAX / n)
+    {
+        return NULL;
+    }
+
+    ptr = m5stickc_mem_malloc(tag, n * size, caps);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, n * size);
+    }
+
+    return ptr;
+}
+
+void m5stickc_mem_free(void *ptr)
+{
+#if M5CONFIG_MEM_TRACK
+    mem_header_t *pxHeader;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    pxHeader = (mem_header_t *)ptr - 1;
+
+    if (pxHeader->tag >= M5STICKC_MEM_TAG_COUNT || pxHeader->check != prvHeaderCheck(pxHeader))
+    {
+        /* Every allocator routed here is paired with this free: the block was
+         * freed twice, or its header was overwritten. Where it starts is not
+         * known, so it is leaked rather than handed back to the heap. */
+        portENTER_CRITICAL(&xMemMux);
+        ulBadFrees++;
+        portEXIT_CRITICAL(&xMemMux);
+
+        ESP_LOGE(TAG, "m5stickc_mem_free: %p has no valid header, not freed", ptr);
+        return;
+    }
+
+    portENTER_CRITICAL(&xMemMux);
+    xTagStats[pxHeader->tag].live -= pxHeader->size;
+    portEXIT_CRITICAL(&xMemMux);
+
+    /* A stale header must not pass the check if the block is freed twice */
+    pxHeader->check = ~pxHeader->check;
+
+    heap_caps_free(pxHeader);
+#else
+    heap_caps_free(ptr);
+#endif
+}
+
+void m5stickc_mem_count(m5stickc_mem_tag_t tag)
+{
+    portENTER_CRITICAL(&xMemMux);
+    xTagStats[tag].allocs++;
+    portEXIT_CRITICAL(&xMemMux);
+}
+
+/*-----------------------------------------------------------*/
+
+void *m5stickc_mem_mqtt_malloc(size_t size)
+{
+    return m5stickc_mem_malloc(M5STICKC_MEM_MQTT, size, MEM_CAPS_DEFAULT);
+}
+
+void *m5stickc_mem_shadow_malloc(size_t size)
+{
+    return m5stickc_mem_malloc(M5STICKC_MEM_SHADOW, size, MEM_CAPS_DEFAULT);
+}
+
+void *m5stickc_mem_taskpool_malloc(size_t size)
+{
+    return m5stickc_mem_malloc(M5STICKC_MEM_TASKPOOL, size, MEM_CAPS_DEFAULT);
+}
+
+#ifdef CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+/* Internal memory only, as CONFIG_MBEDTLS_INTERNAL_MEM_ALLOC would */
+static void *prvMbedtlsCalloc(size_t n, size_t size)
+{
+    return m5stickc_mem_calloc(M5STICKC_MEM_MBEDTLS, n, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_mem_init(void)
+{
+#ifdef CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+    return mbedtls_platform_set_calloc_free(prvMbedtlsCalloc, m5stickc_mem_free) == 0 ? ESP_OK : ESP_FAIL;
+#else
+    ESP_LOGW(TAG, "m5stickc_mem_init: mbedTLS allocations are not tracked, CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC is not set");
+    return ESP_OK;
+#endif
+}
+
+#ifdef CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+/* C_Initialize() of PKCS#11 calls CRYPTO_ConfigureHeap() at every session, which
+ * would hand mbedTLS back to pvPortMalloc/vPortFree while tracked blocks are
+ * still live. The call is wrapped at link time (see the component.mk of
+ * amazon-freertos-common): the hooks of the tracker stay in place, so a block
+ * is always freed by the allocator that returned it. */
+void __wrap_CRYPTO_ConfigureHeap(void)
+{
+    m5stickc_mem_init();
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+static void prvSample(void)
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulElapsedMs = (xNow - xLastSample) * portTICK_PERIOD_MS;
+    mem_sample_t xSample;
+    size_t i;
+
+    xSample.free = heap_caps_get_free_size(MEM_CAPS_DEFAULT);
+    xSample.largest = heap_caps_get_largest_free_block(MEM_CAPS_DEFAULT);
+
+    portENTER_CRITICAL(&xMemMux);
+
+    for (i = 0; i < M5STICKC_MEM_TAG_COUNT; i++)
+    {
+        mem_tag_stats_t *pxStats = &xTagStats[i];
+
+        pxStats->rate = ulElapsedMs == 0 ? 0 : (uint32_t)(((uint64_t)(pxStats->allocs - pxStats->sampled) * 60000) / ulElapsedMs);
+        pxStats->sampled = pxStats->allocs;
+    }
+
+    xHistory[xHistoryNext] = xSample;
+    xHistoryNext = (xHistoryNext + 1) % M5CONFIG_MEM_HISTORY;
+    if (xHistoryCount < M5CONFIG_MEM_HISTORY)
+    {
+        xHistoryCount++;
+    }
+
+    if (xSample.largest < ulLargestMin)
+    {
+        ulLargestMin = xSample.largest;
+    }
+    if (prvFragmentation(xSample.free, xSample.largest) > ulFragmentationMax)
+    {
+        ulFragmentationMax = prvFragmentation(xSample.free, xSample.largest);
+    }
+
+    portEXIT_CRITICAL(&xMemMux);
+
+    xLastSample = xNow;
+    ulSamples++;
+}
+
+#if M5CONFIG_MEM_PUBLISH
+static esp_err_t prvPublish(void)
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    mem_tag_stats_t xStats[M5STICKC_MEM_TAG_COUNT];
+    mem_sample_t xSamples[M5CONFIG_MEM_HISTORY];
+    size_t i, count, first, length = 0;
+    uint32_t ulBadFree, ulFragmentation;
+    int status;
+
+    /* Nothing to publish on before a lab connects */
+    if (pMemStrID == NULL || m5stickc_lab_connection_thing_name() == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&xMemMux);
+    memcpy(xStats, xTagStats, sizeof(xStats));
+    memcpy(xSamples, xHistory, sizeof(xSamples));
+    count = xHistoryCount;
+    first = (xHistoryNext + M5CONFIG_MEM_HISTORY - xHistoryCount) % M5CONFIG_MEM_HISTORY;
+    ulBadFree = ulBadFrees;
+    ulFragmentation = ulFragmentationMax;
+    portEXIT_CRITICAL(&xMemMux);
+
+    status = snprintf(pMemHealthTopic, sizeof(pMemHealthTopic), MEM_HEALTH_TOPIC_FORMAT, pMemStrID);
+    if (status < 0 || status >= (int)sizeof(pMemHealthTopic))
+    {
+        return ESP_FAIL;
+    }
+
+    length = snprintf(pMemHealthPayload, sizeof(pMemHealthPayload),
+                      "{\"free\":%u,\"min\":%u,\"largest\":%u,\"frag_max\":%u,\"bad_free\":%u,\"tags\":{",
+                      heap_caps_get_free_size(MEM_CAPS_DEFAULT), heap_caps_get_minimum_free_size(MEM_CAPS_DEFAULT),
+                      heap_caps_get_largest_free_block(MEM_CAPS_DEFAULT), ulFragmentation, ulBadFree);
+
+    for (i = 0; i < M5STICKC_MEM_TAG_COUNT && length < sizeof(pMemHealthPayload); i++)
+    {
+        length += snprintf(pMemHealthPayload + length, sizeof(pMemHealthPayload) - length,
+                           "%s\"%s\":{\"live\":%u,\"peak\":%u,\"rate\":%u,\"fail\":%u}", i == 0 ? "" : ",",
+                           pTagNames[i], xStats[i].live, xStats[i].peak, xStats[i].rate, xStats[i].failures);
+    }
+
+    /* Oldest sample first, [free, largest] */
+    if (length < sizeof(pMemHealthPayload))
+    {
+        length += snprintf(pMemHealthPayload + length, sizeof(pMemHealthPayload) - length, "},\"history\":[");
+    }
+
+    for (i = 0; i < count && length < sizeof(pMemHealthPayload); i++)
+    {
+        const mem_sample_t *pxSample = &xSamples[(first + i) % M5CONFIG_MEM_HISTORY];
+
+        length += snprintf(pMemHealthPayload + length, sizeof(pMemHealthPayload) - length,
+                           "%s[%u,%u]", i == 0 ? "" : ",", pxSample->free, pxSample->largest);
+    }
+
+    if (length < sizeof(pMemHealthPayload))
+    {
+        length += snprintf(pMemHealthPayload + length, sizeof(pMemHealthPayload) - length, "]}");
+    }
+
+    if (length >= sizeof(pMemHealthPayload))
+    {
+        ESP_LOGE(TAG, "prvPublish: payload does not fit in %u bytes", sizeof(pMemHealthPayload));
+        return ESP_ERR_NO_MEM;
+    }
+
+    publishInfo.qos = IOT_MQTT_QOS_0;
+    publishInfo.pTopicName = pMemHealthTopic;
+    publishInfo.topicNameLength = (uint16_t)strlen(pMemHealthTopic);
+    publishInfo.pPayload = pMemHealthPayload;
+    publishInfo.payloadLength = length;
+
+    return m5stickc_lab_connection_publish(&publishInfo, NULL);
+}
+#endif
+
+static void prvMemJobCallback(void *context)
+{
+    prvSample();
+
+    if (M5CONFIG_MEM_REPORT_SAMPLES > 0 && ulSamples % M5CONFIG_MEM_REPORT_SAMPLES == 0)
+    {
+        m5stickc_mem_dump();
+#if M5CONFIG_MEM_PUBLISH
+        prvPublish();
+#endif
+    }
+}
+
+esp_err_t m5stickc_mem_monitor_start(const char *strID)
+{
+    if (xMemJob != NULL)
+    {
+        return ESP_OK;
+    }
+
+    pMemStrID = strID;
+
+    /* The first period gives the allocation rate since boot */
+    prvSample();
+
+    xMemJob = m5stickc_scheduler_add("mem", M5CONFIG_MEM_SAMPLE_PERIOD_MS, M5CONFIG_MEM_SAMPLE_SLACK_MS, true, prvMemJobCallback, NULL);
+
+    return xMemJob != NULL ? ESP_OK : ESP_FAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+void m5stickc_mem_dump(void)
+{
+    mem_tag_stats_t xStats[M5STICKC_MEM_TAG_COUNT];
+    uint32_t ulFree = heap_caps_get_free_size(MEM_CAPS_DEFAULT);
+    uint32_t ulLargest = heap_caps_get_largest_free_block(MEM_CAPS_DEFAULT);
+    uint32_t ulBadFree, ulSmallest, ulFragmentation;
+    size_t i;
+
+    portENTER_CRITICAL(&xMemMux);
+    memcpy(xStats, xTagStats, sizeof(xStats));
+    ulBadFree = ulBadFrees;
+    ulSmallest = ulLargestMin;
+    ulFragmentation = ulFragmentationMax;
+    portEXIT_CRITICAL(&xMemMux);
+
+    ESP_LOGI(TAG, "%-14s %10s %10s %10s %10s %6s", "Subsystem", "Live", "Peak", "Allocs", "Allocs/min", "Fail");
+
+    for (i = 0; i < M5STICKC_MEM_TAG_COUNT; i++)
+    {
+        ESP_LOGI(TAG, "%-14s %10u %10u %10u %10u %6u", pTagNames[i], xStats[i].live, xStats[i].peak,
+                 xStats[i].allocs, xStats[i].rate, xStats[i].failures);
+    }
+
+    ESP_LOGI(TAG, "Heap: %u free (%u minimum), largest block %u, fragmentation %u%%",
+             ulFree, heap_caps_get_minimum_free_size(MEM_CAPS_DEFAULT), ulLargest, prvFragmentation(ulFree, ulLargest));
+    ESP_LOGI(TAG, "Since boot: smallest largest block %u, worst fragmentation %u%%",
+             ulSmallest == UINT32_MAX ? ulLargest : ulSmallest, ulFragmentation);
+
+    if (ulBadFree > 0)
+    {
+        ESP_LOGE(TAG, "%u blocks freed twice or with a corrupted header, leaked", ulBadFree);
+    }
+}
+
+/*-----------------------------------------------------------*/
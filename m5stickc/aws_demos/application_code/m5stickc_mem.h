@@ -0,0 +1,70 @@
+/**
+ * @file m5stickc_mem.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_MEM_H_
+#define _M5STICKC_MEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief Subsystems the heap allocations are attributed to.
+ */
+typedef enum {
+    M5STICKC_MEM_USER_MESSAGE = 0,  /* getUserMessage, freed by the BLE numeric comparison */
+    M5STICKC_MEM_MBEDTLS,           /* mbedtls_calloc, TLS session and certificates */
+    M5STICKC_MEM_MQTT,              /* IotMqtt_Malloc*, connection, operations and packets */
+    M5STICKC_MEM_SHADOW,            /* AwsIotShadow_Malloc*, operations and documents */
+    M5STICKC_MEM_TASKPOOL,          /* IotTaskPool_Malloc*, jobs and timer events */
+    M5STICKC_MEM_TAG_COUNT
+} m5stickc_mem_tag_t;
+
+/**
+ * @brief Allocate with the heap capabilities caps, and attribute the block to tag.
+ *
+ * With M5CONFIG_MEM_TRACK, a header in front of the block records its size and
+ * tag, so the block must be released with m5stickc_mem_free, and only with it:
+ * a block without a valid header is logged and leaked, never freed. Blocks
+ * larger than 16 MB are refused.
+ */
+void *m5stickc_mem_malloc(m5stickc_mem_tag_t tag, size_t size, uint32_t caps);
+void *m5stickc_mem_calloc(m5stickc_mem_tag_t tag, size_t n, size_t size, uint32_t caps);
+void m5stickc_mem_free(void *ptr);
+
+/**
+ * @brief Count an allocation whose block is freed by code outside of the
+ * tracker. It adds to the allocation rate of tag, but never to its live bytes.
+ */
+void m5stickc_mem_count(m5stickc_mem_tag_t tag);
+
+/**
+ * @brief Route the mbedTLS allocations through the tracker (needs
+ * CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC). Called first thing in app_main, and in
+ * place of CRYPTO_ConfigureHeap() when PKCS#11 is initialized.
+ */
+esp_err_t m5stickc_mem_init(void);
+
+/**
+ * @brief Sample the heap every M5CONFIG_MEM_SAMPLE_PERIOD_MS on the scheduler,
+ * and report the snapshot on the serial console and on m5stickc/<strID>/health.
+ */
+esp_err_t m5stickc_mem_monitor_start(const char *strID);
+
+/**
+ * @brief Print the snapshot on the serial console: live bytes and allocation
+ * rate of each subsystem, free heap, largest free block and fragmentation.
+ */
+void m5stickc_mem_dump(void);
+
+/* Allocators of the Amazon FreeRTOS libraries, see iot_config.h */
+void *m5stickc_mem_mqtt_malloc(size_t size);
+void *m5stickc_mem_shadow_malloc(size_t size);
+void *m5stickc_mem_taskpool_malloc(size_t size);
+
+#endif /* ifndef _M5STICKC_MEM_H_ */
@@ -0,0 +1,111 @@
+/**
+ * @file m5stickc_pm.c
+ * @brief Power manager: DFS, automatic light sleep and Wi-Fi modem sleep.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_PM
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "sdkconfig.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+
+#include "esp_log.h"
+
+#include "m5stickc_pm.h"
+#include "m5stickc_scheduler.h"
+
+static const char *TAG = "m5stickc_pm";
+
+/*-----------------------------------------------------------*/
+
+static bool bPmConfigured = false;
+
+#if defined(CONFIG_PM_PROFILING) && M5CONFIG_PM_STATS_PERIOD_MS > 0
+static m5stickc_scheduler_job_t xPmStatsJob = NULL;
+
+static void prvPmStatsJob(void *context)
+{
+    m5stickc_pm_log_stats();
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_pm_init(void)
+{
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    esp_err_t res = ESP_FAIL;
+
+    esp_pm_config_esp32_t xPmConfig = {
+        .max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = M5CONFIG_PM_MIN_FREQ_MHZ,
+        .light_sleep_enable = M5CONFIG_PM_LIGHT_SLEEP
+    };
+
+    res = esp_pm_configure(&xPmConfig);
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "m5stickc_pm_init: esp_pm_configure failed: %d", res);
+        return res;
+    }
+
+    bPmConfigured = true;
+
+    ESP_LOGI(TAG, "m5stickc_pm_init: CPU %d-%d MHz, light sleep %s",
+             xPmConfig.min_freq_mhz, xPmConfig.max_freq_mhz, xPmConfig.light_sleep_enable ? "on" : "off");
+
+#if defined(CONFIG_PM_PROFILING) && M5CONFIG_PM_STATS_PERIOD_MS > 0
+    if (xPmStatsJob == NULL)
+    {
+        xPmStatsJob = m5stickc_scheduler_add("pm_stats", M5CONFIG_PM_STATS_PERIOD_MS, M5CONFIG_PM_STATS_PERIOD_MS / 4, true, prvPmStatsJob, NULL);
+    }
+#endif
+
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "m5stickc_pm_init: CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE are required");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t m5stickc_pm_network_up(void)
+{
+    esp_err_t res = ESP_OK;
+
+    if (!bPmConfigured)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* Light sleep is blocked for as long as the modem is kept awake */
+    res = esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+    ESP_LOGI(TAG, "m5stickc_pm_network_up: Wi-Fi modem sleep ... %s", res == ESP_OK ? "OK" : "NOK");
+
+    return res;
+}
+
+void m5stickc_pm_log_stats(void)
+{
+#ifdef CONFIG_PM_PROFILING
+    /* Prints the locks held and the time spent in each mode: SLEEP, APB_MIN, APB_MAX, CPU_MAX */
+    esp_pm_dump_locks(stdout);
+#else
+    ESP_LOGW(TAG, "m5stickc_pm_log_stats: enable CONFIG_PM_PROFILING to collect residency statistics");
+#endif
+}
+
+/*-----------------------------------------------------------*/
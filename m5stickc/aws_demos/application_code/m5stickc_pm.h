@@ -0,0 +1,34 @@
+/**
+ * @file m5stickc_pm.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_PM_H_
+#define _M5STICKC_PM_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Enable dynamic frequency scaling and automatic light sleep.
+ *
+ * Requires CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE, returns
+ * ESP_ERR_NOT_SUPPORTED otherwise.
+ */
+esp_err_t m5stickc_pm_init(void);
+
+/**
+ * @brief Put the Wi-Fi modem to sleep between DTIM beacons once the network is up.
+ *
+ * The station stays associated and the MQTT keep-alive timers still wake the
+ * CPU, so the connection survives while the CPU sleeps.
+ */
+esp_err_t m5stickc_pm_network_up(void);
+
+/**
+ * @brief Log the time spent in each power mode (needs CONFIG_PM_PROFILING).
+ */
+void m5stickc_pm_log_stats(void);
+
+#endif /* ifndef _M5STICKC_PM_H_ */
@@ -0,0 +1,267 @@
+/**
+ * @file m5stickc_provisioning.c
+ * @brief Key provisioning that is skipped when the credentials did not change.
+ *
+ * vDevModeKeyProvisioning re-imports the certificate and the private key on
+ * every boot, including every wakeup from deep sleep. The fingerprint of the
+ * credentials compiled in is saved in NVS with the time the provisioning took,
+ * so that the boots that skip it can report what was saved.
+ *
+ * The provisioning goes through xProvisionDevice, which reports failures, and
+ * the fingerprint is only saved when it succeeded. A boot only skips it if the
+ * certificate and the private key are also found in the PKCS#11 token.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_PROVISIONING
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Key provisioning includes. */
+#include "aws_clientcredential_keys.h"
+#include "aws_dev_mode_key_provisioning.h"
+#include "iot_pkcs11_config.h"
+#include "iot_pkcs11.h"
+
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "m5stickc_provisioning.h"
+
+static const char *TAG = "m5stickc_provisioning";
+
+/*-----------------------------------------------------------*/
+
+#define PROVISIONING_NVS_NAMESPACE      "m5stickc"
+#define PROVISIONING_NVS_KEY_HASH       "prov_hash"
+#define PROVISIONING_NVS_KEY_TIME       "prov_us"
+#define PROVISIONING_HASH_LENGTH        ( 32 )
+
+/*-----------------------------------------------------------*/
+
+static size_t prvHashCredential(mbedtls_sha256_context *pxContext, const char *pCredential)
+{
+    uint32_t length = pCredential ? (uint32_t)strlen(pCredential) : 0;
+
+    /* The length goes in first, so that moving bytes from one credential to the next changes the hash */
+    mbedtls_sha256_update_ret(pxContext, (const unsigned char *)&length, sizeof(length));
+
+    if (length > 0)
+    {
+        mbedtls_sha256_update_ret(pxContext, (const unsigned char *)pCredential, length);
+    }
+
+    return length;
+}
+
+static size_t prvFingerprint(uint8_t pHash[PROVISIONING_HASH_LENGTH])
+{
+    mbedtls_sha256_context xContext;
+    size_t length = 0;
+
+    mbedtls_sha256_init(&xContext);
+    mbedtls_sha256_starts_ret(&xContext, 0);
+
+    length += prvHashCredential(&xContext, keyCLIENT_CERTIFICATE_PEM);
+    length += prvHashCredential(&xContext, keyCLIENT_PRIVATE_KEY_PEM);
+    length += prvHashCredential(&xContext, keyJITR_DEVICE_CERTIFICATE_AUTHORITY_PEM);
+
+    mbedtls_sha256_finish_ret(&xContext, pHash);
+    mbedtls_sha256_free(&xContext);
+
+    return length;
+}
+
+static uint32_t prvCredentialLength(const char *pCredential)
+{
+    /* The PEM parser wants the terminating NUL */
+    return pCredential ? (uint32_t)strlen(pCredential) + 1 : 0;
+}
+
+/**
+ * @brief Same as vDevModeKeyProvisioning, with the result.
+ */
+static CK_RV prvProvision(void)
+{
+    ProvisioningParams_t xParams;
+    CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+    CK_SESSION_HANDLE xSession = CK_INVALID_HANDLE;
+    CK_RV xResult;
+
+    xParams.pucClientPrivateKey = (uint8_t *)keyCLIENT_PRIVATE_KEY_PEM;
+    xParams.ulClientPrivateKeyLength = prvCredentialLength(keyCLIENT_PRIVATE_KEY_PEM);
+    xParams.pucClientCertificate = (uint8_t *)keyCLIENT_CERTIFICATE_PEM;
+    xParams.ulClientCertificateLength = prvCredentialLength(keyCLIENT_CERTIFICATE_PEM);
+    xParams.pucJITPCertificate = (uint8_t *)keyJITR_DEVICE_CERTIFICATE_AUTHORITY_PEM;
+    xParams.ulJITPCertificateLength = prvCredentialLength(keyJITR_DEVICE_CERTIFICATE_AUTHORITY_PEM);
+
+    xResult = C_GetFunctionList(&pxFunctionList);
+    if (xResult == CKR_OK)
+    {
+        xResult = xInitializePkcs11Session(&xSession);
+    }
+
+    if (xResult == CKR_OK)
+    {
+        xResult = xProvisionDevice(xSession, &xParams);
+        pxFunctionList->C_CloseSession(xSession);
+    }
+
+    return xResult;
+}
+
+#if M5CONFIG_PROVISIONING_SKIP
+/**
+ * @brief Whether the TLS certificate and private key are in the token. An
+ * erased or corrupted partition has to be provisioned again.
+ */
+static bool prvObjectsPresent(void)
+{
+    CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+    CK_SESSION_HANDLE xSession = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE xCertificate = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE xPrivateKey = CK_INVALID_HANDLE;
+    CK_RV xResult;
+
+    xResult = C_GetFunctionList(&pxFunctionList);
+    if (xResult == CKR_OK)
+    {
+        xResult = xInitializePkcs11Session(&xSession);
+    }
+
+    if (xResult != CKR_OK)
+    {
+        ESP_LOGW(TAG, "prvObjectsPresent: no PKCS#11 session: 0x%x", (unsigned)xResult);
+        return false;
+    }
+
+    xResult = xFindObjectWithLabelAndClass(xSession, pkcs11configLABEL_DEVICE_CERTIFICATE_FOR_TLS,
+                                           CKO_CERTIFICATE, &xCertificate);
+    if (xResult == CKR_OK)
+    {
+        xResult = xFindObjectWithLabelAndClass(xSession, pkcs11configLABEL_DEVICE_PRIVATE_KEY_FOR_TLS,
+                                               CKO_PRIVATE_KEY, &xPrivateKey);
+    }
+
+    pxFunctionList->C_CloseSession(xSession);
+
+    return xResult == CKR_OK && xCertificate != CK_INVALID_HANDLE && xPrivateKey != CK_INVALID_HANDLE;
+}
+
+static bool prvAlreadyProvisioned(const uint8_t pHash[PROVISIONING_HASH_LENGTH], uint32_t *pulTime)
+{
+    nvs_handle handle;
+    uint8_t pSaved[PROVISIONING_HASH_LENGTH] = { 0 };
+    size_t length = sizeof(pSaved);
+    bool bSame = false;
+
+    if (nvs_open(PROVISIONING_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    if (nvs_get_blob(handle, PROVISIONING_NVS_KEY_HASH, pSaved, &length) == ESP_OK &&
+        length == sizeof(pSaved) && memcmp(pSaved, pHash, sizeof(pSaved)) == 0)
+    {
+        bSame = true;
+
+        if (nvs_get_u32(handle, PROVISIONING_NVS_KEY_TIME, pulTime) != ESP_OK)
+        {
+            *pulTime = 0;
+        }
+    }
+
+    nvs_close(handle);
+
+    return bSame;
+}
+
+static void prvSaveFingerprint(const uint8_t pHash[PROVISIONING_HASH_LENGTH], uint32_t ulTime)
+{
+    nvs_handle handle;
+    esp_err_t res = nvs_open(PROVISIONING_NVS_NAMESPACE, NVS_READWRITE, &handle);
+
+    if (res == ESP_OK)
+    {
+        res = nvs_set_blob(handle, PROVISIONING_NVS_KEY_HASH, pHash, PROVISIONING_HASH_LENGTH);
+        if (res == ESP_OK)
+        {
+            res = nvs_set_u32(handle, PROVISIONING_NVS_KEY_TIME, ulTime);
+        }
+        if (res == ESP_OK)
+        {
+            res = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (res != ESP_OK)
+    {
+        ESP_LOGW(TAG, "prvSaveFingerprint: failed, the credentials will be provisioned again: %d", res);
+    }
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_provisioning_run(void)
+{
+    uint8_t pHash[PROVISIONING_HASH_LENGTH];
+    uint32_t ulTime = 0;
+    int64_t start;
+    size_t length;
+    CK_RV xResult;
+
+    length = prvFingerprint(pHash);
+
+#if M5CONFIG_PROVISIONING_SKIP
+    if (prvAlreadyProvisioned(pHash, &ulTime))
+    {
+        if (prvObjectsPresent())
+        {
+            ESP_LOGI(TAG, "Credentials unchanged, provisioning skipped: saved %u ms and %u bytes of flash writes",
+                     ulTime / 1000, length);
+            return ESP_OK;
+        }
+
+        ESP_LOGW(TAG, "Credentials unchanged but missing from the token, provisioning again");
+    }
+#endif
+
+    start = esp_timer_get_time();
+
+    /* A simple example to demonstrate key and certificate provisioning in
+     * microcontroller flash using PKCS#11 interface. This should be replaced
+     * by production ready key provisioning mechanism. */
+    xResult = prvProvision();
+
+    ulTime = (uint32_t)(esp_timer_get_time() - start);
+
+    if (xResult != CKR_OK)
+    {
+        ESP_LOGE(TAG, "Provisioning failed: 0x%x, it is retried at the next boot", (unsigned)xResult);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Credentials provisioned in %u ms (%u bytes)", ulTime / 1000, length);
+
+#if M5CONFIG_PROVISIONING_SKIP
+    prvSaveFingerprint(pHash, ulTime);
+#endif
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,26 @@
+/**
+ * @file m5stickc_provisioning.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_PROVISIONING_H_
+#define _M5STICKC_PROVISIONING_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Provision the credentials of aws_clientcredential_keys.h through PKCS#11,
+ * unless the same credentials were already provisioned.
+ *
+ * A SHA-256 of the credentials is saved in NVS after each successful
+ * provisioning, and compared at the next boot. The provisioning is only
+ * skipped if the certificate and the private key are in the PKCS#11 token too.
+ * NVS has to be initialized first.
+ *
+ * @return ESP_FAIL if the credentials could not be imported.
+ */
+esp_err_t m5stickc_provisioning_run(void);
+
+#endif /* ifndef _M5STICKC_PROVISIONING_H_ */
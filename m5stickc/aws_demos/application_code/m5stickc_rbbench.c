@@ -0,0 +1,1155 @@
+/**
+ * @file m5stickc_rbbench.c
+ * @brief Throughput of the ring buffers of freertos/ringbuf.h, measured on the device.
+ *
+ * Every buffer type runs with every item size of xItemSizes, fed by 1 up to
+ * M5CONFIG_RBBENCH_PRODUCERS_MAX producer tasks and drained by the benchmark
+ * task. An item carries the index of its producer and a sequence number, and
+ * is filled with a pattern derived from them: the consumer checks the order
+ * and the content of every item, the ones that wrapped around the end of the
+ * buffer (split items, dummy data) included. The byte buffers do not keep the
+ * items apart, their stream is only checked with a single producer.
+ *
+ * The producers run at the priority of the benchmark task, and take turns on
+ * the core whenever the buffer is full: the more producers, the more blocked
+ * writers. The rest of the demo keeps running, a busy device reads lower.
+ *
+ * The NOSPLIT and BYTEBUF runs with a single producer are repeated on the
+ * lock-free buffers of xRingbufferCreateSPSC. The NOSPLIT runs are repeated
+ * once more with the producers filling the items in place, between
+ * xRingbufferSendAcquire and xRingbufferSendComplete (modes lk-acq and sp-acq).
+ * The NOSPLIT and ALLOWSPLIT runs are also repeated with the consumer draining
+ * up to RBBENCH_BATCH items per uxRingbufferReceiveMultiple (mode lk-bat).
+ * The NOSPLIT runs are repeated a last time on a broadcast buffer of
+ * xRingbufferCreateBroadcast (mode bcast): the benchmark task copies the items
+ * out through a RINGBUF_READER_BLOCK reader, and a RINGBUF_READER_DROP reader
+ * that never reads during the run must have every item either still in the
+ * buffer or counted as dropped.
+ *
+ * A second table gives the CPU cycles of a single send and of a single receive
+ * (with its return), measured in the benchmark task alone: the buffer never
+ * blocks, and the cycles are those of the calls themselves.
+ *
+ * A last table counts the wakeups of blocked tasks under contention: the
+ * M5CONFIG_RBBENCH_PRODUCERS_MAX producers alternate between two priorities and
+ * send items of 8, 60 and 250 bytes in turn, drained by RBBENCH_CONSUMERS
+ * consumer tasks. Each run is made twice. Protocol "sem" emulates the binary
+ * semaphores the ring buffers used to share between all their senders (and
+ * all their receivers) on top of calls that never block: whoever is woken
+ * tries again, and passes the semaphore on while there is room (or items)
+ * left. Protocol "waiters" blocks in the ring buffer, which only wakes a task
+ * once its item fits (or an item is there for it). A wakeup is spurious when
+ * the task woken finds no room or no item after all, and has to wait again.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_RBBENCH
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
+
+#include "m5stickc_rbbench.h"
+#include "m5stickc_stack.h"
+
+static const char *TAG = "m5stickc_rbbench";
+
+/*-----------------------------------------------------------*/
+
+#define RBBENCH_TASK_NAME           "rbbench"
+#define RBBENCH_TASK_STACK_SIZE     ( 3072 )
+#define RBBENCH_TASK_PRIORITY       ( tskIDLE_PRIORITY + 2 )
+
+#define RBBENCH_PRODUCER_NAME       "rbprod"
+#define RBBENCH_PRODUCER_STACK_SIZE ( 2048 )
+
+#define RBBENCH_CONSUMER_NAME       "rbcons"
+#define RBBENCH_CONSUMER_STACK_SIZE ( 2048 )
+
+/* Consumer tasks of the contention runs */
+#define RBBENCH_CONSUMERS           ( 2 )
+
+/* A send or a receive that waits longer than this is a stalled run */
+#define RBBENCH_TIMEOUT_MS          ( 1000 )
+
+/* Producer index and sequence number in front of the NOSPLIT and ALLOWSPLIT items */
+#define RBBENCH_ITEM_HEADER         ( 5 )
+#define RBBENCH_ITEM_MAX            ( 1000 )
+
+/* Items received at once by the batch mode */
+#define RBBENCH_BATCH               ( 16 )
+
+/* Sizes of the items of the contention runs, in turn */
+#define RBBENCH_MIXED_SIZES         ( 3 )
+#define RBBENCH_MIXED_MAX           ( 250 )
+
+typedef enum {
+    RBBENCH_MODE_LOCKED = 0,    /* xRingbufferCreate */
+    RBBENCH_MODE_SPSC,          /* xRingbufferCreateSPSC, single producer only */
+    RBBENCH_MODE_LOCKED_ACQUIRE,    /* xRingbufferCreate, items written in place, NOSPLIT only */
+    RBBENCH_MODE_SPSC_ACQUIRE,      /* xRingbufferCreateSPSC, items written in place, NOSPLIT only */
+    RBBENCH_MODE_LOCKED_BATCH,      /* xRingbufferCreate, items received in batches, not BYTEBUF */
+    RBBENCH_MODE_BROADCAST,         /* xRingbufferCreateBroadcast, items copied out by a reader, NOSPLIT only */
+    RBBENCH_MODE_COUNT
+} rbbench_mode_t;
+
+typedef struct {
+    RingbufHandle_t xRingbuf;
+    ringbuf_type_t xType;
+    size_t xItemSize;
+    uint32_t ulItems;           /* Items to send */
+    uint32_t ulFailed;          /* Sends that timed out */
+    uint8_t ucId;
+    bool bAcquire;              /* xRingbufferSendAcquire instead of xRingbufferSend */
+} rbbench_producer_t;
+
+/* Producer or consumer task of a contention run */
+typedef struct {
+    RingbufHandle_t xRingbuf;
+    ringbuf_type_t xType;
+    uint32_t ulItems;           /* Producers: items to send. Consumers: items received */
+    uint32_t ulWakeups;         /* Protocol "sem" only, counted by the task */
+    uint32_t ulSpurious;
+    uint32_t ulErrors;
+    uint8_t ucId;               /* Index among the producers, or among the consumers */
+    uint8_t ucProducers;
+    bool bSemaphores;           /* Protocol "sem" instead of the blocking calls */
+} rbbench_contender_t;
+
+typedef struct {
+    uint32_t ulSend;            /* Average cycles per send */
+    uint32_t ulReceive;         /* Average cycles per receive and return */
+    uint32_t ulErrors;
+    bool bSkipped;
+} rbbench_cycles_t;
+
+typedef struct {
+    uint32_t ulItems;
+    uint32_t ulBytes;
+    uint32_t ulErrors;
+    int64_t llElapsed;          /* us */
+    bool bSkipped;              /* Item larger than the buffer can hold */
+} rbbench_result_t;
+
+typedef struct {
+    uint32_t ulItems;
+    uint32_t ulWakeups;
+    uint32_t ulSpurious;
+    uint32_t ulErrors;
+    int64_t llElapsed;          /* us */
+} rbbench_contention_t;
+
+/* Not multiples of the header and alignment sizes, so that the items wrap around at every offset */
+static const size_t xItemSizes[] = { 8, 60, 250, RBBENCH_ITEM_MAX };
+
+static const size_t xMixedSizes[RBBENCH_MIXED_SIZES] = { 8, 60, RBBENCH_MIXED_MAX };
+
+static const char *pTypeNames[] = { "NOSPLIT", "ALLOWSPLIT", "BYTEBUF" };
+static const char *pModeNames[] = { "locked", "spsc", "lk-acq", "sp-acq", "lk-bat", "bcast" };
+
+static rbbench_producer_t xProducers[M5CONFIG_RBBENCH_PRODUCERS_MAX];
+static uint8_t pItems[M5CONFIG_RBBENCH_PRODUCERS_MAX][RBBENCH_ITEM_MAX];
+static uint8_t pScratch[RBBENCH_ITEM_MAX];
+static uint32_t ulNextSeq[M5CONFIG_RBBENCH_PRODUCERS_MAX];
+static RingbufItem_t xBatch[RBBENCH_BATCH];
+
+static rbbench_contender_t xContenders[M5CONFIG_RBBENCH_PRODUCERS_MAX + RBBENCH_CONSUMERS];
+static uint8_t pJoined[RBBENCH_CONSUMERS][RBBENCH_MIXED_MAX];
+
+/* Shared by all the senders and by all the receivers of the protocol "sem" */
+static SemaphoreHandle_t xSpaceSem = NULL;
+static SemaphoreHandle_t xItemSem = NULL;
+
+/* Given by every producer and consumer task when it ends */
+static SemaphoreHandle_t xTasksDone = NULL;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Fill an item. The byte buffer items continue the stream pattern of
+ * their producer, the other items start with the producer and the sequence.
+ */
+static void prvFill(uint8_t *pItem, ringbuf_type_t xType, size_t xItemSize, uint8_t ucId, uint32_t ulSeq)
+{
+    size_t i;
+
+    if (xType == RINGBUF_TYPE_BYTEBUF)
+    {
+        for (i = 0; i < xItemSize; i++)
+        {
+            pItem[i] = (uint8_t)((ulSeq * xItemSize + i) % 251);
+        }
+        return;
+    }
+
+    pItem[0] = ucId;
+    memcpy(pItem + 1, &ulSeq, sizeof(ulSeq));
+
+    for (i = RBBENCH_ITEM_HEADER; i < xItemSize; i++)
+    {
+        pItem[i] = (uint8_t)(ulSeq + i);
+    }
+}
+
+static bool prvCheckPattern(const uint8_t *pItem, size_t xItemSize, uint32_t ulSeq)
+{
+    size_t i;
+
+    for (i = RBBENCH_ITEM_HEADER; i < xItemSize; i++)
+    {
+        if (pItem[i] != (uint8_t)(ulSeq + i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool prvCheckItem(const uint8_t *pItem, size_t xLength, size_t xItemSize, uint8_t ucProducers)
+{
+    uint32_t ulSeq;
+
+    if (xLength != xItemSize || pItem[0] >= ucProducers)
+    {
+        return false;
+    }
+
+    memcpy(&ulSeq, pItem + 1, sizeof(ulSeq));
+
+    if (ulSeq != ulNextSeq[pItem[0]])
+    {
+        return false;
+    }
+    ulNextSeq[pItem[0]]++;
+
+    return prvCheckPattern(pItem, xItemSize, ulSeq);
+}
+
+/**
+ * @brief Check an item of a contention run. The consumers share the items of
+ * every producer, only the size and the content can be checked.
+ */
+static bool prvCheckMixed(const uint8_t *pItem, size_t xLength, uint8_t ucProducers)
+{
+    uint32_t ulSeq;
+
+    if (xLength < RBBENCH_ITEM_HEADER || pItem[0] >= ucProducers)
+    {
+        return false;
+    }
+
+    memcpy(&ulSeq, pItem + 1, sizeof(ulSeq));
+
+    if (xLength != xMixedSizes[ulSeq % RBBENCH_MIXED_SIZES])
+    {
+        return false;
+    }
+
+    return prvCheckPattern(pItem, xLength, ulSeq);
+}
+
+static bool prvCheckStream(const uint8_t *pData, size_t xLength, uint32_t *pulOffset)
+{
+    size_t i;
+
+    for (i = 0; i < xLength; i++)
+    {
+        if (pData[i] != (uint8_t)((*pulOffset + i) % 251))
+        {
+            return false;
+        }
+    }
+
+    *pulOffset += xLength;
+
+    return true;
+}
+
+static void prvProducerTask(void *pvParameters)
+{
+    rbbench_producer_t *pxProducer = (rbbench_producer_t *)pvParameters;
+    TickType_t xTimeout = pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS);
+    uint8_t *pItem = pItems[pxProducer->ucId];
+    uint32_t i;
+
+    for (i = 0; i < pxProducer->ulItems; i++)
+    {
+        if (pxProducer->bAcquire)
+        {
+            if (xRingbufferSendAcquire(pxProducer->xRingbuf, (void **)&pItem, pxProducer->xItemSize, xTimeout) != pdTRUE)
+            {
+                pxProducer->ulFailed = pxProducer->ulItems - i;
+                break;
+            }
+
+            prvFill(pItem, pxProducer->xType, pxProducer->xItemSize, pxProducer->ucId, i);
+            xRingbufferSendComplete(pxProducer->xRingbuf, pItem);
+            continue;
+        }
+
+        prvFill(pItem, pxProducer->xType, pxProducer->xItemSize, pxProducer->ucId, i);
+
+        if (xRingbufferSend(pxProducer->xRingbuf, pItem, pxProducer->xItemSize, xTimeout) != pdTRUE)
+        {
+            pxProducer->ulFailed = pxProducer->ulItems - i;
+            break;
+        }
+    }
+
+    xSemaphoreGive(xTasksDone);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Check an item of a NOSPLIT or ALLOWSPLIT buffer, the parts of a split item once joined.
+ */
+static bool prvCheckParts(const uint8_t *pHead, size_t xHeadSize, const uint8_t *pTail, size_t xTailSize,
+                          size_t xItemSize, uint8_t ucProducers)
+{
+    if (pTail == NULL)
+    {
+        return prvCheckItem(pHead, xHeadSize, xItemSize, ucProducers);
+    }
+
+    if (xHeadSize + xTailSize > sizeof(pScratch))
+    {
+        return false;
+    }
+
+    memcpy(pScratch, pHead, xHeadSize);
+    memcpy(pScratch + xHeadSize, pTail, xTailSize);
+
+    return prvCheckItem(pScratch, xHeadSize + xTailSize, xItemSize, ucProducers);
+}
+
+/**
+ * @brief Receive up to RBBENCH_BATCH items at once and check them.
+ *
+ * @return The number of bytes received, 0 when the buffer stayed empty.
+ */
+static size_t prvConsumeBatch(RingbufHandle_t xRingbuf, size_t xItemSize, uint8_t ucProducers, rbbench_result_t *pxResult)
+{
+    UBaseType_t uxCount, i;
+    size_t xReceived = 0;
+
+    uxCount = uxRingbufferReceiveMultiple(xRingbuf, xBatch, RBBENCH_BATCH, pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS));
+
+    for (i = 0; i < uxCount; i++)
+    {
+        if (!prvCheckParts(xBatch[i].pvHeadItem, xBatch[i].xHeadItemSize, xBatch[i].pvTailItem, xBatch[i].xTailItemSize,
+                           xItemSize, ucProducers))
+        {
+            pxResult->ulErrors++;
+        }
+        xReceived += xBatch[i].xHeadItemSize + xBatch[i].xTailItemSize;
+    }
+
+    vRingbufferReturnMultiple(xRingbuf, xBatch, uxCount);
+
+    return xReceived;
+}
+
+/**
+ * @brief Copy out one item of a broadcast buffer and check it.
+ *
+ * @return The number of bytes received, 0 when the buffer stayed empty.
+ */
+static size_t prvConsumeReader(RingbufReaderHandle_t xReader, size_t xItemSize, uint8_t ucProducers, rbbench_result_t *pxResult)
+{
+    size_t xLength;
+
+    if (xRingbufferReceiveReader(xReader, pScratch, sizeof(pScratch), &xLength, pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS)) != pdTRUE)
+    {
+        return 0;
+    }
+
+    if (!prvCheckItem(pScratch, xLength, xItemSize, ucProducers))
+    {
+        pxResult->ulErrors++;
+    }
+
+    return xLength;
+}
+
+/**
+ * @brief Receive one item, or one contiguous piece of the byte buffer, and check it.
+ *
+ * @return The number of bytes received, 0 when the buffer stayed empty.
+ */
+static size_t prvConsume(RingbufHandle_t xRingbuf, ringbuf_type_t xType, size_t xItemSize, uint8_t ucProducers,
+                         uint32_t *pulOffset, rbbench_result_t *pxResult)
+{
+    TickType_t xTimeout = pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS);
+    uint8_t *pHead = NULL;
+    uint8_t *pTail = NULL;
+    size_t xHeadSize = 0;
+    size_t xTailSize = 0;
+    bool bValid = true;
+
+    if (xType == RINGBUF_TYPE_ALLOWSPLIT)
+    {
+        if (xRingbufferReceiveSplit(xRingbuf, (void **)&pHead, (void **)&pTail, &xHeadSize, &xTailSize, xTimeout) != pdTRUE)
+        {
+            return 0;
+        }
+
+        bValid = prvCheckParts(pHead, xHeadSize, pTail, xTailSize, xItemSize, ucProducers);
+        if (pTail != NULL)
+        {
+            vRingbufferReturnItem(xRingbuf, pTail);
+        }
+        vRingbufferReturnItem(xRingbuf, pHead);
+    }
+    else
+    {
+        pHead = xRingbufferReceive(xRingbuf, &xHeadSize, xTimeout);
+        if (pHead == NULL)
+        {
+            return 0;
+        }
+
+        if (xType == RINGBUF_TYPE_NOSPLIT)
+        {
+            bValid = prvCheckItem(pHead, xHeadSize, xItemSize, ucProducers);
+        }
+        else if (ucProducers == 1)
+        {
+            bValid = prvCheckStream(pHead, xHeadSize, pulOffset);
+        }
+        vRingbufferReturnItem(xRingbuf, pHead);
+    }
+
+    if (!bValid)
+    {
+        pxResult->ulErrors++;
+    }
+
+    return xHeadSize + xTailSize;
+}
+
+static void prvRun(rbbench_mode_t xMode, ringbuf_type_t xType, size_t xItemSize, uint8_t ucProducers, rbbench_result_t *pxResult)
+{
+    uint32_t ulItemsEach = M5CONFIG_RBBENCH_ITEMS / ucProducers;
+    uint32_t ulBytesTotal = ulItemsEach * ucProducers * xItemSize;
+    uint32_t ulOffset = 0;
+    RingbufHandle_t xRingbuf;
+    RingbufReaderHandle_t xReader = NULL;
+    RingbufReaderHandle_t xIdleReader = NULL;
+    RingbufStats_t xStats;
+    size_t xReceived;
+    uint32_t ulIdleItems = 0;
+    int64_t llStart;
+    uint8_t i;
+
+    memset(pxResult, 0, sizeof(*pxResult));
+    memset(ulNextSeq, 0, sizeof(ulNextSeq));
+
+    if (xMode == RBBENCH_MODE_SPSC || xMode == RBBENCH_MODE_SPSC_ACQUIRE)
+    {
+        xRingbuf = xRingbufferCreateSPSC(M5CONFIG_RBBENCH_BUFFER_SIZE, xType);
+    }
+    else if (xMode == RBBENCH_MODE_BROADCAST)
+    {
+        xRingbuf = xRingbufferCreateBroadcast(M5CONFIG_RBBENCH_BUFFER_SIZE, 2);
+        if (xRingbuf != NULL)
+        {
+            xReader = xRingbufferAddReader(xRingbuf, RINGBUF_READER_BLOCK);
+            xIdleReader = xRingbufferAddReader(xRingbuf, RINGBUF_READER_DROP);
+        }
+    }
+    else
+    {
+        xRingbuf = xRingbufferCreate(M5CONFIG_RBBENCH_BUFFER_SIZE, xType);
+    }
+    if (xRingbuf == NULL)
+    {
+        pxResult->ulErrors++;
+        return;
+    }
+    vRingbufferSetName(xRingbuf, "rbbench");
+
+    if (xRingbufferGetMaxItemSize(xRingbuf) < xItemSize)
+    {
+        pxResult->bSkipped = true;
+        vRingbufferDelete(xRingbuf);
+        return;
+    }
+
+    llStart = esp_timer_get_time();
+
+    for (i = 0; i < ucProducers; i++)
+    {
+        xProducers[i].xRingbuf = xRingbuf;
+        xProducers[i].xType = xType;
+        xProducers[i].xItemSize = xItemSize;
+        xProducers[i].ulItems = ulItemsEach;
+        xProducers[i].ulFailed = 0;
+        xProducers[i].ucId = i;
+        xProducers[i].bAcquire = xMode == RBBENCH_MODE_LOCKED_ACQUIRE || xMode == RBBENCH_MODE_SPSC_ACQUIRE;
+
+        if (xTaskCreate(prvProducerTask, RBBENCH_PRODUCER_NAME, RBBENCH_PRODUCER_STACK_SIZE, &xProducers[i], RBBENCH_TASK_PRIORITY, NULL) != pdPASS)
+        {
+            /* Counted as failed, and as done */
+            xProducers[i].ulFailed = ulItemsEach;
+            xSemaphoreGive(xTasksDone);
+        }
+    }
+
+    while (pxResult->ulBytes < ulBytesTotal)
+    {
+        if (xMode == RBBENCH_MODE_LOCKED_BATCH)
+        {
+            xReceived = prvConsumeBatch(xRingbuf, xItemSize, ucProducers, pxResult);
+        }
+        else if (xMode == RBBENCH_MODE_BROADCAST)
+        {
+            xReceived = prvConsumeReader(xReader, xItemSize, ucProducers, pxResult);
+        }
+        else
+        {
+            xReceived = prvConsume(xRingbuf, xType, xItemSize, ucProducers, &ulOffset, pxResult);
+        }
+        if (xReceived == 0)
+        {
+            break;
+        }
+        pxResult->ulBytes += xReceived;
+    }
+
+    pxResult->llElapsed = esp_timer_get_time() - llStart;
+    pxResult->ulItems = pxResult->ulBytes / xItemSize;
+
+    for (i = 0; i < ucProducers; i++)
+    {
+        /* The producers stop on their own after a timeout */
+        xSemaphoreTake(xTasksDone, pdMS_TO_TICKS(2 * RBBENCH_TIMEOUT_MS));
+        pxResult->ulErrors += xProducers[i].ulFailed;
+    }
+
+    if (xMode == RBBENCH_MODE_BROADCAST)
+    {
+        /* The idle reader has the newest items left, the older ones were dropped for it */
+        while (xRingbufferReceiveReader(xIdleReader, pScratch, sizeof(pScratch), &xReceived, 0) == pdTRUE)
+        {
+            ulIdleItems++;
+        }
+        if (ulIdleItems + uxRingbufferGetReaderDropped(xIdleReader) != ulItemsEach * ucProducers)
+        {
+            pxResult->ulErrors++;
+        }
+    }
+
+    vRingbufferGetStats(xRingbuf, &xStats);
+
+    if (pxResult->ulBytes != ulBytesTotal)
+    {
+        pxResult->ulErrors++;
+    }
+    else if (xStats.uxBytesSent != ulBytesTotal || xStats.xPeakUsed > xStats.xSize)
+    {
+        /* Everything sent was received, the statistics must agree */
+        pxResult->ulErrors++;
+    }
+
+    vRingbufferDelete(xRingbuf);
+}
+
+/**
+ * @brief Send an item of a contention run, with the protocol of the task.
+ */
+static bool prvContendSend(rbbench_contender_t *pxTask, const uint8_t *pItem, size_t xItemSize)
+{
+    TickType_t xTimeout = pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS);
+    bool bWoken = false;
+
+    if (!pxTask->bSemaphores)
+    {
+        return xRingbufferSend(pxTask->xRingbuf, pItem, xItemSize, xTimeout) == pdTRUE;
+    }
+
+    while (xRingbufferSend(pxTask->xRingbuf, pItem, xItemSize, 0) != pdTRUE)
+    {
+        if (bWoken)
+        {
+            pxTask->ulSpurious++;
+        }
+        if (xSemaphoreTake(xSpaceSem, xTimeout) != pdTRUE)
+        {
+            return false;
+        }
+        pxTask->ulWakeups++;
+        bWoken = true;
+    }
+
+    if (xRingbufferGetCurFreeSize(pxTask->xRingbuf) > 0)
+    {
+        xSemaphoreGive(xSpaceSem);
+    }
+    xSemaphoreGive(xItemSem);
+
+    return true;
+}
+
+static bool prvReceiveParts(RingbufHandle_t xRingbuf, ringbuf_type_t xType, TickType_t xTicksToWait,
+                            uint8_t **ppHead, size_t *pxHeadSize, uint8_t **ppTail, size_t *pxTailSize)
+{
+    *ppTail = NULL;
+    *pxTailSize = 0;
+
+    if (xType == RINGBUF_TYPE_ALLOWSPLIT)
+    {
+        return xRingbufferReceiveSplit(xRingbuf, (void **)ppHead, (void **)ppTail, pxHeadSize, pxTailSize, xTicksToWait) == pdTRUE;
+    }
+
+    *ppHead = xRingbufferReceive(xRingbuf, pxHeadSize, xTicksToWait);
+
+    return *ppHead != NULL;
+}
+
+/**
+ * @brief Receive an item of a contention run, with the protocol of the task.
+ */
+static bool prvContendReceive(rbbench_contender_t *pxTask, uint8_t **ppHead, size_t *pxHeadSize, uint8_t **ppTail, size_t *pxTailSize)
+{
+    TickType_t xTimeout = pdMS_TO_TICKS(RBBENCH_TIMEOUT_MS);
+    UBaseType_t uxWaiting;
+    bool bWoken = false;
+
+    if (!pxTask->bSemaphores)
+    {
+        return prvReceiveParts(pxTask->xRingbuf, pxTask->xType, xTimeout, ppHead, pxHeadSize, ppTail, pxTailSize);
+    }
+
+    while (!prvReceiveParts(pxTask->xRingbuf, pxTask->xType, 0, ppHead, pxHeadSize, ppTail, pxTailSize))
+    {
+        if (bWoken)
+        {
+            pxTask->ulSpurious++;
+        }
+        if (xSemaphoreTake(xItemSem, xTimeout) != pdTRUE)
+        {
+            return false;
+        }
+        pxTask->ulWakeups++;
+        bWoken = true;
+    }
+
+    vRingbufferGetInfo(pxTask->xRingbuf, NULL, NULL, NULL, &uxWaiting);
+    if (uxWaiting > 0)
+    {
+        xSemaphoreGive(xItemSem);
+    }
+
+    return true;
+}
+
+static void prvContendProducerTask(void *pvParameters)
+{
+    rbbench_contender_t *pxTask = (rbbench_contender_t *)pvParameters;
+    uint8_t *pItem = pItems[pxTask->ucId];
+    size_t xItemSize;
+    uint32_t i;
+
+    for (i = 0; i < pxTask->ulItems; i++)
+    {
+        xItemSize = xMixedSizes[i % RBBENCH_MIXED_SIZES];
+        prvFill(pItem, pxTask->xType, xItemSize, pxTask->ucId, i);
+
+        if (!prvContendSend(pxTask, pItem, xItemSize))
+        {
+            pxTask->ulErrors += pxTask->ulItems - i;
+            break;
+        }
+    }
+
+    xSemaphoreGive(xTasksDone);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Receive and check items until an empty one, the end of the run.
+ */
+static void prvContendConsumerTask(void *pvParameters)
+{
+    rbbench_contender_t *pxTask = (rbbench_contender_t *)pvParameters;
+    uint8_t *pHead, *pTail;
+    size_t xHeadSize, xTailSize;
+    bool bValid;
+
+    pxTask->ulItems = 0;
+
+    while (prvContendReceive(pxTask, &pHead, &xHeadSize, &pTail, &xTailSize))
+    {
+        if (xHeadSize + xTailSize == 0)
+        {
+            vRingbufferReturnItem(pxTask->xRingbuf, pHead);
+            break;
+        }
+
+        if (pTail == NULL)
+        {
+            bValid = prvCheckMixed(pHead, xHeadSize, pxTask->ucProducers);
+        }
+        else if (xHeadSize + xTailSize <= RBBENCH_MIXED_MAX)
+        {
+            memcpy(pJoined[pxTask->ucId], pHead, xHeadSize);
+            memcpy(pJoined[pxTask->ucId] + xHeadSize, pTail, xTailSize);
+            bValid = prvCheckMixed(pJoined[pxTask->ucId], xHeadSize + xTailSize, pxTask->ucProducers);
+        }
+        else
+        {
+            bValid = false;
+        }
+
+        if (pTail != NULL)
+        {
+            vRingbufferReturnItem(pxTask->xRingbuf, pTail);
+        }
+        vRingbufferReturnItem(pxTask->xRingbuf, pHead);
+        if (pxTask->bSemaphores)
+        {
+            xSemaphoreGive(xSpaceSem);
+        }
+
+        if (!bValid)
+        {
+            pxTask->ulErrors++;
+        }
+        pxTask->ulItems++;
+    }
+
+    xSemaphoreGive(xTasksDone);
+    vTaskDelete(NULL);
+}
+
+static void prvContend(ringbuf_type_t xType, bool bSemaphores, rbbench_contention_t *pxResult)
+{
+    uint32_t ulItemsEach = M5CONFIG_RBBENCH_ITEMS / M5CONFIG_RBBENCH_PRODUCERS_MAX;
+    rbbench_contender_t xStopper;
+    RingbufHandle_t xRingbuf;
+    RingbufStats_t xStats;
+    int64_t llStart;
+    uint32_t i;
+
+    memset(pxResult, 0, sizeof(*pxResult));
+
+    xRingbuf = xRingbufferCreate(M5CONFIG_RBBENCH_BUFFER_SIZE, xType);
+    if (xRingbuf == NULL)
+    {
+        pxResult->ulErrors++;
+        return;
+    }
+    vRingbufferSetName(xRingbuf, "rbbench");
+
+    memset(xContenders, 0, sizeof(xContenders));
+    for (i = 0; i < M5CONFIG_RBBENCH_PRODUCERS_MAX + RBBENCH_CONSUMERS; i++)
+    {
+        xContenders[i].xRingbuf = xRingbuf;
+        xContenders[i].xType = xType;
+        xContenders[i].ucProducers = M5CONFIG_RBBENCH_PRODUCERS_MAX;
+        xContenders[i].bSemaphores = bSemaphores;
+    }
+    xStopper = xContenders[0];
+
+    llStart = esp_timer_get_time();
+
+    for (i = 0; i < RBBENCH_CONSUMERS; i++)
+    {
+        rbbench_contender_t *pxTask = &xContenders[M5CONFIG_RBBENCH_PRODUCERS_MAX + i];
+
+        pxTask->ucId = i;
+        if (xTaskCreate(prvContendConsumerTask, RBBENCH_CONSUMER_NAME, RBBENCH_CONSUMER_STACK_SIZE, pxTask, RBBENCH_TASK_PRIORITY, NULL) != pdPASS)
+        {
+            /* Counted as failed, and as done. The stop item left in the buffer goes with it */
+            pxTask->ulErrors++;
+            xSemaphoreGive(xTasksDone);
+        }
+    }
+
+    for (i = 0; i < M5CONFIG_RBBENCH_PRODUCERS_MAX; i++)
+    {
+        xContenders[i].ucId = i;
+        xContenders[i].ulItems = ulItemsEach;
+
+        if (xTaskCreate(prvContendProducerTask, RBBENCH_PRODUCER_NAME, RBBENCH_PRODUCER_STACK_SIZE, &xContenders[i], RBBENCH_TASK_PRIORITY + (i & 1), NULL) != pdPASS)
+        {
+            xContenders[i].ulErrors += ulItemsEach;
+            xSemaphoreGive(xTasksDone);
+        }
+    }
+
+    /* The tasks stop on their own after a timeout */
+    for (i = 0; i < M5CONFIG_RBBENCH_PRODUCERS_MAX; i++)
+    {
+        xSemaphoreTake(xTasksDone, portMAX_DELAY);
+    }
+
+    /* An empty item stops each consumer */
+    for (i = 0; i < RBBENCH_CONSUMERS; i++)
+    {
+        if (!prvContendSend(&xStopper, NULL, 0))
+        {
+            pxResult->ulErrors++;
+        }
+    }
+
+    for (i = 0; i < RBBENCH_CONSUMERS; i++)
+    {
+        xSemaphoreTake(xTasksDone, portMAX_DELAY);
+    }
+
+    pxResult->llElapsed = esp_timer_get_time() - llStart;
+
+    for (i = 0; i < M5CONFIG_RBBENCH_PRODUCERS_MAX + RBBENCH_CONSUMERS; i++)
+    {
+        if (i >= M5CONFIG_RBBENCH_PRODUCERS_MAX)
+        {
+            pxResult->ulItems += xContenders[i].ulItems;
+        }
+        pxResult->ulWakeups += xContenders[i].ulWakeups;
+        pxResult->ulSpurious += xContenders[i].ulSpurious;
+        pxResult->ulErrors += xContenders[i].ulErrors;
+    }
+    pxResult->ulWakeups += xStopper.ulWakeups;
+    pxResult->ulSpurious += xStopper.ulSpurious;
+
+    vRingbufferGetStats(xRingbuf, &xStats);
+
+    if (!bSemaphores)
+    {
+        pxResult->ulWakeups = xStats.uxWakeups;
+        pxResult->ulSpurious = xStats.uxSpuriousWakeups;
+    }
+
+    if (pxResult->ulItems != ulItemsEach * M5CONFIG_RBBENCH_PRODUCERS_MAX)
+    {
+        pxResult->ulErrors++;
+    }
+
+    vRingbufferDelete(xRingbuf);
+
+    /* Nothing may be left given for the next run */
+    xSemaphoreTake(xSpaceSem, 0);
+    xSemaphoreTake(xItemSem, 0);
+}
+
+/**
+ * @brief Run and print one line of wakeups.
+ *
+ * @return The number of errors of the run.
+ */
+static uint32_t prvContendAndReport(ringbuf_type_t xType, bool bSemaphores)
+{
+    rbbench_contention_t xResult;
+    uint64_t ullElapsed;
+
+    prvContend(xType, bSemaphores, &xResult);
+
+    ullElapsed = xResult.llElapsed > 0 ? (uint64_t)xResult.llElapsed : 1;
+
+    ESP_LOGI(TAG, "%-10s %-7s %8u %8u %8u %6u", pTypeNames[xType], bSemaphores ? "sem" : "waiters",
+             (uint32_t)(xResult.ulItems * 1000000ULL / ullElapsed), xResult.ulWakeups, xResult.ulSpurious, xResult.ulErrors);
+
+    return xResult.ulErrors;
+}
+
+/**
+ * @brief Send and receive M5CONFIG_RBBENCH_ITEMS items one by one in the calling
+ * task, and count the cycles of each call.
+ */
+static void prvMeasureCycles(rbbench_mode_t xMode, ringbuf_type_t xType, size_t xItemSize, rbbench_cycles_t *pxCycles)
+{
+    uint64_t ullSend = 0;
+    uint64_t ullReceive = 0;
+    uint32_t ulOffset = 0;
+    uint32_t ulStart, ulEnd;
+    RingbufHandle_t xRingbuf;
+    uint8_t *pItem = pItems[0];
+    uint8_t *pReceived = NULL;
+    uint8_t *pTail;
+    size_t xReceived, xLength, xTailSize;
+    uint32_t i;
+
+    memset(pxCycles, 0, sizeof(*pxCycles));
+    memset(ulNextSeq, 0, sizeof(ulNextSeq));
+
+    if (xMode == RBBENCH_MODE_SPSC)
+    {
+        xRingbuf = xRingbufferCreateSPSC(M5CONFIG_RBBENCH_BUFFER_SIZE, xType);
+    }
+    else
+    {
+        xRingbuf = xRingbufferCreate(M5CONFIG_RBBENCH_BUFFER_SIZE, xType);
+    }
+    if (xRingbuf == NULL)
+    {
+        pxCycles->ulErrors++;
+        return;
+    }
+    vRingbufferSetName(xRingbuf, "rbbench");
+
+    if (xRingbufferGetMaxItemSize(xRingbuf) < xItemSize)
+    {
+        pxCycles->bSkipped = true;
+        vRingbufferDelete(xRingbuf);
+        return;
+    }
+
+    for (i = 0; i < M5CONFIG_RBBENCH_ITEMS; i++)
+    {
+        prvFill(pItem, xType, xItemSize, 0, i);
+
+        ulStart = xthal_get_ccount();
+        if (xRingbufferSend(xRingbuf, pItem, xItemSize, 0) != pdTRUE)
+        {
+            pxCycles->ulErrors++;
+            break;
+        }
+        ulEnd = xthal_get_ccount();
+        ullSend += ulEnd - ulStart;
+
+        if (xType == RINGBUF_TYPE_ALLOWSPLIT)
+        {
+            pTail = NULL;
+            xTailSize = 0;
+
+            ulStart = xthal_get_ccount();
+            if (xRingbufferReceiveSplit(xRingbuf, (void **)&pReceived, (void **)&pTail, &xLength, &xTailSize, 0) == pdTRUE)
+            {
+                if (pTail != NULL)
+                {
+                    vRingbufferReturnItem(xRingbuf, pTail);
+                }
+                vRingbufferReturnItem(xRingbuf, pReceived);
+            }
+            ulEnd = xthal_get_ccount();
+            ullReceive += ulEnd - ulStart;
+
+            /* Checked after the return, the item stays readable until the next send */
+            if (pReceived == NULL || !prvCheckParts(pReceived, xLength, pTail, xTailSize, xItemSize, 1))
+            {
+                pxCycles->ulErrors++;
+            }
+            continue;
+        }
+
+        /* A byte buffer returns the data in two pieces when it wraps around */
+        for (xReceived = 0; xReceived < xItemSize; xReceived += xLength)
+        {
+            ulStart = xthal_get_ccount();
+            pReceived = xRingbufferReceive(xRingbuf, &xLength, 0);
+            if (pReceived != NULL)
+            {
+                vRingbufferReturnItem(xRingbuf, pReceived);
+            }
+            ulEnd = xthal_get_ccount();
+            ullReceive += ulEnd - ulStart;
+
+            if (pReceived == NULL)
+            {
+                pxCycles->ulErrors++;
+                break;
+            }
+
+            if (xType == RINGBUF_TYPE_BYTEBUF ? !prvCheckStream(pReceived, xLength, &ulOffset) : !prvCheckItem(pReceived, xLength, xItemSize, 1))
+            {
+                pxCycles->ulErrors++;
+            }
+        }
+    }
+
+    if (i > 0)
+    {
+        pxCycles->ulSend = (uint32_t)(ullSend / i);
+        pxCycles->ulReceive = (uint32_t)(ullReceive / i);
+    }
+
+    vRingbufferDelete(xRingbuf);
+}
+
+/**
+ * @brief Measure and print one line of cycles.
+ *
+ * @return The number of errors of the measure.
+ */
+static uint32_t prvMeasureAndReport(rbbench_mode_t xMode, ringbuf_type_t xType, size_t xItemSize)
+{
+    rbbench_cycles_t xCycles;
+
+    prvMeasureCycles(xMode, xType, xItemSize, &xCycles);
+
+    if (xCycles.bSkipped)
+    {
+        ESP_LOGI(TAG, "%-10s %-6s %5u skipped, larger than the buffer can hold", pTypeNames[xType], pModeNames[xMode], xItemSize);
+        return 0;
+    }
+
+    ESP_LOGI(TAG, "%-10s %-6s %5u %8u %8u %6u", pTypeNames[xType], pModeNames[xMode], xItemSize,
+             xCycles.ulSend, xCycles.ulReceive, xCycles.ulErrors);
+
+    return xCycles.ulErrors;
+}
+
+/**
+ * @brief Run and print one line of results.
+ *
+ * @return The number of errors of the run.
+ */
+static uint32_t prvRunAndReport(rbbench_mode_t xMode, ringbuf_type_t xType, size_t xItemSize, uint8_t ucProducers)
+{
+    rbbench_result_t xResult;
+    uint64_t ullElapsed;
+
+    prvRun(xMode, xType, xItemSize, ucProducers, &xResult);
+
+    if (xResult.bSkipped)
+    {
+        ESP_LOGI(TAG, "%-10s %-6s %5u %4u skipped, larger than the buffer can hold", pTypeNames[xType], pModeNames[xMode], xItemSize, ucProducers);
+        return 0;
+    }
+
+    ullElapsed = xResult.llElapsed > 0 ? (uint64_t)xResult.llElapsed : 1;
+
+    ESP_LOGI(TAG, "%-10s %-6s %5u %4u %8u %9u %8u %6u", pTypeNames[xType], pModeNames[xMode], xItemSize, ucProducers,
+             (uint32_t)(xResult.ulItems * 1000000ULL / ullElapsed),
+             (uint32_t)(xResult.ulBytes * 1000000ULL / ullElapsed),
+             xResult.ulItems > 0 ? (uint32_t)(ullElapsed * 1000ULL / xResult.ulItems) : 0,
+             xResult.ulErrors);
+
+    return xResult.ulErrors;
+}
+
+static void prvBenchTask(void *pvParameters)
+{
+    uint32_t ulErrors = 0;
+    size_t xSize;
+    uint8_t ucProducers;
+    int type;
+
+    ESP_LOGI(TAG, "%u items per run, %u bytes of buffer", M5CONFIG_RBBENCH_ITEMS, M5CONFIG_RBBENCH_BUFFER_SIZE);
+    ESP_LOGI(TAG, "%-10s %-6s %5s %4s %8s %9s %8s %6s", "Type", "Mode", "Item", "Prod", "Items/s", "Bytes/s", "ns/item", "Errors");
+
+    for (type = RINGBUF_TYPE_NOSPLIT; type <= RINGBUF_TYPE_BYTEBUF; type++)
+    {
+        for (xSize = 0; xSize < sizeof(xItemSizes) / sizeof(xItemSizes[0]); xSize++)
+        {
+            for (ucProducers = 1; ucProducers <= M5CONFIG_RBBENCH_PRODUCERS_MAX; ucProducers *= 2)
+            {
+                ulErrors += prvRunAndReport(RBBENCH_MODE_LOCKED, (ringbuf_type_t)type, xItemSizes[xSize], ucProducers);
+
+                if (type == RINGBUF_TYPE_NOSPLIT)
+                {
+                    ulErrors += prvRunAndReport(RBBENCH_MODE_LOCKED_ACQUIRE, (ringbuf_type_t)type, xItemSizes[xSize], ucProducers);
+                }
+
+                if (type != RINGBUF_TYPE_BYTEBUF)
+                {
+                    ulErrors += prvRunAndReport(RBBENCH_MODE_LOCKED_BATCH, (ringbuf_type_t)type, xItemSizes[xSize], ucProducers);
+                }
+
+                if (type == RINGBUF_TYPE_NOSPLIT)
+                {
+                    ulErrors += prvRunAndReport(RBBENCH_MODE_BROADCAST, (ringbuf_type_t)type, xItemSizes[xSize], ucProducers);
+                }
+            }
+
+            if (type != RINGBUF_TYPE_ALLOWSPLIT)
+            {
+                ulErrors += prvRunAndReport(RBBENCH_MODE_SPSC, (ringbuf_type_t)type, xItemSizes[xSize], 1);
+            }
+
+            if (type == RINGBUF_TYPE_NOSPLIT)
+            {
+                ulErrors += prvRunAndReport(RBBENCH_MODE_SPSC_ACQUIRE, (ringbuf_type_t)type, xItemSizes[xSize], 1);
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Cycles per call, %u calls, one task", M5CONFIG_RBBENCH_ITEMS);
+    ESP_LOGI(TAG, "%-10s %-6s %5s %8s %8s %6s", "Type", "Mode", "Item", "Send", "Receive", "Errors");
+
+    for (type = RINGBUF_TYPE_NOSPLIT; type <= RINGBUF_TYPE_BYTEBUF; type++)
+    {
+        for (xSize = 0; xSize < sizeof(xItemSizes) / sizeof(xItemSizes[0]); xSize++)
+        {
+            ulErrors += prvMeasureAndReport(RBBENCH_MODE_LOCKED, (ringbuf_type_t)type, xItemSizes[xSize]);
+
+            if (type != RINGBUF_TYPE_ALLOWSPLIT)
+            {
+                ulErrors += prvMeasureAndReport(RBBENCH_MODE_SPSC, (ringbuf_type_t)type, xItemSizes[xSize]);
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Wakeups under contention, %u producers, %u consumers, %u items", M5CONFIG_RBBENCH_PRODUCERS_MAX,
+             RBBENCH_CONSUMERS, M5CONFIG_RBBENCH_ITEMS / M5CONFIG_RBBENCH_PRODUCERS_MAX * M5CONFIG_RBBENCH_PRODUCERS_MAX);
+    ESP_LOGI(TAG, "%-10s %-7s %8s %8s %8s %6s", "Type", "Proto", "Items/s", "Wakeups", "Spurious", "Errors");
+
+    /* The byte buffers do not keep the items apart */
+    for (type = RINGBUF_TYPE_NOSPLIT; type <= RINGBUF_TYPE_ALLOWSPLIT; type++)
+    {
+        ulErrors += prvContendAndReport((ringbuf_type_t)type, true);
+        ulErrors += prvContendAndReport((ringbuf_type_t)type, false);
+    }
+
+    if (ulErrors > 0)
+    {
+        ESP_LOGE(TAG, "%u errors", ulErrors);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Done, no errors");
+    }
+
+    vTaskDelete(NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_rbbench_start(void)
+{
+    if (xTasksDone != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xTasksDone = xSemaphoreCreateCounting(M5CONFIG_RBBENCH_PRODUCERS_MAX + RBBENCH_CONSUMERS, 0);
+    xSpaceSem = xSemaphoreCreateBinary();
+    xItemSem = xSemaphoreCreateBinary();
+    if (xTasksDone == NULL || xSpaceSem == NULL || xItemSem == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(prvBenchTask, RBBENCH_TASK_NAME, RBBENCH_TASK_STACK_SIZE, NULL, RBBENCH_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    m5stickc_stack_expect(RBBENCH_TASK_NAME, RBBENCH_TASK_STACK_SIZE, "RBBENCH_TASK_STACK_SIZE");
+    m5stickc_stack_expect(RBBENCH_PRODUCER_NAME, RBBENCH_PRODUCER_STACK_SIZE, "RBBENCH_PRODUCER_STACK_SIZE");
+    m5stickc_stack_expect(RBBENCH_CONSUMER_NAME, RBBENCH_CONSUMER_STACK_SIZE, "RBBENCH_CONSUMER_STACK_SIZE");
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
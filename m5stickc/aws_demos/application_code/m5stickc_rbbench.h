@@ -0,0 +1,21 @@
+/**
+ * @file m5stickc_rbbench.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_RBBENCH_H_
+#define _M5STICKC_RBBENCH_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Run the ring buffer benchmark once, in a task of its own, and print
+ * the items/s and bytes/s of every buffer type, item size and number of
+ * producers on the serial console. The content of every item is checked on
+ * the way, the errors are printed with the results.
+ */
+esp_err_t m5stickc_rbbench_start(void);
+
+#endif /* ifndef _M5STICKC_RBBENCH_H_ */
@@ -0,0 +1,274 @@
+/**
+ * @file m5stickc_ringbuf.c
+ * @brief Usage of all the ring buffers, the sizes they call for, and their backpressure.
+ *
+ * Every ring buffer keeps cumulative statistics: the most bytes it ever held,
+ * the items and bytes sent, the sends that failed or had to wait for space,
+ * the unread items dropped to make room (see vRingbufferSetOverwrite), and
+ * the split items and wrap arounds. The monitor reads them for all the ring
+ * buffers at once with uxRingbufferGetAllStats, and compares each sample with
+ * the previous one. A ring buffer whose sends keep failing, blocking or
+ * dropping items sample after sample is too small, or drained too slowly, and
+ * is reported right away. The report turns the peaks into sizes: the peak plus
+ * a margin. The peak of a ring buffer that was ever full only says that it
+ * needs more.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_RINGBUF
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+#include "esp_log.h"
+
+#include "m5stickc_scheduler.h"
+#include "m5stickc_ringbuf.h"
+
+static const char *TAG = "m5stickc_ringbuf";
+
+/*-----------------------------------------------------------*/
+
+/* Recommended sizes are rounded up to this */
+#define RINGBUF_ROUND               ( 64 )
+
+#define RINGBUF_ROUND_UP(x)         ( ( ( x ) + RINGBUF_ROUND - 1 ) / RINGBUF_ROUND * RINGBUF_ROUND )
+
+typedef struct {
+    RingbufStats_t last;    /* Statistics at the previous sample */
+    uint32_t pressure;      /* Samples in a row with failed or blocked sends, or dropped items */
+    uint32_t seen;          /* Sample that last saw the ring buffer, counted from 1 */
+} ringbuf_record_t;
+
+static ringbuf_record_t xRecords[M5CONFIG_RINGBUF_MAX];
+static size_t xRecordCount = 0;
+static bool bRecordsFull = false;
+
+/* Filled by uxRingbufferGetAllStats, kept out of the stack of the timer task */
+static RingbufStats_t xStats[M5CONFIG_RINGBUF_MAX];
+
+static SemaphoreHandle_t xRingbufMutex = NULL;
+static m5stickc_scheduler_job_t xRingbufJob = NULL;
+static uint32_t ulSamples = 0;
+
+/*-----------------------------------------------------------*/
+
+static const char *prvName(const RingbufStats_t *pxStats)
+{
+    return pxStats->pcName != NULL ? pxStats->pcName : "(unnamed)";
+}
+
+static bool prvAlive(const ringbuf_record_t *pxRecord)
+{
+    return pxRecord->seen == ulSamples;
+}
+
+/**
+ * @brief Record of a ring buffer. The slot of a ring buffer missing from the
+ * previous sample is reused, and so is the record of a deleted ring buffer when
+ * a new one gets the same handle. Called with ulSamples already incremented.
+ */
+static ringbuf_record_t *prvFindRecord(const RingbufStats_t *pxStats)
+{
+    ringbuf_record_t *pxFree = NULL;
+    size_t i;
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        if (xRecords[i].last.xRingbuffer == pxStats->xRingbuffer)
+        {
+            /* Counters going back: deleted and created again */
+            if (xRecords[i].last.xSize != pxStats->xSize || xRecords[i].last.uxItemsSent > pxStats->uxItemsSent)
+            {
+                memset(&xRecords[i], 0, sizeof(xRecords[i]));
+            }
+            return &xRecords[i];
+        }
+        if (xRecords[i].seen + 1 < ulSamples && pxFree == NULL)
+        {
+            pxFree = &xRecords[i];
+        }
+    }
+
+    if (pxFree == NULL)
+    {
+        if (xRecordCount == M5CONFIG_RINGBUF_MAX)
+        {
+            bRecordsFull = true;
+            return NULL;
+        }
+        pxFree = &xRecords[xRecordCount++];
+    }
+
+    memset(pxFree, 0, sizeof(*pxFree));
+    pxFree->last.xRingbuffer = pxStats->xRingbuffer;
+    pxFree->last.xSize = pxStats->xSize;
+
+    return pxFree;
+}
+
+static void prvSample(void)
+{
+    UBaseType_t uxCount, i;
+
+    ulSamples++;
+    uxCount = uxRingbufferGetAllStats(xStats, M5CONFIG_RINGBUF_MAX);
+
+    if (uxCount > M5CONFIG_RINGBUF_MAX)
+    {
+        bRecordsFull = true;
+        uxCount = M5CONFIG_RINGBUF_MAX;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        ringbuf_record_t *pxRecord = prvFindRecord(&xStats[i]);
+        UBaseType_t uxTimeouts, uxBlocked, uxDropped;
+
+        if (pxRecord == NULL)
+        {
+            continue;
+        }
+
+        uxTimeouts = xStats[i].uxSendTimeouts - pxRecord->last.uxSendTimeouts;
+        uxBlocked = xStats[i].uxBlockedSends - pxRecord->last.uxBlockedSends;
+        uxDropped = xStats[i].uxDroppedItems - pxRecord->last.uxDroppedItems;
+
+        if (uxTimeouts > 0 || uxBlocked > 0 || uxDropped > 0)
+        {
+            pxRecord->pressure++;
+            if (pxRecord->pressure == M5CONFIG_RINGBUF_BACKPRESSURE_SAMPLES)
+            {
+                ESP_LOGW(TAG, "%s: sends failed, blocked or dropped items for %u samples in a row, %u bytes are not enough",
+                         prvName(&xStats[i]), pxRecord->pressure, xStats[i].xSize);
+            }
+        }
+        else
+        {
+            pxRecord->pressure = 0;
+        }
+
+        pxRecord->last = xStats[i];
+        pxRecord->seen = ulSamples;
+    }
+}
+
+static void prvRingbufJobCallback(void *context)
+{
+    xSemaphoreTake(xRingbufMutex, portMAX_DELAY);
+    prvSample();
+    xSemaphoreGive(xRingbufMutex);
+
+    if (M5CONFIG_RINGBUF_REPORT_SAMPLES > 0 && ulSamples % M5CONFIG_RINGBUF_REPORT_SAMPLES == 0)
+    {
+        m5stickc_ringbuf_report();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_ringbuf_monitor_start(void)
+{
+    if (xRingbufJob != NULL)
+    {
+        return ESP_OK;
+    }
+
+    xRingbufMutex = xSemaphoreCreateMutex();
+    if (xRingbufMutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* First sample now, so that the first period already counts for the backpressure */
+    prvSample();
+
+    xRingbufJob = m5stickc_scheduler_add("ringbuf", M5CONFIG_RINGBUF_SAMPLE_PERIOD_MS, M5CONFIG_RINGBUF_SAMPLE_SLACK_MS, true, prvRingbufJobCallback, NULL);
+
+    return xRingbufJob != NULL ? ESP_OK : ESP_FAIL;
+}
+
+void m5stickc_ringbuf_report(void)
+{
+    unsigned int uFull = 0;
+    size_t i;
+
+    if (xRingbufMutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xRingbufMutex, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "%-16s %6s %6s %8s %10s %8s %8s %10s %8s %6s %6s", "Ring buffer", "Size", "Peak",
+             "Items", "Bytes", "Failed", "Blocked", "Blocked ms", "Dropped", "Splits", "Wraps");
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        const RingbufStats_t *pxStats = &xRecords[i].last;
+
+        if (!prvAlive(&xRecords[i]))
+        {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "%-16s %6u %6u %8u %10u %8u %8u %10u %8u %6u %6u", prvName(pxStats), pxStats->xSize,
+                 pxStats->xPeakUsed, pxStats->uxItemsSent, pxStats->uxBytesSent, pxStats->uxSendTimeouts,
+                 pxStats->uxBlockedSends, pxStats->xBlockedTicks * portTICK_PERIOD_MS,
+                 pxStats->uxDroppedItems, pxStats->uxSplitItems, pxStats->uxDummyWraps);
+    }
+
+    ESP_LOGI(TAG, "Recommended ring buffer sizes, %u%% over the peak usage:", M5CONFIG_RINGBUF_MARGIN_PERCENT);
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        const RingbufStats_t *pxStats = &xRecords[i].last;
+        uint32_t ulRecommended = RINGBUF_ROUND_UP(pxStats->xPeakUsed + pxStats->xPeakUsed * M5CONFIG_RINGBUF_MARGIN_PERCENT / 100);
+
+        if (!prvAlive(&xRecords[i]) || pxStats->uxItemsSent == 0)
+        {
+            continue;
+        }
+
+        if (pxStats->uxSendTimeouts > 0 || pxStats->uxBlockedSends > 0 || pxStats->uxDroppedItems > 0)
+        {
+            /* Full at some point, the peak is the size: only a lower bound. A row
+             * of the table, the summary warning follows it. */
+            ESP_LOGI(TAG, "%-16s %6u or more /* was %u, full: %u sends failed, %u blocked, %u dropped */", prvName(pxStats),
+                     ulRecommended, pxStats->xSize, pxStats->uxSendTimeouts, pxStats->uxBlockedSends, pxStats->uxDroppedItems);
+            uFull++;
+        }
+        else if (ulRecommended < pxStats->xSize)
+        {
+            ESP_LOGI(TAG, "%-16s %6u /* was %u, %u bytes reclaimed */", prvName(pxStats),
+                     ulRecommended, pxStats->xSize, pxStats->xSize - ulRecommended);
+        }
+    }
+
+    if (uFull > 0)
+    {
+        ESP_LOGW(TAG, "%u ring buffers were full, see the recommended sizes above", uFull);
+    }
+
+    if (bRecordsFull)
+    {
+        ESP_LOGW(TAG, "Some ring buffers were not recorded, increase M5CONFIG_RINGBUF_MAX");
+    }
+
+    xSemaphoreGive(xRingbufMutex);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,28 @@
+/**
+ * @file m5stickc_ringbuf.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_RINGBUF_H_
+#define _M5STICKC_RINGBUF_H_
+
+#include "esp_err.h"
+
+/**
+ * @brief Read the statistics of all the ring buffers every
+ * M5CONFIG_RINGBUF_SAMPLE_PERIOD_MS on the scheduler, and warn when the sends
+ * to a ring buffer fail, block or drop items for
+ * M5CONFIG_RINGBUF_BACKPRESSURE_SAMPLES samples in a row.
+ */
+esp_err_t m5stickc_ringbuf_monitor_start(void);
+
+/**
+ * @brief Print the statistics of all the ring buffers on the serial console,
+ * followed by the recommended sizes with the margin of
+ * M5CONFIG_RINGBUF_MARGIN_PERCENT.
+ */
+void m5stickc_ringbuf_report(void);
+
+#endif /* ifndef _M5STICKC_RINGBUF_H_ */
@@ -0,0 +1,352 @@
+/**
+ * @file m5stickc_scheduler.c
+ * @brief Coalescing scheduler: all periodic jobs of the demo share a single timer.
+ *
+ * Each job has a period and a slack. The scheduler sleeps until the earliest
+ * job is due, then runs every job whose slack window has opened as well, and
+ * restarts their periods together. Jobs with compatible periods end up aligned
+ * on the same wakeups instead of waking the CPU one after the other.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_SCHEDULER
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+
+#include "esp_log.h"
+
+#include "m5stickc_scheduler.h"
+
+static const char *TAG = "m5stickc_scheduler";
+
+/*-----------------------------------------------------------*/
+
+struct m5stickc_scheduler_job {
+    const char *name;
+    TickType_t period;
+    TickType_t slack;
+    TickType_t due;
+    bool used;
+    bool active;
+    bool periodic;
+    m5stickc_scheduler_callback_t callback;
+    void *context;
+    uint32_t runs;
+};
+
+static struct m5stickc_scheduler_job xJobs[M5CONFIG_SCHEDULER_MAX_JOBS];
+static SemaphoreHandle_t xSchedulerMutex = NULL;
+static TimerHandle_t xSchedulerTimer = NULL;
+
+/* Timer service task, known from the first wakeup. It must not wait on its own command queue */
+static TaskHandle_t xTimerTask = NULL;
+
+/* A timer command that waits longer than this for room in the timer queue has failed */
+#define SCHEDULER_COMMAND_WAIT_MS   ( 100 )
+
+/* Statistics since m5stickc_scheduler_init */
+static TickType_t xStatsStart = 0;
+static uint32_t ulWakeups = 0;
+static uint32_t ulJobRuns = 0;
+static uint32_t ulRearmFailures = 0;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tick comparison that survives the tick counter wrapping around.
+ */
+static inline bool prvTickReached(TickType_t xNow, TickType_t xTarget)
+{
+    return (int32_t)(xNow - xTarget) >= 0;
+}
+
+/**
+ * @brief Program the timer for the earliest due job. Must be called with the mutex held.
+ *
+ * The timer command waits for room in the timer queue, except in the timer
+ * service task. There a full queue cannot drain, and the command fails: the
+ * timer is auto-reload, it expires again after its previous period and the
+ * wakeup re-arms it. The jobs are late, they never stop.
+ */
+static void prvRearm(void)
+{
+    TickType_t xWait = xTaskGetCurrentTaskHandle() == xTimerTask ? 0 : pdMS_TO_TICKS(SCHEDULER_COMMAND_WAIT_MS);
+    BaseType_t xResult;
+    TickType_t xNow = xTaskGetTickCount();
+    TickType_t xNext = 0;
+    bool bFound = false;
+    size_t i;
+
+    for (i = 0; i < M5CONFIG_SCHEDULER_MAX_JOBS; i++)
+    {
+        if (xJobs[i].active && (!bFound || (int32_t)(xJobs[i].due - xNext) < 0))
+        {
+            xNext = xJobs[i].due;
+            bFound = true;
+        }
+    }
+
+    if (!bFound)
+    {
+        /* Left running if this fails, a wakeup without a job due only stops it again */
+        xTimerStop(xSchedulerTimer, xWait);
+        return;
+    }
+
+    TickType_t xDelay = prvTickReached(xNow, xNext) ? 1 : xNext - xNow;
+
+    xResult = xTimerChangePeriod(xSchedulerTimer, xDelay, xWait);
+    if (xResult != pdPASS)
+    {
+        ulRearmFailures++;
+        ESP_LOGW(TAG, "prvRearm: timer queue full, the jobs wait for the previous period");
+    }
+}
+
+static void prvSchedulerTimerCallback(TimerHandle_t pxTimer)
+{
+    m5stickc_scheduler_callback_t pxCallbacks[M5CONFIG_SCHEDULER_MAX_JOBS];
+    void *pvContexts[M5CONFIG_SCHEDULER_MAX_JOBS];
+    size_t xCount = 0;
+    size_t i;
+
+    xSemaphoreTake(xSchedulerMutex, portMAX_DELAY);
+
+    xTimerTask = xTaskGetCurrentTaskHandle();
+
+    TickType_t xNow = xTaskGetTickCount();
+    ulWakeups++;
+
+    for (i = 0; i < M5CONFIG_SCHEDULER_MAX_JOBS; i++)
+    {
+        struct m5stickc_scheduler_job *pxJob = &xJobs[i];
+
+        /* Run everything that is due, or close enough to share this wakeup */
+        if (!pxJob->active || !prvTickReached(xNow + pxJob->slack, pxJob->due))
+        {
+            continue;
+        }
+
+        pxCallbacks[xCount] = pxJob->callback;
+        pvContexts[xCount] = pxJob->context;
+        xCount++;
+
+        pxJob->runs++;
+        ulJobRuns++;
+
+        if (pxJob->periodic)
+        {
+            pxJob->due = xNow + pxJob->period;
+        }
+        else
+        {
+            pxJob->active = false;
+        }
+    }
+
+    prvRearm();
+
+    xSemaphoreGive(xSchedulerMutex);
+
+    /* Callbacks run without the mutex, so that they can reset or remove jobs */
+    for (i = 0; i < xCount; i++)
+    {
+        pxCallbacks[i](pvContexts[i]);
+    }
+}
+
+#if M5CONFIG_SCHEDULER_STATS_PERIOD_MS > 0
+static void prvStatsJob(void *context)
+{
+    m5stickc_scheduler_log_stats();
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_scheduler_init(void)
+{
+    if (xSchedulerTimer != NULL)
+    {
+        return ESP_OK;
+    }
+
+    xSchedulerMutex = xSemaphoreCreateMutex();
+    if (xSchedulerMutex == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_scheduler_init: failed to create the mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The period is replaced by prvRearm every time the timer is started. Auto-reload, see prvRearm */
+    xSchedulerTimer = xTimerCreate("Scheduler", 1, pdTRUE, NULL, prvSchedulerTimerCallback);
+    if (xSchedulerTimer == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_scheduler_init: failed to create the timer");
+        vSemaphoreDelete(xSchedulerMutex);
+        xSchedulerMutex = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(xJobs, 0, sizeof(xJobs));
+    xStatsStart = xTaskGetTickCount();
+
+#if M5CONFIG_SCHEDULER_STATS_PERIOD_MS > 0
+    m5stickc_scheduler_add("stats", M5CONFIG_SCHEDULER_STATS_PERIOD_MS, M5CONFIG_SCHEDULER_STATS_PERIOD_MS / 4, true, prvStatsJob, NULL);
+#endif
+
+    return ESP_OK;
+}
+
+m5stickc_scheduler_job_t m5stickc_scheduler_add(const char *name, uint32_t period_ms, uint32_t slack_ms, bool periodic, m5stickc_scheduler_callback_t callback, void *context)
+{
+    struct m5stickc_scheduler_job *pxJob = NULL;
+    size_t i;
+
+    if (xSchedulerTimer == NULL || callback == NULL || period_ms == 0)
+    {
+        ESP_LOGE(TAG, "m5stickc_scheduler_add: invalid job %s", name ? name : "?");
+        return NULL;
+    }
+
+    xSemaphoreTake(xSchedulerMutex, portMAX_DELAY);
+
+    for (i = 0; i < M5CONFIG_SCHEDULER_MAX_JOBS; i++)
+    {
+        if (!xJobs[i].used)
+        {
+            pxJob = &xJobs[i];
+            break;
+        }
+    }
+
+    if (pxJob != NULL)
+    {
+        pxJob->name = name;
+        pxJob->period = pdMS_TO_TICKS(period_ms);
+        pxJob->slack = pdMS_TO_TICKS(slack_ms);
+        pxJob->due = xTaskGetTickCount() + pxJob->period;
+        pxJob->periodic = periodic;
+        pxJob->callback = callback;
+        pxJob->context = context;
+        pxJob->runs = 0;
+        pxJob->used = true;
+        pxJob->active = true;
+
+        prvRearm();
+    }
+
+    xSemaphoreGive(xSchedulerMutex);
+
+    if (pxJob == NULL)
+    {
+        ESP_LOGE(TAG, "m5stickc_scheduler_add: no free slot for %s, increase M5CONFIG_SCHEDULER_MAX_JOBS", name);
+    }
+    else
+    {
+        ESP_LOGD(TAG, "m5stickc_scheduler_add: %s every %u ms, slack %u ms", name, period_ms, slack_ms);
+    }
+
+    return pxJob;
+}
+
+esp_err_t m5stickc_scheduler_reset(m5stickc_scheduler_job_t job)
+{
+    if (job == NULL || xSchedulerTimer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(xSchedulerMutex, portMAX_DELAY);
+
+    if (job->used)
+    {
+        job->due = xTaskGetTickCount() + job->period;
+        job->active = true;
+        prvRearm();
+    }
+
+    xSemaphoreGive(xSchedulerMutex);
+
+    return ESP_OK;
+}
+
+esp_err_t m5stickc_scheduler_remove(m5stickc_scheduler_job_t job)
+{
+    if (job == NULL || xSchedulerTimer == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(xSchedulerMutex, portMAX_DELAY);
+
+    job->used = false;
+    job->active = false;
+    prvRearm();
+
+    xSemaphoreGive(xSchedulerMutex);
+
+    return ESP_OK;
+}
+
+void m5stickc_scheduler_log_stats(void)
+{
+    uint32_t ulWakeupsCopy, ulJobRunsCopy, ulFailuresCopy, ulElapsedMs;
+    size_t i;
+
+    if (xSchedulerTimer == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xSchedulerMutex, portMAX_DELAY);
+
+    ulWakeupsCopy = ulWakeups;
+    ulJobRunsCopy = ulJobRuns;
+    ulFailuresCopy = ulRearmFailures;
+    ulElapsedMs = (xTaskGetTickCount() - xStatsStart) * portTICK_PERIOD_MS;
+
+    for (i = 0; i < M5CONFIG_SCHEDULER_MAX_JOBS; i++)
+    {
+        if (xJobs[i].used)
+        {
+            ESP_LOGD(TAG, "    %-12s runs: %u", xJobs[i].name, xJobs[i].runs);
+        }
+    }
+
+    xSemaphoreGive(xSchedulerMutex);
+
+    if (ulElapsedMs == 0)
+    {
+        return;
+    }
+
+    /* Without coalescing every job run would have been its own timer wakeup */
+    ESP_LOGI(TAG, "Wakeups per minute: %u (%u without coalescing)",
+             (uint32_t)(((uint64_t)ulWakeupsCopy * 60000ULL) / ulElapsedMs),
+             (uint32_t)(((uint64_t)ulJobRunsCopy * 60000ULL) / ulElapsedMs));
+
+    if (ulFailuresCopy > 0)
+    {
+        ESP_LOGW(TAG, "Timer re-arms that failed on a full timer queue: %u", ulFailuresCopy);
+    }
+}
+
+/*-----------------------------------------------------------*/
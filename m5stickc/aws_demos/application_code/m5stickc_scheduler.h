@@ -0,0 +1,46 @@
+/**
+ * @file m5stickc_scheduler.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_SCHEDULER_H_
+#define _M5STICKC_SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef void (*m5stickc_scheduler_callback_t)(void *context);
+
+typedef struct m5stickc_scheduler_job * m5stickc_scheduler_job_t;
+
+esp_err_t m5stickc_scheduler_init(void);
+
+/**
+ * @brief Add a job to the scheduler.
+ *
+ * A job may run up to slack_ms before it is due, so that it shares a wakeup
+ * with another job instead of waking the CPU on its own. Callbacks run in the
+ * context of the FreeRTOS timer task.
+ *
+ * @return The job handle, or NULL if the scheduler is full or not initialized.
+ */
+m5stickc_scheduler_job_t m5stickc_scheduler_add(const char *name, uint32_t period_ms, uint32_t slack_ms, bool periodic, m5stickc_scheduler_callback_t callback, void *context);
+
+/**
+ * @brief Restart the period of a job from now. Re-arms one-shot jobs that already ran.
+ */
+esp_err_t m5stickc_scheduler_reset(m5stickc_scheduler_job_t job);
+
+esp_err_t m5stickc_scheduler_remove(m5stickc_scheduler_job_t job);
+
+/**
+ * @brief Log the scheduler wakeups per minute against the job runs per minute,
+ * which is the number of wakeups separate timers would have caused.
+ */
+void m5stickc_scheduler_log_stats(void);
+
+#endif /* ifndef _M5STICKC_SCHEDULER_H_ */
@@ -0,0 +1,324 @@
+/**
+ * @file m5stickc_stack.c
+ * @brief Stack high water marks of all the tasks, and the stack sizes they call for.
+ *
+ * FreeRTOS keeps the lowest free stack of each task (the high water mark).
+ * The monitor walks the tasks with uxTaskGetSystemState and keeps the lowest
+ * mark seen for each task name, so that a task that ran and was deleted
+ * between two reports still counts. The report turns the marks into stack
+ * sizes: what the task used, plus a margin. Several tasks may share a name
+ * and a setting (the Amazon FreeRTOS threads are all "iot_thread"), the
+ * lowest mark of the name is then used for all of them, which can only
+ * overestimate what each of them needs.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Compile-time log level of this module, defined before esp_log.h is included. */
+#include "m5stickc_lab_config.h"
+#define LOG_LOCAL_LEVEL     M5CONFIG_LOG_LEVEL_STACK
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/* Stack sizes of the library tasks. */
+#include "aws_demo_config.h"
+#include "aws_ota_agent_config.h"
+#include "iot_mqtt_agent_config.h"
+#include "FreeRTOSIPConfig.h"
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "m5stickc_scheduler.h"
+#include "m5stickc_stack.h"
+
+static const char *TAG = "m5stickc_stack";
+
+/*-----------------------------------------------------------*/
+
+/* Tasks declared with m5stickc_stack_expect */
+#define STACK_EXPECT_MAX            ( 8 )
+
+/* Recommended sizes are rounded up to this */
+#define STACK_ROUND                 ( 64 )
+
+#define STACK_ROUND_UP(x)           ( ( ( x ) + STACK_ROUND - 1 ) / STACK_ROUND * STACK_ROUND )
+
+typedef struct {
+    const char *task;
+    uint32_t size;
+    const char *setting;
+} stack_expect_t;
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t free_min;      /* Lowest high water mark, in bytes */
+    bool alive;             /* Seen by the last walk */
+} stack_record_t;
+
+/* Stack sizes of the system and library tasks, in bytes (StackType_t is a byte on the ESP32) */
+static const stack_expect_t xKnown[] = {
+    { "IDLE",       CONFIG_FREERTOS_IDLE_TASK_STACKSIZE,    "CONFIG_FREERTOS_IDLE_TASK_STACKSIZE" },
+    { "Tmr Svc",    CONFIG_TIMER_TASK_STACK_DEPTH,          "CONFIG_TIMER_TASK_STACK_DEPTH" },
+    { "esp_timer",  CONFIG_TIMER_TASK_STACK_SIZE,           "CONFIG_TIMER_TASK_STACK_SIZE" },
+    { "ipc0",       CONFIG_IPC_TASK_STACK_SIZE,             "CONFIG_IPC_TASK_STACK_SIZE" },
+    { "sys_evt",    CONFIG_SYSTEM_EVENT_TASK_STACK_SIZE,    "CONFIG_SYSTEM_EVENT_TASK_STACK_SIZE" },
+    { "main",       CONFIG_MAIN_TASK_STACK_SIZE,            "CONFIG_MAIN_TASK_STACK_SIZE" },
+    { "IP-task",    ipconfigIP_TASK_STACK_SIZE_WORDS,       "ipconfigIP_TASK_STACK_SIZE_WORDS" },
+    { "iot_thread", IOT_THREAD_DEFAULT_STACK_SIZE,          "IOT_THREAD_DEFAULT_STACK_SIZE" },
+    { "iot_thread", democonfigDEMO_STACKSIZE,               "democonfigDEMO_STACKSIZE" },
+    { "MQTT",       mqttconfigMQTT_TASK_STACK_DEPTH,        "mqttconfigMQTT_TASK_STACK_DEPTH" },
+    { "OTA Task",   otaconfigSTACK_SIZE,                    "otaconfigSTACK_SIZE" },
+};
+
+static stack_expect_t xExpected[STACK_EXPECT_MAX];
+static size_t xExpectedCount = 0;
+static portMUX_TYPE xExpectedMux = portMUX_INITIALIZER_UNLOCKED;
+
+static stack_record_t xRecords[M5CONFIG_STACK_MAX_TASKS];
+static size_t xRecordCount = 0;
+static bool bRecordsFull = false;
+
+/* Filled by uxTaskGetSystemState, kept out of the stack of the timer task */
+static TaskStatus_t xTaskStatus[M5CONFIG_STACK_MAX_TASKS];
+
+static SemaphoreHandle_t xStackMutex = NULL;
+static m5stickc_scheduler_job_t xStackJob = NULL;
+static uint32_t ulSamples = 0;
+
+/*-----------------------------------------------------------*/
+
+static stack_record_t *prvFindRecord(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        if (strncmp(xRecords[i].name, name, sizeof(xRecords[i].name)) == 0)
+        {
+            return &xRecords[i];
+        }
+    }
+
+    if (xRecordCount == M5CONFIG_STACK_MAX_TASKS)
+    {
+        bRecordsFull = true;
+        return NULL;
+    }
+
+    strncpy(xRecords[xRecordCount].name, name, sizeof(xRecords[xRecordCount].name) - 1);
+    xRecords[xRecordCount].free_min = UINT32_MAX;
+
+    return &xRecords[xRecordCount++];
+}
+
+/**
+ * @brief Used bytes plus the margin, rounded up.
+ */
+static uint32_t prvRecommended(uint32_t size, uint32_t free_min)
+{
+    uint32_t used = free_min < size ? size - free_min : 0;
+    uint32_t margin = used * M5CONFIG_STACK_MARGIN_PERCENT / 100;
+
+    if (margin < M5CONFIG_STACK_MARGIN_MIN)
+    {
+        margin = M5CONFIG_STACK_MARGIN_MIN;
+    }
+
+    return STACK_ROUND_UP(used + margin);
+}
+
+/**
+ * @brief Print the recommended value of one setting. Must be called with the mutex held.
+ *
+ * @return true if the setting is below the margin.
+ */
+static bool prvReportSetting(const stack_expect_t *pxExpected)
+{
+    stack_record_t *pxRecord = NULL;
+    uint32_t ulRecommended;
+    size_t i;
+
+    for (i = 0; i < xRecordCount && pxRecord == NULL; i++)
+    {
+        if (strncmp(xRecords[i].name, pxExpected->task, sizeof(xRecords[i].name)) == 0)
+        {
+            pxRecord = &xRecords[i];
+        }
+    }
+
+    /* Never ran, nothing to say */
+    if (pxRecord == NULL)
+    {
+        return false;
+    }
+
+    ulRecommended = prvRecommended(pxExpected->size, pxRecord->free_min);
+
+    if (ulRecommended < pxExpected->size)
+    {
+        ESP_LOGI(TAG, "#define %-36s %6u /* was %u, %u bytes reclaimed per %s */", pxExpected->setting,
+                 ulRecommended, pxExpected->size, pxExpected->size - ulRecommended, pxExpected->task);
+    }
+    else if (ulRecommended > pxExpected->size)
+    {
+        /* A row of the table, the summary warning follows it */
+        ESP_LOGI(TAG, "#define %-36s %6u /* was %u, below the margin */", pxExpected->setting,
+                 ulRecommended, pxExpected->size);
+        return true;
+    }
+
+    return false;
+}
+
+static void prvSample(void)
+{
+    UBaseType_t uxCount, i;
+
+    uxCount = uxTaskGetSystemState(xTaskStatus, M5CONFIG_STACK_MAX_TASKS, NULL);
+
+    if (uxCount == 0)
+    {
+        ESP_LOGW(TAG, "prvSample: more than %u tasks, increase M5CONFIG_STACK_MAX_TASKS", M5CONFIG_STACK_MAX_TASKS);
+        return;
+    }
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        xRecords[i].alive = false;
+    }
+
+    for (i = 0; i < uxCount; i++)
+    {
+        stack_record_t *pxRecord = prvFindRecord(xTaskStatus[i].pcTaskName);
+
+        if (pxRecord == NULL)
+        {
+            continue;
+        }
+
+        pxRecord->alive = true;
+        if (xTaskStatus[i].usStackHighWaterMark < pxRecord->free_min)
+        {
+            pxRecord->free_min = xTaskStatus[i].usStackHighWaterMark;
+        }
+    }
+
+    ulSamples++;
+}
+
+static void prvStackJobCallback(void *context)
+{
+    xSemaphoreTake(xStackMutex, portMAX_DELAY);
+    prvSample();
+    xSemaphoreGive(xStackMutex);
+
+    if (M5CONFIG_STACK_REPORT_SAMPLES > 0 && ulSamples % M5CONFIG_STACK_REPORT_SAMPLES == 0)
+    {
+        m5stickc_stack_report();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_stack_expect(const char *task, uint32_t size, const char *setting)
+{
+    esp_err_t res = ESP_ERR_NO_MEM;
+
+    portENTER_CRITICAL(&xExpectedMux);
+    if (xExpectedCount < STACK_EXPECT_MAX)
+    {
+        xExpected[xExpectedCount].task = task;
+        xExpected[xExpectedCount].size = size;
+        xExpected[xExpectedCount].setting = setting;
+        xExpectedCount++;
+        res = ESP_OK;
+    }
+    portEXIT_CRITICAL(&xExpectedMux);
+
+    return res;
+}
+
+esp_err_t m5stickc_stack_monitor_start(void)
+{
+#if configUSE_TRACE_FACILITY
+    if (xStackJob != NULL)
+    {
+        return ESP_OK;
+    }
+
+    xStackMutex = xSemaphoreCreateMutex();
+    if (xStackMutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The boot tasks are gone by now, but the walk still catches the others early */
+    prvSample();
+
+    xStackJob = m5stickc_scheduler_add("stack", M5CONFIG_STACK_SAMPLE_PERIOD_MS, M5CONFIG_STACK_SAMPLE_SLACK_MS, true, prvStackJobCallback, NULL);
+
+    return xStackJob != NULL ? ESP_OK : ESP_FAIL;
+#else
+    ESP_LOGW(TAG, "m5stickc_stack_monitor_start: needs CONFIG_FREERTOS_USE_TRACE_FACILITY");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void m5stickc_stack_report(void)
+{
+    unsigned int uBelowMargin = 0;
+    size_t i;
+
+    if (xStackMutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(xStackMutex, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "%-16s %8s %6s", "Task", "Free min", "Alive");
+
+    for (i = 0; i < xRecordCount; i++)
+    {
+        ESP_LOGI(TAG, "%-16s %8u %6s", xRecords[i].name, xRecords[i].free_min, xRecords[i].alive ? "yes" : "no");
+    }
+
+    ESP_LOGI(TAG, "Recommended stack sizes, %u%% or at least %u bytes over the peak usage:",
+             M5CONFIG_STACK_MARGIN_PERCENT, M5CONFIG_STACK_MARGIN_MIN);
+
+    for (i = 0; i < sizeof(xKnown) / sizeof(xKnown[0]); i++)
+    {
+        uBelowMargin += prvReportSetting(&xKnown[i]);
+    }
+
+    for (i = 0; i < xExpectedCount; i++)
+    {
+        uBelowMargin += prvReportSetting(&xExpected[i]);
+    }
+
+    if (uBelowMargin > 0)
+    {
+        ESP_LOGW(TAG, "%u stack sizes below the margin, see the recommended sizes above", uBelowMargin);
+    }
+
+    if (bRecordsFull)
+    {
+        ESP_LOGW(TAG, "Some tasks were not recorded, increase M5CONFIG_STACK_MAX_TASKS");
+    }
+
+    xSemaphoreGive(xStackMutex);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,36 @@
+/**
+ * @file m5stickc_stack.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_STACK_H_
+#define _M5STICKC_STACK_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief Declare the stack size a task is created with, and the setting it
+ * comes from, so that the report can recommend a new value for it. The system
+ * and library tasks are already known. The strings are stored as pointers, so
+ * they have to be string literals.
+ */
+esp_err_t m5stickc_stack_expect(const char *task, uint32_t size, const char *setting);
+
+/**
+ * @brief Walk the tasks every M5CONFIG_STACK_SAMPLE_PERIOD_MS on the scheduler,
+ * and keep the lowest stack high water mark seen for each task name, including
+ * the tasks that are deleted since.
+ */
+esp_err_t m5stickc_stack_monitor_start(void);
+
+/**
+ * @brief Print the high water marks on the serial console, followed by the
+ * recommended stack sizes with the margins of M5CONFIG_STACK_MARGIN_*.
+ */
+void m5stickc_stack_report(void);
+
+#endif /* ifndef _M5STICKC_STACK_H_ */
@@ -0,0 +1,123 @@
+/**
+ * @file m5stickc_user_input.c
+ * @brief Answer to the BLE numeric comparison, read from UART0.
+ *
+ * The numeric comparison of Amazon FreeRTOS only looks at the first character
+ * of the message, and frees it with vPortFree. Every message is read into a
+ * block of the same small size, and the rest of the input is dropped, so that
+ * the block freed by the caller is reused by the next message instead of
+ * fragmenting the heap. The host soak test of m5stickc/tests/user_input checks
+ * that the heap stays flat over many messages.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+#include "m5stickc_lab_config.h"
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "driver/uart.h"
+
+#if BLE_ENABLED
+
+#include "iot_ble_numericComparison.h"
+
+#include "m5stickc_mem.h"
+#include "m5stickc_user_input.h"
+
+/*-----------------------------------------------------------*/
+
+static void prvUartHighWater(size_t xEventSize)
+{
+    static size_t xRxHighWater = 0;
+    static UBaseType_t uxQueueHighWater = 0;
+    size_t xBuffered = 0;
+    /* The event being handled was in the queue too. */
+    UBaseType_t uxWaiting = uxQueueMessagesWaiting(spp_uart_queue) + 1;
+
+    uart_get_buffered_data_len(UART_NUM_0, &xBuffered);
+    xBuffered = (xBuffered > xEventSize) ? xBuffered : xEventSize;
+
+    /* Only logged when a peak is exceeded, the values to size the
+     * M5CONFIG_UART_* buffers with. */
+    if (xBuffered > xRxHighWater || uxWaiting > uxQueueHighWater)
+    {
+        xRxHighWater = (xBuffered > xRxHighWater) ? xBuffered : xRxHighWater;
+        uxQueueHighWater = (uxWaiting > uxQueueHighWater) ? uxWaiting : uxQueueHighWater;
+
+        configPRINTF(("UART0 high water: RX %u of %u bytes, events %u of %u\n",
+                      (unsigned)xRxHighWater, (unsigned)M5CONFIG_UART_RX_BUFFER_SIZE,
+                      (unsigned)uxQueueHighWater, (unsigned)M5CONFIG_UART_EVENT_QUEUE_LENGTH));
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t getUserMessage(INPUTMessage_t *pxINPUTmessage, TickType_t xAuthTimeout)
+{
+    uart_event_t xEvent;
+    BaseType_t xReturnMessage = pdFALSE;
+    int xLength;
+
+    if (!xQueueReceive(spp_uart_queue, (void *)&xEvent, (portTickType)xAuthTimeout))
+    {
+        return pdFALSE;
+    }
+
+    /* Event of UART receiving data */
+    if (xEvent.type != UART_DATA)
+    {
+        return pdFALSE;
+    }
+
+    prvUartHighWater(xEvent.size);
+
+    if (xEvent.size == 0)
+    {
+        return pdFALSE;
+    }
+
+    pxINPUTmessage->pcData = (uint8_t *)pvPortMalloc(M5STICKC_USER_MESSAGE_LENGTH);
+
+    if (pxINPUTmessage->pcData == NULL)
+    {
+        configPRINTF(("Malloc failed in m5stickc_user_input.c\n"));
+        return pdFALSE;
+    }
+
+    /* Freed by the numeric comparison with vPortFree, only the allocation
+     * rate can be tracked. */
+    m5stickc_mem_count(M5STICKC_MEM_USER_MESSAGE);
+
+    xLength = uart_read_bytes(UART_NUM_0, (uint8_t *)pxINPUTmessage->pcData,
+                              (xEvent.size < M5STICKC_USER_MESSAGE_LENGTH) ? xEvent.size : M5STICKC_USER_MESSAGE_LENGTH - 1,
+                              xAuthTimeout);
+
+    if (xEvent.size >= M5STICKC_USER_MESSAGE_LENGTH)
+    {
+        uart_flush_input(UART_NUM_0);
+    }
+
+    if (xLength > 0)
+    {
+        pxINPUTmessage->pcData[xLength] = '\0';
+        xReturnMessage = pdTRUE;
+    }
+    else
+    {
+        vPortFree(pxINPUTmessage->pcData);
+        pxINPUTmessage->pcData = NULL;
+    }
+
+    return xReturnMessage;
+}
+
+#endif /* if BLE_ENABLED */
+
+/*-----------------------------------------------------------*/
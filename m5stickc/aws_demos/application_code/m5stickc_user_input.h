@@ -0,0 +1,29 @@
+/**
+ * @file m5stickc_user_input.h
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _M5STICKC_USER_INPUT_H_
+#define _M5STICKC_USER_INPUT_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/**
+ * @brief Size of the block holding the user input, terminator included.
+ */
+#define M5STICKC_USER_MESSAGE_LENGTH    ( 8 )
+
+/**
+ * @brief UART0 events, the queue of uart_driver_install in main.c.
+ *
+ * getUserMessage (see iot_ble_numericComparison.h) reads the BLE numeric
+ * comparison answer from it. Every message is returned in a block of
+ * M5STICKC_USER_MESSAGE_LENGTH bytes from pvPortMalloc, that the caller
+ * frees with vPortFree.
+ */
+extern QueueHandle_t spp_uart_queue;
+
+#endif /* ifndef _M5STICKC_USER_INPUT_H_ */
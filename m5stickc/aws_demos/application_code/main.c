@@ -70,13 +70,27 @@
     #include "iot_ble_numericComparison.h"
 #endif
 
+#include "m5stickc_lab_config.h"
 #include "m5stickc_demo.h"
+#include "m5stickc_boot.h"
+#include "m5stickc_boot_trace.h"
+#include "m5stickc_provisioning.h"
+#include "m5stickc_log.h"
+#include "m5stickc_mem.h"
+#include "m5stickc_stack.h"
+#include "m5stickc_user_input.h"
 
 /* Logging Task Defines. */
 #define mainLOGGING_MESSAGE_QUEUE_LENGTH    ( 32 )
 #define mainLOGGING_TASK_STACK_SIZE         ( configMINIMAL_STACK_SIZE * 4 )
 #define mainDEVICE_NICK_NAME                "Espressif_Demo"
 
+/* Boot step Defines. The radio steps go to the protocol core, the board ones
+ * to the application core. Both are ignored with CONFIG_FREERTOS_UNICORE. */
+#define mainBOOT_STEP_STACK_SIZE            ( 4096 )
+#define mainBOOT_RADIO_CORE                 ( 0 )
+#define mainBOOT_BOARD_CORE                 ( 1 )
+
 QueueHandle_t spp_uart_queue = NULL;
 
 /* Static arrays for FreeRTOS+TCP stack initialization for Ethernet network connections
@@ -85,9 +99,78 @@ QueueHandle_t spp_uart_queue = NULL;
  * FreeRTOSConfig.h. */
 
 /**
- * @brief Initializes the board.
+ * @brief Boot steps, in dependency order.
  */
-static void prvMiscInitialization( void );
+static esp_err_t prvNvsInit( void );
+static esp_err_t prvLoggingInit( void );
+static esp_err_t prvIPInit( void );
+static esp_err_t prvSystemInit( void );
+static esp_err_t prvKeyProvisioning( void );
+static esp_err_t prvBLEInit( void );
+
+enum
+{
+    mainBOOT_NVS,
+    mainBOOT_LOGGING,
+    mainBOOT_IP,
+    mainBOOT_SYSTEM,
+    mainBOOT_KEYS,
+    mainBOOT_BLE,
+    mainBOOT_DISPLAY,
+    mainBOOT_POWER
+};
+
+static const m5stickc_boot_step_t xBootSteps[] =
+{
+    [ mainBOOT_NVS ] =
+    {
+        "nvs_init", prvNvsInit,
+        0,
+        mainBOOT_STEP_STACK_SIZE, tskNO_AFFINITY
+    },
+    [ mainBOOT_LOGGING ] =
+    {
+        "logging_task", prvLoggingInit,
+        0,
+        mainBOOT_STEP_STACK_SIZE, tskNO_AFFINITY
+    },
+    [ mainBOOT_IP ] =
+    {
+        "ip_init", prvIPInit,
+        M5STICKC_BOOT_DEP( mainBOOT_NVS ),
+        mainBOOT_STEP_STACK_SIZE, mainBOOT_RADIO_CORE
+    },
+    [ mainBOOT_SYSTEM ] =
+    {
+        "system_init", prvSystemInit,
+        M5STICKC_BOOT_DEP( mainBOOT_LOGGING ),
+        mainBOOT_STEP_STACK_SIZE, tskNO_AFFINITY
+    },
+    [ mainBOOT_KEYS ] =
+    {
+        "key_provisioning", prvKeyProvisioning,
+        M5STICKC_BOOT_DEP( mainBOOT_NVS ) | M5STICKC_BOOT_DEP( mainBOOT_SYSTEM ),
+        mainBOOT_STEP_STACK_SIZE, tskNO_AFFINITY
+    },
+    [ mainBOOT_BLE ] =
+    {
+        "ble_init", prvBLEInit,
+        M5STICKC_BOOT_DEP( mainBOOT_NVS ),
+        mainBOOT_STEP_STACK_SIZE, mainBOOT_RADIO_CORE
+    },
+    [ mainBOOT_DISPLAY ] =
+    {
+        "display", m5stickc_demo_display_init,
+        0,
+        mainBOOT_STEP_STACK_SIZE, mainBOOT_BOARD_CORE
+    },
+    [ mainBOOT_POWER ] =
+    {
+        "power", m5stickc_demo_power_init,
+        0,
+        mainBOOT_STEP_STACK_SIZE, mainBOOT_BOARD_CORE
+    },
+};
 
 #if BLE_ENABLED
 /* Initializes bluetooth */
@@ -102,32 +185,18 @@ static void prvMiscInitialization( void );
  */
 int app_main( void )
 {
-    /* Perform any hardware initialization that does not require the RTOS to be
-     * running.  */
+    m5stickc_boot_trace_mark( "app_main" );
 
-    prvMiscInitialization();
+    /* Before the boot steps, so that they can use the binary log, and so
+     * that the TLS allocations of the key provisioning are tracked. */
+    m5stickc_log_init();
+    m5stickc_mem_init();
 
-    if( SYSTEM_Init() == pdPASS )
+    /* NVS, the network stack, the key provisioning, the radio and the board
+     * are initialized concurrently, each step as soon as its dependencies are
+     * done. The demos only run if every step succeeded. */
+    if( m5stickc_boot_run( xBootSteps, sizeof( xBootSteps ) / sizeof( xBootSteps[ 0 ] ) ) == ESP_OK )
     {
-        /* A simple example to demonstrate key and certificate provisioning in
-         * microcontroller flash using PKCS#11 interface. This should be replaced
-         * by production ready key provisioning mechanism. */
-        vDevModeKeyProvisioning();
-
-        #if BLE_ENABLED
-            /* Initialize BLE. */
-            if( prvBLEStackInit() != ESP_OK )
-            {
-                configPRINTF( ( "Failed to initialize the bluetooth stack\n " ) );
-
-                while( 1 )
-                {
-                }
-            }
-        #else
-            ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_CLASSIC_BT ) );
-            ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_BLE ) );
-        #endif /* if BLE_ENABLED */
         /* Run all demos. */
         DEMO_RUNNER_RunDemos();
     }
@@ -141,8 +210,8 @@ int app_main( void )
 }
 
 /*-----------------------------------------------------------*/
-extern void vApplicationIPInit( void );
-static void prvMiscInitialization( void )
+
+static esp_err_t prvNvsInit( void )
 {
     /* Initialize NVS */
     esp_err_t ret = nvs_flash_init();
@@ -153,19 +222,83 @@ static void prvMiscInitialization( void )
         ret = nvs_flash_init();
     }
 
-    ESP_ERROR_CHECK( ret );
+    return ret;
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvLoggingInit( void )
+{
+    /* Create tasks that are not dependent on the WiFi being initialized. */
+    if( xLoggingTaskInitialize( mainLOGGING_TASK_STACK_SIZE,
+                                tskIDLE_PRIORITY + 5,
+                                mainLOGGING_MESSAGE_QUEUE_LENGTH ) != pdPASS )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    m5stickc_stack_expect( "Logging", mainLOGGING_TASK_STACK_SIZE, "mainLOGGING_TASK_STACK_SIZE" );
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+extern void vApplicationIPInit( void );
+static esp_err_t prvIPInit( void )
+{
+    vApplicationIPInit();
+
+    return ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvSystemInit( void )
+{
+    return SYSTEM_Init() == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvKeyProvisioning( void )
+{
+    /* Skipped when the credentials were already provisioned, which is the
+     * case on every wakeup from deep sleep. A failure is not fatal, the labs
+     * that do not connect to AWS IoT still run. */
+    if( m5stickc_provisioning_run() != ESP_OK )
+    {
+        configPRINTF( ( "Key provisioning failed, the connection to AWS IoT will fail.\r\n" ) );
+    }
+
+    return ESP_OK;
+}
 
+/*-----------------------------------------------------------*/
+
+static esp_err_t prvBLEInit( void )
+{
     #if BLE_ENABLED
+        esp_err_t xRet;
+
         NumericComparisonInit();
         spp_uart_init();
-    #endif
 
-    /* Create tasks that are not dependent on the WiFi being initialized. */
-    xLoggingTaskInitialize( mainLOGGING_TASK_STACK_SIZE,
-                            tskIDLE_PRIORITY + 5,
-                            mainLOGGING_MESSAGE_QUEUE_LENGTH );
+        /* Initialize BLE. */
+        xRet = prvBLEStackInit();
 
-    vApplicationIPInit();
+        if( xRet != ESP_OK )
+        {
+            configPRINTF( ( "Failed to initialize the bluetooth stack\n " ) );
+        }
+
+        return xRet;
+    #else
+        ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_CLASSIC_BT ) );
+        ESP_ERROR_CHECK( esp_bt_controller_mem_release( ESP_BT_MODE_BLE ) );
+
+        return ESP_OK;
+    #endif /* if BLE_ENABLED */
 }
 
 /*-----------------------------------------------------------*/
@@ -244,48 +377,12 @@ static void prvMiscInitialization( void )
         /*Set UART pins */
         uart_set_pin( UART_NUM_0, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE );
         /*Install UART driver, and get the queue. */
-        uart_driver_install( UART_NUM_0, 4096, 8192, 10, &spp_uart_queue, 0 );
-    }
-
-/*-----------------------------------------------------------*/
-
-    BaseType_t getUserMessage( INPUTMessage_t * pxINPUTmessage,
-                               TickType_t xAuthTimeout )
-    {
-        uart_event_t xEvent;
-        BaseType_t xReturnMessage = pdFALSE;
-
-        if( xQueueReceive( spp_uart_queue, ( void * ) &xEvent, ( portTickType ) xAuthTimeout ) )
-        {
-            switch( xEvent.type )
-            {
-                /*Event of UART receiving data */
-                case UART_DATA:
-
-                    if( xEvent.size )
-                    {
-                        pxINPUTmessage->pcData = ( uint8_t * ) malloc( sizeof( uint8_t ) * xEvent.size );
-
-                        if( pxINPUTmessage->pcData != NULL )
-                        {
-                            memset( pxINPUTmessage->pcData, 0x0, xEvent.size );
-                            uart_read_bytes( UART_NUM_0, ( uint8_t * ) pxINPUTmessage->pcData, xEvent.size, portMAX_DELAY );
-                            xReturnMessage = pdTRUE;
-                        }
-                        else
-                        {
-                            configPRINTF( ( "Malloc failed in main.c\n" ) );
-                        }
-                    }
-
-                    break;
-
-                default:
-                    break;
-            }
-        }
-
-        return xReturnMessage;
+        uart_driver_install( UART_NUM_0,
+                             M5CONFIG_UART_RX_BUFFER_SIZE,
+                             M5CONFIG_UART_TX_BUFFER_SIZE,
+                             M5CONFIG_UART_EVENT_QUEUE_LENGTH,
+                             &spp_uart_queue,
+                             0 );
     }
 #endif /* if BLE_ENABLED */
 
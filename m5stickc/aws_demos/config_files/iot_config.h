@@ -24,8 +24,9 @@
 #ifndef IOT_CONFIG_H_
 #define IOT_CONFIG_H_
 
-/* Standard include. */
+/* Standard includes. */
 #include <stdbool.h>
+#include <stddef.h>
 
 /* How long the MQTT library will wait for PINGRESPs or PUBACKs. */
 #define IOT_MQTT_RESPONSE_WAIT_MS               ( 10000 )
@@ -75,4 +76,55 @@ extern const IotMqttSerializer_t * demoGetMqttSerializer( void );
 /* Include the common configuration file for FreeRTOS. */
 #include "iot_config_common.h"
 
+/* Attribute the allocations of the MQTT, Shadow and task pool libraries to
+ * their subsystem, see m5stickc_mem.h. These replace the pvPortMalloc and
+ * vPortFree of the common configuration. */
+extern void * m5stickc_mem_mqtt_malloc( size_t size );
+extern void * m5stickc_mem_shadow_malloc( size_t size );
+extern void * m5stickc_mem_taskpool_malloc( size_t size );
+extern void m5stickc_mem_free( void * ptr );
+
+#undef IotMqtt_MallocConnection
+#undef IotMqtt_FreeConnection
+#undef IotMqtt_MallocMessage
+#undef IotMqtt_FreeMessage
+#undef IotMqtt_MallocOperation
+#undef IotMqtt_FreeOperation
+#undef IotMqtt_MallocSubscription
+#undef IotMqtt_FreeSubscription
+#define IotMqtt_MallocConnection         m5stickc_mem_mqtt_malloc
+#define IotMqtt_FreeConnection           m5stickc_mem_free
+#define IotMqtt_MallocMessage            m5stickc_mem_mqtt_malloc
+#define IotMqtt_FreeMessage              m5stickc_mem_free
+#define IotMqtt_MallocOperation          m5stickc_mem_mqtt_malloc
+#define IotMqtt_FreeOperation            m5stickc_mem_free
+#define IotMqtt_MallocSubscription       m5stickc_mem_mqtt_malloc
+#define IotMqtt_FreeSubscription         m5stickc_mem_free
+
+#undef AwsIotShadow_MallocOperation
+#undef AwsIotShadow_FreeOperation
+#undef AwsIotShadow_MallocString
+#undef AwsIotShadow_FreeString
+#undef AwsIotShadow_MallocSubscription
+#undef AwsIotShadow_FreeSubscription
+#define AwsIotShadow_MallocOperation     m5stickc_mem_shadow_malloc
+#define AwsIotShadow_FreeOperation       m5stickc_mem_free
+#define AwsIotShadow_MallocString        m5stickc_mem_shadow_malloc
+#define AwsIotShadow_FreeString          m5stickc_mem_free
+#define AwsIotShadow_MallocSubscription  m5stickc_mem_shadow_malloc
+#define AwsIotShadow_FreeSubscription    m5stickc_mem_free
+
+#undef IotTaskPool_MallocTaskPool
+#undef IotTaskPool_FreeTaskPool
+#undef IotTaskPool_MallocJob
+#undef IotTaskPool_FreeJob
+#undef IotTaskPool_MallocTimerEvent
+#undef IotTaskPool_FreeTimerEvent
+#define IotTaskPool_MallocTaskPool       m5stickc_mem_taskpool_malloc
+#define IotTaskPool_FreeTaskPool         m5stickc_mem_free
+#define IotTaskPool_MallocJob            m5stickc_mem_taskpool_malloc
+#define IotTaskPool_FreeJob              m5stickc_mem_free
+#define IotTaskPool_MallocTimerEvent     m5stickc_mem_taskpool_malloc
+#define IotTaskPool_FreeTimerEvent       m5stickc_mem_free
+
 #endif /* ifndef IOT_CONFIG_H_ */
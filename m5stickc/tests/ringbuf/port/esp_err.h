@@ -0,0 +1,22 @@
+/**
+ * @file esp_err.h
+ * @brief Host port of the ESP-IDF error codes used by the application code.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _ESP_ERR_H_
+#define _ESP_ERR_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK                      ( 0 )
+#define ESP_FAIL                    ( -1 )
+#define ESP_ERR_NO_MEM              ( 0x101 )
+#define ESP_ERR_INVALID_ARG         ( 0x102 )
+#define ESP_ERR_INVALID_STATE       ( 0x103 )
+#define ESP_ERR_NOT_FOUND           ( 0x105 )
+#define ESP_ERR_NOT_SUPPORTED       ( 0x106 )
+
+#endif /* ifndef _ESP_ERR_H_ */
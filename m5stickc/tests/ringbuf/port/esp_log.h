@@ -0,0 +1,43 @@
+/**
+ * @file esp_log.h
+ * @brief Host port of ESP_LOGx, printed on stdout. The level of each module is
+ * still set with LOG_LOCAL_LEVEL.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _ESP_LOG_H_
+#define _ESP_LOG_H_
+
+#include <stdio.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL     ESP_LOG_INFO
+#endif
+
+#define ESP_LOG_LEVEL_LOCAL( level, letter, tag, format, ... )                  \
+    do {                                                                        \
+        if( LOG_LOCAL_LEVEL >= ( level ) )                                      \
+        {                                                                       \
+            printf( letter " %s: " format "\n", tag, ## __VA_ARGS__ );          \
+        }                                                                       \
+    } while( 0 )
+
+#define ESP_LOGE( tag, format, ... )    ESP_LOG_LEVEL_LOCAL( ESP_LOG_ERROR, "E", tag, format, ## __VA_ARGS__ )
+#define ESP_LOGW( tag, format, ... )    ESP_LOG_LEVEL_LOCAL( ESP_LOG_WARN, "W", tag, format, ## __VA_ARGS__ )
+#define ESP_LOGI( tag, format, ... )    ESP_LOG_LEVEL_LOCAL( ESP_LOG_INFO, "I", tag, format, ## __VA_ARGS__ )
+#define ESP_LOGD( tag, format, ... )    ESP_LOG_LEVEL_LOCAL( ESP_LOG_DEBUG, "D", tag, format, ## __VA_ARGS__ )
+#define ESP_LOGV( tag, format, ... )    ESP_LOG_LEVEL_LOCAL( ESP_LOG_VERBOSE, "V", tag, format, ## __VA_ARGS__ )
+
+#endif /* ifndef _ESP_LOG_H_ */
@@ -0,0 +1,23 @@
+/**
+ * @file esp_timer.h
+ * @brief Host port of esp_timer_get_time, microseconds of the monotonic clock.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _ESP_TIMER_H_
+#define _ESP_TIMER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time( void )
+{
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( int64_t ) xNow.tv_sec * 1000000 + xNow.tv_nsec / 1000;
+}
+
+#endif /* ifndef _ESP_TIMER_H_ */
@@ -0,0 +1,65 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host port: the subset of the FreeRTOS API used by ringbuf.c, on POSIX threads.
+ *
+ * Every task is a thread. A critical section is one recursive mutex shared by
+ * all of them, as on a single core port. Ticks are milliseconds.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdTRUE                              ( ( BaseType_t ) 1 )
+#define pdFALSE                             ( ( BaseType_t ) 0 )
+#define pdPASS                              ( pdTRUE )
+#define pdFAIL                              ( pdFALSE )
+
+#define portMAX_DELAY                       ( ( TickType_t ) 0xFFFFFFFFUL )
+#define portTickType                        TickType_t
+#define portBYTE_ALIGNMENT_MASK             ( 3 )
+#define portTICK_PERIOD_MS                  ( 1 )
+#define pdMS_TO_TICKS( xTimeInMs )          ( ( TickType_t ) ( xTimeInMs ) )
+
+#define configASSERT( x )                   assert( x )
+#define configPRINTF( X )                   printf X
+#define configSUPPORT_STATIC_ALLOCATION     ( 1 )
+#define configSUPPORT_DYNAMIC_ALLOCATION    ( 1 )
+#define tskIDLE_PRIORITY                    ( ( UBaseType_t ) 0 )
+
+void vPortEnterCritical( void );
+void vPortExitCritical( void );
+
+/* Not in port.c: provided by the tests that need them, to count the allocations */
+void * pvPortMalloc( size_t xSize );
+void vPortFree( void * pv );
+
+#define taskENTER_CRITICAL()                vPortEnterCritical()
+#define taskEXIT_CRITICAL()                 vPortExitCritical()
+
+typedef struct HostSemaphore * QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef QueueHandle_t QueueSetHandle_t;
+typedef QueueHandle_t QueueSetMemberHandle_t;
+typedef struct HostTask * TaskHandle_t;
+
+/* Large enough for struct HostSemaphore, checked in port.c */
+typedef struct
+{
+    void * pvDummy[ 24 ];
+} StaticSemaphore_t;
+
+#endif /* INC_FREERTOS_H */
@@ -0,0 +1,30 @@
+/**
+ * @file queue.h
+ * @brief Host port, see FreeRTOS.h. The queue sets only record their last member.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef INC_QUEUE_H
+#define INC_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xQueueAddToSet( QueueSetMemberHandle_t xQueueOrSemaphore,
+                           QueueSetHandle_t xQueueSet );
+BaseType_t xQueueRemoveFromSet( QueueSetMemberHandle_t xQueueOrSemaphore,
+                                QueueSetHandle_t xQueueSet );
+
+/**
+ * @brief The member added by the last xQueueAddToSet.
+ */
+QueueSetMemberHandle_t xHostQueueSetLastMember( void );
+
+/* Not in port.c: provided by the tests that need them, as the fake of a driver queue */
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * const pvBuffer,
+                          TickType_t xTicksToWait );
+UBaseType_t uxQueueMessagesWaiting( const QueueHandle_t xQueue );
+
+#endif /* INC_QUEUE_H */
@@ -0,0 +1,28 @@
+/**
+ * @file semphr.h
+ * @brief Host port, see FreeRTOS.h.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include "freertos/queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void );
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic( StaticSemaphore_t * pxSemaphoreBuffer );
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount );
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xBlockTime );
+BaseType_t xSemaphoreTakeFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken );
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore );
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken );
+UBaseType_t uxSemaphoreGetCount( SemaphoreHandle_t xSemaphore );
+void vSemaphoreDelete( SemaphoreHandle_t xSemaphore );
+
+#endif /* SEMAPHORE_H */
@@ -0,0 +1,41 @@
+/**
+ * @file task.h
+ * @brief Host port, see FreeRTOS.h.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (* TaskFunction_t)( void * );
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask );
+void vTaskDelete( TaskHandle_t xTaskToDelete );
+void vTaskDelay( const TickType_t xTicksToDelay );
+TickType_t xTaskGetTickCount( void );
+TaskHandle_t xTaskGetCurrentTaskHandle( void );
+UBaseType_t uxTaskPriorityGet( TaskHandle_t xTask );
+void vTaskSuspendAll( void );
+BaseType_t xTaskResumeAll( void );
+
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait );
+BaseType_t xTaskNotifyGive( TaskHandle_t xTaskToNotify );
+void vTaskNotifyGiveFromISR( TaskHandle_t xTaskToNotify,
+                             BaseType_t * pxHigherPriorityTaskWoken );
+
+/**
+ * @brief Tasks created with xTaskCreate that have not returned or deleted themselves yet.
+ */
+UBaseType_t uxHostTasksRunning( void );
+
+#endif /* INC_TASK_H */
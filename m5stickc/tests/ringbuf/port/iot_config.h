@@ -0,0 +1,7 @@
+/**
+ * @file iot_config.h
+ * @brief Host port: the application code includes it first, nothing is needed from it.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
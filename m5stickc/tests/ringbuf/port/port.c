@@ -0,0 +1,390 @@
+/**
+ * @file port.c
+ * @brief Host port: the subset of the FreeRTOS API used by ringbuf.c, on POSIX threads.
+ *
+ * The semaphores are a counter, a mutex and a condition variable. The task
+ * notifications are a counting semaphore per task. The priorities are only
+ * recorded, for ringbuf.c to order its waiters: the threads all run at the
+ * same priority, on as many cores as the host has, which exercises the locking
+ * of ringbuf.c harder than the device does.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct HostSemaphore
+{
+    pthread_mutex_t xMutex;
+    pthread_cond_t xCondition;
+    UBaseType_t uxCount;
+    UBaseType_t uxMaxCount;
+    bool bStatic;
+};
+
+struct HostTask
+{
+    pthread_t xThread;
+    TaskFunction_t pxTaskCode;
+    void * pvParameters;
+    UBaseType_t uxPriority;
+    struct HostSemaphore * pxNotification;
+};
+
+_Static_assert( sizeof( StaticSemaphore_t ) >= sizeof( struct HostSemaphore ), "StaticSemaphore_t is too small" );
+
+static pthread_mutex_t xCriticalMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread struct HostTask * pxCurrentTask = NULL;
+static struct HostTask xMainTask = { .uxPriority = tskIDLE_PRIORITY + 1 };
+static UBaseType_t uxTasksRunning = 0;
+static QueueSetMemberHandle_t xLastSetMember = NULL;
+
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    pthread_mutex_lock( &xCriticalMutex );
+}
+
+void vPortExitCritical( void )
+{
+    pthread_mutex_unlock( &xCriticalMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+static struct HostSemaphore * prvCreateSemaphore( UBaseType_t uxMaxCount,
+                                                  UBaseType_t uxInitialCount,
+                                                  void * pvStorage )
+{
+    struct HostSemaphore * pxSemaphore = pvStorage ? pvStorage : calloc( 1, sizeof( *pxSemaphore ) );
+
+    if( pxSemaphore == NULL )
+    {
+        return NULL;
+    }
+
+    pthread_mutex_init( &pxSemaphore->xMutex, NULL );
+    pthread_cond_init( &pxSemaphore->xCondition, NULL );
+    pxSemaphore->uxCount = uxInitialCount;
+    pxSemaphore->uxMaxCount = uxMaxCount;
+    pxSemaphore->bStatic = ( pvStorage != NULL );
+
+    return pxSemaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void )
+{
+    return prvCreateSemaphore( 1, 0, NULL );
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic( StaticSemaphore_t * pxSemaphoreBuffer )
+{
+    return prvCreateSemaphore( 1, 0, pxSemaphoreBuffer );
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount )
+{
+    return prvCreateSemaphore( uxMaxCount, uxInitialCount, NULL );
+}
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xBlockTime )
+{
+    struct timespec xDeadline;
+    BaseType_t xResult = pdTRUE;
+
+    clock_gettime( CLOCK_REALTIME, &xDeadline );
+
+    if( xBlockTime != portMAX_DELAY )
+    {
+        xDeadline.tv_sec += xBlockTime / 1000;
+        xDeadline.tv_nsec += ( long ) ( xBlockTime % 1000 ) * 1000000L;
+
+        if( xDeadline.tv_nsec >= 1000000000L )
+        {
+            xDeadline.tv_sec++;
+            xDeadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock( &xSemaphore->xMutex );
+
+    while( xSemaphore->uxCount == 0 )
+    {
+        if( xBlockTime == 0 )
+        {
+            xResult = pdFALSE;
+            break;
+        }
+
+        if( xBlockTime == portMAX_DELAY )
+        {
+            pthread_cond_wait( &xSemaphore->xCondition, &xSemaphore->xMutex );
+        }
+        else if( ( pthread_cond_timedwait( &xSemaphore->xCondition, &xSemaphore->xMutex, &xDeadline ) == ETIMEDOUT ) &&
+                 ( xSemaphore->uxCount == 0 ) )
+        {
+            xResult = pdFALSE;
+            break;
+        }
+    }
+
+    if( xResult == pdTRUE )
+    {
+        xSemaphore->uxCount--;
+    }
+
+    pthread_mutex_unlock( &xSemaphore->xMutex );
+
+    return xResult;
+}
+
+BaseType_t xSemaphoreTakeFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken )
+{
+    return xSemaphoreTake( xSemaphore, 0 );
+}
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore )
+{
+    BaseType_t xResult = pdFALSE;
+
+    pthread_mutex_lock( &xSemaphore->xMutex );
+
+    if( xSemaphore->uxCount < xSemaphore->uxMaxCount )
+    {
+        xSemaphore->uxCount++;
+        pthread_cond_signal( &xSemaphore->xCondition );
+        xResult = pdTRUE;
+    }
+
+    pthread_mutex_unlock( &xSemaphore->xMutex );
+
+    return xResult;
+}
+
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xSemaphore,
+                                  BaseType_t * pxHigherPriorityTaskWoken )
+{
+    return xSemaphoreGive( xSemaphore );
+}
+
+UBaseType_t uxSemaphoreGetCount( SemaphoreHandle_t xSemaphore )
+{
+    UBaseType_t uxCount;
+
+    pthread_mutex_lock( &xSemaphore->xMutex );
+    uxCount = xSemaphore->uxCount;
+    pthread_mutex_unlock( &xSemaphore->xMutex );
+
+    return uxCount;
+}
+
+void vSemaphoreDelete( SemaphoreHandle_t xSemaphore )
+{
+    pthread_cond_destroy( &xSemaphore->xCondition );
+    pthread_mutex_destroy( &xSemaphore->xMutex );
+
+    if( !xSemaphore->bStatic )
+    {
+        free( xSemaphore );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueAddToSet( QueueSetMemberHandle_t xQueueOrSemaphore,
+                           QueueSetHandle_t xQueueSet )
+{
+    xLastSetMember = xQueueOrSemaphore;
+    return pdPASS;
+}
+
+BaseType_t xQueueRemoveFromSet( QueueSetMemberHandle_t xQueueOrSemaphore,
+                                QueueSetHandle_t xQueueSet )
+{
+    return pdPASS;
+}
+
+QueueSetMemberHandle_t xHostQueueSetLastMember( void )
+{
+    return xLastSetMember;
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTaskThread( void * pvTask )
+{
+    pxCurrentTask = pvTask;
+    pxCurrentTask->pxTaskCode( pxCurrentTask->pvParameters );
+
+    /* A task function must not return, the host tolerates it */
+    vTaskDelete( NULL );
+
+    return NULL;
+}
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    struct HostTask * pxTask = calloc( 1, sizeof( *pxTask ) );
+
+    if( pxTask == NULL )
+    {
+        return pdFAIL;
+    }
+
+    pxTask->pxTaskCode = pxTaskCode;
+    pxTask->pvParameters = pvParameters;
+    pxTask->uxPriority = uxPriority;
+    pxTask->pxNotification = prvCreateSemaphore( UINT32_MAX, 0, NULL );
+
+    if( pxCreatedTask != NULL )
+    {
+        *pxCreatedTask = pxTask;
+    }
+
+    __atomic_add_fetch( &uxTasksRunning, 1, __ATOMIC_SEQ_CST );
+
+    if( pthread_create( &pxTask->xThread, NULL, prvTaskThread, pxTask ) != 0 )
+    {
+        __atomic_sub_fetch( &uxTasksRunning, 1, __ATOMIC_SEQ_CST );
+        return pdFAIL;
+    }
+
+    pthread_detach( pxTask->xThread );
+
+    return pdPASS;
+}
+
+void vTaskDelete( TaskHandle_t xTaskToDelete )
+{
+    /* Only the calling task can be deleted. Its control block is leaked:
+     * another task may still hold the handle and notify it. */
+    configASSERT( xTaskToDelete == NULL || xTaskToDelete == pxCurrentTask );
+
+    __atomic_sub_fetch( &uxTasksRunning, 1, __ATOMIC_SEQ_CST );
+    pthread_exit( NULL );
+}
+
+UBaseType_t uxHostTasksRunning( void )
+{
+    return __atomic_load_n( &uxTasksRunning, __ATOMIC_SEQ_CST );
+}
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    struct timespec xDelay = { xTicksToDelay / 1000, ( long ) ( xTicksToDelay % 1000 ) * 1000000L };
+
+    nanosleep( &xDelay, NULL );
+}
+
+static struct timespec xTickStart;
+static pthread_once_t xTickStartOnce = PTHREAD_ONCE_INIT;
+
+static void prvStartTicks( void )
+{
+    clock_gettime( CLOCK_MONOTONIC, &xTickStart );
+}
+
+TickType_t xTaskGetTickCount( void )
+{
+    struct timespec xNow;
+
+    pthread_once( &xTickStartOnce, prvStartTicks );
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( TickType_t ) ( ( xNow.tv_sec - xTickStart.tv_sec ) * 1000 + ( xNow.tv_nsec - xTickStart.tv_nsec ) / 1000000 );
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    if( pxCurrentTask == NULL )
+    {
+        /* The main thread, and the threads not created by xTaskCreate, share one task */
+        vPortEnterCritical();
+
+        if( xMainTask.pxNotification == NULL )
+        {
+            xMainTask.pxNotification = prvCreateSemaphore( UINT32_MAX, 0, NULL );
+        }
+
+        vPortExitCritical();
+
+        pxCurrentTask = &xMainTask;
+    }
+
+    return pxCurrentTask;
+}
+
+UBaseType_t uxTaskPriorityGet( TaskHandle_t xTask )
+{
+    return ( xTask ? xTask : xTaskGetCurrentTaskHandle() )->uxPriority;
+}
+
+void vTaskSuspendAll( void )
+{
+    vPortEnterCritical();
+}
+
+BaseType_t xTaskResumeAll( void )
+{
+    vPortExitCritical();
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait )
+{
+    struct HostSemaphore * pxNotification = xTaskGetCurrentTaskHandle()->pxNotification;
+    uint32_t ulValue;
+
+    if( xSemaphoreTake( pxNotification, xTicksToWait ) != pdTRUE )
+    {
+        return 0;
+    }
+
+    /* Value before it was decremented or cleared */
+    pthread_mutex_lock( &pxNotification->xMutex );
+    ulValue = ( uint32_t ) pxNotification->uxCount + 1;
+
+    if( xClearCountOnExit != pdFALSE )
+    {
+        pxNotification->uxCount = 0;
+    }
+
+    pthread_mutex_unlock( &pxNotification->xMutex );
+
+    return ulValue;
+}
+
+BaseType_t xTaskNotifyGive( TaskHandle_t xTaskToNotify )
+{
+    xSemaphoreGive( xTaskToNotify->pxNotification );
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR( TaskHandle_t xTaskToNotify,
+                             BaseType_t * pxHigherPriorityTaskWoken )
+{
+    xSemaphoreGive( xTaskToNotify->pxNotification );
+}
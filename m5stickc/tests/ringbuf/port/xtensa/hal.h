@@ -0,0 +1,32 @@
+/**
+ * @file hal.h
+ * @brief Host port of the cycle counter read by m5stickc_rbbench.c. Nanoseconds
+ * where there is no time stamp counter.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _XTENSA_HAL_H_
+#define _XTENSA_HAL_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+static inline uint32_t xthal_get_ccount( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    return ( uint32_t ) __rdtsc();
+#else
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( uint32_t ) ( xNow.tv_sec * 1000000000ULL + xNow.tv_nsec );
+#endif
+}
+
+#endif /* ifndef _XTENSA_HAL_H_ */
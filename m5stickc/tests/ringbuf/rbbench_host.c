@@ -0,0 +1,46 @@
+/**
+ * @file rbbench_host.c
+ * @brief Runs m5stickc_rbbench.c on the host, on the pthread shim of port/.
+ *
+ * The figures only compare the ring buffer variants with each other: the
+ * threads of the port run on every core of the host, and its critical
+ * sections are a mutex.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#include "m5stickc_rbbench.h"
+#include "m5stickc_stack.h"
+
+/*-----------------------------------------------------------*/
+
+esp_err_t m5stickc_stack_expect(const char *task, uint32_t size, const char *setting)
+{
+    return ESP_OK;
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (m5stickc_rbbench_start() != ESP_OK)
+    {
+        printf("m5stickc_rbbench_start failed\n");
+        return 1;
+    }
+
+    /* The bench task deletes itself once it is done */
+    while (uxHostTasksRunning() > 0)
+    {
+        vTaskDelay(100);
+    }
+
+    return 0;
+}
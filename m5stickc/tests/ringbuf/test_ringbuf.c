@@ -0,0 +1,1456 @@
+/**
+ * @file test_ringbuf.c
+ * @brief Correctness tests of freertos/ringbuf.c, built on the host with the pthread shim of port/.
+ *
+ * Every item carries a sequence number and a pattern derived from it, so that
+ * the tests check the order and the content of every item they get back, the
+ * ones that wrapped around the end of the buffer (split items, dummy data)
+ * included. The tests that need concurrency run their producers and consumers
+ * as tasks of the port, which are threads: they are not paced by a scheduler
+ * as on the device, and run on several cores at once.
+ *
+ *      test_ringbuf            run every test
+ *      test_ringbuf <name>     run one test, see xTests
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+/*-----------------------------------------------------------*/
+
+#define TEST_CHECK(x)                                                           \
+    do {                                                                        \
+        if (!(x))                                                               \
+        {                                                                       \
+            printf("    %s:%d: check failed: %s\n", __FILE__, __LINE__, #x);    \
+            __atomic_add_fetch(&lTestFailures, 1, __ATOMIC_SEQ_CST);            \
+        }                                                                       \
+    } while (0)
+
+/* Largest item of the tests, sequence number included */
+#define TEST_ITEM_MAX           ( 256 )
+
+/* Time for a task to block, or to run once it is woken */
+#define TEST_SETTLE_MS          ( 30 )
+
+/* Same layout as ItemHeader_t of ringbuf.c */
+#define TEST_HEADER_SIZE        ( sizeof( size_t ) + sizeof( UBaseType_t ) )
+
+typedef struct {
+    const char *name;
+    void (*test)(void);
+} test_t;
+
+static int lTestFailures = 0;
+
+/* Called by every memcpy() while set, memcpy() is wrapped at link time (see CMakeLists.txt) */
+static void (*pxCopyHook)(size_t xSize) = NULL;
+
+void *__real_memcpy(void *pvDest, const void *pvSource, size_t xSize);
+
+void *__wrap_memcpy(void *pvDest, const void *pvSource, size_t xSize)
+{
+    if (pxCopyHook != NULL)
+    {
+        pxCopyHook(xSize);
+    }
+
+    return __real_memcpy(pvDest, pvSource, xSize);
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Item of producer ucProducer with sequence number ulSequence: the
+ * producer, the sequence number, and a pattern depending on both and on the size.
+ */
+static void prvFill(uint8_t *pucItem, uint8_t ucProducer, uint32_t ulSequence, size_t xSize)
+{
+    size_t i;
+
+    pucItem[0] = ucProducer;
+    memcpy(pucItem + 1, &ulSequence, sizeof(ulSequence));
+
+    for (i = 5; i < xSize; i++)
+    {
+        pucItem[i] = (uint8_t)(ulSequence + i + xSize + ucProducer);
+    }
+}
+
+/**
+ * @brief Check an item of prvFill, and that it is the next one of its producer.
+ * With bGaps, items may be missing (dropped by an overwriting buffer), never reordered.
+ */
+static bool prvCheck(const uint8_t *pucItem, size_t xSize, uint32_t *pulNext, uint8_t ucProducers, bool bGaps)
+{
+    uint32_t ulSequence;
+    size_t i;
+
+    if (xSize < 5 || pucItem[0] >= ucProducers)
+    {
+        return false;
+    }
+
+    memcpy(&ulSequence, pucItem + 1, sizeof(ulSequence));
+
+    if (bGaps ? ulSequence < pulNext[pucItem[0]] : ulSequence != pulNext[pucItem[0]])
+    {
+        return false;
+    }
+
+    for (i = 5; i < xSize; i++)
+    {
+        if (pucItem[i] != (uint8_t)(ulSequence + i + xSize + pucItem[0]))
+        {
+            return false;
+        }
+    }
+
+    pulNext[pucItem[0]] = ulSequence + 1;
+
+    return true;
+}
+
+/**
+ * @brief Receive an item of a no-split or allow-split buffer, joined into pucItem.
+ */
+static bool prvReceiveJoined(RingbufHandle_t xRingbuffer, ringbuf_type_t xType, uint8_t *pucItem, size_t *pxSize, TickType_t xTicksToWait)
+{
+    void *pvHead = NULL, *pvTail = NULL;
+    size_t xHeadSize = 0, xTailSize = 0;
+
+    if (xType == RINGBUF_TYPE_ALLOWSPLIT)
+    {
+        if (xRingbufferReceiveSplit(xRingbuffer, &pvHead, &pvTail, &xHeadSize, &xTailSize, xTicksToWait) != pdTRUE)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        pvHead = xRingbufferReceive(xRingbuffer, &xHeadSize, xTicksToWait);
+        if (pvHead == NULL)
+        {
+            return false;
+        }
+    }
+
+    memcpy(pucItem, pvHead, xHeadSize);
+    vRingbufferReturnItem(xRingbuffer, pvHead);
+
+    if (pvTail != NULL)
+    {
+        memcpy(pucItem + xHeadSize, pvTail, xTailSize);
+        vRingbufferReturnItem(xRingbuffer, pvTail);
+    }
+
+    *pxSize = xHeadSize + xTailSize;
+
+    return true;
+}
+
+static UBaseType_t prvItemsWaiting(RingbufHandle_t xRingbuffer)
+{
+    UBaseType_t uxItemsWaiting;
+
+    vRingbufferGetInfo(xRingbuffer, NULL, NULL, NULL, &uxItemsWaiting);
+
+    return uxItemsWaiting;
+}
+
+static RingbufStats_t prvStats(RingbufHandle_t xRingbuffer)
+{
+    RingbufStats_t xStats;
+
+    vRingbufferGetStats(xRingbuffer, &xStats);
+
+    return xStats;
+}
+
+static void prvWaitFor(volatile int *plCount, int lExpected)
+{
+    while (__atomic_load_n(plCount, __ATOMIC_SEQ_CST) < lExpected)
+    {
+        vTaskDelay(1);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Keep the buffer as full as it gets with items of every size, so that
+ * the items wrap around the end of the buffer at every possible offset.
+ */
+static void prvStream(ringbuf_type_t xType, size_t xBufferSize)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(xBufferSize, xType);
+    size_t xMaxSize = xRingbufferGetMaxItemSize(xRingbuffer);
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulSent = 0, ulNext[1] = { 0 };
+    size_t xSize;
+    RingbufStats_t xStats;
+
+    if (xMaxSize > 60)
+    {
+        xMaxSize = 60;
+    }
+
+    while (ulNext[0] < 2000)
+    {
+        xSize = 5 + (ulSent * 7) % (xMaxSize - 4);
+        prvFill(pucItem, 0, ulSent, xSize);
+
+        if (xRingbufferSend(xRingbuffer, pucItem, xSize, 0) == pdTRUE)
+        {
+            ulSent++;
+            continue;
+        }
+
+        /* Full: make room for the item that did not fit */
+        TEST_CHECK(prvReceiveJoined(xRingbuffer, xType, pucItem, &xSize, 0));
+        TEST_CHECK(prvCheck(pucItem, xSize, ulNext, 1, false));
+    }
+
+    while (prvReceiveJoined(xRingbuffer, xType, pucItem, &xSize, 0))
+    {
+        TEST_CHECK(prvCheck(pucItem, xSize, ulNext, 1, false));
+    }
+
+    xStats = prvStats(xRingbuffer);
+
+    TEST_CHECK(ulNext[0] == ulSent);
+    TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+    TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+    TEST_CHECK(xStats.uxItemsSent == ulSent);
+
+    if (xType == RINGBUF_TYPE_ALLOWSPLIT)
+    {
+        TEST_CHECK(xStats.uxSplitItems > 0);
+    }
+    else
+    {
+        TEST_CHECK(xStats.uxSplitItems == 0);
+        TEST_CHECK(xStats.uxDummyWraps > 0);
+    }
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+static void prvTestNoSplitWraparound(void)
+{
+    prvStream(RINGBUF_TYPE_NOSPLIT, 128);
+    prvStream(RINGBUF_TYPE_NOSPLIT, 500);
+}
+
+static void prvTestAllowSplitWraparound(void)
+{
+    prvStream(RINGBUF_TYPE_ALLOWSPLIT, 128);
+    prvStream(RINGBUF_TYPE_ALLOWSPLIT, 500);
+}
+
+static void prvTestByteWraparound(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(100, RINGBUF_TYPE_BYTEBUF);
+    uint8_t pucChunk[40], ucNextSent = 0, ucNextReceived = 0;
+    uint32_t ulSent = 0, ulReceived = 0, i = 0;
+    uint8_t *pucData;
+    size_t xSize, j;
+
+    while (ulSent < 20000)
+    {
+        xSize = 1 + (i * 13) % sizeof(pucChunk);
+
+        for (j = 0; j < xSize; j++)
+        {
+            pucChunk[j] = (uint8_t)(ucNextSent + j);
+        }
+
+        if (xRingbufferSend(xRingbuffer, pucChunk, xSize, 0) == pdTRUE)
+        {
+            ucNextSent += xSize;
+            ulSent += xSize;
+            i++;
+            continue;
+        }
+
+        /* Never more than asked, and never across the end of the buffer */
+        pucData = xRingbufferReceiveUpTo(xRingbuffer, &xSize, 0, 1 + i % 50);
+        TEST_CHECK(pucData != NULL);
+        if (pucData == NULL)
+        {
+            break;
+        }
+        TEST_CHECK(xSize <= 1 + i % 50);
+
+        for (j = 0; j < xSize; j++)
+        {
+            TEST_CHECK(pucData[j] == ucNextReceived);
+            ucNextReceived++;
+        }
+        ulReceived += xSize;
+
+        vRingbufferReturnItem(xRingbuffer, pucData);
+        i++;
+    }
+
+    while ((pucData = xRingbufferReceive(xRingbuffer, &xSize, 0)) != NULL)
+    {
+        for (j = 0; j < xSize; j++)
+        {
+            TEST_CHECK(pucData[j] == ucNextReceived);
+            ucNextReceived++;
+        }
+        ulReceived += xSize;
+        vRingbufferReturnItem(xRingbuffer, pucData);
+    }
+
+    TEST_CHECK(ulReceived == ulSent);
+    TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == 100);
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+/**
+ * @brief An item that does not fit before the end of a no-split buffer leaves
+ * dummy data there, and is written at the start of the buffer.
+ */
+static void prvTestDummyData(void)
+{
+    /* Room for 4 items of 16 bytes */
+    size_t xBufferSize = 4 * (16 + TEST_HEADER_SIZE);
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(xBufferSize, RINGBUF_TYPE_NOSPLIT);
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint8_t *pucFirst, *pucData, *pucWrapped;
+    uint32_t ulNext[1] = { 0 };
+    size_t xSize;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        prvFill(pucItem, 0, i, 16);
+        TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 16, 0) == pdTRUE);
+    }
+
+    pucFirst = xRingbufferReceive(xRingbuffer, &xSize, 0);
+    TEST_CHECK(pucFirst != NULL && prvCheck(pucFirst, xSize, ulNext, 1, false));
+    vRingbufferReturnItem(xRingbuffer, pucFirst);
+
+    pucData = xRingbufferReceive(xRingbuffer, &xSize, 0);
+    TEST_CHECK(pucData != NULL && prvCheck(pucData, xSize, ulNext, 1, false));
+    vRingbufferReturnItem(xRingbuffer, pucData);
+
+    /* Room for one item of 16 left at the end: an item of 24 goes to the start */
+    prvFill(pucItem, 0, 3, 24);
+    TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 24, 0) == pdTRUE);
+    TEST_CHECK(prvStats(xRingbuffer).uxDummyWraps == 1);
+
+    pucData = xRingbufferReceive(xRingbuffer, &xSize, 0);
+    TEST_CHECK(pucData != NULL && prvCheck(pucData, xSize, ulNext, 1, false));
+    vRingbufferReturnItem(xRingbuffer, pucData);
+
+    pucWrapped = xRingbufferReceive(xRingbuffer, &xSize, 0);
+    TEST_CHECK(pucWrapped == pucFirst);
+    TEST_CHECK(pucWrapped != NULL && xSize == 24 && prvCheck(pucWrapped, xSize, ulNext, 1, false));
+    vRingbufferReturnItem(xRingbuffer, pucWrapped);
+
+    TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+    TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+/**
+ * @brief Fill the buffer to the last byte, where the write pointer catches up
+ * with the free pointer, then empty it.
+ */
+static uint32_t prvFillUpWith(RingbufHandle_t xRingbuffer, size_t xItemSize, uint32_t *pulSent)
+{
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulFilled = 0;
+
+    for (;;)
+    {
+        prvFill(pucItem, 0, *pulSent, xItemSize);
+        if (xRingbufferSend(xRingbuffer, pucItem, xItemSize, 0) != pdTRUE)
+        {
+            return ulFilled;
+        }
+        (*pulSent)++;
+        ulFilled++;
+    }
+}
+
+static void prvReceiveChecked(RingbufHandle_t xRingbuffer, ringbuf_type_t xType, size_t xItemSize, uint32_t *pulNext)
+{
+    uint8_t pucItem[TEST_ITEM_MAX], *pucData;
+    size_t xSize = 0;
+
+    if (xType == RINGBUF_TYPE_BYTEBUF)
+    {
+        /* Byte buffers do not keep the items apart */
+        pucData = xRingbufferReceiveUpTo(xRingbuffer, &xSize, 0, xItemSize);
+        TEST_CHECK(pucData != NULL && xSize == xItemSize);
+        if (pucData != NULL)
+        {
+            memcpy(pucItem, pucData, xSize);
+            vRingbufferReturnItem(xRingbuffer, pucData);
+        }
+    }
+    else
+    {
+        TEST_CHECK(prvReceiveJoined(xRingbuffer, xType, pucItem, &xSize, 0));
+    }
+
+    TEST_CHECK(prvCheck(pucItem, xSize, pulNext, 1, false));
+}
+
+static void prvTestFullBuffer(void)
+{
+    ringbuf_type_t xTypes[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF };
+    size_t xItemSize = 16, t;
+    uint32_t ulNext[1], ulSent;
+
+    for (t = 0; t < 3; t++)
+    {
+        /* Room for 4 items exactly, or 4 chunks of a byte buffer */
+        size_t xBufferSize = 4 * (xItemSize + (xTypes[t] == RINGBUF_TYPE_BYTEBUF ? 0 : TEST_HEADER_SIZE));
+        RingbufHandle_t xRingbuffer = xRingbufferCreate(xBufferSize, xTypes[t]);
+
+        ulNext[0] = 0;
+        ulSent = 0;
+
+        /* Full from the start of the buffer */
+        TEST_CHECK(prvFillUpWith(xRingbuffer, xItemSize, &ulSent) == 4);
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == 0);
+
+        prvReceiveChecked(xRingbuffer, xTypes[t], xItemSize, ulNext);
+        prvReceiveChecked(xRingbuffer, xTypes[t], xItemSize, ulNext);
+
+        /* Full again from its middle, the write pointer back on the free pointer */
+        TEST_CHECK(prvFillUpWith(xRingbuffer, xItemSize, &ulSent) == 2);
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == 0);
+
+        while (ulNext[0] < ulSent)
+        {
+            prvReceiveChecked(xRingbuffer, xTypes[t], xItemSize, ulNext);
+        }
+
+        TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+        TEST_CHECK(prvFillUpWith(xRingbuffer, xItemSize, &ulSent) == 4);
+
+        vRingbufferDelete(xRingbuffer);
+    }
+}
+
+/**
+ * @brief Every item of a full buffer received before any is returned: the read
+ * pointer ends on the free pointer, and the first item returned must free the
+ * items in front of the next one still held, whatever the order of the returns.
+ */
+static void prvTestFullBufferHeld(void)
+{
+    static const int lOrders[][4] = { { 0, 1, 2, 3 }, { 2, 0, 3, 1 }, { 3, 2, 1, 0 } };
+    size_t xItemSize = 16, xSize, o;
+    RingbufItem_t xItems[4];
+    uint8_t *pucItems[4];
+    uint32_t ulNext[1] = { 0 }, ulSent = 0;
+    int i;
+
+    for (o = 0; o < sizeof(lOrders) / sizeof(lOrders[0]); o++)
+    {
+        RingbufHandle_t xRingbuffer = xRingbufferCreate(4 * (xItemSize + TEST_HEADER_SIZE), RINGBUF_TYPE_NOSPLIT);
+
+        ulNext[0] = ulSent;
+        TEST_CHECK(prvFillUpWith(xRingbuffer, xItemSize, &ulSent) == 4);
+
+        for (i = 0; i < 4; i++)
+        {
+            pucItems[i] = xRingbufferReceive(xRingbuffer, &xSize, 0);
+            TEST_CHECK(pucItems[i] != NULL && prvCheck(pucItems[i], xSize, ulNext, 1, false));
+        }
+
+        for (i = 0; i < 4; i++)
+        {
+            if (pucItems[lOrders[o][i]] != NULL)
+            {
+                vRingbufferReturnItem(xRingbuffer, pucItems[lOrders[o][i]]);
+            }
+        }
+
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+        TEST_CHECK(prvFillUpWith(xRingbuffer, xItemSize, &ulSent) == 4);
+
+        /* Same with a batch, returned at once */
+        ulNext[0] = ulSent - 4;
+        TEST_CHECK(uxRingbufferReceiveMultiple(xRingbuffer, xItems, 4, 0) == 4);
+        for (i = 0; i < 4; i++)
+        {
+            TEST_CHECK(prvCheck(xItems[i].pvHeadItem, xItems[i].xHeadItemSize, ulNext, 1, false));
+        }
+        vRingbufferReturnMultiple(xRingbuffer, xItems, 4);
+
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+
+        vRingbufferDelete(xRingbuffer);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct {
+    RingbufHandle_t xRingbuffer;
+    ringbuf_type_t xType;
+    uint8_t ucProducer;
+    uint32_t ulItems;
+    size_t xMaxSize;
+    bool bAcquire;
+    bool bFromISR;
+    volatile int *plDone;
+} test_producer_t;
+
+static void prvProducerTask(void *pvParameters)
+{
+    test_producer_t *pxProducer = pvParameters;
+    unsigned int uSeed = pxProducer->ucProducer + 1;
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint8_t *pucSlot;
+    uint32_t i;
+    size_t xSize;
+    BaseType_t xResult;
+
+    for (i = 0; i < pxProducer->ulItems; i++)
+    {
+        xSize = 5 + rand_r(&uSeed) % (pxProducer->xMaxSize - 4);
+
+        if (pxProducer->bAcquire && rand_r(&uSeed) % 2)
+        {
+            /* Filled in place, sometimes slowly so that later items complete first */
+            xResult = xRingbufferSendAcquire(pxProducer->xRingbuffer, (void **)&pucSlot, xSize, portMAX_DELAY);
+            TEST_CHECK(xResult == pdTRUE);
+            if (xResult != pdTRUE)
+            {
+                continue;
+            }
+            if (rand_r(&uSeed) % 16 == 0)
+            {
+                vTaskDelay(1);
+            }
+            prvFill(pucSlot, pxProducer->ucProducer, i, xSize);
+            xResult = xRingbufferSendComplete(pxProducer->xRingbuffer, pucSlot);
+            TEST_CHECK(xResult == pdTRUE);
+        }
+        else if (pxProducer->bFromISR && rand_r(&uSeed) % 4 == 0)
+        {
+            prvFill(pucItem, pxProducer->ucProducer, i, xSize);
+            while (xRingbufferSendFromISR(pxProducer->xRingbuffer, pucItem, xSize, NULL) != pdTRUE)
+            {
+                vTaskDelay(0);
+            }
+        }
+        else
+        {
+            prvFill(pucItem, pxProducer->ucProducer, i, xSize);
+            /* Short timeouts too, to exercise the waiters that give up */
+            while (xRingbufferSend(pxProducer->xRingbuffer, pucItem, xSize, rand_r(&uSeed) % 2 ? portMAX_DELAY : 1) != pdTRUE)
+            {
+            }
+        }
+    }
+
+    __atomic_add_fetch(pxProducer->plDone, 1, __ATOMIC_SEQ_CST);
+    vTaskDelete(NULL);
+}
+
+static void prvStartProducers(test_producer_t *pxProducers, uint8_t ucProducers, RingbufHandle_t xRingbuffer, ringbuf_type_t xType,
+                              uint32_t ulItems, bool bAcquire, bool bFromISR, volatile int *plDone)
+{
+    BaseType_t xResult;
+    uint8_t i;
+
+    for (i = 0; i < ucProducers; i++)
+    {
+        pxProducers[i].xRingbuffer = xRingbuffer;
+        pxProducers[i].xType = xType;
+        pxProducers[i].ucProducer = i;
+        pxProducers[i].ulItems = ulItems;
+        pxProducers[i].xMaxSize = xRingbufferGetMaxItemSize(xRingbuffer) < TEST_ITEM_MAX ? xRingbufferGetMaxItemSize(xRingbuffer) : TEST_ITEM_MAX;
+        pxProducers[i].bAcquire = bAcquire;
+        pxProducers[i].bFromISR = bFromISR;
+        pxProducers[i].plDone = plDone;
+
+        xResult = xTaskCreate(prvProducerTask, "prod", 4096, &pxProducers[i], tskIDLE_PRIORITY + 1 + i % 2, NULL);
+        TEST_CHECK(xResult == pdPASS);
+    }
+}
+
+static void prvTestSPSC(void)
+{
+    static const size_t xSizes[] = { 64, 100, 132, 1000 };
+    test_producer_t xProducer;
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulNext[1];
+    volatile int lDone;
+    uint8_t *pucData;
+    size_t i, xSize;
+
+    for (i = 0; i < sizeof(xSizes) / sizeof(xSizes[0]); i++)
+    {
+        RingbufHandle_t xRingbuffer = xRingbufferCreateSPSC(xSizes[i], RINGBUF_TYPE_NOSPLIT);
+
+        lDone = 0;
+        ulNext[0] = 0;
+        prvStartProducers(&xProducer, 1, xRingbuffer, RINGBUF_TYPE_NOSPLIT, 20000, i % 2 == 1, false, &lDone);
+
+        while (ulNext[0] < 20000)
+        {
+            pucData = xRingbufferReceive(xRingbuffer, &xSize, 1000);
+            TEST_CHECK(pucData != NULL);
+            if (pucData == NULL)
+            {
+                break;
+            }
+            TEST_CHECK(prvCheck(pucData, xSize, ulNext, 1, false));
+            vRingbufferReturnItem(xRingbuffer, pucData);
+        }
+
+        prvWaitFor(&lDone, 1);
+        TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+        vRingbufferDelete(xRingbuffer);
+    }
+
+    /* Byte stream */
+    {
+        RingbufHandle_t xRingbuffer = xRingbufferCreateSPSC(100, RINGBUF_TYPE_BYTEBUF);
+        uint8_t ucNext = 0;
+        uint32_t ulSent = 0, ulReceived = 0;
+
+        for (i = 0; ulSent < 20000; i++)
+        {
+            xSize = 1 + (i * 13) % 40;
+            for (size_t j = 0; j < xSize; j++)
+            {
+                pucItem[j] = (uint8_t)(ulSent + j);
+            }
+
+            if (xRingbufferSend(xRingbuffer, pucItem, xSize, 0) == pdTRUE)
+            {
+                ulSent += xSize;
+            }
+
+            while ((pucData = xRingbufferReceiveUpTo(xRingbuffer, &xSize, 0, 1 + i % 30)) != NULL)
+            {
+                for (size_t j = 0; j < xSize; j++)
+                {
+                    TEST_CHECK(pucData[j] == ucNext);
+                    ucNext++;
+                }
+                ulReceived += xSize;
+                vRingbufferReturnItem(xRingbuffer, pucData);
+                if (i % 3)
+                {
+                    break;
+                }
+            }
+        }
+
+        while ((pucData = xRingbufferReceive(xRingbuffer, &xSize, 0)) != NULL)
+        {
+            ulReceived += xSize;
+            vRingbufferReturnItem(xRingbuffer, pucData);
+        }
+
+        TEST_CHECK(ulReceived == ulSent);
+        vRingbufferDelete(xRingbuffer);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTestAcquireComplete(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(256, RINGBUF_TYPE_NOSPLIT);
+    test_producer_t xProducers[3];
+    uint32_t ulNext[3] = { 0 };
+    uint8_t *pucFirst, *pucSecond, *pucData;
+    volatile int lDone = 0;
+    size_t xSize;
+    uint32_t i;
+
+    /* An item completed before the one in front of it waits for it */
+    TEST_CHECK(xRingbufferSendAcquire(xRingbuffer, (void **)&pucFirst, 20, 0) == pdTRUE);
+    TEST_CHECK(xRingbufferSendAcquire(xRingbuffer, (void **)&pucSecond, 30, 0) == pdTRUE);
+    prvFill(pucSecond, 0, 1, 30);
+    TEST_CHECK(xRingbufferSendComplete(xRingbuffer, pucSecond) == pdTRUE);
+    TEST_CHECK(xRingbufferReceive(xRingbuffer, &xSize, 0) == NULL);
+
+    prvFill(pucFirst, 0, 0, 20);
+    TEST_CHECK(xRingbufferSendComplete(xRingbuffer, pucFirst) == pdTRUE);
+
+    for (i = 0; i < 2; i++)
+    {
+        pucData = xRingbufferReceive(xRingbuffer, &xSize, 0);
+        TEST_CHECK(pucData != NULL && prvCheck(pucData, xSize, ulNext, 1, false));
+        vRingbufferReturnItem(xRingbuffer, pucData);
+    }
+
+    vRingbufferDelete(xRingbuffer);
+
+    /* Producers completing out of order */
+    memset(ulNext, 0, sizeof(ulNext));
+    xRingbuffer = xRingbufferCreate(600, RINGBUF_TYPE_NOSPLIT);
+    prvStartProducers(xProducers, 3, xRingbuffer, RINGBUF_TYPE_NOSPLIT, 5000, true, false, &lDone);
+
+    for (i = 0; i < 3 * 5000; i++)
+    {
+        pucData = xRingbufferReceive(xRingbuffer, &xSize, 1000);
+        TEST_CHECK(pucData != NULL);
+        if (pucData == NULL)
+        {
+            break;
+        }
+        TEST_CHECK(prvCheck(pucData, xSize, ulNext, 3, false));
+        vRingbufferReturnItem(xRingbuffer, pucData);
+    }
+
+    prvWaitFor(&lDone, 3);
+    TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+    vRingbufferDelete(xRingbuffer);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTestBatch(void)
+{
+    ringbuf_type_t xTypes[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT };
+    RingbufItem_t xItems[4];
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulNext[1], ulSent;
+    UBaseType_t uxCount, j;
+    bool bSplit = false;
+    size_t i, xSize;
+
+    for (i = 0; i < 2; i++)
+    {
+        RingbufHandle_t xRingbuffer = xRingbufferCreate(200, xTypes[i]);
+
+        ulNext[0] = 0;
+        ulSent = 0;
+
+        /* Nothing waiting: no item, after the timeout */
+        TEST_CHECK(uxRingbufferReceiveMultiple(xRingbuffer, xItems, 4, 1) == 0);
+
+        while (ulNext[0] < 500)
+        {
+            xSize = 5 + (ulSent * 11) % 40;
+            prvFill(pucItem, 0, ulSent, xSize);
+            while (xRingbufferSend(xRingbuffer, pucItem, xSize, 0) == pdTRUE)
+            {
+                ulSent++;
+                xSize = 5 + (ulSent * 11) % 40;
+                prvFill(pucItem, 0, ulSent, xSize);
+            }
+
+            uxCount = uxRingbufferReceiveMultiple(xRingbuffer, xItems, 1 + ulSent % 4, 0);
+            TEST_CHECK(uxCount > 0 && uxCount <= 1 + ulSent % 4);
+
+            for (j = 0; j < uxCount; j++)
+            {
+                memcpy(pucItem, xItems[j].pvHeadItem, xItems[j].xHeadItemSize);
+                if (xItems[j].pvTailItem != NULL)
+                {
+                    bSplit = true;
+                    memcpy(pucItem + xItems[j].xHeadItemSize, xItems[j].pvTailItem, xItems[j].xTailItemSize);
+                }
+                TEST_CHECK(prvCheck(pucItem, xItems[j].xHeadItemSize + xItems[j].xTailItemSize, ulNext, 1, false));
+            }
+
+            vRingbufferReturnMultiple(xRingbuffer, xItems, uxCount);
+        }
+
+        while ((uxCount = uxRingbufferReceiveMultiple(xRingbuffer, xItems, 4, 0)) > 0)
+        {
+            vRingbufferReturnMultiple(xRingbuffer, xItems, uxCount);
+        }
+
+        TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+        TEST_CHECK(xRingbufferGetCurFreeSize(xRingbuffer) == xRingbufferGetMaxItemSize(xRingbuffer));
+        vRingbufferDelete(xRingbuffer);
+    }
+
+    TEST_CHECK(bSplit);
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTestOverwrite(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(256, RINGBUF_TYPE_NOSPLIT);
+    uint8_t pucItem[TEST_ITEM_MAX], ucNext = 0, ucLast = 0;
+    uint32_t ulNext[1] = { 0 }, ulReceived = 0, ulSent = 0, i;
+    UBaseType_t uxDropped;
+    uint8_t *pucHeld, *pucData;
+    size_t xSize, j;
+    int lFailed = 0;
+
+    vRingbufferSetOverwrite(xRingbuffer, pdTRUE);
+
+    /* Every send succeeds, the oldest items are dropped */
+    for (i = 0; i < 100; i++)
+    {
+        prvFill(pucItem, 0, i, 5 + i % 30);
+        TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 5 + i % 30, 0) == pdTRUE);
+    }
+
+    while ((pucData = xRingbufferReceive(xRingbuffer, &xSize, 0)) != NULL)
+    {
+        TEST_CHECK(prvCheck(pucData, xSize, ulNext, 1, true));
+        ulReceived++;
+        vRingbufferReturnItem(xRingbuffer, pucData);
+    }
+
+    TEST_CHECK(ulNext[0] == 100);
+    TEST_CHECK(ulReceived + prvStats(xRingbuffer).uxDroppedItems == 100);
+
+    /* An item being read is never dropped: the sends fail until it is returned */
+    prvFill(pucItem, 0, 1000, 40);
+    xRingbufferSend(xRingbuffer, pucItem, 40, 0);
+    pucHeld = xRingbufferReceive(xRingbuffer, &xSize, 0);
+
+    for (i = 0; i < 50; i++)
+    {
+        prvFill(pucItem, 0, 2000 + i, 40);
+        lFailed += xRingbufferSend(xRingbuffer, pucItem, 40, 0) != pdTRUE;
+    }
+
+    ulNext[0] = 1000;
+    TEST_CHECK(pucHeld != NULL && prvCheck(pucHeld, xSize, ulNext, 1, false));
+    TEST_CHECK(lFailed > 0);
+
+    uxDropped = prvStats(xRingbuffer).uxDroppedItems;
+    vRingbufferReturnItem(xRingbuffer, pucHeld);
+
+    for (i = 0; i < 10; i++)
+    {
+        prvFill(pucItem, 0, 3000 + i, 40);
+        TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 40, 0) == pdTRUE);
+    }
+
+    TEST_CHECK(prvStats(xRingbuffer).uxDroppedItems > uxDropped);
+    vRingbufferDelete(xRingbuffer);
+
+    /* Byte buffer, from tasks and from ISRs: the newest bytes are kept, in order */
+    for (int lFromISR = 0; lFromISR < 2; lFromISR++)
+    {
+        xRingbuffer = xRingbufferCreate(100, RINGBUF_TYPE_BYTEBUF);
+        vRingbufferSetOverwrite(xRingbuffer, pdTRUE);
+        ucNext = 0;
+        ulSent = 0;
+        ulReceived = 0;
+
+        for (i = 0; i < 200; i++)
+        {
+            xSize = 1 + i % 37;
+            for (j = 0; j < xSize; j++)
+            {
+                pucItem[j] = ucNext++;
+            }
+
+            TEST_CHECK((lFromISR ? xRingbufferSendFromISR(xRingbuffer, pucItem, xSize, NULL)
+                                 : xRingbufferSend(xRingbuffer, pucItem, xSize, 0)) == pdTRUE);
+            ulSent += xSize;
+
+            if (i % 5 == 0 && (pucData = xRingbufferReceiveUpTo(xRingbuffer, &xSize, 0, 7)) != NULL)
+            {
+                for (j = 1; j < xSize; j++)
+                {
+                    TEST_CHECK(pucData[j] == (uint8_t)(pucData[j - 1] + 1));
+                }
+                ulReceived += xSize;
+                vRingbufferReturnItem(xRingbuffer, pucData);
+            }
+        }
+
+        while ((pucData = xRingbufferReceive(xRingbuffer, &xSize, 0)) != NULL)
+        {
+            for (j = 1; j < xSize; j++)
+            {
+                TEST_CHECK(pucData[j] == (uint8_t)(pucData[j - 1] + 1));
+            }
+            ulReceived += xSize;
+            ucLast = pucData[xSize - 1];
+            vRingbufferReturnItem(xRingbuffer, pucData);
+        }
+
+        TEST_CHECK(ucLast == (uint8_t)(ucNext - 1));
+        TEST_CHECK(ulReceived + prvStats(xRingbuffer).uxDroppedItems == ulSent);
+        vRingbufferDelete(xRingbuffer);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTestBroadcast(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreateBroadcast(256, 3);
+    RingbufReaderHandle_t xBlock = xRingbufferAddReader(xRingbuffer, RINGBUF_READER_BLOCK);
+    RingbufReaderHandle_t xDrop = xRingbufferAddReader(xRingbuffer, RINGBUF_READER_DROP);
+    RingbufReaderHandle_t xLate;
+    uint8_t pucItem[TEST_ITEM_MAX], pucOut[TEST_ITEM_MAX];
+    uint32_t ulBlockNext[1] = { 0 }, ulDropNext[1] = { 0 }, ulSent = 0;
+    UBaseType_t uxLate = 0, uxDropReceived = 0;
+    size_t xSize;
+
+    TEST_CHECK(xBlock != NULL && xDrop != NULL);
+
+    /* The blocking reader holds the writer back once the buffer is full */
+    while (ulSent < 100)
+    {
+        prvFill(pucItem, 0, ulSent, 20);
+        if (xRingbufferSend(xRingbuffer, pucItem, 20, 0) != pdTRUE)
+        {
+            break;
+        }
+        ulSent++;
+    }
+    TEST_CHECK(ulSent > 0 && ulSent < 100);
+
+    /* An item larger than the buffer stays unread */
+    TEST_CHECK(xRingbufferReceiveReader(xBlock, pucOut, 19, &xSize, 0) == pdFALSE);
+    TEST_CHECK(xSize == 20);
+
+    TEST_CHECK(xRingbufferReceiveReader(xBlock, pucOut, sizeof(pucOut), &xSize, 0) == pdTRUE);
+    TEST_CHECK(xSize == 20 && prvCheck(pucOut, xSize, ulBlockNext, 1, false));
+
+    prvFill(pucItem, 0, ulSent, 20);
+    TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 20, 0) == pdTRUE);
+    ulSent++;
+
+    while (xRingbufferReceiveReader(xBlock, pucOut, sizeof(pucOut), &xSize, 0) == pdTRUE)
+    {
+        TEST_CHECK(prvCheck(pucOut, xSize, ulBlockNext, 1, false));
+    }
+    TEST_CHECK(ulBlockNext[0] == ulSent);
+    TEST_CHECK(xSize == 0);
+
+    /* A late reader starts at the oldest item still in the buffer */
+    xLate = xRingbufferAddReader(xRingbuffer, RINGBUF_READER_DROP);
+    TEST_CHECK(xLate != NULL);
+    TEST_CHECK(xRingbufferAddReader(xRingbuffer, RINGBUF_READER_DROP) == NULL);
+
+    while (xRingbufferReceiveReader(xLate, pucOut, sizeof(pucOut), &xSize, 0) == pdTRUE)
+    {
+        uxLate++;
+    }
+    TEST_CHECK(uxLate > 0);
+
+    /* The dropping reader got every item, or counted it as dropped */
+    while (xRingbufferReceiveReader(xDrop, pucOut, sizeof(pucOut), &xSize, 0) == pdTRUE)
+    {
+        TEST_CHECK(prvCheck(pucOut, xSize, ulDropNext, 1, true));
+        uxDropReceived++;
+    }
+    TEST_CHECK(uxDropReceived + uxRingbufferGetReaderDropped(xDrop) == ulSent);
+
+    /* Without a blocking reader, the sends overwrite */
+    vRingbufferRemoveReader(xBlock);
+
+    for (ulSent = 0; ulSent < 100; ulSent++)
+    {
+        prvFill(pucItem, 0, ulSent, 20);
+        TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 20, 0) == pdTRUE);
+    }
+
+    TEST_CHECK(uxRingbufferGetReaderDropped(xDrop) > 0);
+    TEST_CHECK(prvStats(xRingbuffer).uxSendTimeouts > 0);
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+static RingbufHandle_t xPinnedRingbuffer;
+static BaseType_t xPinnedSent, xPinnedSentFromISR;
+
+static void prvSendWhileCopying(size_t xSize)
+{
+    uint8_t pucItem[100];
+
+    if (xSize != sizeof(pucItem))
+    {
+        return;
+    }
+
+    pxCopyHook = NULL;
+    prvFill(pucItem, 0, 100, sizeof(pucItem));
+    xPinnedSentFromISR = xRingbufferSendFromISR(xPinnedRingbuffer, pucItem, sizeof(pucItem), NULL);
+    xPinnedSent = xRingbufferSend(xPinnedRingbuffer, pucItem, sizeof(pucItem), 0);
+}
+
+/**
+ * @brief A reader copies its item out of the critical section: a send that
+ * would drop that item meanwhile fails, even for a reader that drops what it misses.
+ */
+static void prvTestBroadcastPinned(void)
+{
+    /* Room for 3 items of 100 bytes */
+    RingbufHandle_t xRingbuffer = xRingbufferCreateBroadcast(3 * (100 + TEST_HEADER_SIZE) + 8, 1);
+    RingbufReaderHandle_t xReader = xRingbufferAddReader(xRingbuffer, RINGBUF_READER_DROP);
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulNext[1] = { 0 }, i;
+    size_t xSize;
+
+    for (i = 0; i < 3; i++)
+    {
+        prvFill(pucItem, 0, i, 100);
+        TEST_CHECK(xRingbufferSend(xRingbuffer, pucItem, 100, 0) == pdTRUE);
+    }
+
+    xPinnedRingbuffer = xRingbuffer;
+    xPinnedSent = pdTRUE;
+    xPinnedSentFromISR = pdTRUE;
+    pxCopyHook = prvSendWhileCopying;
+
+    TEST_CHECK(xRingbufferReceiveReader(xReader, pucItem, sizeof(pucItem), &xSize, 0) == pdTRUE);
+    TEST_CHECK(pxCopyHook == NULL);
+    pxCopyHook = NULL;
+
+    TEST_CHECK(xPinnedSentFromISR == pdFALSE && xPinnedSent == pdFALSE);
+    TEST_CHECK(prvCheck(pucItem, xSize, ulNext, 1, false));
+    TEST_CHECK(uxRingbufferGetReaderDropped(xReader) == 0);
+
+    /* Once read, the item can be dropped */
+    prvFill(pucItem, 0, 3, 100);
+    TEST_CHECK(xRingbufferSendFromISR(xRingbuffer, pucItem, 100, NULL) == pdTRUE);
+
+    while (xRingbufferReceiveReader(xReader, pucItem, sizeof(pucItem), &xSize, 0) == pdTRUE)
+    {
+        TEST_CHECK(prvCheck(pucItem, xSize, ulNext, 1, false));
+    }
+    TEST_CHECK(ulNext[0] == 4);
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+typedef struct {
+    RingbufReaderHandle_t xReader;
+    uint8_t ucProducers;
+    volatile int *plStop;
+    volatile int *plDone;
+    int lErrors;
+    long lReceived;
+} test_reader_t;
+
+static void prvReaderTask(void *pvParameters)
+{
+    test_reader_t *pxReader = pvParameters;
+    uint8_t pucItem[TEST_ITEM_MAX];
+    uint32_t ulNext[4] = { 0 };
+    size_t xSize;
+
+    while (!__atomic_load_n(pxReader->plStop, __ATOMIC_SEQ_CST))
+    {
+        if (xRingbufferReceiveReader(pxReader->xReader, pucItem, sizeof(pucItem), &xSize, 10) == pdTRUE)
+        {
+            /* Dropped items are skipped, an item copied while it was overwritten would not check out */
+            pxReader->lErrors += !prvCheck(pucItem, xSize, ulNext, pxReader->ucProducers, true);
+            pxReader->lReceived++;
+        }
+
+        /* Fall behind now and then, to be reading the oldest item when it is needed */
+        if (pxReader->lReceived % 8 == 0)
+        {
+            vTaskDelay(1);
+        }
+    }
+
+    __atomic_add_fetch(pxReader->plDone, 1, __ATOMIC_SEQ_CST);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Readers that drop what they miss, copying large items out while the
+ * producers keep overwriting the oldest ones.
+ */
+static void prvTestBroadcastStress(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreateBroadcast(1024, 3);
+    test_producer_t xProducers[2];
+    test_reader_t xReaders[3];
+    volatile int lStop = 0, lProducersDone = 0, lReadersDone = 0;
+    BaseType_t xResult;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        xReaders[i] = (test_reader_t) { xRingbufferAddReader(xRingbuffer, RINGBUF_READER_DROP), 2, &lStop, &lReadersDone, 0, 0 };
+        xResult = xTaskCreate(prvReaderTask, "reader", 4096, &xReaders[i], tskIDLE_PRIORITY + 1, NULL);
+        TEST_CHECK(xResult == pdPASS);
+    }
+
+    prvStartProducers(xProducers, 2, xRingbuffer, RINGBUF_TYPE_NOSPLIT, 20000, false, true, &lProducersDone);
+    prvWaitFor(&lProducersDone, 2);
+    __atomic_store_n(&lStop, 1, __ATOMIC_SEQ_CST);
+    prvWaitFor(&lReadersDone, 3);
+
+    for (i = 0; i < 3; i++)
+    {
+        uint8_t pucItem[TEST_ITEM_MAX];
+        size_t xSize;
+
+        TEST_CHECK(xReaders[i].lErrors == 0);
+        TEST_CHECK(xReaders[i].lReceived > 0);
+
+        /* Every item was read once, or dropped once */
+        while (xRingbufferReceiveReader(xReaders[i].xReader, pucItem, sizeof(pucItem), &xSize, 0) == pdTRUE)
+        {
+            xReaders[i].lReceived++;
+        }
+        TEST_CHECK(xReaders[i].lReceived + uxRingbufferGetReaderDropped(xReaders[i].xReader) == 2 * 20000);
+    }
+
+    vRingbufferDelete(xRingbuffer);
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct {
+    RingbufHandle_t xRingbuffer;
+    size_t xSize;
+    TickType_t xTicksToWait;
+    TaskHandle_t xTask;
+    volatile int lDone;
+    volatile BaseType_t xResult;
+    volatile uint32_t ulNotified;       /* Notification value of the task once done */
+} test_waiter_t;
+
+static void prvSenderTask(void *pvParameters)
+{
+    test_waiter_t *pxWaiter = pvParameters;
+    uint8_t pucItem[TEST_ITEM_MAX] = { 0 };
+
+    pxWaiter->xResult = xRingbufferSend(pxWaiter->xRingbuffer, pucItem, pxWaiter->xSize, pxWaiter->xTicksToWait);
+    pxWaiter->ulNotified = ulTaskNotifyTake(pdTRUE, 0);
+    __atomic_store_n(&pxWaiter->lDone, 1, __ATOMIC_SEQ_CST);
+    vTaskDelete(NULL);
+}
+
+static void prvReceiverTask(void *pvParameters)
+{
+    test_waiter_t *pxWaiter = pvParameters;
+    size_t xSize;
+    void *pvItem = xRingbufferReceive(pxWaiter->xRingbuffer, &xSize, pxWaiter->xTicksToWait);
+
+    if (pvItem != NULL)
+    {
+        vRingbufferReturnItem(pxWaiter->xRingbuffer, pvItem);
+    }
+
+    pxWaiter->xResult = pvItem != NULL;
+    __atomic_store_n(&pxWaiter->lDone, 1, __ATOMIC_SEQ_CST);
+    vTaskDelete(NULL);
+}
+
+static void prvStartWaiter(TaskFunction_t pxTask, test_waiter_t *pxWaiter, RingbufHandle_t xRingbuffer,
+                           size_t xSize, TickType_t xTicksToWait, UBaseType_t uxPriority)
+{
+    BaseType_t xResult;
+
+    pxWaiter->xRingbuffer = xRingbuffer;
+    pxWaiter->xSize = xSize;
+    pxWaiter->xTicksToWait = xTicksToWait;
+    pxWaiter->lDone = 0;
+    pxWaiter->xResult = pdFALSE;
+
+    xResult = xTaskCreate(pxTask, "waiter", 4096, pxWaiter, uxPriority, &pxWaiter->xTask);
+    TEST_CHECK(xResult == pdPASS);
+    vTaskDelay(TEST_SETTLE_MS);
+}
+
+static void prvFillUp(RingbufHandle_t xRingbuffer)
+{
+    uint8_t pucItem[8] = { 0 };
+
+    while (xRingbufferSend(xRingbuffer, pucItem, sizeof(pucItem), 0) == pdTRUE)
+    {
+    }
+}
+
+static void prvPop(RingbufHandle_t xRingbuffer)
+{
+    size_t xSize;
+    void *pvItem = xRingbufferReceive(xRingbuffer, &xSize, 0);
+
+    TEST_CHECK(pvItem != NULL);
+    if (pvItem != NULL)
+    {
+        vRingbufferReturnItem(xRingbuffer, pvItem);
+    }
+}
+
+static void prvTestWaiters(void)
+{
+    RingbufHandle_t xRingbuffer = xRingbufferCreate(128, RINGBUF_TYPE_NOSPLIT);
+    test_waiter_t xLarge, xSmall, xLow, xHigh, xReceivers[3], xTimeout, xNotified;
+    uint8_t pucItem[8] = { 0 };
+    RingbufStats_t xBefore;
+    size_t xSize;
+    void *pvItem;
+    int i;
+
+    /* A small item that fits is not held back by a large one that does not */
+    prvFillUp(xRingbuffer);
+    prvStartWaiter(prvSenderTask, &xLarge, xRingbuffer, 40, portMAX_DELAY, 1);
+    prvStartWaiter(prvSenderTask, &xSmall, xRingbuffer, 8, portMAX_DELAY, 1);
+    prvPop(xRingbuffer);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xSmall.lDone && !xLarge.lDone);
+
+    while (!xLarge.lDone)
+    {
+        if ((pvItem = xRingbufferReceive(xRingbuffer, &xSize, 0)) != NULL)
+        {
+            vRingbufferReturnItem(xRingbuffer, pvItem);
+        }
+        vTaskDelay(1);
+    }
+    TEST_CHECK(xLarge.xResult == pdTRUE);
+    TEST_CHECK(prvStats(xRingbuffer).uxSpuriousWakeups == 0);
+    vRingbufferDelete(xRingbuffer);
+
+    /* The highest priority writer goes first */
+    xRingbuffer = xRingbufferCreate(128, RINGBUF_TYPE_NOSPLIT);
+    prvFillUp(xRingbuffer);
+    prvStartWaiter(prvSenderTask, &xLow, xRingbuffer, 8, portMAX_DELAY, 1);
+    prvStartWaiter(prvSenderTask, &xHigh, xRingbuffer, 8, portMAX_DELAY, 3);
+    prvPop(xRingbuffer);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xHigh.lDone && !xLow.lDone);
+    prvPop(xRingbuffer);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xLow.lDone);
+    vRingbufferDelete(xRingbuffer);
+
+    /* One item wakes one reader, the highest priority one */
+    xRingbuffer = xRingbufferCreate(128, RINGBUF_TYPE_NOSPLIT);
+    for (i = 0; i < 3; i++)
+    {
+        prvStartWaiter(prvReceiverTask, &xReceivers[i], xRingbuffer, 0, portMAX_DELAY, 1 + i);
+    }
+
+    xBefore = prvStats(xRingbuffer);
+    xRingbufferSend(xRingbuffer, pucItem, sizeof(pucItem), 0);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xReceivers[2].lDone && !xReceivers[1].lDone && !xReceivers[0].lDone);
+    TEST_CHECK(prvStats(xRingbuffer).uxWakeups == xBefore.uxWakeups + 1);
+
+    xRingbufferSendFromISR(xRingbuffer, pucItem, sizeof(pucItem), NULL);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xReceivers[1].lDone && !xReceivers[0].lDone);
+
+    xRingbufferSend(xRingbuffer, pucItem, sizeof(pucItem), 0);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xReceivers[0].lDone);
+    TEST_CHECK(prvStats(xRingbuffer).uxSpuriousWakeups == 0);
+
+    /* A writer that timed out is not woken any more */
+    prvFillUp(xRingbuffer);
+    prvStartWaiter(prvSenderTask, &xTimeout, xRingbuffer, 8, 10, 1);
+    TEST_CHECK(xTimeout.lDone && xTimeout.xResult == pdFALSE);
+    xBefore = prvStats(xRingbuffer);
+    prvPop(xRingbuffer);
+    TEST_CHECK(prvStats(xRingbuffer).uxWakeups == xBefore.uxWakeups);
+
+    /* A notification from elsewhere neither ends the wait nor is consumed by it */
+    prvFillUp(xRingbuffer);
+    prvStartWaiter(prvSenderTask, &xNotified, xRingbuffer, 8, portMAX_DELAY, 1);
+    xTaskNotifyGive(xNotified.xTask);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(!xNotified.lDone);
+    prvPop(xRingbuffer);
+    vTaskDelay(TEST_SETTLE_MS);
+    TEST_CHECK(xNotified.lDone && xNotified.xResult == pdTRUE);
+    TEST_CHECK(xNotified.ulNotified == 1);
+    vRingbufferDelete(xRingbuffer);
+}
+
+/*-----------------------------------------------------------*/
+
+typedef struct {
+    RingbufHandle_t xRingbuffer;
+    ringbuf_type_t xType;
+    bool bBatch;
+    uint32_t *pulNext;
+    volatile long *plReceived;
+    long lTotal;
+    int *plErrors;
+    volatile int *plDone;
+} test_consumer_t;
+
+/* The consumers share the sequence numbers, under this lock */
+static SemaphoreHandle_t xCheckMutex;
+
+static void prvConsumed(test_consumer_t *pxConsumer, const uint8_t *pucItem, size_t xSize)
+{
+    uint32_t ulSequence;
+
+    /* Several consumers: an item may be checked after a later one of the same producer */
+    xSemaphoreTake(xCheckMutex, portMAX_DELAY);
+    memcpy(&ulSequence, pucItem + 1, sizeof(ulSequence));
+    if (xSize < 5 || pucItem[0] >= 4 || ulSequence >= 4000 || pxConsumer->pulNext[pucItem[0] * 4000 + ulSequence]++ != 0)
+    {
+        (*pxConsumer->plErrors)++;
+    }
+    else
+    {
+        uint32_t ulNext[4] = { 0 };
+        ulNext[pucItem[0]] = ulSequence;
+        if (!prvCheck(pucItem, xSize, ulNext, 4, false))
+        {
+            (*pxConsumer->plErrors)++;
+        }
+    }
+    xSemaphoreGive(xCheckMutex);
+
+    __atomic_add_fetch(pxConsumer->plReceived, 1, __ATOMIC_SEQ_CST);
+}
+
+static void prvConsumerTask(void *pvParameters)
+{
+    test_consumer_t *pxConsumer = pvParameters;
+    uint8_t pucItem[TEST_ITEM_MAX];
+    RingbufItem_t xItems[4];
+    UBaseType_t uxCount, i;
+    size_t xSize;
+
+    while (__atomic_load_n(pxConsumer->plReceived, __ATOMIC_SEQ_CST) < pxConsumer->lTotal)
+    {
+        if (pxConsumer->bBatch)
+        {
+            uxCount = uxRingbufferReceiveMultiple(pxConsumer->xRingbuffer, xItems, 4, 10);
+            for (i = 0; i < uxCount; i++)
+            {
+                memcpy(pucItem, xItems[i].pvHeadItem, xItems[i].xHeadItemSize);
+                if (xItems[i].pvTailItem != NULL)
+                {
+                    memcpy(pucItem + xItems[i].xHeadItemSize, xItems[i].pvTailItem, xItems[i].xTailItemSize);
+                }
+                prvConsumed(pxConsumer, pucItem, xItems[i].xHeadItemSize + xItems[i].xTailItemSize);
+            }
+            vRingbufferReturnMultiple(pxConsumer->xRingbuffer, xItems, uxCount);
+        }
+        else if (prvReceiveJoined(pxConsumer->xRingbuffer, pxConsumer->xType, pucItem, &xSize, 10))
+        {
+            prvConsumed(pxConsumer, pucItem, xSize);
+        }
+    }
+
+    __atomic_add_fetch(pxConsumer->plDone, 1, __ATOMIC_SEQ_CST);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Several producers and consumers on one buffer, every item received exactly once.
+ */
+static void prvTestManyToMany(void)
+{
+    static uint32_t ulSeen[4 * 4000];
+    ringbuf_type_t xTypes[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT };
+    test_producer_t xProducers[4];
+    test_consumer_t xConsumers[4];
+    volatile long lReceived;
+    volatile int lDone;
+    BaseType_t xResult;
+    int lErrors, i;
+    size_t t;
+
+    xCheckMutex = xSemaphoreCreateBinary();
+    xSemaphoreGive(xCheckMutex);
+
+    for (t = 0; t < 2; t++)
+    {
+        RingbufHandle_t xRingbuffer = xRingbufferCreate(600, xTypes[t]);
+
+        memset(ulSeen, 0, sizeof(ulSeen));
+        lReceived = 0;
+        lDone = 0;
+        lErrors = 0;
+
+        for (i = 0; i < 4; i++)
+        {
+            xConsumers[i] = (test_consumer_t) { xRingbuffer, xTypes[t], i == 0, ulSeen, &lReceived, 4 * 4000, &lErrors, &lDone };
+            xResult = xTaskCreate(prvConsumerTask, "cons", 4096, &xConsumers[i], tskIDLE_PRIORITY + 1 + i % 3, NULL);
+            TEST_CHECK(xResult == pdPASS);
+        }
+
+        prvStartProducers(xProducers, 4, xRingbuffer, xTypes[t], 4000, false, true, &lDone);
+        prvWaitFor(&lDone, 8);
+
+        TEST_CHECK(lErrors == 0);
+        TEST_CHECK(lReceived == 4 * 4000);
+        TEST_CHECK(prvItemsWaiting(xRingbuffer) == 0);
+        vRingbufferDelete(xRingbuffer);
+    }
+
+    vSemaphoreDelete(xCheckMutex);
+}
+
+/*-----------------------------------------------------------*/
+
+static const test_t xTests[] = {
+    { "nosplit_wraparound",     prvTestNoSplitWraparound },
+    { "allowsplit_wraparound",  prvTestAllowSplitWraparound },
+    { "byte_wraparound",        prvTestByteWraparound },
+    { "dummy_data",             prvTestDummyData },
+    { "full_buffer",            prvTestFullBuffer },
+    { "full_buffer_held",       prvTestFullBufferHeld },
+    { "spsc",                   prvTestSPSC },
+    { "acquire_complete",       prvTestAcquireComplete },
+    { "batch",                  prvTestBatch },
+    { "overwrite",              prvTestOverwrite },
+    { "broadcast",              prvTestBroadcast },
+    { "broadcast_pinned",       prvTestBroadcastPinned },
+    { "broadcast_stress",       prvTestBroadcastStress },
+    { "waiters",                prvTestWaiters },
+    { "many_to_many",           prvTestManyToMany },
+};
+
+int main(int argc, char **argv)
+{
+    size_t i;
+    int lFailed = 0, lRun = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    for (i = 0; i < sizeof(xTests) / sizeof(xTests[0]); i++)
+    {
+        if (argc > 1 && strcmp(argv[1], xTests[i].name) != 0)
+        {
+            continue;
+        }
+
+        lTestFailures = 0;
+        xTests[i].test();
+        lRun++;
+
+        printf("%-24s %s\n", xTests[i].name, lTestFailures == 0 ? "OK" : "FAILED");
+        lFailed += lTestFailures != 0;
+    }
+
+    if (lRun == 0)
+    {
+        printf("Unknown test %s\n", argv[1]);
+        return 2;
+    }
+
+    return lFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file uart.h
+ * @brief Host stub of the UART driver: the subset used by m5stickc_user_input.c,
+ * faked by test_user_input.c.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _DRIVER_UART_H_
+#define _DRIVER_UART_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int uart_port_t;
+
+#define UART_NUM_0          ( 0 )
+
+typedef enum
+{
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct
+{
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+int uart_read_bytes( uart_port_t uart_num,
+                     uint8_t * buf,
+                     uint32_t length,
+                     TickType_t ticks_to_wait );
+esp_err_t uart_flush_input( uart_port_t uart_num );
+esp_err_t uart_get_buffered_data_len( uart_port_t uart_num,
+                                      size_t * size );
+
+#endif /* _DRIVER_UART_H_ */
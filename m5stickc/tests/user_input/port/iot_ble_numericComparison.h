@@ -0,0 +1,25 @@
+/**
+ * @file iot_ble_numericComparison.h
+ * @brief Host stub: the message type of the BLE numeric comparison of Amazon FreeRTOS.
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#ifndef _IOT_BLE_NUMERIC_COMPARISON_H_
+#define _IOT_BLE_NUMERIC_COMPARISON_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct
+{
+    uint8_t * pcData;
+    uint32_t xDataSize;
+} INPUTMessage_t;
+
+BaseType_t getUserMessage( INPUTMessage_t * pxINPUTmessage,
+                           TickType_t xAuthTimeout );
+
+#endif /* _IOT_BLE_NUMERIC_COMPARISON_H_ */
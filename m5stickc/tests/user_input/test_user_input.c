@@ -0,0 +1,273 @@
+/**
+ * @file test_user_input.c
+ * @brief Soak test of getUserMessage (m5stickc_user_input.c), built on the host.
+ *
+ * The UART driver is faked: an event announces the bytes the user typed, the
+ * reads and the flush take them from a buffer. The heap is counted: every
+ * block returned by pvPortMalloc and not given back to vPortFree yet. The test
+ * answers the messages as the BLE numeric comparison does, and checks that no
+ * block is left behind and that every block has the same size, so that the
+ * heap stays flat however long the device runs.
+ *
+ *      test_user_input            run every test
+ *      test_user_input <name>     run one test, see xTests
+ *
+ * (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+ * This code is licensed under the MIT License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "iot_ble_numericComparison.h"
+
+#include "m5stickc_mem.h"
+#include "m5stickc_user_input.h"
+
+/*-----------------------------------------------------------*/
+
+#define TEST_CHECK(x)                                                           \
+    do {                                                                        \
+        if (!(x))                                                               \
+        {                                                                       \
+            printf("    %s:%d: check failed: %s\n", __FILE__, __LINE__, #x);    \
+            lTestFailures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+/* Longest input of the tests, larger than the block on purpose */
+#define TEST_INPUT_MAX          ( 200 )
+
+#define TEST_SOAK_MESSAGES      ( 200000 )
+
+typedef struct {
+    const char *name;
+    void (*test)(void);
+} test_t;
+
+static int lTestFailures = 0;
+
+QueueHandle_t spp_uart_queue = NULL;
+
+/*-----------------------------------------------------------*/
+
+/* Fake UART driver: one pending event, and the bytes it announced */
+static bool bEventPending = false;
+static uart_event_t xPendingEvent;
+static uint8_t pucInput[TEST_INPUT_MAX];
+static size_t xInputLength = 0;
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+    if (!bEventPending)
+    {
+        return pdFALSE;
+    }
+
+    bEventPending = false;
+    memcpy(pvBuffer, &xPendingEvent, sizeof(xPendingEvent));
+
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+    return bEventPending ? 1 : 0;
+}
+
+int uart_read_bytes(uart_port_t uart_num, uint8_t *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    size_t xRead = (length < xInputLength) ? length : xInputLength;
+
+    memcpy(buf, pucInput, xRead);
+    memmove(pucInput, pucInput + xRead, xInputLength - xRead);
+    xInputLength -= xRead;
+
+    return (int)xRead;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    xInputLength = 0;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    *size = xInputLength;
+    return ESP_OK;
+}
+
+/* The user typed xSize bytes, of which only xKept are still in the driver */
+static void prvType(uart_event_type_t xType, size_t xSize, size_t xKept, unsigned int *puSeed)
+{
+    size_t i;
+
+    for (i = 0; i < xKept; i++)
+    {
+        pucInput[i] = (uint8_t)('!' + rand_r(puSeed) % 90);
+    }
+
+    xInputLength = xKept;
+    xPendingEvent = (uart_event_t) { xType, xSize, false };
+    bEventPending = true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Counted heap */
+static size_t xLiveBlocks = 0, xPeakBlocks = 0, xAllocations = 0, xOtherSizes = 0;
+static uint32_t ulCounted = 0;
+
+void *pvPortMalloc(size_t xSize)
+{
+    xAllocations++;
+    xOtherSizes += (xSize != M5STICKC_USER_MESSAGE_LENGTH);
+    xLiveBlocks++;
+    xPeakBlocks = (xLiveBlocks > xPeakBlocks) ? xLiveBlocks : xPeakBlocks;
+
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv)
+{
+    if (pv != NULL)
+    {
+        xLiveBlocks--;
+    }
+
+    free(pv);
+}
+
+void m5stickc_mem_count(m5stickc_mem_tag_t tag)
+{
+    if (tag == M5STICKC_MEM_USER_MESSAGE)
+    {
+        ulCounted++;
+    }
+}
+
+static void prvResetHeap(void)
+{
+    xLiveBlocks = 0;
+    xPeakBlocks = 0;
+    xAllocations = 0;
+    xOtherSizes = 0;
+    ulCounted = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Many messages of any length, some lost by the driver or of another
+ * event type: every block is freed, all blocks have the same size.
+ */
+static void prvTestSoak(void)
+{
+    unsigned int uSeed = 1;
+    INPUTMessage_t xMessage;
+    size_t xSize, xKept, xAnswered = 0, xExpected, xLeaks = 0, xLeftovers = 0, xBadMessages = 0;
+    uint8_t ucFirst;
+    uart_event_type_t xType;
+    uint32_t i;
+
+    prvResetHeap();
+
+    for (i = 0; i < TEST_SOAK_MESSAGES; i++)
+    {
+        xSize = rand_r(&uSeed) % (TEST_INPUT_MAX + 1);
+        /* Now and then the driver lost the bytes, or the event is another one */
+        xKept = (rand_r(&uSeed) % 16 == 0) ? 0 : xSize;
+        xType = (rand_r(&uSeed) % 16 == 0) ? UART_BREAK : UART_DATA;
+        prvType(xType, xSize, xKept, &uSeed);
+        ucFirst = pucInput[0];
+
+        xMessage.pcData = NULL;
+
+        if (getUserMessage(&xMessage, 10) == pdTRUE)
+        {
+            /* As the numeric comparison does: look at the first character, free the block */
+            xExpected = (xSize < M5STICKC_USER_MESSAGE_LENGTH) ? xSize : M5STICKC_USER_MESSAGE_LENGTH - 1;
+            xBadMessages += (xMessage.pcData[0] != ucFirst || strlen((char *)xMessage.pcData) != xExpected);
+            vPortFree(xMessage.pcData);
+            xAnswered++;
+        }
+        else
+        {
+            TEST_CHECK(xMessage.pcData == NULL);
+        }
+
+        /* The block was freed, and a message leaves nothing in the driver for the next one */
+        xLeaks += (xLiveBlocks != 0);
+        xLeftovers += (xType == UART_DATA && xInputLength != 0);
+        xInputLength = 0;
+    }
+
+    TEST_CHECK(xAnswered > TEST_SOAK_MESSAGES / 2);
+    TEST_CHECK(xBadMessages == 0);
+    TEST_CHECK(xLeaks == 0);
+    TEST_CHECK(xLeftovers == 0);
+    TEST_CHECK(xLiveBlocks == 0);
+    TEST_CHECK(xPeakBlocks == 1);
+    TEST_CHECK(xOtherSizes == 0);
+    TEST_CHECK(ulCounted == xAllocations);
+}
+
+/**
+ * @brief Nothing typed: no message and no allocation.
+ */
+static void prvTestTimeout(void)
+{
+    INPUTMessage_t xMessage = { NULL, 0 };
+
+    prvResetHeap();
+    bEventPending = false;
+
+    TEST_CHECK(getUserMessage(&xMessage, 10) == pdFALSE);
+    TEST_CHECK(xMessage.pcData == NULL);
+    TEST_CHECK(xAllocations == 0);
+}
+
+/*-----------------------------------------------------------*/
+
+static const test_t xTests[] = {
+    { "soak",                   prvTestSoak },
+    { "timeout",                prvTestTimeout },
+};
+
+int main(int argc, char **argv)
+{
+    size_t i;
+    int lFailed = 0, lRun = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    for (i = 0; i < sizeof(xTests) / sizeof(xTests[0]); i++)
+    {
+        if (argc > 1 && strcmp(argv[1], xTests[i].name) != 0)
+        {
+            continue;
+        }
+
+        lTestFailures = 0;
+        xTests[i].test();
+        lRun++;
+
+        printf("%-24s %s\n", xTests[i].name, lTestFailures == 0 ? "OK" : "FAILED");
+        lFailed += lTestFailures != 0;
+    }
+
+    if (lRun == 0)
+    {
+        printf("Unknown test %s\n", argv[1]);
+        return 2;
+    }
+
+    return lFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+#
+# Decode the binary log records of m5stickc_log.c.
+#
+# The lines starting with '~' are decoded with the format strings found in the
+# ELF file of the image, the other lines are printed as they are:
+#
+#   idf.py monitor | python m5stickc_log_decode.py build/aws_demos.elf
+#   python m5stickc_log_decode.py build/aws_demos.elf capture.log
+#
+# Requires pyelftools (pip install pyelftools), which comes with ESP-IDF.
+#
+# (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+# This code is licensed under the MIT License.
+
+from __future__ import print_function
+
+import argparse
+import base64
+import binascii
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+from elftools.elf.constants import SH_FLAGS
+
+HEADER = struct.Struct('<IBII')
+TRUNCATED = 0x80
+LEVELS = {1: 'E', 2: 'W', 3: 'I', 4: 'D', 5: 'V'}
+
+# %[flags][width][.precision][length]conversion
+CONVERSION = re.compile(r'%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcspfFeEgGaAn%])')
+
+
+class Strings(object):
+    """ The strings of the allocated sections of the image, by address. """
+
+    def __init__(self, path):
+        self.sections = []
+        with open(path, 'rb') as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section['sh_flags'] & SH_FLAGS.SHF_ALLOC and section['sh_type'] == 'SHT_PROGBITS':
+                    self.sections.append((section['sh_addr'], section.data()))
+
+    def get(self, address):
+        for start, data in self.sections:
+            if start <= address < start + len(data):
+                end = data.find(b'\0', address - start)
+                return data[address - start:end].decode('utf-8', 'replace')
+        return None
+
+
+def decode_arguments(fmt, data):
+    """ Return the Python format and the arguments, following the same rules as prvPutArguments. """
+    arguments = []
+    pieces = []
+    offset = [0]
+    position = 0
+
+    def take(size, code):
+        if offset[0] + size > len(data):
+            raise IndexError
+        value = struct.unpack_from(code, data, offset[0])[0]
+        offset[0] += size
+        return value
+
+    for match in CONVERSION.finditer(fmt):
+        flags, width, precision, length, conversion = match.groups()
+        pieces.append(fmt[position:match.start()].replace('%', '%%'))
+        position = match.end()
+
+        if conversion == '%':
+            pieces.append('%%')
+            continue
+
+        try:
+            if width == '*':
+                width = str(take(4, '<i'))
+            if precision == '*':
+                precision = str(take(4, '<i'))
+
+            if conversion == 's':
+                size = take(1, '<B')
+                value = data[offset[0]:offset[0] + size].decode('utf-8', 'replace')
+                offset[0] += size
+            elif conversion in 'fFeEgGaA':
+                value = take(8, '<d')
+                if conversion in 'aA':
+                    conversion = 'e'
+            elif length in ('ll', 'j'):
+                value = take(8, '<q' if conversion in 'di' else '<Q')
+            else:
+                value = take(4, '<i' if conversion in 'di' else '<I')
+        except IndexError:
+            pieces.append('<?>')
+            continue
+
+        if conversion == 'p':
+            flags, width, conversion = '#0', '10', 'x'
+        if conversion == 's' and precision:
+            # The device already applied the precision, the string is not terminated
+            precision = ''
+
+        pieces.append('%' + flags + width + ('.' + precision if precision else '') + conversion)
+        arguments.append(value)
+
+    pieces.append(fmt[position:].replace('%', '%%'))
+
+    return ''.join(pieces), tuple(arguments)
+
+
+def decode_line(strings, line):
+    record = base64.b64decode(line[1:].strip())
+    time, level, tag, fmt = HEADER.unpack_from(record)
+    tag = strings.get(tag) or '0x%08x' % tag
+    fmt_string = strings.get(fmt)
+
+    if fmt_string is None:
+        message = '<unknown format 0x%08x, is this the right ELF?>' % fmt
+    else:
+        python_fmt, arguments = decode_arguments(fmt_string, record[HEADER.size:])
+        try:
+            message = python_fmt % arguments
+        except (TypeError, ValueError):
+            message = '%s %r' % (fmt_string, arguments)
+
+    return '%s (%u) %s: %s%s' % (LEVELS.get(level & ~TRUNCATED, '?'), time, tag, message,
+                                 ' [truncated]' if level & TRUNCATED else '')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the binary log records of m5stickc_log.c')
+    parser.add_argument('elf', help='ELF file of the running image')
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='captured serial output (default: stdin)')
+    args = parser.parse_args()
+
+    strings = Strings(args.elf)
+
+    for line in args.log:
+        if line.startswith('~'):
+            try:
+                line = decode_line(strings, line) + '\n'
+            except (binascii.Error, struct.error, ValueError):
+                pass
+        sys.stdout.write(line)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
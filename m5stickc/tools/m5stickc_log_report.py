@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+#
+# Report the log call sites removed at compile time by the per-module levels
+# of m5stickc_lab_config.h (M5CONFIG_LOG_LEVEL_*), compared with the global
+# CONFIG_LOG_DEFAULT_LEVEL of sdkconfig.
+#
+#   python m5stickc_log_report.py [--call-cycles N]
+#
+# The flash figure is the size of the format strings of the removed calls,
+# before the linker merges identical strings, plus the call sequence itself
+# (--call-bytes). A call site that survives the compile-time check but is
+# filtered at runtime still costs a call to esp_log_write and a lookup of the
+# level of its tag: measure it once with xthal_get_ccount() around an
+# ESP_LOGD of a tag lowered with esp_log_level_set, and pass it as
+# --call-cycles to get the cycles saved per pass through the removed sites.
+#
+# (C) 2019 - Timothee Cruse <timothee.cruse@gmail.com>
+# This code is licensed under the MIT License.
+
+from __future__ import print_function
+
+import argparse
+import ast
+import glob
+import os
+import re
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+APPLICATION_CODE = os.path.join(HERE, '..', 'aws_demos', 'application_code')
+SDKCONFIG = os.path.join(HERE, '..', 'aws_demos', 'sdkconfig')
+LAB_CONFIG = os.path.join(APPLICATION_CODE, 'm5stickc_lab_config.h')
+
+LEVELS = ['ESP_LOG_NONE', 'ESP_LOG_ERROR', 'ESP_LOG_WARN', 'ESP_LOG_INFO', 'ESP_LOG_DEBUG', 'ESP_LOG_VERBOSE']
+LETTERS = 'NEWIDV'
+
+CALL = re.compile(r'\b(?:ESP|M5)_LOG([EWIDV])\s*\(\s*\w+\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"(?:[^"\\]|\\.)*"')
+LOCAL_LEVEL = re.compile(r'^#define\s+LOG_LOCAL_LEVEL\s+(\w+)', re.M)
+CONFIG_LEVEL = re.compile(r'^#define\s+(M5CONFIG_LOG_LEVEL_\w+)\s+(\w+)', re.M)
+
+
+def level_value(name, config):
+    name = config.get(name, name)
+    if name in LEVELS:
+        return LEVELS.index(name)
+    return int(name)
+
+
+def default_level():
+    with open(SDKCONFIG) as f:
+        match = re.search(r'^CONFIG_LOG_DEFAULT_LEVEL=(\d+)', f.read(), re.M)
+    return int(match.group(1)) if match else 3
+
+
+def format_length(literals):
+    return sum(len(ast.literal_eval(literal).encode('utf-8')) for literal in LITERAL.findall(literals)) + 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report the log calls removed by the per-module log levels')
+    parser.add_argument('--call-bytes', type=int, default=12,
+                        help='code size of one log call sequence (default: %(default)s)')
+    parser.add_argument('--call-cycles', type=int, default=0,
+                        help='measured cost of a log call filtered at runtime')
+    args = parser.parse_args()
+
+    with open(LAB_CONFIG) as f:
+        config = dict(CONFIG_LEVEL.findall(f.read()))
+
+    baseline = default_level()
+    totals = [0, 0, 0, 0]
+
+    print('%-36s %-6s %5s %8s %8s %8s' % ('Module', 'Level', 'Calls', 'Kept', 'Removed', 'Bytes'))
+
+    for path in sorted(glob.glob(os.path.join(APPLICATION_CODE, '*.c'))):
+        with open(path) as f:
+            source = f.read()
+
+        match = LOCAL_LEVEL.search(source)
+        level = level_value(match.group(1), config) if match else baseline
+
+        calls = kept = removed = removed_bytes = 0
+
+        for letter, literals in CALL.findall(source):
+            call_level = LETTERS.index(letter)
+            calls += 1
+
+            if call_level <= level:
+                kept += 1
+            elif call_level <= baseline:
+                # Only removed thanks to the per-module level
+                removed += 1
+                removed_bytes += format_length(literals) + args.call_bytes
+
+        if calls == 0:
+            continue
+
+        print('%-36s %-6s %5u %8u %8u %8u' % (os.path.basename(path), LETTERS[level], calls, kept, removed, removed_bytes))
+
+        totals[0] += calls
+        totals[1] += kept
+        totals[2] += removed
+        totals[3] += removed_bytes
+
+    print('%-36s %-6s %5u %8u %8u %8u' % ('Total', '', totals[0], totals[1], totals[2], totals[3]))
+    print()
+    print('Flash removed compared with CONFIG_LOG_DEFAULT_LEVEL (%s): %u bytes in %u call sites'
+          % (LETTERS[baseline], totals[3], totals[2]))
+
+    if args.call_cycles:
+        print('Cycles saved per pass through the removed call sites: %u' % (totals[2] * args.call_cycles))
+    else:
+        print('Pass --call-cycles to estimate the cycles saved on the hot path')
+
+
+if __name__ == '__main__':
+    main()